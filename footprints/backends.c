@@ -0,0 +1,55 @@
+/* Output backends for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#include "backends.h"
+#include "eagle.h"
+#include "geometry.h"
+#include "kicad.h"
+#include "preview.h"
+
+#include <unistd.h>
+
+const footprint_writer_t footprint_writers[] = {
+    {"kicad", "kicad_mod", write_kicad_footprint},
+    {"kicad-legacy", "kicad_mod", write_kicad_legacy_footprint},
+    {"eagle", "lbr", write_eagle_library},
+    {"svg", "svg", write_svg_footprint},
+    {"png", "png", write_png_footprint},
+};
+
+static const int num_footprint_writers = sizeof(footprint_writers) / sizeof(footprint_writers[0]);
+
+const footprint_writer_t* find_footprint_writer(const char* name) {
+    for (int i = 0; i < num_footprint_writers; i++) {
+        if (strcmp(footprint_writers[i].name, name) == 0) {
+            return &footprint_writers[i];
+        }
+    }
+    return NULL;
+}
+
+// Format already generated geometry into a freshly allocated buffer
+char* render_footprint(footprint_geometry_t* geom, const component_spec_t* spec, footprint_options_t* opts,
+                       const footprint_writer_t* writer, size_t* size) {
+    char* data = NULL;
+    FILE* f = open_memstream(&data, size);
+    if (!f) return NULL;
+
+    TRACE_START(t_writer);
+    writer->write(f, geom, spec, opts);
+    fclose(f);
+    TRACE_STOP(t_writer, STAGE_WRITER, *size);
+    return data;
+}
+
+// Generate and format a KiCad footprint into a freshly allocated buffer
+char* render_kicad_footprint(const component_spec_t* spec, footprint_options_t* opts, size_t* size) {
+    footprint_geometry_t* geom = generate_geometry(spec, opts);
+    if (!geom) return NULL;
+
+    char* data = render_footprint(geom, spec, opts, &footprint_writers[0], size);
+    free_geometry(geom);
+    return data;
+}
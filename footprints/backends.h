@@ -0,0 +1,26 @@
+/* Output backends for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#ifndef PLCC_BACKENDS_H
+#define PLCC_BACKENDS_H
+
+#include "plcc-gen.h"
+
+typedef struct {
+    const char* name;
+    const char* extension;
+    void (*write)(FILE* f, footprint_geometry_t* geom, const component_spec_t* spec, footprint_options_t* opts);
+} footprint_writer_t;
+
+#define MAX_OUTPUT_FORMATS 8
+
+extern const footprint_writer_t footprint_writers[];
+
+const footprint_writer_t* find_footprint_writer(const char* name);
+char* render_footprint(footprint_geometry_t* geom, const component_spec_t* spec, footprint_options_t* opts,
+                       const footprint_writer_t* writer, size_t* size);
+char* render_kicad_footprint(const component_spec_t* spec, footprint_options_t* opts, size_t* size);
+
+#endif
@@ -0,0 +1,501 @@
+/* Benchmarks for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#include "bench.h"
+#include "catalog.h"
+#include "geometry.h"
+#include "header-model.h"
+#include "kicad.h"
+#include "mesh-analysis.h"
+#include "mesh.h"
+#include "precompiled.h"
+#include "scad.h"
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Each case is run for a number of warm-up iterations and then timed
+// repeatedly. Results go to stdout as JSON lines (one case per line) so
+// runs from different commits can be compared with --bench-compare.
+
+#define BENCH_WARMUP_DIVISOR 10
+#define BENCH_WRITE_BUFFER (16 << 20)
+#define BENCH_MODEL_DIVISOR 10   // plug bodies are written in tens of ms
+#define BENCH_SCAD_DIVISOR 100  // renders take a second, not microseconds
+
+typedef struct {
+    int iterations;
+    const char* filter;    // substring a case name must contain, or NULL
+    FILE* out;
+    double* samples;
+    int cases;
+} bench_t;
+
+typedef int (*bench_fn_t)(void* ctx);
+
+static volatile long bench_sink;
+
+// Returns the median, or -1 if the case was filtered out
+static double bench_case(bench_t* b, const char* name, bench_fn_t fn, void* ctx) {
+    if (b->filter && !strstr(name, b->filter)) return -1;
+
+    int warmup = b->iterations / BENCH_WARMUP_DIVISOR + 1;
+    for (int i = 0; i < warmup; i++) {
+        bench_sink += fn(ctx);
+    }
+
+    double total = 0;
+    for (int i = 0; i < b->iterations; i++) {
+        double start = monotonic_us();
+        bench_sink += fn(ctx);
+        b->samples[i] = monotonic_us() - start;
+        total += b->samples[i];
+    }
+    qsort(b->samples, b->iterations, sizeof(double), compare_double);
+
+    int n = b->iterations;
+    fprintf(b->out, "{\"case\":\"%s\",\"iterations\":%d,\"median_us\":%.3f,\"p95_us\":%.3f,"
+                    "\"min_us\":%.3f,\"mean_us\":%.3f}\n",
+            name, n, b->samples[(n - 1) / 2], b->samples[(n - 1) * 95 / 100],
+            b->samples[0], total / n);
+    fflush(b->out);
+    fprintf(stderr, "%-48s %10.2f %10.2f us\n", name, b->samples[(n - 1) / 2], b->samples[(n - 1) * 95 / 100]);
+    b->cases++;
+    return b->samples[(n - 1) / 2];
+}
+
+typedef struct {
+    const component_spec_t* spec;
+    footprint_options_t opts;
+    footprint_geometry_t* geom;
+    char* buffer;
+} bench_footprint_t;
+
+static int bench_geometry(void* ctx) {
+    bench_footprint_t* c = ctx;
+    footprint_geometry_t* geom = generate_geometry(c->spec, &c->opts);
+    int n = geom ? geom->pad_count : 0;
+    free_geometry(geom);
+    return n;
+}
+
+static int bench_writer(void* ctx) {
+    bench_footprint_t* c = ctx;
+    FILE* f = fmemopen(c->buffer, BENCH_WRITE_BUFFER, "w");
+    if (!f) return 0;
+    write_kicad_footprint(f, c->geom, c->spec, &c->opts);
+    int n = (int)ftell(f);
+    fclose(f);
+    return n;
+}
+
+static int bench_precompiled(void* ctx) {
+    bench_footprint_t* c = ctx;
+    size_t size = 0;
+    char* data = precompiled_footprint(c->spec, &c->opts, &size);
+    free(data);
+    return (int)size;
+}
+
+static void bench_footprint(bench_t* b, const component_spec_t* spec, footprint_options_t* opts, const char* variant) {
+    bench_footprint_t c = { .spec = spec, .opts = *opts };
+    char name[128];
+
+    snprintf(name, sizeof(name), "geometry/%s/%s", spec->name, variant);
+    bench_case(b, name, bench_geometry, &c);
+
+    c.geom = generate_geometry(spec, opts);
+    c.buffer = malloc(BENCH_WRITE_BUFFER);
+    if (c.geom && c.buffer) {
+        snprintf(name, sizeof(name), "writer/%s/%s", spec->name, variant);
+        bench_case(b, name, bench_writer, &c);
+    }
+    free(c.buffer);
+    free_geometry(c.geom);
+
+    size_t size = 0;
+    char* data = precompiled_footprint(spec, opts, &size);
+    if (data) {
+        snprintf(name, sizeof(name), "precompiled/%s/%s", spec->name, variant);
+        bench_case(b, name, bench_precompiled, &c);
+    }
+    free(data);
+}
+
+// Carrier scaled from the APW9328 body proportions
+static void make_synthetic_spec(component_spec_t* spec, int pins_x, int pins_y) {
+    memset(spec, 0, sizeof(*spec));
+    spec->pins_x = pins_x;
+    spec->pins_y = pins_y;
+    spec->pins = 2 * (pins_x + pins_y);
+    spec->pitch = 1.27;
+    spec->body.a = pins_x * spec->pitch + 9.93;
+    spec->body.b = pins_x * spec->pitch + 0.83;
+    spec->body.c = pins_y * spec->pitch + 9.93;
+    spec->body.d = pins_y * spec->pitch + 0.83;
+    spec->pad_width = 0.9;
+    snprintf(spec->name, sizeof(spec->name), "SYNTH%d", spec->pins);
+}
+
+typedef struct {
+    model_t model;
+    const mesh_writer_t* writer;
+    char* buffer;
+} bench_model_t;
+
+static int bench_model_write(void* ctx) {
+    bench_model_t* c = ctx;
+    FILE* f = fmemopen(c->buffer, BENCH_WRITE_BUFFER, "w");
+    if (!f) return 0;
+    c->writer->write(f, &c->model);
+    int n = (int)ftell(f);
+    fclose(f);
+    return n;
+}
+
+// The plug bodies of plccplug.scad, rendered natively once per size, through
+// every mesh writer
+static void bench_models(bench_t* b, const char* root) {
+    char path[4096], pins[32], name[128];
+    char* defines[] = { pins, "scale_factor=1" };
+    bench_t s = *b;
+
+    snprintf(path, sizeof(path), "%s/plccplug.scad", root);
+    if (access(path, R_OK) != 0) return;
+    char* buffer = malloc(BENCH_WRITE_BUFFER);
+    if (!buffer) return;
+    s.iterations = b->iterations / BENCH_MODEL_DIVISOR;
+    if (s.iterations < 1) s.iterations = 1;
+
+    for (int i = 0; i < num_component_specs; i++) {
+        bench_model_t c = { .buffer = buffer };
+        mesh_t mesh = {0};
+        int pin_count = component_specs[i].pins;
+
+        // Rendering takes longer than the writes, so only for sizes that run
+        int wanted = 0;
+        for (int w = 0; w < num_mesh_writers; w++) {
+            snprintf(name, sizeof(name), "model_write/%s/%dpin", mesh_writers[w].name, pin_count);
+            wanted |= !b->filter || strstr(name, b->filter);
+        }
+        if (!wanted) continue;
+
+        snprintf(pins, sizeof(pins), "output_pins=%d", pin_count);
+        snprintf(c.model.name, sizeof(c.model.name), "PLCCplug-%dpin", pin_count);
+        model_part_t* part = model_add_part(&c.model, "body", 0.97647, 0.843137, 0.172549);
+        if (part && scad_render(path, defines, 2, 1, &mesh) == 0 &&
+            mesh_append(&part->mesh, &mesh, &transform_identity) == 0) {
+            for (int w = 0; w < num_mesh_writers; w++) {
+                c.writer = &mesh_writers[w];
+                snprintf(name, sizeof(name), "model_write/%s/%dpin", c.writer->name, pin_count);
+                bench_case(&s, name, bench_model_write, &c);
+            }
+        }
+        mesh_free(&mesh);
+        model_free(&c.model);
+    }
+    b->cases = s.cases;
+    free(buffer);
+}
+
+typedef struct {
+    const plug_spec_t* plug;
+    int bend_segments;
+} bench_header_t;
+
+static int bench_header_mesh(void* ctx) {
+    bench_header_t* c = ctx;
+    model_t model;
+    if (build_header_model(&model, c->plug, c->bend_segments) < 0) return 0;
+    int n = (int)model_triangle_count(&model);
+    model_free(&model);
+    return n;
+}
+
+static void bench_header_models(bench_t* b) {
+    for (int i = 0; i < num_plug_specs; i++) {
+        bench_header_t c = { .plug = &plug_specs[i], .bend_segments = DEFAULT_BEND_SEGMENTS };
+        char name[128];
+
+        snprintf(name, sizeof(name), "header_mesh/%dpin", c.plug->pins);
+        bench_case(b, name, bench_header_mesh, &c);
+
+        bench_model_t m = { .buffer = malloc(BENCH_WRITE_BUFFER) };
+        if (m.buffer && build_header_model(&m.model, c.plug, c.bend_segments) == 0) {
+            for (int w = 0; w < num_mesh_writers; w++) {
+                m.writer = &mesh_writers[w];
+                snprintf(name, sizeof(name), "header_write/%s/%dpin", m.writer->name, c.plug->pins);
+                bench_case(b, name, bench_model_write, &m);
+            }
+            model_free(&m.model);
+        }
+        free(m.buffer);
+    }
+}
+
+static int bench_quote_file(void* ctx) {
+    mesh_stats_t* parts = NULL;
+    int count = 0;
+    const char* format;
+    if (analyse_stl(ctx, &parts, &count, &format) < 0) return 0;
+    free(parts);
+    return count;
+}
+
+static void bench_quotes(bench_t* b, const char* root) {
+    char path[4096], name[128];
+    for (int i = 0; i <= num_component_specs; i++) {
+        if (i < num_component_specs) {
+            snprintf(path, sizeof(path), "%s/PLCCplug.stl/PLCCplug-%dpin.stl", root, component_specs[i].pins);
+            snprintf(name, sizeof(name), "quote/stl/%dpin", component_specs[i].pins);
+        } else {
+            snprintf(path, sizeof(path), "%s/PLCCplug.stl/PLCCplug_all_versions.stl", root);
+            snprintf(name, sizeof(name), "quote/stl/all_versions");
+        }
+        if (access(path, R_OK) == 0) bench_case(b, name, bench_quote_file, path);
+    }
+}
+
+typedef struct {
+    char path[4096];
+    const char* openscad;
+    char output[64];
+    char* defines[2];
+    char pins[32];
+} bench_scad_t;
+
+static int bench_scad_native(void* ctx) {
+    bench_scad_t* c = ctx;
+    mesh_t mesh = {0};
+    int n = scad_render(c->path, c->defines, 2, 1, &mesh) < 0 ? 0 : mesh.triangle_count;
+    mesh_free(&mesh);
+    return n;
+}
+
+// The same render by OpenSCAD, as the Makefile runs it for the STL models
+static int bench_scad_openscad(void* ctx) {
+    bench_scad_t* c = ctx;
+    char* argv[] = { (char*)c->openscad, "-D", c->defines[0], "-D", c->defines[1],
+                     c->path, "-o", c->output, NULL };
+    posix_spawn_file_actions_t actions;
+    pid_t pid;
+    int status;
+
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, 1, "/dev/null", O_WRONLY, 0);
+    posix_spawn_file_actions_addopen(&actions, 2, "/dev/null", O_WRONLY, 0);
+    int err = posix_spawnp(&pid, c->openscad, &actions, NULL, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    if (err != 0) return -1;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) return -1;
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 1 : -1;
+}
+
+// plccplug.scad rendered natively and, if it can be run, by OpenSCAD, so
+// the two can be compared on the same machine
+static void bench_scad(bench_t* b, const char* root, const char* openscad) {
+    static const int pins[] = { 20, 84 };
+    bench_scad_t c = { .openscad = openscad, .output = "/tmp/plcc-bench-XXXXXX.stl" };
+    bench_t s = *b;
+    char name[128];
+
+    snprintf(c.path, sizeof(c.path), "%s/plccplug.scad", root);
+    if (access(c.path, R_OK) != 0) return;
+    s.iterations = b->iterations / BENCH_SCAD_DIVISOR;
+    if (s.iterations < 1) s.iterations = 1;
+
+    int fd = openscad ? mkstemps(c.output, 4) : -1;
+    if (fd >= 0) close(fd);
+    c.defines[0] = c.pins;
+    c.defines[1] = "scale_factor=1";
+
+    for (size_t i = 0; i < sizeof(pins) / sizeof(pins[0]); i++) {
+        snprintf(c.pins, sizeof(c.pins), "output_pins=%d", pins[i]);
+        snprintf(name, sizeof(name), "scad/native/%dpin", pins[i]);
+        double native = bench_case(&s, name, bench_scad_native, &c);
+
+        snprintf(name, sizeof(name), "scad/openscad/%dpin", pins[i]);
+        if (fd < 0 || (b->filter && !strstr(name, b->filter))) continue;
+        if (bench_scad_openscad(&c) < 0) {
+            fprintf(stderr, "%-48s skipped, %s did not run\n", name, openscad);
+            fd = -1;
+            continue;
+        }
+        double external = bench_case(&s, name, bench_scad_openscad, &c);
+        if (native > 0) {
+            fprintf(stderr, "%-48s %10.1fx\n", "  native speedup", external / native);
+        }
+    }
+    b->cases = s.cases;
+    if (openscad) unlink(c.output);
+}
+
+typedef struct {
+    char dir[4096];
+    catalog_t catalog;
+    catalog_query_t query;
+    int* matches;
+} bench_catalog_t;
+
+static int bench_catalog_index(void* ctx) {
+    bench_catalog_t* c = ctx;
+    catalog_t none = {0};
+    catalog_builder_t b;
+    catalog_counts_t counts;
+    char* dirs[] = { c->dir };
+    int n = catalog_build(&b, &none, dirs, 1, &counts) < 0 ? 0 : b.count;
+    catalog_builder_free(&b);
+    return n;
+}
+
+static int bench_catalog_query(void* ctx) {
+    bench_catalog_t* c = ctx;
+    return catalog_query(&c->catalog, &c->query, c->matches);
+}
+
+// Full scan of the library, and a range query on its index
+static void bench_catalog(bench_t* b, const char* root) {
+    bench_catalog_t c = { .query = { .pins_lo = 0, .pins_hi = INT64_MAX } };
+    char index[] = "/tmp/plcc-bench-XXXXXX";
+    snprintf(c.dir, sizeof(c.dir), "%s/PLCCplug.pretty", root);
+    if (access(c.dir, R_OK) != 0) return;
+    bench_case(b, "catalog/index", bench_catalog_index, &c);
+
+    int fd = mkstemp(index);
+    if (fd < 0) return;
+    close(fd);
+    char* dirs[] = { c.dir };
+    char pins[] = "pins=44..84", size[] = "size<=30", type[] = "type=tht";
+    catalog_builder_t builder;
+    catalog_counts_t counts;
+    catalog_t none = {0};
+    if (catalog_build(&builder, &none, dirs, 1, &counts) == 0 && catalog_write(index, &builder) == 0 &&
+        catalog_open(index, &c.catalog) == 0 && (c.matches = malloc(builder.count * sizeof(int)))) {
+        parse_catalog_term(&c.query, pins);
+        parse_catalog_term(&c.query, size);
+        parse_catalog_term(&c.query, type);
+        bench_case(b, "catalog/query", bench_catalog_query, &c);
+    }
+    free(c.matches);
+    catalog_close(&c.catalog);
+    catalog_builder_free(&builder);
+    unlink(index);
+}
+
+int run_benchmarks(int iterations, const char* filter, const char* root, const char* openscad) {
+    static const struct {
+        const char* name;
+        int double_sided, via_outside;
+    } variants[] = {
+        {"double", 1, 0},
+        {"double_via_outside", 1, 1},
+        {"single", 0, 0},
+        {"single_via_outside", 0, 1},
+    };
+    static const int synthetic_sides[] = { 33, 49, 65, 97 };
+
+    bench_t b = {
+        .iterations = iterations > 0 ? iterations : BENCH_DEFAULT_ITERATIONS,
+        .filter = filter,
+        .out = stdout,
+    };
+    b.samples = malloc(b.iterations * sizeof(double));
+    if (!b.samples) {
+        fprintf(stderr, "Error: out of memory\n");
+        return 1;
+    }
+
+    fprintf(stderr, "%-48s %10s %10s\n", "case", "median", "p95");
+
+    for (int v = 0; v < 4; v++) {
+        footprint_options_t opts = { variants[v].double_sided, variants[v].via_outside, {0} };
+        generate_timestamp(opts.timestamp, sizeof(opts.timestamp));
+
+        for (int i = 0; i < num_component_specs; i++) {
+            bench_footprint(&b, &component_specs[i], &opts, variants[v].name);
+        }
+        for (size_t i = 0; i < sizeof(synthetic_sides) / sizeof(synthetic_sides[0]); i++) {
+            component_spec_t spec;
+            make_synthetic_spec(&spec, synthetic_sides[i], synthetic_sides[i]);
+            bench_footprint(&b, &spec, &opts, variants[v].name);
+        }
+    }
+
+    bench_models(&b, root);
+    bench_header_models(&b);
+    bench_quotes(&b, root);
+    bench_catalog(&b, root);
+    bench_scad(&b, root, openscad);
+
+    free(b.samples);
+    return b.cases ? 0 : 1;
+}
+
+typedef struct {
+    char name[128];
+    double median_us;
+} bench_baseline_t;
+
+// Compare a fresh run (current) against an older one (baseline). Cases whose
+// median got slower by more than threshold percent count as regressions.
+int compare_benchmarks(const char* baseline_path, const char* current_path, double threshold) {
+    bench_baseline_t* base = NULL;
+    int nbase = 0, capacity = 0;
+    char line[512];
+
+    FILE* f = fopen(baseline_path, "r");
+    if (!f) {
+        perror("Error opening baseline");
+        return 1;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        if (grow_array((void**)&base, &capacity, nbase + 1, sizeof(*base)) < 0) {
+            fprintf(stderr, "Error: out of memory\n");
+            fclose(f);
+            free(base);
+            return 1;
+        }
+        if (sscanf(line, "{\"case\":\"%127[^\"]\",\"iterations\":%*d,\"median_us\":%lf",
+                   base[nbase].name, &base[nbase].median_us) == 2) {
+            nbase++;
+        }
+    }
+    fclose(f);
+
+    f = fopen(current_path, "r");
+    if (!f) {
+        perror("Error opening benchmark results");
+        free(base);
+        return 1;
+    }
+
+    int regressions = 0;
+    printf("%-48s %10s %10s %8s\n", "case", "before", "after", "change");
+    while (fgets(line, sizeof(line), f)) {
+        char name[128];
+        double median;
+        if (sscanf(line, "{\"case\":\"%127[^\"]\",\"iterations\":%*d,\"median_us\":%lf", name, &median) != 2) {
+            continue;
+        }
+        for (int i = 0; i < nbase; i++) {
+            if (strcmp(base[i].name, name) != 0) continue;
+            double change = base[i].median_us > 0 ? (median / base[i].median_us - 1) * 100 : 0;
+            int slower = change > threshold;
+            regressions += slower;
+            printf("%-48s %10.2f %10.2f %+7.1f%%%s\n", name, base[i].median_us, median, change,
+                   slower ? "  REGRESSION" : "");
+            break;
+        }
+    }
+    fclose(f);
+    free(base);
+
+    printf("%d regression%s above %.0f%%\n", regressions, regressions == 1 ? "" : "s", threshold);
+    return regressions ? 1 : 0;
+}
@@ -0,0 +1,16 @@
+/* Benchmarks for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#ifndef PLCC_BENCH_H
+#define PLCC_BENCH_H
+
+#include "plcc-gen.h"
+
+#define BENCH_DEFAULT_ITERATIONS 200
+
+int run_benchmarks(int iterations, const char* filter, const char* root, const char* openscad);
+int compare_benchmarks(const char* baseline_path, const char* current_path, double threshold);
+
+#endif
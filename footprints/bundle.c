@@ -0,0 +1,758 @@
+/* Library bundles for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#include "bundle.h"
+#include "precompiled.h"
+
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <dirent.h>
+
+// The library (footprints, 3D models and STLs) as one file for syncing to
+// other machines. Each distinct content is stored once under its FNV-1a
+// hash, packed with the LZ coder of the precompiled footprints. The member
+// table sorted by name and the blob table sorted by hash come first, so
+// --bundle-extract maps the file, finds a member with two binary searches
+// and unpacks only that member. A delta bundle has the same layout but
+// leaves out the blobs its base bundle already holds and stores changed
+// files as copy and insert instructions against the base member of the
+// same name; --bundle-apply rebuilds the new bundle byte for byte and
+// checks it against the id the delta recorded.
+
+#define BUNDLE_MAGIC "PLCCBDL"
+#define BUNDLE_VERSION 1
+#define DELTA_WINDOW 16         // shortest copy worth an instruction
+#define DELTA_STEP 4            // spacing of the indexed base positions
+#define DELTA_HASH_BITS 18
+#define DELTA_MAX_SIZE (1u << 30)
+
+static const char* const bundle_default_dirs[] = { "PLCCplug.pretty", "PLCCplug.3dshapes", "PLCCplug.stl" };
+
+enum {
+    BLOB_STORED,                // as is
+    BLOB_PACKED,                // lz_pack
+    BLOB_DELTA,                 // lz_pack of instructions against the blob base
+    BLOB_IN_BASE,               // delta bundles: held by the base bundle
+    BLOB_ENCODINGS
+};
+
+static const char* const blob_encodings[] = { "stored", "packed", "delta", "in-base" };
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t member_count;
+    uint32_t blob_count;
+    uint32_t names_size;
+    uint64_t id;                // names and contents, see bundle_id
+    uint64_t base_id;           // delta bundles: id of the base, else 0
+} bundle_header_t;
+
+typedef struct {
+    uint32_t name;              // offset into the names
+    uint32_t blob;
+} bundle_member_t;
+
+typedef struct {
+    uint64_t hash;              // FNV-1a of the contents
+    uint64_t size;
+    uint64_t base;              // BLOB_DELTA: hash of the base contents
+    uint64_t offset;            // of the stored bytes in the file
+    uint64_t stored_size;
+    uint32_t encoding;
+    uint32_t delta_size;        // BLOB_DELTA: size of the unpacked instructions
+} bundle_blob_t;
+
+typedef struct {
+    const char* path;
+    const bundle_header_t* header;
+    const bundle_member_t* members;
+    const bundle_blob_t* blobs;
+    const char* names;
+    const uint8_t* map;
+    size_t map_size;
+} bundle_t;
+
+typedef struct {
+    char* name;
+    uint8_t* data;
+    size_t size;
+    uint64_t hash;
+} bundle_file_t;
+
+static void bundle_close(bundle_t* b) {
+    if (b->map) munmap((void*)b->map, b->map_size);
+    memset(b, 0, sizeof(*b));
+}
+
+static int bundle_open(const char* path, bundle_t* b) {
+    memset(b, 0, sizeof(*b));
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        fprintf(stderr, "Error: %s: %s\n", path, strerror(errno));
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    // Not populated: extracting one member only touches its pages
+    void* map = (size_t)st.st_size >= sizeof(bundle_header_t) ?
+                mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Error: %s: not a bundle\n", path);
+        return -1;
+    }
+    b->path = path;
+    b->map = map;
+    b->map_size = st.st_size;
+    b->header = map;
+
+    const bundle_header_t* h = b->header;
+    size_t tables = sizeof(*h) + (size_t)h->member_count * sizeof(bundle_member_t) +
+                    (size_t)h->blob_count * sizeof(bundle_blob_t) + h->names_size;
+    int ok = memcmp(h->magic, BUNDLE_MAGIC, sizeof(h->magic)) == 0 && h->version == BUNDLE_VERSION &&
+             tables <= b->map_size;
+    if (ok) {
+        b->members = (const bundle_member_t*)(h + 1);
+        b->blobs = (const bundle_blob_t*)(b->members + h->member_count);
+        b->names = (const char*)(b->blobs + h->blob_count);
+        ok = h->names_size == 0 ? h->member_count == 0 : b->names[h->names_size - 1] == '\0';
+    }
+    for (uint32_t i = 0; ok && i < h->member_count; i++)
+        ok = b->members[i].name < h->names_size && b->members[i].blob < h->blob_count;
+    for (uint32_t i = 0; ok && i < h->blob_count; i++) {
+        const bundle_blob_t* blob = &b->blobs[i];
+        if (blob->encoding == BLOB_IN_BASE) ok = h->base_id != 0 && blob->stored_size == 0;
+        else ok = blob->encoding < BLOB_ENCODINGS && blob->offset >= tables && blob->offset <= b->map_size &&
+                  blob->stored_size <= b->map_size - blob->offset;
+    }
+    if (!ok) {
+        fprintf(stderr, "Error: %s: not a bundle\n", path);
+        bundle_close(b);
+        return -1;
+    }
+    return 0;
+}
+
+// Index of the member called name, or -1
+static int bundle_find_member(const bundle_t* b, const char* name) {
+    int lo = 0, hi = b->header->member_count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        int cmp = strcmp(b->names + b->members[mid].name, name);
+        if (cmp == 0) return mid;
+        if (cmp < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return -1;
+}
+
+// Index of the blob with this content hash, or -1
+static int bundle_find_blob(const bundle_t* b, uint64_t hash) {
+    int lo = 0, hi = b->header->blob_count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (b->blobs[mid].hash == hash) return mid;
+        if (b->blobs[mid].hash < hash) lo = mid + 1;
+        else hi = mid;
+    }
+    return -1;
+}
+
+static uint8_t* put_varint(uint8_t* out, uint64_t v) {
+    for (; v >= 0x80; v >>= 7) *out++ = (uint8_t)(v | 0x80);
+    *out++ = (uint8_t)v;
+    return out;
+}
+
+static int get_varint(const uint8_t** p, const uint8_t* end, uint64_t* v) {
+    *v = 0;
+    for (int shift = 0; shift < 64 && *p < end; shift += 7) {
+        uint8_t c = *(*p)++;
+        *v |= (uint64_t)(c & 0x7f) << shift;
+        if (!(c & 0x80)) return 0;
+    }
+    return -1;
+}
+
+static uint32_t delta_hash(const uint8_t* p) {
+    uint64_t a, b;
+    memcpy(&a, p, sizeof(a));
+    memcpy(&b, p + sizeof(a), sizeof(b));
+    return (uint32_t)((a * 0x9e3779b97f4a7c15ULL ^ b * 0xc2b2ae3d27d4eb4fULL) >> (64 - DELTA_HASH_BITS));
+}
+
+// Instructions rebuilding target from base: runs of inserted bytes, each
+// followed by a copy from base (varint length and offset), a copy length
+// of zero ending the stream. out needs 2 * size + 32 bytes; returns 0 if
+// out of memory.
+static size_t delta_encode(const uint8_t* base, size_t base_size, const uint8_t* target, size_t size, uint8_t* out) {
+    uint32_t* table = calloc((size_t)1 << DELTA_HASH_BITS, sizeof(uint32_t));   // position + 1
+    if (!table) return 0;
+    for (size_t i = 0; i + DELTA_WINDOW <= base_size; i += DELTA_STEP) table[delta_hash(base + i)] = i + 1;
+
+    uint8_t* o = out;
+    size_t anchor = 0, i = 0;
+    while (i + DELTA_WINDOW <= size) {
+        size_t candidate = table[delta_hash(target + i)];
+        if (!candidate || memcmp(base + candidate - 1, target + i, DELTA_WINDOW) != 0) {
+            i++;
+            continue;
+        }
+        size_t from = candidate - 1, len = DELTA_WINDOW;
+        while (i + len < size && from + len < base_size && base[from + len] == target[i + len]) len++;
+        // Only every DELTA_STEP position is indexed, so the match may
+        // start a little earlier
+        while (i > anchor && from > 0 && base[from - 1] == target[i - 1]) {
+            i--;
+            from--;
+            len++;
+        }
+        o = put_varint(o, i - anchor);
+        memcpy(o, target + anchor, i - anchor);
+        o += i - anchor;
+        o = put_varint(o, len);
+        o = put_varint(o, from);
+        i += len;
+        anchor = i;
+    }
+    o = put_varint(o, size - anchor);
+    memcpy(o, target + anchor, size - anchor);
+    o += size - anchor;
+    o = put_varint(o, 0);
+    free(table);
+    return o - out;
+}
+
+// Returns 0 if the instructions rebuild exactly size bytes
+static int delta_decode(const uint8_t* in, size_t in_size, const uint8_t* base, size_t base_size,
+                        uint8_t* out, size_t size) {
+    const uint8_t* end = in + in_size;
+    size_t o = 0;
+    for (;;) {
+        uint64_t insert, copy, from;
+        if (get_varint(&in, end, &insert) < 0 || insert > (uint64_t)(end - in) || insert > size - o) return -1;
+        memcpy(out + o, in, insert);
+        in += insert;
+        o += insert;
+        if (get_varint(&in, end, &copy) < 0) return -1;
+        if (copy == 0) return in == end && o == size ? 0 : -1;
+        if (get_varint(&in, end, &from) < 0 || from > base_size || copy > base_size - from || copy > size - o)
+            return -1;
+        memcpy(out + o, base + from, copy);
+        o += copy;
+    }
+}
+
+// Contents of blob i, checked against its hash. base resolves the
+// BLOB_DELTA and BLOB_IN_BASE blobs of a delta bundle. Caller frees.
+static uint8_t* bundle_read(const bundle_t* b, int i, const bundle_t* base) {
+    const bundle_blob_t* blob = &b->blobs[i];
+    const uint8_t* stored = b->map + blob->offset;
+    int ref = -1;
+
+    if (blob->encoding == BLOB_DELTA || blob->encoding == BLOB_IN_BASE) {
+        ref = base ? bundle_find_blob(base, blob->encoding == BLOB_DELTA ? blob->base : blob->hash) : -1;
+        if (ref < 0) {
+            fprintf(stderr, "Error: %s: blob %016llx needs the base bundle\n", b->path, (unsigned long long)blob->hash);
+            return NULL;
+        }
+        if (blob->encoding == BLOB_IN_BASE) return bundle_read(base, ref, NULL);
+    }
+
+    uint8_t* data = malloc(blob->size ? blob->size : 1);
+    if (!data) {
+        fprintf(stderr, "Error: out of memory\n");
+        return NULL;
+    }
+    int ok = 0;
+    if (blob->encoding == BLOB_STORED) {
+        ok = blob->stored_size == blob->size;
+        if (ok) memcpy(data, stored, blob->size);
+    } else if (blob->encoding == BLOB_PACKED) {
+        ok = lz_unpack(stored, blob->stored_size, data, blob->size) == 0;
+    } else {
+        uint8_t* original = bundle_read(base, ref, NULL);
+        uint8_t* ops = malloc(blob->delta_size ? blob->delta_size : 1);
+        ok = original && ops && lz_unpack(stored, blob->stored_size, ops, blob->delta_size) == 0 &&
+             delta_decode(ops, blob->delta_size, original, base->blobs[ref].size, data, blob->size) == 0;
+        free(original);
+        free(ops);
+    }
+    if (!ok || hash_bytes(data, blob->size) != blob->hash) {
+        fprintf(stderr, "Error: %s: blob %016llx is damaged\n", b->path, (unsigned long long)blob->hash);
+        free(data);
+        return NULL;
+    }
+    return data;
+}
+
+static void bundle_files_free(bundle_file_t* files, int count) {
+    for (int i = 0; i < count; i++) {
+        free(files[i].name);
+        free(files[i].data);
+    }
+    free(files);
+}
+
+// Every member of b, with base for a delta bundle; returns the count or -1
+static int bundle_files(const bundle_t* b, const bundle_t* base, bundle_file_t** files) {
+    int count = b->header->member_count;
+    *files = calloc(count ? count : 1, sizeof(bundle_file_t));
+    if (!*files) return -1;
+    for (int i = 0; i < count; i++) {
+        const bundle_blob_t* blob = &b->blobs[b->members[i].blob];
+        bundle_file_t* f = &(*files)[i];
+        f->name = strdup(b->names + b->members[i].name);
+        f->data = bundle_read(b, b->members[i].blob, base);
+        f->size = blob->size;
+        f->hash = blob->hash;
+        if (!f->name || !f->data) {
+            bundle_files_free(*files, count);
+            return -1;
+        }
+    }
+    return count;
+}
+
+// Regular files in dir as members named after the last component of dir
+static int bundle_add_directory(bundle_file_t** files, int* count, int* capacity, const char* dir) {
+    size_t dir_len = strlen(dir);
+    while (dir_len > 1 && dir[dir_len - 1] == '/') dir_len--;
+    const char* prefix = dir + dir_len;
+    while (prefix > dir && prefix[-1] != '/') prefix--;
+    int prefix_len = (int)(dir + dir_len - prefix);
+
+    DIR* d = opendir(dir);
+    if (!d) {
+        fprintf(stderr, "Error: %s: %s\n", dir, strerror(errno));
+        return -1;
+    }
+    int ret = 0;
+    struct dirent* de;
+    while (ret == 0 && (de = readdir(d))) {
+        if (de->d_name[0] == '.') continue;
+        char path[4096], name[4096];
+        struct stat st;
+        snprintf(path, sizeof(path), "%.*s/%s", (int)dir_len, dir, de->d_name);
+        snprintf(name, sizeof(name), "%.*s/%s", prefix_len, prefix, de->d_name);
+        if (stat(path, &st) < 0 || !S_ISREG(st.st_mode)) continue;
+        if (grow_array((void**)files, capacity, *count + 1, sizeof(bundle_file_t)) < 0) {
+            ret = -1;
+            break;
+        }
+        bundle_file_t* f = &(*files)[*count];
+        f->data = (uint8_t*)read_file(path, &f->size);
+        f->name = strdup(name);
+        if (!f->data || !f->name) {
+            fprintf(stderr, "Error: %s: %s\n", path, strerror(errno));
+            free(f->data);
+            free(f->name);
+            ret = -1;
+            break;
+        }
+        f->hash = hash_bytes(f->data, f->size);
+        (*count)++;
+    }
+    closedir(d);
+    return ret;
+}
+
+// Same for a bundle and the delta bundle that rebuilds it: the encodings
+// are left out
+static uint64_t bundle_id(const bundle_file_t* files, int count) {
+    size_t size = 0;
+    for (int i = 0; i < count; i++) size += strlen(files[i].name) + 1 + sizeof(uint64_t);
+    char* buffer = malloc(size ? size : 1);
+    if (!buffer) return 0;
+    char* p = buffer;
+    for (int i = 0; i < count; i++) {
+        size_t len = strlen(files[i].name) + 1;
+        memcpy(p, files[i].name, len);
+        memcpy(p + len, &files[i].hash, sizeof(uint64_t));
+        p += len + sizeof(uint64_t);
+    }
+    uint64_t id = hash_bytes(buffer, size);
+    free(buffer);
+    return id;
+}
+
+// Smallest encoding of f; *out receives the bytes to store
+static int bundle_encode(bundle_blob_t* blob, const bundle_file_t* f, const bundle_t* base, uint8_t** out) {
+    if (base && bundle_find_blob(base, f->hash) >= 0) {
+        blob->encoding = BLOB_IN_BASE;
+        return 0;
+    }
+    uint8_t* packed = malloc(f->size + f->size / 255 + 16);
+    if (!packed) {
+        fprintf(stderr, "Error: out of memory\n");
+        return -1;
+    }
+    size_t packed_size = lz_pack(f->data, f->size, packed);
+    if (packed_size < f->size) {
+        blob->encoding = BLOB_PACKED;
+        blob->stored_size = packed_size;
+    } else {
+        memcpy(packed, f->data, f->size);
+        blob->encoding = BLOB_STORED;
+        blob->stored_size = f->size;
+    }
+    *out = packed;
+
+    int m = base ? bundle_find_member(base, f->name) : -1;
+    if (m < 0 || f->size > DELTA_MAX_SIZE || base->blobs[base->members[m].blob].size > DELTA_MAX_SIZE) return 0;
+    const bundle_blob_t* ref = &base->blobs[base->members[m].blob];
+    uint8_t* original = bundle_read(base, base->members[m].blob, NULL);
+    if (!original) return -1;
+    uint8_t* ops = malloc(2 * f->size + 32);
+    size_t ops_size = ops ? delta_encode(original, ref->size, f->data, f->size, ops) : 0;
+    uint8_t* packed_ops = ops_size ? malloc(ops_size + ops_size / 255 + 16) : NULL;
+    int ret = packed_ops ? 0 : -1;
+    if (!packed_ops) {
+        fprintf(stderr, "Error: out of memory\n");
+    } else {
+        size_t n = lz_pack(ops, ops_size, packed_ops);
+        if (n < blob->stored_size) {
+            free(*out);
+            *out = packed_ops;
+            packed_ops = NULL;
+            blob->encoding = BLOB_DELTA;
+            blob->base = ref->hash;
+            blob->stored_size = n;
+            blob->delta_size = ops_size;
+        }
+    }
+    free(packed_ops);
+    free(ops);
+    free(original);
+    return ret;
+}
+
+static int compare_bundle_files(const void* a, const void* b) {
+    return strcmp(((const bundle_file_t*)a)->name, ((const bundle_file_t*)b)->name);
+}
+
+static const bundle_file_t* sort_bundle_files;
+
+static int compare_bundle_hashes(const void* a, const void* b) {
+    const bundle_file_t* x = &sort_bundle_files[*(const int*)a];
+    const bundle_file_t* y = &sort_bundle_files[*(const int*)b];
+    if (x->hash != y->hash) return x->hash < y->hash ? -1 : 1;
+    return *(const int*)a - *(const int*)b;
+}
+
+// Write files (sorted here) to path, as a delta bundle against base unless
+// that is NULL. The layout only depends on the names and contents, so a
+// bundle rebuilt from a delta is identical to the original.
+static int bundle_write(const char* path, bundle_file_t* files, int count, const bundle_t* base) {
+    qsort(files, count, sizeof(bundle_file_t), compare_bundle_files);
+    size_t names_size = 0;
+    for (int i = 0; i < count; i++) {
+        if (i > 0 && strcmp(files[i - 1].name, files[i].name) == 0) {
+            fprintf(stderr, "Error: %s: duplicate member %s\n", path, files[i].name);
+            return -1;
+        }
+        names_size += strlen(files[i].name) + 1;
+    }
+    if (names_size > UINT32_MAX) {
+        fprintf(stderr, "Error: %s: too many members\n", path);
+        return -1;
+    }
+
+    int n = count ? count : 1;
+    bundle_member_t* members = calloc(n, sizeof(bundle_member_t));
+    bundle_blob_t* blobs = calloc(n, sizeof(bundle_blob_t));
+    uint8_t** stored = calloc(n, sizeof(uint8_t*));
+    int* order = malloc(n * sizeof(int));
+    int* first = malloc(n * sizeof(int));     // a file holding each blob
+    char* names = malloc(names_size ? names_size : 1);
+    int blob_count = 0, ret = -1;
+    FILE* f = NULL;
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    if (!members || !blobs || !stored || !order || !first || !names) {
+        fprintf(stderr, "Error: out of memory\n");
+        goto out;
+    }
+
+    size_t at = 0;
+    for (int i = 0; i < count; i++) {
+        size_t len = strlen(files[i].name) + 1;
+        memcpy(names + at, files[i].name, len);
+        members[i].name = at;
+        at += len;
+        order[i] = i;
+    }
+    sort_bundle_files = files;
+    qsort(order, count, sizeof(int), compare_bundle_hashes);
+    for (int k = 0; k < count; k++) {
+        const bundle_file_t* file = &files[order[k]];
+        if (blob_count && blobs[blob_count - 1].hash == file->hash) {
+            const bundle_file_t* other = &files[first[blob_count - 1]];
+            if (other->size != file->size || memcmp(other->data, file->data, file->size) != 0) {
+                fprintf(stderr, "Error: %s and %s have the same hash\n", other->name, file->name);
+                goto out;
+            }
+        } else {
+            blobs[blob_count].hash = file->hash;
+            blobs[blob_count].size = file->size;
+            first[blob_count++] = order[k];
+        }
+        members[order[k]].blob = blob_count - 1;
+    }
+
+    uint64_t offset = sizeof(bundle_header_t) + (uint64_t)count * sizeof(bundle_member_t) +
+                      (uint64_t)blob_count * sizeof(bundle_blob_t) + names_size;
+    for (int i = 0; i < blob_count; i++) {
+        if (bundle_encode(&blobs[i], &files[first[i]], base, &stored[i]) < 0) goto out;
+        if (blobs[i].encoding == BLOB_IN_BASE) continue;
+        blobs[i].offset = offset;
+        offset += blobs[i].stored_size;
+    }
+
+    f = fopen(tmp, "wb");
+    if (!f) {
+        fprintf(stderr, "Error: %s: %s\n", tmp, strerror(errno));
+        goto out;
+    }
+    bundle_header_t h = {
+        .magic = BUNDLE_MAGIC,
+        .version = BUNDLE_VERSION,
+        .member_count = count,
+        .blob_count = blob_count,
+        .names_size = names_size,
+        .id = bundle_id(files, count),
+        .base_id = base ? base->header->id : 0,
+    };
+    int ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+             fwrite(members, sizeof(bundle_member_t), count, f) == (size_t)count &&
+             fwrite(blobs, sizeof(bundle_blob_t), blob_count, f) == (size_t)blob_count &&
+             fwrite(names, 1, names_size, f) == names_size;
+    for (int i = 0; i < blob_count && ok; i++)
+        ok = fwrite(stored[i], 1, blobs[i].stored_size, f) == blobs[i].stored_size;
+    if (fclose(f) != 0) ok = 0;
+    // Readers keep their mapping of the old file
+    if (!ok || rename(tmp, path) < 0) {
+        fprintf(stderr, "Error: %s: %s\n", path, strerror(errno));
+        unlink(tmp);
+        goto out;
+    }
+    ret = 0;
+
+out:
+    for (int i = 0; i < blob_count; i++) free(stored[i]);
+    free(stored);
+    free(members);
+    free(blobs);
+    free(order);
+    free(first);
+    free(names);
+    return ret;
+}
+
+static void bundle_report(const char* path) {
+    bundle_t b;
+    if (bundle_open(path, &b) < 0) return;
+    int counts[BLOB_ENCODINGS] = { 0 };
+    uint64_t size = 0;
+    for (uint32_t i = 0; i < b.header->blob_count; i++) {
+        counts[b.blobs[i].encoding]++;
+        size += b.blobs[i].size;
+    }
+    fprintf(stderr, "%s: %u members, %u blobs (%d packed, %d stored, %d delta, %d in base); "
+            "%zu bytes for %llu\n", path, b.header->member_count, b.header->blob_count, counts[BLOB_PACKED],
+            counts[BLOB_STORED], counts[BLOB_DELTA], counts[BLOB_IN_BASE], b.map_size, (unsigned long long)size);
+    bundle_close(&b);
+}
+
+// Bundle dirs, or the model directories under root
+int run_bundle(const char* path, char** dirs, int ndirs, const char* root) {
+    bundle_file_t* files = NULL;
+    int count = 0, capacity = 0, ret = 0;
+    int n = ndirs ? ndirs : (int)(sizeof(bundle_default_dirs) / sizeof(bundle_default_dirs[0]));
+    for (int i = 0; i < n && ret == 0; i++) {
+        char dir[4096];
+        if (ndirs) snprintf(dir, sizeof(dir), "%s", dirs[i]);
+        else snprintf(dir, sizeof(dir), "%s/%s", root, bundle_default_dirs[i]);
+        ret = bundle_add_directory(&files, &count, &capacity, dir);
+    }
+    if (ret == 0) ret = bundle_write(path, files, count, NULL);
+    if (ret == 0) bundle_report(path);
+    bundle_files_free(files, count);
+    return ret < 0;
+}
+
+int run_bundle_list(const char* path) {
+    bundle_t b;
+    if (bundle_open(path, &b) < 0) return 1;
+    for (uint32_t i = 0; i < b.header->member_count; i++) {
+        const bundle_blob_t* blob = &b.blobs[b.members[i].blob];
+        printf("{\"name\":\"%s\",\"size\":%llu,\"stored\":%llu,\"encoding\":\"%s\",\"hash\":\"%016llx\"}\n",
+               b.names + b.members[i].name, (unsigned long long)blob->size, (unsigned long long)blob->stored_size,
+               blob_encodings[blob->encoding], (unsigned long long)blob->hash);
+    }
+    bundle_close(&b);
+    return 0;
+}
+
+// Member names are relative paths without empty, . or .. components
+static int bundle_safe_name(const char* name) {
+    for (const char* p = name;; p++) {
+        size_t len = strcspn(p, "/");
+        if (len == 0 || (len == 1 && p[0] == '.') || (len == 2 && p[0] == '.' && p[1] == '.')) return 0;
+        p += len;
+        if (!*p) return 1;
+    }
+}
+
+// Write one member below root, unless the file there already has its
+// contents; returns 1 if written
+static int bundle_extract_member(const bundle_t* b, int m, const char* root) {
+    const char* name = b->names + b->members[m].name;
+    const bundle_blob_t* blob = &b->blobs[b->members[m].blob];
+    char path[4096], tmp[4096 + 16];
+    if (!bundle_safe_name(name)) {
+        fprintf(stderr, "Error: %s: refusing to extract %s\n", b->path, name);
+        return -1;
+    }
+    snprintf(path, sizeof(path), "%s/%s", root, name);
+
+    struct stat st;
+    if (stat(path, &st) == 0 && (uint64_t)st.st_size == blob->size) {
+        size_t size = 0;
+        char* old = read_file(path, &size);
+        int same = old && size == blob->size && hash_bytes(old, size) == blob->hash;
+        free(old);
+        if (same) return 0;
+    }
+    for (char* p = path + strlen(root) + 1; (p = strchr(p, '/')); p++) {
+        *p = '\0';
+        int err = mkdir(path, 0777) < 0 && errno != EEXIST;
+        *p = '/';
+        if (err) {
+            fprintf(stderr, "Error: %s: %s\n", path, strerror(errno));
+            return -1;
+        }
+    }
+
+    uint8_t* data = bundle_read(b, b->members[m].blob, NULL);
+    if (!data) return -1;
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE* f = fopen(tmp, "wb");
+    int ok = f && fwrite(data, 1, blob->size, f) == blob->size;
+    if (f && fclose(f) != 0) ok = 0;
+    free(data);
+    if (!ok || rename(tmp, path) < 0) {
+        fprintf(stderr, "Error: %s: %s\n", path, strerror(errno));
+        unlink(tmp);
+        return -1;
+    }
+    return 1;
+}
+
+// Named members to outfile or stdout, or without names every member below
+// root
+int run_bundle_extract(const char* path, char** names, int nnames, const char* root, const char* outfile) {
+    bundle_t b;
+    if (bundle_open(path, &b) < 0) return 1;
+    int ret = 0;
+    if (b.header->base_id) {
+        fprintf(stderr, "Error: %s: delta bundle, apply it with --bundle-apply first\n", path);
+        ret = 1;
+    } else if (nnames > 1 && outfile) {
+        fprintf(stderr, "Error: --outfile takes a single member\n");
+        ret = 1;
+    } else if (nnames) {
+        FILE* f = outfile ? fopen(outfile, "wb") : stdout;
+        if (!f) {
+            fprintf(stderr, "Error: %s: %s\n", outfile, strerror(errno));
+            ret = 1;
+        }
+        for (int i = 0; i < nnames && ret == 0; i++) {
+            int m = bundle_find_member(&b, names[i]);
+            if (m < 0) {
+                fprintf(stderr, "Error: %s: no member %s\n", path, names[i]);
+                ret = 1;
+                break;
+            }
+            const bundle_blob_t* blob = &b.blobs[b.members[m].blob];
+            uint8_t* data = bundle_read(&b, b.members[m].blob, NULL);
+            ret = !data || fwrite(data, 1, blob->size, f) != blob->size;
+            free(data);
+        }
+        if (f && fclose(f) != 0) ret = 1;
+    } else {
+        int written = 0;
+        for (uint32_t i = 0; i < b.header->member_count && ret == 0; i++) {
+            int status = bundle_extract_member(&b, i, root);
+            if (status < 0) ret = 1;
+            else written += status;
+        }
+        if (ret == 0)
+            fprintf(stderr, "%s: %u members, %d written, %u unchanged\n", path, b.header->member_count, written,
+                    b.header->member_count - written);
+    }
+    bundle_close(&b);
+    return ret;
+}
+
+int run_bundle_delta(const char* old_path, const char* new_path, const char* outfile) {
+    bundle_t old, new;
+    if (!outfile) {
+        fprintf(stderr, "Error: --bundle-delta needs --outfile\n");
+        return 1;
+    }
+    if (bundle_open(old_path, &old) < 0) return 1;
+    if (bundle_open(new_path, &new) < 0) {
+        bundle_close(&old);
+        return 1;
+    }
+    int ret = 1;
+    bundle_file_t* files = NULL;
+    int count = -1;
+    if (old.header->base_id || new.header->base_id)
+        fprintf(stderr, "Error: deltas are made between full bundles\n");
+    else if ((count = bundle_files(&new, NULL, &files)) >= 0 && bundle_write(outfile, files, count, &old) == 0)
+        ret = 0;
+    if (ret == 0) bundle_report(outfile);
+    if (count >= 0) bundle_files_free(files, count);
+    bundle_close(&new);
+    bundle_close(&old);
+    return ret;
+}
+
+int run_bundle_apply(const char* old_path, const char* delta_path, const char* outfile) {
+    bundle_t old, delta, result;
+    if (!outfile) {
+        fprintf(stderr, "Error: --bundle-apply needs --outfile\n");
+        return 1;
+    }
+    if (bundle_open(old_path, &old) < 0) return 1;
+    if (bundle_open(delta_path, &delta) < 0) {
+        bundle_close(&old);
+        return 1;
+    }
+    int ret = 1;
+    bundle_file_t* files = NULL;
+    int count = -1;
+    if (old.header->base_id) {
+        fprintf(stderr, "Error: %s: not a full bundle\n", old_path);
+    } else if (delta.header->base_id != old.header->id) {
+        fprintf(stderr, "Error: %s was made against %016llx, not %016llx\n", delta_path,
+                (unsigned long long)delta.header->base_id, (unsigned long long)old.header->id);
+    } else if ((count = bundle_files(&delta, &old, &files)) >= 0 && bundle_write(outfile, files, count, NULL) == 0 &&
+               bundle_open(outfile, &result) == 0) {
+        ret = result.header->id != delta.header->id;
+        if (ret) fprintf(stderr, "Error: %s: rebuilt bundle does not match the delta\n", outfile);
+        bundle_close(&result);
+    }
+    if (ret == 0) bundle_report(outfile);
+    if (count >= 0) bundle_files_free(files, count);
+    bundle_close(&delta);
+    bundle_close(&old);
+    return ret;
+}
@@ -0,0 +1,17 @@
+/* Library bundles for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#ifndef PLCC_BUNDLE_H
+#define PLCC_BUNDLE_H
+
+#include "plcc-gen.h"
+
+int run_bundle(const char* path, char** dirs, int ndirs, const char* root);
+int run_bundle_list(const char* path);
+int run_bundle_extract(const char* path, char** names, int nnames, const char* root, const char* outfile);
+int run_bundle_delta(const char* old_path, const char* new_path, const char* outfile);
+int run_bundle_apply(const char* old_path, const char* delta_path, const char* outfile);
+
+#endif
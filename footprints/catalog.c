@@ -0,0 +1,697 @@
+/* Library catalog for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#include "catalog.h"
+#include "preview.h"
+
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <fnmatch.h>
+
+// Parametric index over .pretty directories. --index scans them into one
+// file: a header, a fixed size record per footprint sorted by pin count,
+// the directory list and a string table. --find maps the file and answers
+// range queries with a binary search on the pin count and a scan of the
+// records in that range. Rescans reuse a record while size and mtime are
+// unchanged, or while the content hash still matches, and only parse the
+// files that really changed. Lengths are stored in micrometres so queries
+// compare integers.
+
+#define CATALOG_MAGIC "PLCCIDX"
+#define CATALOG_VERSION 1
+
+enum {
+    CATALOG_SMD = 1,            // pad types present
+    CATALOG_THT = 2,
+    CATALOG_NPTH = 4,
+    CATALOG_VIAS = 8,           // unnumbered copper pads
+    CATALOG_NO_COURTYARD = 16,  // courtyard taken from the body or the pads
+};
+
+typedef struct {
+    char name[16];
+    point_t at;
+} catalog_pad_t;
+
+static const struct {
+    const char* name;
+    int length;                 // given in mm, stored in um
+} catalog_fields[FIELD_COUNT] = {
+    [FIELD_PINS]        = {"pins", 0},
+    [FIELD_PADS]        = {"pads", 0},
+    [FIELD_PITCH]       = {"pitch", 1},
+    [FIELD_WIDTH]       = {"width", 1},
+    [FIELD_HEIGHT]      = {"height", 1},
+    [FIELD_SIZE]        = {"size", 1},
+    [FIELD_BODY_WIDTH]  = {"body-width", 1},
+    [FIELD_BODY_HEIGHT] = {"body-height", 1},
+};
+
+static int32_t to_um(double mm) {
+    return (int32_t)lround(mm * 1000);
+}
+
+static uint32_t catalog_string(catalog_builder_t* b, const char* s) {
+    int len = strlen(s) + 1;
+    if (grow_array((void**)&b->strings, &b->strings_capacity, b->strings_size + len, 1) < 0) {
+        b->failed = 1;
+        return 0;
+    }
+    memcpy(b->strings + b->strings_size, s, len);
+    b->strings_size += len;
+    return b->strings_size - len;
+}
+
+// Quoted string (unescaped) or bare word at p
+static const char* sexp_token(const char* p, const char* end, char* out, size_t len) {
+    size_t n = 0;
+    while (p < end && isspace((unsigned char)*p)) p++;
+    if (p < end && *p == '"') {
+        for (p++; p < end && *p != '"'; p++) {
+            if (*p == '\\' && p + 1 < end) p++;
+            if (n + 1 < len) out[n++] = *p;
+        }
+        if (p < end) p++;
+    } else {
+        for (; p < end && !isspace((unsigned char)*p) && *p != '(' && *p != ')'; p++) {
+            if (n + 1 < len) out[n++] = *p;
+        }
+    }
+    out[n] = '\0';
+    return p;
+}
+
+// Up to n numbers after key at or behind p; returns how many were read and
+// moves *next past them. The buffer is NUL terminated, so strtod stops.
+static int sexp_numbers(const char* p, const char* end, const char* key, double* v, int n, const char** next) {
+    size_t klen = strlen(key);
+    const char* s = memmem(p, end - p, key, klen);
+    if (!s) return 0;
+    s += klen;
+    int i = 0;
+    for (; i < n; i++) {
+        char* e;
+        v[i] = strtod(s, &e);
+        if (e == s || e > end) break;
+        s = e;
+    }
+    if (next) *next = s;
+    return i;
+}
+
+static void sexp_points(bounds_t* b, const char* p, const char* end, const char* key) {
+    double v[2];
+    while (sexp_numbers(p, end, key, v, 2, &p) == 2) bounds_add(b, v[0], v[1]);
+}
+
+static int compare_pad_names(const void* a, const void* b) {
+    return strcmp(((const catalog_pad_t*)a)->name, ((const catalog_pad_t*)b)->name);
+}
+
+static int compare_pad_rows(const void* a, const void* b) {
+    const point_t* p = &((const catalog_pad_t*)a)->at;
+    const point_t* q = &((const catalog_pad_t*)b)->at;
+    int32_t py = to_um(p->y), qy = to_um(q->y);
+    if (py != qy) return py < qy ? -1 : 1;
+    return (p->x > q->x) - (p->x < q->x);
+}
+
+static int compare_pad_columns(const void* a, const void* b) {
+    const point_t* p = &((const catalog_pad_t*)a)->at;
+    const point_t* q = &((const catalog_pad_t*)b)->at;
+    int32_t px = to_um(p->x), qx = to_um(q->x);
+    if (px != qx) return px < qx ? -1 : 1;
+    return (p->y > q->y) - (p->y < q->y);
+}
+
+static int compare_int32(const void* a, const void* b) {
+    int32_t x = *(const int32_t*)a, y = *(const int32_t*)b;
+    return (x > y) - (x < y);
+}
+
+// Most common distance between neighbouring pins in a row or a column
+static int32_t catalog_pitch(catalog_pad_t* pads, int count) {
+    int32_t* steps = malloc((count ? count : 1) * 2 * sizeof(int32_t));
+    if (!steps) return 0;
+    int n = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        qsort(pads, count, sizeof(*pads), pass ? compare_pad_columns : compare_pad_rows);
+        for (int i = 1; i < count; i++) {
+            const point_t* p = &pads[i - 1].at;
+            const point_t* q = &pads[i].at;
+            int32_t d = pass ? (to_um(p->x) == to_um(q->x) ? to_um(q->y - p->y) : 0)
+                             : (to_um(p->y) == to_um(q->y) ? to_um(q->x - p->x) : 0);
+            if (d > 0) steps[n++] = d;
+        }
+    }
+    qsort(steps, n, sizeof(int32_t), compare_int32);
+    int32_t best = 0;
+    for (int i = 0, run = 0, best_run = 0; i < n; i++) {
+        run = i && steps[i] == steps[i - 1] ? run + 1 : 1;
+        if (run > best_run) {
+            best_run = run;
+            best = steps[i];
+        }
+    }
+    free(steps);
+    return best;
+}
+
+static void bounds_to_um(int32_t* out, const bounds_t* b) {
+    out[0] = to_um(b->min_x);
+    out[1] = to_um(b->min_y);
+    out[2] = to_um(b->max_x);
+    out[3] = to_um(b->max_y);
+}
+
+// Fill the geometry part of e from a NUL terminated .kicad_mod
+static int catalog_scan(const char* data, size_t size, catalog_builder_t* b, catalog_entry_t* e, const char* fallback_name) {
+    const char* end = data + size;
+    const char* p = memchr(data, '(', size);
+    char head[32], name[256] = "", model[1024] = "";
+    catalog_pad_t* pads = NULL;
+    int pad_count = 0, pad_capacity = 0, numbered = 0;
+    bounds_t body = { 1e9, 1e9, -1e9, -1e9 }, courtyard = body, copper = body;
+
+    if (!p) return -1;
+    p = sexp_token(p + 1, end, head, sizeof(head));
+    if (strcmp(head, "footprint") != 0 && strcmp(head, "module") != 0) return -1;
+    sexp_token(p, end, name, sizeof(name));
+
+    int depth = 1;
+    const char* start = NULL;
+    for (; p < end && depth > 0; p++) {
+        if (*p == '"') {
+            for (p++; p < end && *p != '"'; p++) {
+                if (*p == '\\') p++;
+            }
+            continue;
+        }
+        if (*p == '(') {
+            if (++depth == 2) start = p;
+            continue;
+        }
+        if (*p != ')' || depth-- != 2) continue;
+
+        // One child element in [start, p]
+        const char* s = sexp_token(start + 1, p, head, sizeof(head));
+        if (strcmp(head, "pad") == 0) {
+            catalog_pad_t pad = {0};
+            char type[32];
+            double v[4];
+            s = sexp_token(s, p, pad.name, sizeof(pad.name));
+            sexp_token(s, p, type, sizeof(type));
+            if (sexp_numbers(s, p, "(at ", v, 2, NULL) == 2) pad.at = (point_t){ v[0], v[1] };
+            if (sexp_numbers(s, p, "(size ", v + 2, 2, NULL) == 2) {
+                bounds_add(&copper, v[0] - v[2] / 2, v[1] - v[3] / 2);
+                bounds_add(&copper, v[0] + v[2] / 2, v[1] + v[3] / 2);
+            }
+            if (strcmp(type, "smd") == 0) e->flags |= CATALOG_SMD;
+            else if (strcmp(type, "thru_hole") == 0) e->flags |= CATALOG_THT;
+            else if (strcmp(type, "np_thru_hole") == 0) e->flags |= CATALOG_NPTH;
+            if (!pad.name[0] && strcmp(type, "np_thru_hole") != 0) e->flags |= CATALOG_VIAS;
+
+            e->pads++;
+            if (pad.name[0]) {
+                if (grow_array((void**)&pads, &pad_capacity, pad_count + 1, sizeof(*pads)) < 0) {
+                    free(pads);
+                    return -1;
+                }
+                pads[pad_count++] = pad;
+            }
+        } else if (strncmp(head, "fp_", 3) == 0 && strcmp(head, "fp_text") != 0) {
+            char layer[64] = "";
+            const char* l = memmem(s, p - s, "(layer ", 7);
+            if (l) sexp_token(l + 7, p, layer, sizeof(layer));
+            size_t len = strlen(layer);
+            bounds_t* target = len > 4 && strcmp(layer + len - 4, ".Fab") == 0 ? &body :
+                               len > 6 && strcmp(layer + len - 6, ".CrtYd") == 0 ? &courtyard : NULL;
+            if (!target) continue;
+            double c[2], r[2];
+            if (strcmp(head, "fp_circle") == 0 && sexp_numbers(s, p, "(center ", c, 2, NULL) == 2 &&
+                sexp_numbers(s, p, "(end ", r, 2, NULL) == 2) {
+                double radius = hypot(r[0] - c[0], r[1] - c[1]);
+                bounds_add(target, c[0] - radius, c[1] - radius);
+                bounds_add(target, c[0] + radius, c[1] + radius);
+            } else {
+                sexp_points(target, s, p, "(start ");
+                sexp_points(target, s, p, "(mid ");
+                sexp_points(target, s, p, "(end ");
+                sexp_points(target, s, p, "(xy ");
+            }
+        } else if (strcmp(head, "model") == 0 && !model[0]) {
+            sexp_token(s, p, model, sizeof(model));
+        }
+    }
+    if (depth != 0) {
+        free(pads);
+        return -1;
+    }
+
+    qsort(pads, pad_count, sizeof(*pads), compare_pad_names);
+    for (int i = 0; i < pad_count; i++) {
+        if (i == 0 || strcmp(pads[i].name, pads[i - 1].name) != 0) numbered++;
+    }
+    e->pins = numbered;
+    e->pitch = catalog_pitch(pads, pad_count);
+    free(pads);
+
+    if (body.min_x > body.max_x) body = copper;
+    if (courtyard.min_x > courtyard.max_x) {
+        courtyard = body;
+        e->flags |= CATALOG_NO_COURTYARD;
+    }
+    if (body.min_x > body.max_x) body = (bounds_t){ 0, 0, 0, 0 };
+    if (courtyard.min_x > courtyard.max_x) courtyard = (bounds_t){ 0, 0, 0, 0 };
+    bounds_to_um(e->body, &body);
+    bounds_to_um(e->courtyard, &courtyard);
+    e->name = catalog_string(b, name[0] ? name : fallback_name);
+    e->model = catalog_string(b, model);
+    return b->failed ? -1 : 0;
+}
+
+void catalog_close(catalog_t* c) {
+    if (c->map) munmap(c->map, c->map_size);
+    memset(c, 0, sizeof(*c));
+}
+
+// Map an index; returns 1 if there is none yet, -1 if it is unusable
+int catalog_open(const char* path, catalog_t* c) {
+    memset(c, 0, sizeof(*c));
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0) return errno == ENOENT ? 1 : -1;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(catalog_header_t)) {
+        close(fd);
+        return -1;
+    }
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+
+    const catalog_header_t* h = map;
+    size_t need = sizeof(*h) + (size_t)h->entry_count * sizeof(catalog_entry_t) +
+                  (size_t)h->dir_count * sizeof(uint32_t) + h->strings_size;
+    const char* base = map;
+    if (memcmp(h->magic, CATALOG_MAGIC, sizeof(h->magic)) != 0 || h->version != CATALOG_VERSION ||
+        need != (size_t)st.st_size || h->strings_size == 0 || base[st.st_size - 1] != '\0') {
+        munmap(map, st.st_size);
+        return -1;
+    }
+    c->map = map;
+    c->map_size = st.st_size;
+    c->header = h;
+    c->entries = (const catalog_entry_t*)(h + 1);
+    c->dirs = (const uint32_t*)(c->entries + h->entry_count);
+    c->strings = (const char*)(c->dirs + h->dir_count);
+    for (uint32_t i = 0; i < h->entry_count; i++) {
+        const catalog_entry_t* e = &c->entries[i];
+        if (e->name >= h->strings_size || e->path >= h->strings_size || e->model >= h->strings_size) {
+            catalog_close(c);
+            return -1;
+        }
+    }
+    for (uint32_t i = 0; i < h->dir_count; i++) {
+        if (c->dirs[i] >= h->strings_size) {
+            catalog_close(c);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static const catalog_t* sort_catalog;
+
+static int compare_catalog_paths(const void* a, const void* b) {
+    return strcmp(sort_catalog->strings + sort_catalog->entries[*(const int*)a].path,
+                  sort_catalog->strings + sort_catalog->entries[*(const int*)b].path);
+}
+
+static const char* sort_strings;
+
+static int compare_catalog_entries(const void* a, const void* b) {
+    const catalog_entry_t* x = a;
+    const catalog_entry_t* y = b;
+    if (x->pins != y->pins) return x->pins < y->pins ? -1 : 1;
+    if (x->pitch != y->pitch) return x->pitch < y->pitch ? -1 : 1;
+    return strcmp(sort_strings + x->path, sort_strings + y->path);
+}
+
+static int compare_names(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+// Old record for path, or NULL
+static const catalog_entry_t* catalog_lookup(const catalog_t* old, const int* by_path, const char* path) {
+    int lo = 0, hi = old->header ? (int)old->header->entry_count : 0;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        const catalog_entry_t* e = &old->entries[by_path[mid]];
+        int cmp = strcmp(old->strings + e->path, path);
+        if (cmp == 0) return e;
+        if (cmp < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return NULL;
+}
+
+static int catalog_add_file(catalog_builder_t* b, const catalog_t* old, const int* by_path,
+                            const char* path, const char* file, catalog_counts_t* counts) {
+    struct stat st;
+    if (stat(path, &st) < 0) return -1;
+    catalog_entry_t e = {0};
+    e.mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    e.size = st.st_size;
+
+    const catalog_entry_t* prev = catalog_lookup(old, by_path, path);
+    if (prev) counts->matched++;
+    char* data = NULL;
+    size_t size = 0;
+    if (!prev || prev->mtime != e.mtime || prev->size != e.size) {
+        if (!(data = read_text_file(path, &size))) return -1;
+        e.hash = hash_bytes(data, size);
+    }
+    if (prev && (!data || prev->hash == e.hash)) {
+        // Unchanged: copy the record and its strings
+        int64_t mtime = e.mtime;
+        e = *prev;
+        e.mtime = mtime;
+        e.name = catalog_string(b, old->strings + prev->name);
+        e.model = catalog_string(b, old->strings + prev->model);
+        if (data) counts->rehashed++;
+        else counts->unchanged++;
+    } else {
+        char stem[256];
+        snprintf(stem, sizeof(stem), "%.*s", (int)(strlen(file) - strlen(".kicad_mod")), file);
+        if (catalog_scan(data, size, b, &e, stem) < 0) {
+            free(data);
+            if (b->failed) return -1;
+            fprintf(stderr, "Warning: %s: cannot parse footprint, skipped\n", path);
+            counts->skipped++;
+            return 0;
+        }
+        counts->parsed++;
+    }
+    free(data);
+    e.path = catalog_string(b, path);
+    if (grow_array((void**)&b->entries, &b->capacity, b->count + 1, sizeof(e)) < 0) b->failed = 1;
+    if (b->failed) return -1;
+    b->entries[b->count++] = e;
+    return 0;
+}
+
+static int catalog_add_directory(catalog_builder_t* b, const catalog_t* old, const int* by_path,
+                                 const char* dir, catalog_counts_t* counts) {
+    DIR* d = opendir(dir);
+    if (!d) {
+        fprintf(stderr, "Error: %s: %s\n", dir, strerror(errno));
+        return -1;
+    }
+    char** files = NULL;
+    int count = 0, capacity = 0, ret = 0;
+    struct dirent* de;
+    while ((de = readdir(d))) {
+        size_t len = strlen(de->d_name);
+        if (len <= 10 || strcmp(de->d_name + len - 10, ".kicad_mod") != 0) continue;
+        char* name = strdup(de->d_name);
+        if (!name || grow_array((void**)&files, &capacity, count + 1, sizeof(char*)) < 0) {
+            free(name);
+            ret = -1;
+            break;
+        }
+        files[count++] = name;
+    }
+    closedir(d);
+
+    // Sorted, so the index does not depend on directory order
+    qsort(files, count, sizeof(char*), compare_names);
+    uint32_t dir_offset = catalog_string(b, dir);
+    if (grow_array((void**)&b->dirs, &b->dir_capacity, b->dir_count + 1, sizeof(uint32_t)) < 0) ret = -1;
+    else b->dirs[b->dir_count++] = dir_offset;
+
+    for (int i = 0; i < count && ret == 0; i++) {
+        char path[4096];
+        size_t len = strlen(dir);
+        snprintf(path, sizeof(path), "%s%s%s", dir, len && dir[len - 1] == '/' ? "" : "/", files[i]);
+        if (catalog_add_file(b, old, by_path, path, files[i], counts) < 0) {
+            if (!b->failed) fprintf(stderr, "Error: %s: %s\n", path, strerror(errno));
+            ret = -1;
+        }
+    }
+    for (int i = 0; i < count; i++) free(files[i]);
+    free(files);
+    return ret;
+}
+
+int catalog_write(const char* path, const catalog_builder_t* b) {
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE* f = fopen(tmp, "wb");
+    if (!f) {
+        fprintf(stderr, "Error: %s: %s\n", tmp, strerror(errno));
+        return -1;
+    }
+    catalog_header_t h = {
+        .magic = CATALOG_MAGIC,
+        .version = CATALOG_VERSION,
+        .entry_count = b->count,
+        .dir_count = b->dir_count,
+        .strings_size = b->strings_size,
+    };
+    int ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+             fwrite(b->entries, sizeof(catalog_entry_t), b->count, f) == (size_t)b->count &&
+             fwrite(b->dirs, sizeof(uint32_t), b->dir_count, f) == (size_t)b->dir_count &&
+             fwrite(b->strings, 1, b->strings_size, f) == (size_t)b->strings_size;
+    if (fclose(f) != 0) ok = 0;
+    // Readers keep their mapping of the old file
+    if (!ok || rename(tmp, path) < 0) {
+        fprintf(stderr, "Error: %s: %s\n", path, strerror(errno));
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+void catalog_builder_free(catalog_builder_t* b) {
+    free(b->entries);
+    free(b->dirs);
+    free(b->strings);
+    memset(b, 0, sizeof(*b));
+}
+
+// Scan dirs (or the directories already in the index) into b, reusing
+// the records of old where possible
+int catalog_build(catalog_builder_t* b, const catalog_t* old, char** dirs, int ndirs, catalog_counts_t* counts) {
+    int old_count = old->header ? (int)old->header->entry_count : 0;
+    int ndirs_old = old->header ? (int)old->header->dir_count : 0;
+    int* by_path = malloc((old_count ? old_count : 1) * sizeof(int));
+    int ret = 0;
+
+    memset(b, 0, sizeof(*b));
+    memset(counts, 0, sizeof(*counts));
+    if (!by_path) return -1;
+    for (int i = 0; i < old_count; i++) by_path[i] = i;
+    sort_catalog = old;
+    qsort(by_path, old_count, sizeof(int), compare_catalog_paths);
+
+    catalog_string(b, "");      // offset 0 is the empty string
+    TRACE_START(t_index);
+    for (int i = 0; i < (ndirs ? ndirs : ndirs_old) && ret == 0; i++) {
+        const char* dir = ndirs ? dirs[i] : old->strings + old->dirs[i];
+        ret = catalog_add_directory(b, old, by_path, dir, counts);
+    }
+    sort_strings = b->strings;
+    qsort(b->entries, b->count, sizeof(catalog_entry_t), compare_catalog_entries);
+    TRACE_STOP(t_index, STAGE_INDEX, b->count);
+    free(by_path);
+    if (b->failed) fprintf(stderr, "Error: out of memory\n");
+    return ret < 0 || b->failed ? -1 : 0;
+}
+
+int run_index(const char* index_path, char** dirs, int ndirs) {
+    catalog_t old;
+    int status = catalog_open(index_path, &old);
+    if (status < 0) fprintf(stderr, "Warning: %s: not a usable index, rebuilding\n", index_path);
+    if (!ndirs && (status != 0 || old.header->dir_count == 0)) {
+        fprintf(stderr, "Error: no .pretty directories to index\n");
+        catalog_close(&old);
+        return 1;
+    }
+
+    catalog_builder_t b;
+    catalog_counts_t counts;
+    int ret = catalog_build(&b, &old, dirs, ndirs, &counts) < 0 || catalog_write(index_path, &b) < 0;
+    if (!ret) {
+        int kept = counts.unchanged + counts.rehashed;
+        int old_count = old.header ? (int)old.header->entry_count : 0;
+        fprintf(stderr, "%s: %d footprints in %d directories; %d parsed, %d unchanged, %d removed\n",
+                index_path, b.count, b.dir_count, counts.parsed, kept, old_count - counts.matched);
+    }
+    catalog_builder_free(&b);
+    catalog_close(&old);
+    return ret;
+}
+
+// "pins=68", "pitch=1.27", "size<=30", "pins=20..84", "type=smd", "name=APW*"
+int parse_catalog_term(catalog_query_t* q, char* term) {
+    size_t key_len = strcspn(term, "<>=");
+    const char* op = term + key_len;
+    char* value = term + key_len + strspn(op, "<>=");
+    if (!*op || !*value) return -1;
+
+    int equals = *op == '=' && op + 1 == value;
+    if (key_len == 4 && strncmp(term, "name", 4) == 0 && equals) {
+        q->name = value;
+        return 0;
+    }
+    if (key_len == 4 && strncmp(term, "type", 4) == 0 && equals) {
+        if (strcmp(value, "smd") == 0) q->flags |= CATALOG_SMD;
+        else if (strcmp(value, "tht") == 0) q->flags |= CATALOG_THT;
+        else if (strcmp(value, "npth") == 0) q->flags |= CATALOG_NPTH;
+        else return -1;
+        return 0;
+    }
+
+    int field = 0;
+    while (field < FIELD_COUNT && (strlen(catalog_fields[field].name) != key_len ||
+                                   strncmp(term, catalog_fields[field].name, key_len) != 0)) {
+        field++;
+    }
+    if (field == FIELD_COUNT || q->term_count == CATALOG_MAX_TERMS) return -1;
+
+    double scale = catalog_fields[field].length ? 1000 : 1;
+    char* range = strstr(value, "..");
+    if (range && !equals) return -1;
+    if (range) *range = '\0';
+    char* end;
+    double a = strtod(value, &end), b = a;
+    if (end == value || *end) return -1;
+    if (range) {
+        b = strtod(range + 2, &end);
+        if (end == range + 2 || *end) return -1;
+    }
+
+    int64_t lo = llround(a * scale), hi = llround(b * scale);
+    int64_t min = INT64_MIN, max = INT64_MAX;
+    int op_len = value - op;
+    if (equals) min = lo, max = hi;
+    else if (op_len == 2 && strncmp(op, "<=", 2) == 0) max = lo;
+    else if (op_len == 2 && strncmp(op, ">=", 2) == 0) min = lo;
+    else if (op_len == 1 && *op == '<') max = lo - 1;
+    else if (op_len == 1 && *op == '>') min = lo + 1;
+    else return -1;
+
+    if (field == FIELD_PINS) {
+        if (min > q->pins_lo) q->pins_lo = min;
+        if (max < q->pins_hi) q->pins_hi = max;
+    }
+    q->terms[q->term_count++] = (catalog_term_t){ field, min, max };
+    return 0;
+}
+
+static int64_t catalog_field_value(const catalog_entry_t* e, catalog_field_t field) {
+    int64_t w = (int64_t)e->courtyard[2] - e->courtyard[0];
+    int64_t h = (int64_t)e->courtyard[3] - e->courtyard[1];
+    switch (field) {
+    case FIELD_PINS:        return e->pins;
+    case FIELD_PADS:        return e->pads;
+    case FIELD_PITCH:       return e->pitch;
+    case FIELD_WIDTH:       return w;
+    case FIELD_HEIGHT:      return h;
+    case FIELD_SIZE:        return w > h ? w : h;
+    case FIELD_BODY_WIDTH:  return (int64_t)e->body[2] - e->body[0];
+    case FIELD_BODY_HEIGHT: return (int64_t)e->body[3] - e->body[1];
+    default:                return 0;
+    }
+}
+
+// Indices of the matching records, in index order; returns their number
+int catalog_query(const catalog_t* c, const catalog_query_t* q, int* matches) {
+    TRACE_START(t_query);
+    const catalog_entry_t* entries = c->entries;
+    int count = c->header->entry_count, n = 0;
+
+    // First record with enough pins
+    int lo = 0, hi = count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if ((int64_t)entries[mid].pins < q->pins_lo) lo = mid + 1;
+        else hi = mid;
+    }
+    for (int i = lo; i < count && (int64_t)entries[i].pins <= q->pins_hi; i++) {
+        const catalog_entry_t* e = &entries[i];
+        int ok = (e->flags & q->flags) == q->flags;
+        for (int t = 0; ok && t < q->term_count; t++) {
+            int64_t v = catalog_field_value(e, q->terms[t].field);
+            ok = v >= q->terms[t].lo && v <= q->terms[t].hi;
+        }
+        if (ok && q->name) ok = fnmatch(q->name, c->strings + e->name, 0) == 0;
+        if (ok) matches[n++] = i;
+    }
+    TRACE_STOP(t_query, STAGE_QUERY, n);
+    return n;
+}
+
+static void print_json_string(FILE* f, const char* s) {
+    fputc('"', f);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') fprintf(f, "\\%c", *s);
+        else if ((unsigned char)*s < 0x20) fprintf(f, "\\u%04x", *s);
+        else fputc(*s, f);
+    }
+    fputc('"', f);
+}
+
+static void print_catalog_entry(FILE* f, const catalog_t* c, const catalog_entry_t* e) {
+    static const struct {
+        uint32_t flag;
+        const char* name;
+    } types[] = { {CATALOG_SMD, "smd"}, {CATALOG_THT, "tht"}, {CATALOG_NPTH, "npth"}, {CATALOG_VIAS, "vias"} };
+
+    fprintf(f, "{\"name\":");
+    print_json_string(f, c->strings + e->name);
+    fprintf(f, ",\"path\":");
+    print_json_string(f, c->strings + e->path);
+    fprintf(f, ",\"pins\":%u,\"pads\":%u,\"pitch\":%.3f,\"body_mm\":[%.3f,%.3f],\"courtyard_mm\":[%.3f,%.3f],\"types\":[",
+            e->pins, e->pads, e->pitch / 1000.0,
+            catalog_field_value(e, FIELD_BODY_WIDTH) / 1000.0, catalog_field_value(e, FIELD_BODY_HEIGHT) / 1000.0,
+            catalog_field_value(e, FIELD_WIDTH) / 1000.0, catalog_field_value(e, FIELD_HEIGHT) / 1000.0);
+    int n = 0;
+    for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+        if (e->flags & types[i].flag) fprintf(f, "%s\"%s\"", n++ ? "," : "", types[i].name);
+    }
+    fprintf(f, "],\"model\":");
+    print_json_string(f, c->strings + e->model);
+    fprintf(f, ",\"hash\":\"%016llx\"}\n", (unsigned long long)e->hash);
+}
+
+int run_find(const char* index_path, char** terms, int nterms) {
+    catalog_query_t q = { .pins_lo = 0, .pins_hi = INT64_MAX };
+    for (int i = 0; i < nterms; i++) {
+        if (parse_catalog_term(&q, terms[i]) < 0) {
+            fprintf(stderr, "Error: bad query term '%s'\n", terms[i]);
+            return 1;
+        }
+    }
+
+    catalog_t c;
+    if (catalog_open(index_path, &c) != 0) {
+        fprintf(stderr, "Error: %s: no usable index, build one with --index\n", index_path);
+        return 1;
+    }
+    int* matches = malloc((c.header->entry_count ? c.header->entry_count : 1) * sizeof(int));
+    if (!matches) {
+        catalog_close(&c);
+        return 1;
+    }
+    int n = catalog_query(&c, &q, matches);
+    for (int i = 0; i < n; i++) print_catalog_entry(stdout, &c, &c.entries[matches[i]]);
+    free(matches);
+    catalog_close(&c);
+    return 0;
+}
@@ -0,0 +1,94 @@
+/* Library catalog for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#ifndef PLCC_CATALOG_H
+#define PLCC_CATALOG_H
+
+#include "plcc-gen.h"
+
+#define CATALOG_MAX_TERMS 16
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t entry_count;
+    uint32_t dir_count;
+    uint32_t strings_size;
+} catalog_header_t;
+
+typedef struct {
+    uint32_t pins;              // distinct pad numbers
+    uint32_t pads;              // all pads
+    uint32_t flags;
+    int32_t pitch;              // most common spacing within a row of pins, um
+    int32_t body[4];            // fab layer bounds, um: min x, min y, max x, max y
+    int32_t courtyard[4];
+    uint32_t name, path, model; // offsets into the string table
+    uint32_t reserved;
+    int64_t mtime;              // ns
+    uint64_t size;
+    uint64_t hash;              // FNV-1a of the file
+} catalog_entry_t;
+
+typedef struct {
+    const catalog_header_t* header;
+    const catalog_entry_t* entries;
+    const uint32_t* dirs;
+    const char* strings;
+    void* map;
+    size_t map_size;
+} catalog_t;
+
+typedef struct {
+    catalog_entry_t* entries;
+    int count, capacity;
+    uint32_t* dirs;
+    int dir_count, dir_capacity;
+    char* strings;
+    int strings_size, strings_capacity;
+    int failed;
+} catalog_builder_t;
+
+typedef enum {
+    FIELD_PINS,
+    FIELD_PADS,
+    FIELD_PITCH,
+    FIELD_WIDTH,
+    FIELD_HEIGHT,
+    FIELD_SIZE,
+    FIELD_BODY_WIDTH,
+    FIELD_BODY_HEIGHT,
+    FIELD_COUNT
+} catalog_field_t;
+
+typedef struct {
+    catalog_field_t field;
+    int64_t lo, hi;             // inclusive
+} catalog_term_t;
+
+typedef struct {
+    catalog_term_t terms[CATALOG_MAX_TERMS];
+    int term_count;
+    int64_t pins_lo, pins_hi;
+    uint32_t flags;             // all of these pad types
+    const char* name;           // fnmatch pattern
+} catalog_query_t;
+
+typedef struct {
+    int parsed, unchanged, rehashed, skipped;
+    int matched;                // records of the old index seen again
+} catalog_counts_t;
+
+void catalog_close(catalog_t* c);
+int catalog_open(const char* path, catalog_t* c);
+int catalog_write(const char* path, const catalog_builder_t* b);
+void catalog_builder_free(catalog_builder_t* b);
+int catalog_build(catalog_builder_t* b, const catalog_t* old, char** dirs, int ndirs, catalog_counts_t* counts);
+int run_index(const char* index_path, char** dirs, int ndirs);
+int parse_catalog_term(catalog_query_t* q, char* term);
+int catalog_query(const catalog_t* c, const catalog_query_t* q, int* matches);
+int run_find(const char* index_path, char** terms, int nterms);
+
+#endif
@@ -0,0 +1,735 @@
+/* Regression check for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#include "check.h"
+#include "backends.h"
+#include "geometry.h"
+#include "kicad.h"
+#include "preview-tools.h"
+#include "precompiled.h"
+#include "step.h"
+
+#include <unistd.h>
+
+// Regenerates every catalog variant in memory and compares it semantically
+// against the committed library and against the legacy generator (apw.c,
+// linked in as apw_main). Footprints are split into their top level
+// elements, timestamps are dropped and numbers normalised, and each class
+// of element is compared as a multiset. Known, intended differences are
+// listed in check_allowances[].
+
+int apw_main(int argc, char *argv[]);
+
+#define CHECK_MAX_REPORT 4
+
+static const char* element_class_names[ELEM_CLASS_COUNT] = {
+    "header", "text", "silkscreen", "courtyard", "fab", "pad", "via", "model"
+};
+
+typedef struct {
+    const char* reference;   // "library" or "legacy"
+    const char* part;        // part name, or NULL for all
+    const char* variant;     // variant suffix, or NULL for all
+    element_class_t cls;
+    const char* reason;
+    int used;
+} check_allowance_t;
+
+static check_allowance_t check_allowances[] = {
+    {"legacy", NULL, NULL, ELEM_SILKSCREEN, "apw.c draws a fixed +/-18.5 outline and 84-pin edge marks", 0},
+    {"legacy", NULL, NULL, ELEM_FAB, "apw.c emits the 84-pin fab outline for every size", 0},
+    {"legacy", NULL, NULL, ELEM_COURTYARD, "apw.c draws the body outline as the courtyard, without clearance", 0},
+    {"legacy", NULL, NULL, ELEM_MODEL, "apw.c references the KiCad PLCC socket model", 0},
+    {"legacy", "APW9324", NULL, ELEM_PAD, "apw.c computes cp[7] from PINS_X, misnumbering the 7x9 part", 0},
+    {"legacy", NULL, "_single_sided_via_outside", ELEM_VIA, "apw.c has no via pads for single-sided footprints", 0},
+};
+
+static int num_check_allowances = sizeof(check_allowances) / sizeof(check_allowances[0]);
+
+const check_variant_t check_variants[NUM_CHECK_VARIANTS] = {
+    {"", 1, 0},
+    {"_via_outside", 1, 1},
+    {"_single_sided", 0, 0},
+    {"_single_sided_via_outside", 0, 1},
+};
+
+// Canonical form of one S-expression element: single spaces, numbers
+// printed with three decimals, timestamps and UUIDs removed.
+static char* canonical_element(const char* p, const char* end) {
+    size_t cap = (end - p) * 2 + 16, len = 0;
+    char* out = malloc(cap);
+    if (!out) return NULL;
+    int skip_depth = 0, depth = 0;
+
+    while (p < end) {
+        if (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') {
+            p++;
+            continue;
+        }
+        const char* tok = p;
+        if (*p == '(' || *p == ')') {
+            p++;
+        } else if (*p == '"') {
+            for (p++; p < end && *p != '"'; p++) {
+                if (*p == '\\' && p + 1 < end) p++;
+            }
+            if (p < end) p++;
+        } else {
+            while (p < end && !strchr(" \t\r\n()", *p)) p++;
+        }
+        size_t toklen = p - tok;
+
+        if (*tok == '(') {
+            depth++;
+            // Look at the head of the new list
+            const char* h = p;
+            while (h < end && *h == ' ') h++;
+            if (!skip_depth && (strncmp(h, "tstamp ", 7) == 0 || strncmp(h, "uuid ", 5) == 0)) {
+                skip_depth = depth;
+            }
+        }
+        char num[64];
+        if (!skip_depth) {
+            char* numend;
+            if (*tok != '"' && *tok != '(' && *tok != ')' && toklen < sizeof(num)) {
+                memcpy(num, tok, toklen);
+                num[toklen] = '\0';
+                double v = strtod(num, &numend);
+                if (numend != num && *numend == '\0') {
+                    if (fabs(v) < 0.0005) v = 0;
+                    toklen = snprintf(num, sizeof(num), "%.3f", v);
+                    tok = num;
+                }
+            }
+            if (len && out[len - 1] != '(' && *tok != ')') out[len++] = ' ';
+            memcpy(out + len, tok, toklen);
+            len += toklen;
+        }
+        if (*tok == ')') {
+            if (skip_depth == depth) skip_depth = 0;
+            depth--;
+        }
+    }
+    out[len] = '\0';
+    return out;
+}
+
+static element_class_t classify_element(const char* canon) {
+    if (strncmp(canon, "(fp_text", 8) == 0 || strncmp(canon, "(property", 9) == 0) return ELEM_TEXT;
+    if (strncmp(canon, "(model", 6) == 0) return ELEM_MODEL;
+    if (strncmp(canon, "(pad \"\"", 7) == 0) return ELEM_VIA;
+    if (strncmp(canon, "(pad", 4) == 0) return ELEM_PAD;
+    if (strncmp(canon, "(fp_line", 8) == 0) {
+        if (strstr(canon, ".SilkS\"")) return ELEM_SILKSCREEN;
+        if (strstr(canon, ".CrtYd\"")) return ELEM_COURTYARD;
+        if (strstr(canon, ".Fab\"")) return ELEM_FAB;
+    }
+    return ELEM_HEADER;
+}
+
+void free_element_set(element_set_t* set) {
+    for (int i = 0; i < set->total; i++) {
+        free(set->text[i]);
+    }
+    memset(set, 0, sizeof(*set));
+}
+
+// Split "(footprint NAME child child ...)" into its children
+int parse_footprint_elements(const char* data, size_t size, element_set_t* set) {
+    const char* p = memchr(data, '(', size);
+    const char* end = data + size;
+    memset(set, 0, sizeof(*set));
+    if (!p) return -1;
+
+    int depth = 0;
+    const char* start = NULL;
+    for (; p < end; p++) {
+        if (*p == '"') {
+            for (p++; p < end && *p != '"'; p++) {
+                if (*p == '\\') p++;
+            }
+            continue;
+        }
+        if (*p == '(') {
+            if (++depth == 2) start = p;
+        } else if (*p == ')') {
+            if (depth-- == 2) {
+                if (set->total == CHECK_MAX_ELEMENTS) return -1;
+                char* canon = canonical_element(start, p + 1);
+                if (!canon) return -1;
+                element_class_t cls = classify_element(canon);
+                set->text[set->total] = canon;
+                set->cls[set->total++] = cls;
+                set->count[cls]++;
+            } else if (depth == 0) {
+                return 0;
+            }
+        }
+    }
+    return -1;
+}
+
+static int compare_strings(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+static check_allowance_t* find_allowance(const char* reference, const char* part, const char* variant, element_class_t cls) {
+    for (int i = 0; i < num_check_allowances; i++) {
+        check_allowance_t* a = &check_allowances[i];
+        if (strcmp(a->reference, reference) == 0 && a->cls == cls &&
+            (!a->part || strcmp(a->part, part) == 0) &&
+            (!a->variant || strcmp(a->variant, variant) == 0)) {
+            return a;
+        }
+    }
+    return NULL;
+}
+
+// Compare one element class; returns the number of differing elements
+static int diff_element_class(element_set_t* expected, element_set_t* actual, element_class_t cls,
+                              int verbose, FILE* report) {
+    char* a[CHECK_MAX_ELEMENTS];
+    char* b[CHECK_MAX_ELEMENTS];
+    int na = 0, nb = 0;
+
+    for (int i = 0; i < expected->total; i++) {
+        if (expected->cls[i] == cls) a[na++] = expected->text[i];
+    }
+    for (int i = 0; i < actual->total; i++) {
+        if (actual->cls[i] == cls) b[nb++] = actual->text[i];
+    }
+    qsort(a, na, sizeof(char*), compare_strings);
+    qsort(b, nb, sizeof(char*), compare_strings);
+
+    int i = 0, j = 0, diffs = 0;
+    while (i < na || j < nb) {
+        int c = i == na ? 1 : j == nb ? -1 : strcmp(a[i], b[j]);
+        if (c == 0) {
+            i++;
+            j++;
+            continue;
+        }
+        if (verbose && diffs < CHECK_MAX_REPORT) {
+            fprintf(report, "      %c %s\n", c < 0 ? '-' : '+', c < 0 ? a[i] : b[j]);
+        }
+        if (c < 0) i++; else j++;
+        diffs++;
+    }
+    if (verbose && diffs > CHECK_MAX_REPORT) {
+        fprintf(report, "      ... %d more\n", diffs - CHECK_MAX_REPORT);
+    }
+    return diffs;
+}
+
+// Returns the number of unexpected differences
+static int check_against(const char* reference, const char* part, const char* variant,
+                         const char* expected_data, size_t expected_size,
+                         element_set_t* actual, int verbose, FILE* report) {
+    element_set_t expected;
+    if (parse_footprint_elements(expected_data, expected_size, &expected) < 0) {
+        fprintf(report, "FAIL %s%s vs %s: cannot parse reference footprint\n", part, variant, reference);
+        free_element_set(&expected);
+        return 1;
+    }
+
+    int failures = 0;
+    for (int cls = 0; cls < ELEM_CLASS_COUNT; cls++) {
+        int diffs = diff_element_class(&expected, actual, cls, 0, report);
+        if (!diffs) continue;
+
+        check_allowance_t* allow = find_allowance(reference, part, variant, cls);
+        if (allow) {
+            allow->used++;
+            if (verbose) {
+                fprintf(report, "  allowed %s%s vs %s: %d %s difference%s (%s)\n", part, variant, reference,
+                        diffs, element_class_names[cls], diffs == 1 ? "" : "s", allow->reason);
+            }
+            continue;
+        }
+        fprintf(report, "FAIL %s%s vs %s: %d %s difference%s\n", part, variant, reference,
+                diffs, element_class_names[cls], diffs == 1 ? "" : "s");
+        diff_element_class(&expected, actual, cls, 1, report);
+        failures++;
+    }
+    free_element_set(&expected);
+    return failures;
+}
+
+static char* render_legacy_footprint(const component_spec_t* spec, int double_sided, int via_outside, size_t* size) {
+    char pins[16];
+    snprintf(pins, sizeof(pins), "%d", spec->pins);
+    char* argv[] = {
+        "apw", "--pins", pins,
+        double_sided ? "--double-sided" : "--single-sided",
+        via_outside ? "--via-outside" : "--via-inside",
+        NULL
+    };
+
+    char* data = NULL;
+    FILE* mem = open_memstream(&data, size);
+    if (!mem) return NULL;
+
+    // apw.c prints to stdout
+    fflush(stdout);
+    FILE* saved = stdout;
+    stdout = mem;
+    int saved_optind = optind;
+    optind = 0;
+    int ret = apw_main(5, argv);
+    optind = saved_optind;
+    stdout = saved;
+    fclose(mem);
+
+    if (ret != 0) {
+        free(data);
+        return NULL;
+    }
+    return data;
+}
+
+// Eagle writes the copper of pin N as <smd name="N"> and the hole of a
+// double-sided pin as <pad name="N@2">. Both have to land where the KiCad
+// footprint puts them: the copper at (at) plus the drill offset, which is
+// also where pin maps place the pin, and the hole at (at).
+static int check_eagle_pads(const component_spec_t* spec, const char* suffix, footprint_geometry_t* geom,
+                            footprint_options_t* opts, const char* kicad, size_t kicad_size, int* checked, FILE* report) {
+    size_t eagle_size = 0;
+    char* eagle = render_footprint(geom, spec, opts, find_footprint_writer("eagle"), &eagle_size);
+    footprint_geometry_t* reference = load_kicad_footprint(kicad, kicad_size);
+    if (!eagle || !reference) {
+        fprintf(report, "FAIL %s%s: cannot render Eagle pads\n", spec->name, suffix);
+        free(eagle);
+        if (reference) free_geometry(reference);
+        return 1;
+    }
+
+    int mismatches = 0;
+    for (const char* p = eagle; (p = strstr(p, "<smd name=\"")) != NULL; p++) {
+        int number;
+        char hole;
+        double x, y;
+        if (sscanf(p, "<smd name=\"%d%c x=\"%lf\" y=\"%lf\"", &number, &hole, &x, &y) != 4 || hole != '"') continue;
+
+        const pad_t* pad = NULL;
+        for (int i = 0; i < reference->pad_count && !pad; i++) {
+            if (reference->pads[i].number == number) pad = &reference->pads[i];
+        }
+        pin_info_t pin;
+        int bad = !pad || pin_locate(spec, number, &pin) < 0 ||
+                  fabs(x - (pad->position.x + pad->drill.offset.x)) > 0.0015 ||
+                  fabs(-y - (pad->position.y + pad->drill.offset.y)) > 0.0015 ||
+                  fabs(x - pin.position.x) > 0.0015 || fabs(-y - pin.position.y) > 0.0015;
+
+        char name[32];
+        snprintf(name, sizeof(name), "<pad name=\"%d@2\"", number);
+        const char* h = strstr(eagle, name);
+        if (!bad && h && pad->type == PAD_THROUGHHOLE) {
+            bad = sscanf(h + strlen(name), " x=\"%lf\" y=\"%lf\"", &x, &y) != 2 ||
+                  fabs(x - pad->position.x) > 0.0015 || fabs(-y - pad->position.y) > 0.0015;
+        } else if (!bad) {
+            bad = (h != NULL) != (pad->type == PAD_THROUGHHOLE);
+        }
+
+        if (bad && mismatches++ < CHECK_MAX_REPORT) {
+            fprintf(report, "FAIL %s%s: Eagle pad %d is not where the KiCad footprint has it\n", spec->name, suffix, number);
+        }
+        (*checked)++;
+    }
+
+    free(eagle);
+    free_geometry(reference);
+    return mismatches != 0;
+}
+
+// "(version N)" from the start of a footprint, 0 if there is none
+static int kicad_file_version(const char* data, size_t size) {
+    const char* p = memmem(data, size < 512 ? size : 512, "(version ", 9);
+    return p ? atoi(p + 9) : 0;
+}
+
+int run_check(const char* library, int verbose) {
+    TRACE_START(t_check);
+    int failures = 0, compared = 0, precompiled = 0, eagle_pads = 0;
+    FILE* report = stdout;
+
+    for (int i = 0; i < num_component_specs; i++) {
+        const component_spec_t* spec = &component_specs[i];
+        for (int v = 0; v < 4; v++) {
+            footprint_options_t opts = { check_variants[v].double_sided, check_variants[v].via_outside, {0} };
+            generate_timestamp(opts.timestamp, sizeof(opts.timestamp));
+            const char* suffix = check_variants[v].suffix;
+
+            // The legacy format is compared with apw.c, and with libraries
+            // still in that format
+            size_t size = 0, legacy_format_size = 0;
+            char* generated = render_kicad_footprint(spec, &opts, &size);
+            char* legacy_format = NULL;
+            footprint_geometry_t* geom = generate_geometry(spec, &opts);
+            if (geom) {
+                legacy_format = render_footprint(geom, spec, &opts, find_footprint_writer("kicad-legacy"), &legacy_format_size);
+                if (generated) failures += check_eagle_pads(spec, suffix, geom, &opts, generated, size, &eagle_pads, report);
+                free_geometry(geom);
+            }
+            element_set_t actual = {0}, actual_legacy = {0};
+            if (!generated || !legacy_format || parse_footprint_elements(generated, size, &actual) < 0 ||
+                parse_footprint_elements(legacy_format, legacy_format_size, &actual_legacy) < 0) {
+                fprintf(report, "FAIL %s%s: cannot generate footprint\n", spec->name, suffix);
+                free_element_set(&actual);
+                free_element_set(&actual_legacy);
+                free(generated);
+                free(legacy_format);
+                failures++;
+                continue;
+            }
+
+            char path[4096];
+            snprintf(path, sizeof(path), "%s/%s%s.kicad_mod", library, spec->name, suffix);
+            size_t lib_size = 0;
+            char* committed = read_file(path, &lib_size);
+            if (committed) {
+                element_set_t* expected = kicad_file_version(committed, lib_size) < KICAD_FORMAT_VERSION ? &actual_legacy : &actual;
+                failures += check_against("library", spec->name, suffix, committed, lib_size, expected, verbose, report) != 0;
+            } else {
+                fprintf(report, "FAIL %s: %s\n", path, strerror(errno));
+                failures++;
+            }
+
+            // The embedded copy has to be byte for byte what the engine writes
+            size_t packed_size = 0;
+            use_precompiled = 1;
+            char* packed = precompiled_footprint(spec, &opts, &packed_size);
+            if (packed && (packed_size != size || memcmp(packed, generated, size) != 0)) {
+                fprintf(report, "FAIL %s%s: precompiled footprint differs from the engine\n", spec->name, suffix);
+                failures++;
+            }
+            precompiled += packed != NULL;
+            free(packed);
+
+            size_t legacy_size = 0;
+            char* legacy = render_legacy_footprint(spec, opts.double_sided, opts.via_outside, &legacy_size);
+            if (legacy) {
+                failures += check_against("legacy", spec->name, suffix, legacy, legacy_size, &actual_legacy, verbose, report) != 0;
+            } else {
+                fprintf(report, "FAIL %s%s: legacy generator failed\n", spec->name, suffix);
+                failures++;
+            }
+
+            compared += 2;
+            free(legacy);
+            free(committed);
+            free_element_set(&actual);
+            free_element_set(&actual_legacy);
+            free(legacy_format);
+            free(generated);
+        }
+    }
+
+    for (int i = 0; i < num_check_allowances; i++) {
+        if (!check_allowances[i].used) {
+            fprintf(report, "note: allowance for %s %s%s no longer needed (%s)\n",
+                    check_allowances[i].reference,
+                    check_allowances[i].part ? check_allowances[i].part : "*",
+                    check_allowances[i].variant ? check_allowances[i].variant : "",
+                    element_class_names[check_allowances[i].cls]);
+        }
+    }
+    TRACE_STOP(t_check, STAGE_VALIDATE, compared);
+
+    fprintf(report, "%d Eagle pads checked against the KiCad footprints\n", eagle_pads);
+    if (precompiled) fprintf(report, "%d precompiled footprints checked against the engine\n", precompiled);
+    fprintf(report, "%d comparisons, %d failed\n", compared, failures);
+    return failures ? 1 : 0;
+}
+
+// STEP files are checked for structure rather than content: every #N
+// reference resolves, and in every CLOSED_SHELL each edge is used exactly
+// once in each direction by loops whose edges join up end to start. That
+// is what an importer needs to sew the faces into a closed solid; the
+// geometry itself is not looked at.
+
+#define STEP_CHECK_MAX_ID 10000000
+
+typedef struct {
+    const char* type;      // entity name, "" for complex entities
+    int type_len;
+    const char* args;      // just past the opening parenthesis
+    const char* end;       // the terminating ';'
+} step_entity_t;
+
+typedef struct {
+    step_entity_t* entities;   // indexed by id, type NULL if undefined
+    int capacity;
+    int max_id;
+    int* refs;
+    int ref_capacity;
+} step_file_t;
+
+typedef struct {
+    int edge, sense;
+} step_use_t;
+
+// Next quoted string or terminator, whichever comes first
+static const char* step_skip_string(const char* p, const char* end) {
+    for (p++; p < end; p++) {
+        if (*p == '\'') {
+            if (p + 1 < end && p[1] == '\'') p++;
+            else return p + 1;
+        }
+    }
+    return end;
+}
+
+static int parse_step_file(const char* data, size_t size, step_file_t* file, char* err, size_t errlen) {
+    const char* end = data + size;
+    const char* p = memmem(data, size, "\nDATA;", 6);
+    if (!p) {
+        snprintf(err, errlen, "no DATA section");
+        return -1;
+    }
+    for (p += 6; ; ) {
+        while (p < end && isspace((unsigned char)*p)) p++;
+        if (p == end) break;
+        if (p + 7 <= end && strncmp(p, "ENDSEC;", 7) == 0) return 0;
+        char* next;
+        long id = *p == '#' ? strtol(p + 1, &next, 10) : 0;
+        if (id < 1 || id > STEP_CHECK_MAX_ID || *next != '=') {
+            snprintf(err, errlen, "malformed entity at offset %ld", (long)(p - data));
+            return -1;
+        }
+        int old_capacity = file->capacity;
+        if (grow_array((void**)&file->entities, &file->capacity, id + 1, sizeof(step_entity_t)) < 0) {
+            snprintf(err, errlen, "out of memory");
+            return -1;
+        }
+        memset(file->entities + old_capacity, 0, (file->capacity - old_capacity) * sizeof(step_entity_t));
+        step_entity_t* e = &file->entities[id];
+        if (e->type) {
+            snprintf(err, errlen, "#%ld defined twice", id);
+            return -1;
+        }
+        e->type = ++next;
+        while (next < end && (isalnum((unsigned char)*next) || *next == '_')) next++;
+        e->type_len = next - e->type;
+        e->args = next < end ? next + 1 : end;
+        for (p = e->args; p < end && *p != ';'; ) {
+            p = *p == '\'' ? step_skip_string(p, end) : p + 1;
+        }
+        if (p == end) {
+            snprintf(err, errlen, "#%ld is not terminated", id);
+            return -1;
+        }
+        e->end = p++;
+        if (id > file->max_id) file->max_id = id;
+    }
+    snprintf(err, errlen, "DATA section not closed");
+    return -1;
+}
+
+static int step_is(const step_entity_t* e, const char* type) {
+    return e->type && e->type_len == (int)strlen(type) && strncmp(e->type, type, e->type_len) == 0;
+}
+
+// References of an entity in order into file->refs; returns their number
+static int step_refs(step_file_t* file, const step_entity_t* e) {
+    int n = 0;
+    for (const char* p = e->args; p < e->end; ) {
+        if (*p == '\'') {
+            p = step_skip_string(p, e->end);
+        } else if (*p == '#') {
+            char* next;
+            long id = strtol(p + 1, &next, 10);
+            if (grow_array((void**)&file->refs, &file->ref_capacity, n + 1, sizeof(int)) < 0) return -1;
+            file->refs[n++] = id > 0 && id <= file->max_id ? (int)id : 0;
+            p = next;
+        } else {
+            p++;
+        }
+    }
+    return n;
+}
+
+// The last logical of an entity, the sense flag of everything used here
+static int step_sense(const step_entity_t* e) {
+    for (const char* p = e->end - 3; p >= e->args; p--) {
+        if (p[0] == '.' && (p[1] == 'T' || p[1] == 'F') && p[2] == '.') return p[1] == 'T';
+    }
+    return 1;
+}
+
+static const step_entity_t* step_entity(const step_file_t* file, int id, const char* type) {
+    const step_entity_t* e = id > 0 && id <= file->max_id ? &file->entities[id] : NULL;
+    return e && step_is(e, type) ? e : NULL;
+}
+
+static int compare_step_uses(const void* a, const void* b) {
+    const step_use_t *x = a, *y = b;
+    if (x->edge != y->edge) return x->edge - y->edge;
+    return x->sense - y->sense;
+}
+
+// One loop of a face: its edge uses go to uses, its vertices must chain
+static int check_step_loop(step_file_t* file, int bound_id, step_use_t** uses, int* count, int* capacity,
+                           char* err, size_t errlen) {
+    const step_entity_t* bound = step_entity(file, bound_id, "FACE_OUTER_BOUND");
+    if (!bound) bound = step_entity(file, bound_id, "FACE_BOUND");
+    if (!bound || step_refs(file, bound) != 1) {
+        snprintf(err, errlen, "#%d is not a face bound", bound_id);
+        return -1;
+    }
+    int loop_id = file->refs[0], flip = !step_sense(bound);
+    const step_entity_t* loop = step_entity(file, loop_id, "EDGE_LOOP");
+    int n = loop ? step_refs(file, loop) : 0;
+    if (n < 1) {
+        snprintf(err, errlen, "#%d is not an edge loop", loop_id);
+        return -1;
+    }
+    int* oriented = malloc(n * sizeof(int));
+    if (!oriented) return -1;
+    memcpy(oriented, file->refs, n * sizeof(int));
+
+    int ret = -1, first = 0, last = 0;
+    for (int i = 0; i < n; i++) {
+        int k = flip ? n - 1 - i : i;
+        const step_entity_t* o = step_entity(file, oriented[k], "ORIENTED_EDGE");
+        if (!o || step_refs(file, o) != 1) {
+            snprintf(err, errlen, "#%d is not an oriented edge", oriented[k]);
+            goto out;
+        }
+        int edge_id = file->refs[0], sense = step_sense(o) != flip;
+        const step_entity_t* edge = step_entity(file, edge_id, "EDGE_CURVE");
+        if (!edge || step_refs(file, edge) != 3) {
+            snprintf(err, errlen, "#%d is not an edge curve", edge_id);
+            goto out;
+        }
+        int start = file->refs[sense ? 0 : 1], stop = file->refs[sense ? 1 : 0];
+        if (i == 0) {
+            first = start;
+        } else if (start != last) {
+            snprintf(err, errlen, "loop #%d breaks at edge #%d", loop_id, edge_id);
+            goto out;
+        }
+        last = stop;
+        if (grow_array((void**)uses, capacity, *count + 1, sizeof(step_use_t)) < 0) goto out;
+        (*uses)[(*count)++] = (step_use_t){ edge_id, sense };
+    }
+    if (last != first) {
+        snprintf(err, errlen, "loop #%d is not closed", loop_id);
+        goto out;
+    }
+    ret = 0;
+out:
+    free(oriented);
+    return ret;
+}
+
+static int check_step_shell(step_file_t* file, int shell_id, char* err, size_t errlen) {
+    step_use_t* uses = NULL;
+    int use_count = 0, use_capacity = 0, ret = -1;
+    int face_count = step_refs(file, &file->entities[shell_id]);
+    int* faces = malloc((face_count > 0 ? face_count : 1) * sizeof(int));
+    if (!faces || face_count < 1) {
+        snprintf(err, errlen, "shell #%d has no faces", shell_id);
+        goto out;
+    }
+    memcpy(faces, file->refs, face_count * sizeof(int));
+
+    for (int f = 0; f < face_count; f++) {
+        const step_entity_t* face = step_entity(file, faces[f], "ADVANCED_FACE");
+        int n = face ? step_refs(file, face) : 0;
+        if (n < 2) {
+            snprintf(err, errlen, "#%d is not a face", faces[f]);
+            goto out;
+        }
+        // Bounds, then the surface
+        int* bounds = malloc((n - 1) * sizeof(int));
+        if (!bounds) goto out;
+        memcpy(bounds, file->refs, (n - 1) * sizeof(int));
+        int bad = 0;
+        for (int i = 0; i < n - 1 && !bad; i++) {
+            bad = check_step_loop(file, bounds[i], &uses, &use_count, &use_capacity, err, errlen) < 0;
+        }
+        free(bounds);
+        if (bad) goto out;
+    }
+
+    // Closed: every edge exactly once forwards and once backwards
+    qsort(uses, use_count, sizeof(step_use_t), compare_step_uses);
+    for (int i = 0; i < use_count; i += 2) {
+        if (i + 1 == use_count || uses[i + 1].edge != uses[i].edge || uses[i].sense == uses[i + 1].sense ||
+            (i + 2 < use_count && uses[i + 2].edge == uses[i].edge)) {
+            snprintf(err, errlen, "shell #%d is open at edge #%d", shell_id, uses[i].edge);
+            goto out;
+        }
+    }
+    ret = 0;
+out:
+    free(faces);
+    free(uses);
+    return ret;
+}
+
+static int check_step_file(const char* data, size_t size, int* shells, char* err, size_t errlen) {
+    step_file_t file = {0};
+    int ret = -1;
+    *shells = 0;
+    if (parse_step_file(data, size, &file, err, errlen) < 0) goto out;
+
+    for (int id = 1; id <= file.max_id; id++) {
+        const step_entity_t* e = &file.entities[id];
+        if (!e->type) continue;
+        int n = step_refs(&file, e);
+        for (int i = 0; i < n; i++) {
+            if (!file.refs[i] || !file.entities[file.refs[i]].type) {
+                snprintf(err, errlen, "#%d refers to an undefined entity", id);
+                goto out;
+            }
+        }
+    }
+    for (int id = 1; id <= file.max_id; id++) {
+        if (!step_is(&file.entities[id], "CLOSED_SHELL")) continue;
+        if (check_step_shell(&file, id, err, errlen) < 0) goto out;
+        (*shells)++;
+    }
+    ret = 0;
+out:
+    free(file.entities);
+    free(file.refs);
+    return ret;
+}
+
+// The named files, or without any the plug models as written now
+int run_step_check(char** paths, int count) {
+    int checked = 0, failures = 0;
+    TRACE_START(t_check);
+    for (int i = 0; i < (count ? count : 2 * num_plug_specs); i++) {
+        char name[4096], err[256];
+        size_t size = 0;
+        char* data;
+        if (count) {
+            snprintf(name, sizeof(name), "%s", paths[i]);
+            data = read_text_file(name, &size);
+            if (!data) snprintf(err, sizeof(err), "%s", strerror(errno));
+        } else {
+            const plug_spec_t* plug = &plug_specs[i / 2];
+            snprintf(name, sizeof(name), "PLCCplug-%dpin%s", plug->pins, i % 2 ? " header" : "");
+            data = render_step_model(plug, i % 2 == 0, 1, &size);
+            if (!data) snprintf(err, sizeof(err), "cannot build model");
+        }
+
+        int shells = 0;
+        if (!data || check_step_file(data, size, &shells, err, sizeof(err)) < 0) {
+            printf("FAIL %s: %s\n", name, err);
+            failures++;
+        } else if (shells == 0) {
+            printf("FAIL %s: no closed shells\n", name);
+            failures++;
+        }
+        checked++;
+        free(data);
+    }
+    TRACE_STOP(t_check, STAGE_VALIDATE, checked);
+    printf("%d STEP models checked, %d failed\n", checked, failures);
+    return failures ? 1 : 0;
+}
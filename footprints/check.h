@@ -0,0 +1,47 @@
+/* Regression check for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#ifndef PLCC_CHECK_H
+#define PLCC_CHECK_H
+
+#include "plcc-gen.h"
+
+#define CHECK_MAX_ELEMENTS 1024
+
+typedef enum {
+    ELEM_HEADER,
+    ELEM_TEXT,
+    ELEM_SILKSCREEN,
+    ELEM_COURTYARD,
+    ELEM_FAB,
+    ELEM_PAD,
+    ELEM_VIA,
+    ELEM_MODEL,
+    ELEM_CLASS_COUNT
+} element_class_t;
+
+typedef struct {
+    char* text[CHECK_MAX_ELEMENTS];
+    int count[ELEM_CLASS_COUNT];
+    element_class_t cls[CHECK_MAX_ELEMENTS];
+    int total;
+} element_set_t;
+
+// The four footprints of every part, by file name suffix
+#define NUM_CHECK_VARIANTS 4
+
+typedef struct {
+    const char* suffix;
+    int double_sided, via_outside;
+} check_variant_t;
+
+extern const check_variant_t check_variants[NUM_CHECK_VARIANTS];
+
+void free_element_set(element_set_t* set);
+int parse_footprint_elements(const char* data, size_t size, element_set_t* set);
+int run_check(const char* library, int verbose);
+int run_step_check(char** paths, int count);
+
+#endif
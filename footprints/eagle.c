@@ -0,0 +1,101 @@
+/* Eagle output formatter for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#include "eagle.h"
+
+// Eagle library (.lbr) holding a single package. Eagle's y axis points up,
+// so all y coordinates are mirrored. Eagle has no rectangular drilled pads:
+// a double-sided pad becomes a top and a bottom SMD plus a round pad at the
+// drill position, tied together with Eagle's "name@n" convention.
+
+static int eagle_layer(const char* kicad_layer) {
+    if (strcmp(kicad_layer, "F.SilkS") == 0) return 21;   // tPlace
+    if (strcmp(kicad_layer, "B.SilkS") == 0) return 22;   // bPlace
+    if (strcmp(kicad_layer, "F.CrtYd") == 0) return 39;   // tKeepout
+    if (strcmp(kicad_layer, "F.Fab") == 0) return 51;     // tDocu
+    return 51;
+}
+
+static void write_eagle_header(FILE* f) {
+    static const struct { int number; const char* name; int color; } layers[] = {
+        {1, "Top", 4}, {16, "Bottom", 1}, {17, "Pads", 2}, {18, "Vias", 2},
+        {20, "Dimension", 15}, {21, "tPlace", 7}, {22, "bPlace", 7},
+        {25, "tNames", 7}, {27, "tValues", 7}, {29, "tStop", 7}, {30, "bStop", 7},
+        {31, "tCream", 7}, {39, "tKeepout", 4}, {44, "Drills", 7}, {51, "tDocu", 7},
+    };
+
+    fprintf(f, "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n");
+    fprintf(f, "<!DOCTYPE eagle SYSTEM \"eagle.dtd\">\n");
+    fprintf(f, "<eagle version=\"9.6.2\">\n<drawing>\n");
+    fprintf(f, "<settings>\n<setting alwaysvectorfont=\"no\"/>\n</settings>\n");
+    fprintf(f, "<grid distance=\"0.05\" unitdist=\"mm\" unit=\"mm\" style=\"lines\" multiple=\"1\" display=\"no\"/>\n");
+    fprintf(f, "<layers>\n");
+    for (size_t i = 0; i < sizeof(layers) / sizeof(layers[0]); i++) {
+        fprintf(f, "<layer number=\"%d\" name=\"%s\" color=\"%d\" fill=\"1\" visible=\"yes\" active=\"yes\"/>\n",
+                layers[i].number, layers[i].name, layers[i].color);
+    }
+    fprintf(f, "</layers>\n");
+}
+
+static void write_eagle_wire(FILE* f, line_t* line) {
+    fprintf(f, "<wire x1=\"%.3f\" y1=\"%.3f\" x2=\"%.3f\" y2=\"%.3f\" width=\"%g\" layer=\"%d\"/>\n",
+            line->start.x, -line->start.y, line->end.x, -line->end.y,
+            line->width, eagle_layer(line->layer));
+}
+
+static void write_eagle_pad(FILE* f, pad_t* pad, int* via_index) {
+    if (pad->number == 0) {
+        fprintf(f, "<pad name=\"V%d\" x=\"%.3f\" y=\"%.3f\" drill=\"%.1f\" diameter=\"%.3f\" shape=\"round\"/>\n",
+                ++*via_index, pad->position.x, -pad->position.y, pad->drill.diameter, pad->size.x);
+        return;
+    }
+
+    // As in KiCad, the copper sits at the drill offset and the hole at the
+    // pad position.
+    double x = pad->position.x + pad->drill.offset.x;
+    double y = pad->position.y + pad->drill.offset.y;
+    fprintf(f, "<smd name=\"%d\" x=\"%.3f\" y=\"%.3f\" dx=\"%.3f\" dy=\"%.3f\" layer=\"1\"/>\n",
+            pad->number, x, -y, pad->size.x, pad->size.y);
+    if (pad->type == PAD_THROUGHHOLE) {
+        fprintf(f, "<smd name=\"%d@1\" x=\"%.3f\" y=\"%.3f\" dx=\"%.3f\" dy=\"%.3f\" layer=\"16\"/>\n",
+                pad->number, x, -y, pad->size.x, pad->size.y);
+        fprintf(f, "<pad name=\"%d@2\" x=\"%.3f\" y=\"%.3f\" drill=\"%.1f\" diameter=\"%.3f\" shape=\"round\"/>\n",
+                pad->number, pad->position.x, -pad->position.y,
+                pad->drill.diameter, pad->drill.diameter * 2);
+    }
+}
+
+void write_eagle_library(FILE* f, footprint_geometry_t* geom, const component_spec_t* spec, footprint_options_t* opts) {
+    (void)opts;
+    write_eagle_header(f);
+
+    fprintf(f, "<library>\n");
+    fprintf(f, "<description>PLCC plugs generated by plcc-gen</description>\n");
+    fprintf(f, "<packages>\n");
+    fprintf(f, "<package name=\"%s\">\n", spec->name);
+    fprintf(f, "<description>PLCC plug, %d pins, surface mount</description>\n", spec->pins);
+
+    for (int i = 0; i < geom->silkscreen.count; i++) {
+        write_eagle_wire(f, &geom->silkscreen.lines[i]);
+    }
+    for (int i = 0; i < geom->courtyard.count; i++) {
+        write_eagle_wire(f, &geom->courtyard.lines[i]);
+    }
+    for (int i = 0; i < geom->fab.count; i++) {
+        write_eagle_wire(f, &geom->fab.lines[i]);
+    }
+
+    int via_index = 0;
+    for (int i = 0; i < geom->pad_count; i++) {
+        write_eagle_pad(f, &geom->pads[i], &via_index);
+    }
+
+    fprintf(f, "<text x=\"%.3f\" y=\"%.3f\" size=\"1\" layer=\"25\" align=\"center\">&gt;NAME</text>\n",
+            geom->text_positions[0].x, -geom->text_positions[0].y);
+    fprintf(f, "<text x=\"%.3f\" y=\"%.3f\" size=\"1\" layer=\"27\" align=\"center\">&gt;VALUE</text>\n",
+            geom->text_positions[1].x, -geom->text_positions[1].y);
+
+    fprintf(f, "</package>\n</packages>\n</library>\n</drawing>\n</eagle>\n");
+}
@@ -0,0 +1,13 @@
+/* Eagle output formatter for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#ifndef PLCC_EAGLE_H
+#define PLCC_EAGLE_H
+
+#include "plcc-gen.h"
+
+void write_eagle_library(FILE* f, footprint_geometry_t* geom, const component_spec_t* spec, footprint_options_t* opts);
+
+#endif
@@ -0,0 +1,545 @@
+/* Geometry calculation engine for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#include "geometry.h"
+
+// Pin 1 sits in the middle of the top row and the numbering runs clockwise:
+// the right half of the top row, the right side top to bottom, the bottom
+// row right to left, the left side bottom to top and the left half of the
+// top row. Any pin is found in constant time.
+int pin_locate(const component_spec_t* spec, int number, pin_info_t* pin) {
+    if (number < 1 || number > spec->pins) return -1;
+
+    double pitch = spec->pitch;
+    double a = spec->body.a;
+    double c = spec->body.c;
+    double pad_length = (c - spec->body.d) / 2;
+    double pins_width = spec->pins_x * pitch;
+    double pins_height = spec->pins_y * pitch;
+
+    // First pin of each side after the right half of the top row
+    int right = 2 + spec->pins_x / 2;
+    int bottom = right + spec->pins_y;
+    int left = bottom + spec->pins_x;
+    int top = left + spec->pins_y;
+
+    pin->number = number;
+    if (number < right || number >= top) {
+        int k = number < right ? number - 1 : number - top;
+        pin->side = SIDE_TOP;
+        pin->index = number < right ? spec->pins - top + 1 + k : k;
+        pin->position.x = number < right ? k * pitch : -(pins_width - pitch) / 2 + k * pitch;
+        pin->position.y = -(c - pad_length) / 2;
+    } else if (number < bottom) {
+        pin->side = SIDE_RIGHT;
+        pin->index = number - right;
+        pin->position.x = (a - pad_length) / 2;
+        pin->position.y = -(pins_height - pitch) / 2 + pin->index * pitch;
+    } else if (number < left) {
+        pin->side = SIDE_BOTTOM;
+        pin->index = number - bottom;
+        pin->position.x = (pins_width - pitch) / 2 - pin->index * pitch;
+        pin->position.y = (c - pad_length) / 2;
+    } else {
+        pin->side = SIDE_LEFT;
+        pin->index = number - left;
+        pin->position.x = -(a - pad_length) / 2;
+        pin->position.y = (pins_height - pitch) / 2 - pin->index * pitch;
+    }
+    int across = pin->side == SIDE_TOP || pin->side == SIDE_BOTTOM;
+    pin->size.x = across ? spec->pad_width : pad_length;
+    pin->size.y = across ? pad_length : spec->pad_width;
+    return 0;
+}
+
+static void calculate_pin_positions(footprint_geometry_t* geom, const component_spec_t* spec, footprint_options_t* opts) {
+    geom->pad_count = 0;
+
+    for (int i = 1; i <= spec->pins; i++) {
+        pin_info_t pin;
+        pin_locate(spec, i, &pin);
+        double px = pin.position.x;
+        double py = pin.position.y;
+        double sx = pin.size.x;
+        double sy = pin.size.y;
+
+        pad_t* pad = &geom->pads[geom->pad_count++];
+        pad->number = i;
+        pad->position.x = px;
+        pad->position.y = py;
+        pad->size.x = sx;
+        pad->size.y = sy;
+        pad->type = opts->double_sided ? PAD_THROUGHHOLE : PAD_SMD;
+
+        if (pad->type == PAD_THROUGHHOLE) {
+            pad->drill.diameter = 0.3;
+            double ox = (sx > sy) ? (px < 0 ? sx/4 : -sx/4) : 0;
+            double oy = (sx <= sy) ? (py < 0 ? sy/4 : -sy/4) : 0;
+            if (!opts->via_outside) {
+                ox *= -1;
+                oy *= -1;
+            }
+            pad->drill.offset.x = ox;
+            pad->drill.offset.y = oy;
+            pad->position.x = px - ox;
+            pad->position.y = py - oy;
+            strcpy(pad->layers, "\"*.Cu\" \"*.Mask\"");
+        } else {
+            strcpy(pad->layers, "\"F.Cu\" \"F.Paste\" \"F.Mask\"");
+
+            // Add via pad if via_outside is enabled for single-sided
+            if (opts->via_outside) {
+                pad_t* via_pad = &geom->pads[geom->pad_count++];
+                via_pad->number = 0; // Via pads don't have pin numbers
+                double ox = (sx > sy) ? (px < 0 ? sx/4 : -sx/4) : 0;
+                double oy = (sx <= sy) ? (py < 0 ? sy/4 : -sy/4) : 0;
+                // For via_outside, we want the via on the opposite side (outside)
+                via_pad->position.x = px - ox;
+                via_pad->position.y = py - oy;
+                via_pad->size.x = 0.6;
+                via_pad->size.y = 0.6;
+                via_pad->type = PAD_THROUGHHOLE;
+                via_pad->drill.diameter = 0.3;
+                via_pad->drill.offset.x = 0;
+                via_pad->drill.offset.y = 0;
+                strcpy(via_pad->layers, "\"*.Cu\" \"*.Mask\"");
+            }
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Outlines
+// ---------------------------------------------------------------------------
+
+// Courtyard, silkscreen and fab outlines are computed from what the
+// footprint actually covers. Pads, the squares around the vias and the body
+// are axis-aligned rectangles in integer micrometres. Growing a union of
+// rectangles by a square of radius r gives the union of the grown
+// rectangles, so offsets are exact. The union is then rasterised on the
+// grid of its own edge coordinates, which stays robust when shapes touch or
+// overlap, and its boundary is read off the grid as maximal straight lines.
+// Notches narrower than twice a gap are closed by growing by the gap and
+// then shrinking by it again; shrinking is growing the complement.
+
+#define REGION_UNITS 1000.0        // per mm: micrometres
+#define COURTYARD_CLEARANCE 0.25    // IPC-7351 nominal density
+#define COURTYARD_GAP 0.25          // closes notches up to 0.5 mm
+#define COURTYARD_GRID 0.01         // corners rounded outwards to this
+#define SILK_OFFSET 0.2             // silkscreen outline outside the body
+#define PIN1_GAP 1.0                // half width of the silkscreen gap above pin 1
+#define CORNER_CHAMFER 1.0          // bevelled top right corner, as on the plug
+
+typedef struct {
+    int64_t x0, y0, x1, y1;
+} region_rect_t;
+
+typedef struct {
+    region_rect_t* rects;
+    int count, capacity;
+} region_t;
+
+typedef struct {
+    int64_t* xs;
+    int64_t* ys;
+    int nx, ny;                 // edge coordinates; (nx - 1) x (ny - 1) cells
+    uint8_t* inside;
+} region_grid_t;
+
+static int64_t region_units(double mm) {
+    return llround(mm * REGION_UNITS);
+}
+
+static int region_init(region_t* o, int capacity) {
+    o->rects = malloc(capacity * sizeof(region_rect_t));
+    o->count = 0;
+    o->capacity = capacity;
+    return o->rects ? 0 : -1;
+}
+
+static void region_add(region_t* o, double x0, double y0, double x1, double y1) {
+    if (o->count == o->capacity) return;
+    o->rects[o->count++] = (region_rect_t){
+        region_units(fmin(x0, x1)), region_units(fmin(y0, y1)),
+        region_units(fmax(x0, x1)), region_units(fmax(y0, y1))
+    };
+}
+
+// Copper of a pad, or the square around a round via; the drill offset
+// moves the copper away from the hole
+static void region_add_pad(region_t* o, const pad_t* pad) {
+    double x = pad->position.x + pad->drill.offset.x;
+    double y = pad->position.y + pad->drill.offset.y;
+    region_add(o, x - pad->size.x / 2, y - pad->size.y / 2, x + pad->size.x / 2, y + pad->size.y / 2);
+}
+
+static void region_free_grid(region_grid_t* g) {
+    free(g->xs);
+    free(g->ys);
+    free(g->inside);
+    memset(g, 0, sizeof(*g));
+}
+
+static int compare_int64(const void* a, const void* b) {
+    int64_t x = *(const int64_t*)a, y = *(const int64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+static int region_unique(int64_t* v, int n) {
+    qsort(v, n, sizeof(int64_t), compare_int64);
+    int k = 0;
+    for (int i = 0; i < n; i++) {
+        if (k == 0 || v[k - 1] != v[i]) v[k++] = v[i];
+    }
+    return k;
+}
+
+static int region_index(const int64_t* v, int n, int64_t x) {
+    int lo = 0, hi = n - 1;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (v[mid] < x) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static int64_t snap_down(int64_t v, int64_t snap) {
+    int64_t r = v % snap;
+    return r < 0 ? v - r - snap : v - r;
+}
+
+static int64_t snap_up(int64_t v, int64_t snap) {
+    return -snap_down(-v, snap);
+}
+
+// Mark the union of rects, each grown by grow and rounded outwards to
+// multiples of snap, on a grid spanning frame
+static int region_rasterise(const region_rect_t* rects, int count, int64_t grow, int64_t snap,
+                             const region_rect_t* frame, region_grid_t* g) {
+    memset(g, 0, sizeof(*g));
+    g->xs = malloc((2 * count + 2) * sizeof(int64_t));
+    g->ys = malloc((2 * count + 2) * sizeof(int64_t));
+    region_rect_t* grown = malloc((count ? count : 1) * sizeof(region_rect_t));
+    if (!g->xs || !g->ys || !grown) {
+        free(grown);
+        region_free_grid(g);
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        region_rect_t r = {
+            snap_down(rects[i].x0 - grow, snap), snap_down(rects[i].y0 - grow, snap),
+            snap_up(rects[i].x1 + grow, snap), snap_up(rects[i].y1 + grow, snap)
+        };
+        r.x0 = r.x0 > frame->x0 ? r.x0 : frame->x0;
+        r.y0 = r.y0 > frame->y0 ? r.y0 : frame->y0;
+        r.x1 = r.x1 < frame->x1 ? r.x1 : frame->x1;
+        r.y1 = r.y1 < frame->y1 ? r.y1 : frame->y1;
+        grown[i] = r;
+        g->xs[g->nx++] = r.x0;
+        g->xs[g->nx++] = r.x1;
+        g->ys[g->ny++] = r.y0;
+        g->ys[g->ny++] = r.y1;
+    }
+    g->xs[g->nx++] = frame->x0;
+    g->xs[g->nx++] = frame->x1;
+    g->ys[g->ny++] = frame->y0;
+    g->ys[g->ny++] = frame->y1;
+    g->nx = region_unique(g->xs, g->nx);
+    g->ny = region_unique(g->ys, g->ny);
+
+    int width = g->nx - 1;
+    g->inside = calloc((size_t)width * (g->ny - 1) + 1, 1);
+    if (!g->inside) {
+        free(grown);
+        region_free_grid(g);
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        const region_rect_t* r = &grown[i];
+        if (r->x0 >= r->x1 || r->y0 >= r->y1) continue;
+        int i0 = region_index(g->xs, g->nx, r->x0), i1 = region_index(g->xs, g->nx, r->x1);
+        int j0 = region_index(g->ys, g->ny, r->y0), j1 = region_index(g->ys, g->ny, r->y1);
+        for (int j = j0; j < j1; j++) memset(g->inside + (size_t)j * width + i0, 1, i1 - i0);
+    }
+    free(grown);
+    return 0;
+}
+
+// The cells outside g as runs along each row, stored in rects unless NULL
+static int region_complement(const region_grid_t* g, region_rect_t* rects) {
+    int width = g->nx - 1, count = 0;
+    for (int j = 0; j < g->ny - 1; j++) {
+        const uint8_t* row = g->inside + (size_t)j * width;
+        for (int i = 0; i < width; ) {
+            if (row[i]) {
+                i++;
+                continue;
+            }
+            int start = i;
+            while (i < width && !row[i]) i++;
+            if (rects) rects[count] = (region_rect_t){ g->xs[start], g->ys[j], g->xs[i], g->ys[j + 1] };
+            count++;
+        }
+    }
+    return count;
+}
+
+// Union of the rects of o grown by grow, with corners rounded outwards to
+// multiples of snap and notches narrower than 2 * gap closed
+static int region_close(const region_t* o, int64_t grow, int64_t gap, int64_t snap, region_grid_t* g) {
+    region_rect_t frame = { INT64_MAX, INT64_MAX, INT64_MIN, INT64_MIN };
+    for (int i = 0; i < o->count; i++) {
+        const region_rect_t* r = &o->rects[i];
+        frame = (region_rect_t){
+            r->x0 < frame.x0 ? r->x0 : frame.x0, r->y0 < frame.y0 ? r->y0 : frame.y0,
+            r->x1 > frame.x1 ? r->x1 : frame.x1, r->y1 > frame.y1 ? r->y1 : frame.y1
+        };
+    }
+    if (o->count == 0) frame = (region_rect_t){ 0, 0, 0, 0 };
+    // Room for the complement around the grown outline
+    int64_t margin = snap_up(grow + 2 * gap + snap, snap);
+    frame = (region_rect_t){
+        snap_down(frame.x0 - margin, snap), snap_down(frame.y0 - margin, snap),
+        snap_up(frame.x1 + margin, snap), snap_up(frame.y1 + margin, snap)
+    };
+    if (gap == 0) return region_rasterise(o->rects, o->count, grow, snap, &frame, g);
+
+    region_grid_t grown;
+    if (region_rasterise(o->rects, o->count, grow + gap, snap, &frame, &grown) < 0) return -1;
+
+    // Shrinking by gap is growing the complement by gap
+    int runs = region_complement(&grown, NULL);
+    region_rect_t* complement = malloc((runs ? runs : 1) * sizeof(region_rect_t));
+    if (!complement) {
+        region_free_grid(&grown);
+        return -1;
+    }
+    region_complement(&grown, complement);
+    region_free_grid(&grown);
+
+    int ret = region_rasterise(complement, runs, gap, 1, &frame, g);
+    free(complement);
+    if (ret < 0) return -1;
+    size_t cells = (size_t)(g->nx - 1) * (g->ny - 1);
+    for (size_t i = 0; i < cells; i++) g->inside[i] = !g->inside[i];
+    return 0;
+}
+
+static int region_cell(const region_grid_t* g, int i, int j) {
+    if (i < 0 || j < 0 || i >= g->nx - 1 || j >= g->ny - 1) return 0;
+    return g->inside[(size_t)j * (g->nx - 1) + i];
+}
+
+static int region_emit(line_list_t* list, double x0, double y0, double x1, double y1,
+                       double width, const char* layer) {
+    if (grow_array((void**)&list->lines, &list->capacity, list->count + 1, sizeof(line_t)) < 0) return -1;
+    line_t* l = &list->lines[list->count++];
+    *l = (line_t){ { x0, y0 }, { x1, y1 }, width, "" };
+    snprintf(l->layer, sizeof(l->layer), "%s", layer);
+    return 0;
+}
+
+// Boundary of g as maximal horizontal and vertical lines; a line ends where
+// the inside changes sides
+static int region_trace(const region_grid_t* g, line_list_t* list, double width, const char* layer) {
+    for (int j = 0; j < g->ny; j++) {
+        for (int i = 0; i < g->nx - 1; ) {
+            int side = region_cell(g, i, j) - region_cell(g, i, j - 1);
+            if (!side) {
+                i++;
+                continue;
+            }
+            int start = i;
+            while (i < g->nx - 1 && region_cell(g, i, j) - region_cell(g, i, j - 1) == side) i++;
+            double y = g->ys[j] / REGION_UNITS;
+            if (region_emit(list, g->xs[start] / REGION_UNITS, y, g->xs[i] / REGION_UNITS, y, width, layer) < 0) return -1;
+        }
+    }
+    for (int i = 0; i < g->nx; i++) {
+        for (int j = 0; j < g->ny - 1; ) {
+            int side = region_cell(g, i, j) - region_cell(g, i - 1, j);
+            if (!side) {
+                j++;
+                continue;
+            }
+            int start = j;
+            while (j < g->ny - 1 && region_cell(g, i, j) - region_cell(g, i - 1, j) == side) j++;
+            double x = g->xs[i] / REGION_UNITS;
+            if (region_emit(list, x, g->ys[start] / REGION_UNITS, x, g->ys[j] / REGION_UNITS, width, layer) < 0) return -1;
+        }
+    }
+    return 0;
+}
+
+// Trace the rects of o grown by grow, notches below 2 * gap closed
+static int region_draw(const region_t* o, double grow, double gap, double snap,
+                       line_list_t* list, double width, const char* layer) {
+    region_grid_t g;
+    if (region_close(o, region_units(grow), region_units(gap), region_units(snap), &g) < 0) return -1;
+    int ret = region_trace(&g, list, width, layer);
+    region_free_grid(&g);
+    return ret;
+}
+
+// Cut the horizontal lines from first on at y = top between x0 and x1
+static int region_cut(line_list_t* list, int first, double top, double x0, double x1) {
+    int n = list->count;
+    for (int i = first; i < n; i++) {
+        line_t l = list->lines[i];
+        if (l.start.y != top || l.end.y != top) continue;
+        double lo = fmin(l.start.x, l.end.x), hi = fmax(l.start.x, l.end.x);
+        if (hi <= x0 || lo >= x1) continue;
+        list->lines[i].start.x = lo;
+        list->lines[i].end.x = fmax(lo, x0);
+        if (hi > x1 && region_emit(list, x1, top, hi, top, l.width, l.layer) < 0) return -1;
+    }
+    // Drop what the cut reduced to nothing
+    int k = first;
+    for (int i = first; i < list->count; i++) {
+        const line_t* l = &list->lines[i];
+        if (l->start.x != l->end.x || l->start.y != l->end.y) list->lines[k++] = *l;
+    }
+    list->count = k;
+    return 0;
+}
+
+// Bevel the corner at (x, y) of the lines from first on by len towards
+// (-1, +1), the top right corner of a footprint
+static int region_chamfer(line_list_t* list, int first, double x, double y, double len) {
+    int found = 0;
+    for (int i = first; i < list->count; i++) {
+        line_t* l = &list->lines[i];
+        point_t* ends[2] = { &l->start, &l->end };
+        for (int k = 0; k < 2; k++) {
+            if (ends[k]->x != x || ends[k]->y != y) continue;
+            if (l->start.y == l->end.y) ends[k]->x -= len;
+            else ends[k]->y += len;
+            found++;
+        }
+    }
+    if (found != 2) return 0;
+    line_t edge = list->lines[first];
+    return region_emit(list, x - len, y, x, y + len, edge.width, edge.layer);
+}
+
+// Top right corner of the lines from first on
+static point_t region_corner(const line_list_t* list, int first) {
+    point_t corner = { -INFINITY, INFINITY };
+    for (int i = first; i < list->count; i++) {
+        const line_t* l = &list->lines[i];
+        corner.x = fmax(corner.x, fmax(l->start.x, l->end.x));
+        corner.y = fmin(corner.y, fmin(l->start.y, l->end.y));
+    }
+    return corner;
+}
+
+static int generate_silkscreen_lines(footprint_geometry_t* geom, const region_t* copper, const char* layer) {
+    // Around the body and any copper beyond it, with a gap above pin 1 and
+    // a bevel where the socket has its bevelled corner
+    line_list_t* list = &geom->silkscreen;
+    int first = list->count;
+    if (region_draw(copper, SILK_OFFSET, 0, 1 / REGION_UNITS, list, 0.12, layer) < 0) return -1;
+
+    point_t corner = region_corner(list, first);
+    if (region_cut(list, first, corner.y, -PIN1_GAP, PIN1_GAP) < 0) return -1;
+    return region_chamfer(list, first, corner.x, corner.y, CORNER_CHAMFER);
+}
+
+static int generate_courtyard_lines(footprint_geometry_t* geom, const region_t* copper) {
+    return region_draw(copper, COURTYARD_CLEARANCE, COURTYARD_GAP, COURTYARD_GRID,
+                       &geom->courtyard, 0.05, "F.CrtYd");
+}
+
+static int generate_fabrication_lines(footprint_geometry_t* geom, const component_spec_t* spec) {
+    // Socket body (a x c) with its bevelled corner, the opening (b x d)
+    // and a pin 1 marker
+    line_list_t* list = &geom->fab;
+    region_rect_t rect;
+    region_t body = { &rect, 0, 1 };
+
+    region_add(&body, -spec->body.a / 2, -spec->body.c / 2, spec->body.a / 2, spec->body.c / 2);
+    if (region_draw(&body, 0, 0, 1 / REGION_UNITS, list, 0.1, "F.Fab") < 0) return -1;
+    point_t corner = region_corner(list, 0);
+    if (region_chamfer(list, 0, corner.x, corner.y, CORNER_CHAMFER) < 0) return -1;
+
+    body.count = 0;
+    region_add(&body, -spec->body.b / 2, -spec->body.d / 2, spec->body.b / 2, spec->body.d / 2);
+    if (region_draw(&body, 0, 0, 1 / REGION_UNITS, list, 0.1, "F.Fab") < 0) return -1;
+
+    if (region_emit(list, -0.5, corner.y, 0, corner.y + 1, 0.1, "F.Fab") < 0) return -1;
+    return region_emit(list, 0, corner.y + 1, 0.5, corner.y, 0.1, "F.Fab");
+}
+
+static void calculate_text_positions(footprint_geometry_t* geom, const component_spec_t* spec) {
+    double offset = spec->body.a / 2 + 1.0;
+
+    geom->text_positions[0] = (point_t){0, -offset};      // reference
+    geom->text_positions[1] = (point_t){0, offset + 0.5}; // value
+    geom->text_positions[2] = (point_t){0, 0.525};        // user
+}
+
+void free_geometry(footprint_geometry_t* geom) {
+    if (!geom) return;
+    free(geom->pads);
+    free(geom->silkscreen.lines);
+    free(geom->fab.lines);
+    free(geom->courtyard.lines);
+    free(geom);
+}
+
+footprint_geometry_t* generate_geometry(const component_spec_t* spec, footprint_options_t* opts) {
+    TRACE_START(t_geometry);
+    footprint_geometry_t* geom = calloc(1, sizeof(footprint_geometry_t));
+    if (!geom) return NULL;
+
+    // Every pin may carry an extra via pad
+    geom->pad_capacity = spec->pins * 2;
+    geom->pads = calloc(geom->pad_capacity, sizeof(pad_t));
+    if (!geom->pads) {
+        free(geom);
+        return NULL;
+    }
+
+    TRACE_START(t_pins);
+    calculate_pin_positions(geom, spec, opts);
+    TRACE_STOP(t_pins, STAGE_PINS, geom->pad_count);
+
+    // Everything the outlines keep clear of: the body, pads and vias
+    region_t copper;
+    if (region_init(&copper, geom->pad_count + 1) < 0) {
+        free_geometry(geom);
+        return NULL;
+    }
+    region_add(&copper, -spec->body.a / 2, -spec->body.c / 2, spec->body.a / 2, spec->body.c / 2);
+    for (int i = 0; i < geom->pad_count; i++) region_add_pad(&copper, &geom->pads[i]);
+
+    TRACE_START(t_silk);
+    int err = generate_silkscreen_lines(geom, &copper, "F.SilkS");
+    err = err || generate_silkscreen_lines(geom, &copper, "B.SilkS");
+    TRACE_STOP(t_silk, STAGE_SILKSCREEN, geom->silkscreen.count);
+
+    TRACE_START(t_courtyard);
+    err = err || generate_courtyard_lines(geom, &copper);
+    TRACE_STOP(t_courtyard, STAGE_COURTYARD, geom->courtyard.count);
+
+    TRACE_START(t_fab);
+    err = err || generate_fabrication_lines(geom, spec);
+    TRACE_STOP(t_fab, STAGE_FAB, geom->fab.count);
+
+    free(copper.rects);
+    if (err) {
+        fprintf(stderr, "Error: %s: out of memory for the outlines\n", spec->name);
+        free_geometry(geom);
+        return NULL;
+    }
+
+    TRACE_START(t_text);
+    calculate_text_positions(geom, spec);
+    TRACE_STOP(t_text, STAGE_TEXT, 3);
+
+    TRACE_STOP(t_geometry, STAGE_GEOMETRY, spec->pins);
+    return geom;
+}
@@ -0,0 +1,15 @@
+/* Geometry calculation engine for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#ifndef PLCC_GEOMETRY_H
+#define PLCC_GEOMETRY_H
+
+#include "plcc-gen.h"
+
+int pin_locate(const component_spec_t* spec, int number, pin_info_t* pin);
+void free_geometry(footprint_geometry_t* geom);
+footprint_geometry_t* generate_geometry(const component_spec_t* spec, footprint_options_t* opts);
+
+#endif
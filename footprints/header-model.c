@@ -0,0 +1,114 @@
+/* Header strip model for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#include "header-model.h"
+#include "mesh.h"
+
+// Native version of render_pins in plccplug.scad: four 1.27mm right angle
+// header strips around the plug, geometry as in angle_header.scad. One pin
+// is tessellated once and instanced along each strip.
+
+// Append one pin in the angle_pin() frame: vertical leg at x = -p from
+// z = 0 up, bend around the origin, horizontal leg at z = -p towards +x
+static int build_header_pin(mesh_t* metal, mesh_t* plastic, int bend_segments) {
+    const double p = HEADER_PITCH;
+    const double s = p / 4 + 0.005;      // pin cross section
+    const double d = s / 2;
+    const double h = p * 4 - 0.5 + 1.9;  // vertical leg length
+    const double body_z = HEADER_PIN_BASE + d;
+
+    transform_t top = transform_translate(-p, 0, h);
+    transform_t tip_at = transform_translate(p, 0, -p);
+    transform_t tip_rot = transform_rotate(0, 90, 0);
+    transform_t tip = transform_mul(&tip_at, &tip_rot);
+    transform_t bend = transform_rotate(90, 0, 0);
+
+    if (mesh_box(metal, (vec3_t){ -p - d, -d, 0 }, (vec3_t){ -p + d, d, h }) < 0 ||
+        mesh_pyramid(metal, d, d, &top) < 0 ||
+        mesh_quarter_bend(metal, p, s, bend_segments, &bend) < 0 ||
+        mesh_box(metal, (vec3_t){ 0, -d, -p - d }, (vec3_t){ p, d, -p + d }) < 0 ||
+        mesh_pyramid(metal, d, d, &tip) < 0) {
+        return -1;
+    }
+
+    // The plastic cube loses its corners to four triangular prisms; what
+    // is left is an octagon. The prisms' inner edges lie on x + y = chamfer.
+    const double chamfer = 2 * 1.9 * s - sqrt(2) * d;
+    const double e = p / 2, c = chamfer - e;
+    const point_t body[8] = {
+        {-p + e, -c}, {-p + e, c}, {-p + c, e}, {-p - c, e},
+        {-p - e, c}, {-p - e, -c}, {-p - c, -e}, {-p + c, -e},
+    };
+    return mesh_prism(plastic, body, 8, body_z - p / 2, body_z + p / 2);
+}
+
+// Header placement from plccplug(): translation, rotation and pin count
+typedef struct {
+    double x, y, z;
+    double rx, ry, rz;
+    int pins;
+} header_strip_t;
+
+// Where every pin of the four strips goes, in plug coordinates. place
+// needs room for plug->pins transforms; returns how many were filled in.
+int header_pin_placements(const plug_spec_t* plug, transform_t* place) {
+    const double c = plug->c, d = plug->d;
+    const header_strip_t strips[4] = {
+        { c - 0.4, d / 2 - 0.025, -2.35, 0, 270, 0, plug->pins_y },     // right
+        { c / 2 - 0.025, d - 0.4, -2.35, 90, 270, 0, plug->pins_x },    // top
+        { 0.4, d / 2 - 0.025, -2.35, 180, 270, 0, plug->pins_y },       // left
+        { c / 2 - 0.025, 0.4, -2.35, 270, 270, 0, plug->pins_x },       // bottom
+    };
+    int count = 0;
+
+    for (int s = 0; s < 4; s++) {
+        const header_strip_t* hs = &strips[s];
+        transform_t at = transform_translate(hs->x, hs->y, hs->z);
+        transform_t rot = transform_rotate(hs->rx, hs->ry, hs->rz);
+        transform_t strip = transform_mul(&at, &rot);
+        transform_t header_rot = transform_rotate(0, 90, 0);
+        strip = transform_mul(&strip, &header_rot);
+
+        // angle_header(rows, cols=1): pins along y, centred, lifted by p
+        double offset = -(hs->pins - 1) / 2.0 * HEADER_PITCH;
+        for (int i = 0; i < hs->pins; i++) {
+            transform_t pin = transform_translate(0, offset + HEADER_PITCH * i, HEADER_PITCH);
+            place[count++] = transform_mul(&strip, &pin);
+        }
+    }
+    return count;
+}
+
+int build_header_model(model_t* model, const plug_spec_t* plug, int bend_segments) {
+    mesh_t pin_metal = {0}, pin_plastic = {0};
+    transform_t* place = NULL;
+    int ret = -1;
+
+    memset(model, 0, sizeof(*model));
+    snprintf(model->name, sizeof(model->name), "PLCCplug_%dpin_header", plug->pins);
+    model_part_t* metal = model_add_part(model, "pins", 0.976471, 0.843137, 0.172549);
+    model_part_t* plastic = model_add_part(model, "body", 0.411765, 0.411765, 0.411765);
+
+    TRACE_START(t_mesh);
+    if (bend_segments < 1 || build_header_pin(&pin_metal, &pin_plastic, bend_segments) < 0) goto out;
+    if (!(place = malloc(plug->pins * sizeof(*place)))) goto out;
+
+    int count = header_pin_placements(plug, place);
+    for (int i = 0; i < count; i++) {
+        if (mesh_append(&metal->mesh, &pin_metal, &place[i]) < 0 ||
+            mesh_append(&plastic->mesh, &pin_plastic, &place[i]) < 0) {
+            goto out;
+        }
+    }
+    ret = 0;
+
+out:
+    TRACE_STOP(t_mesh, STAGE_MESH, model_triangle_count(model));
+    free(place);
+    mesh_free(&pin_metal);
+    mesh_free(&pin_plastic);
+    if (ret < 0) model_free(model);
+    return ret;
+}
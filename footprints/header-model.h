@@ -0,0 +1,19 @@
+/* Header strip model for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#ifndef PLCC_HEADER_MODEL_H
+#define PLCC_HEADER_MODEL_H
+
+#include "plcc-gen.h"
+#include "mesh.h"
+
+#define HEADER_PITCH 1.27
+#define HEADER_PIN_BASE 0.3       // base in h_pin()
+#define DEFAULT_BEND_SEGMENTS 25  // rotate_extrude($fn=100, angle=90)
+
+int header_pin_placements(const plug_spec_t* plug, transform_t* place);
+int build_header_model(model_t* model, const plug_spec_t* plug, int bend_segments);
+
+#endif
@@ -0,0 +1,363 @@
+/* Header strip planner for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#include "header-plan.h"
+
+// Cut lists for batches of plugs. Every plug takes four strips, pins_y,
+// pins_x, pins_y and pins_x pins long as in render_pins, cut from stock
+// strips of the lengths on hand. The linear relaxation of the cutting
+// stock problem is solved by column generation: a simplex with one row per
+// strip length, whose new patterns come from an unbounded knapsack per
+// stock length priced with the duals. Rounding the patterns down and
+// solving the rest again gives the integer plan, and the last few pieces
+// go first fit decreasing. The work depends on the number of distinct
+// lengths, not on the size of the batch.
+
+#define PLAN_MAX_LENGTHS 8          // distinct strip lengths, the LP rows
+#define PLAN_MAX_STOCK 8
+#define PLAN_MAX_STOCK_PINS 1000
+#define PLAN_MAX_ITERATIONS 1000
+#define PLAN_MAX_ROUNDS 32
+
+typedef struct {
+    int stock;                      // pins of the stock strip
+    int count[PLAN_MAX_LENGTHS];    // pieces of every length
+} cut_pattern_t;
+
+typedef struct {
+    cut_pattern_t pattern;
+    long times;
+} cut_entry_t;
+
+typedef struct {
+    int lengths[PLAN_MAX_LENGTHS];  // strip lengths in pins, longest first
+    int length_count;
+    int stock[PLAN_MAX_STOCK];      // shortest first
+    int stock_count;
+    int kerf;                       // pins lost to every cut
+    cut_entry_t* entries;
+    int entry_count, entry_capacity;
+} cut_plan_t;
+
+static int pattern_pins(const cut_plan_t* plan, const cut_pattern_t* p) {
+    int pins = 0, pieces = 0;
+    for (int i = 0; i < plan->length_count; i++) {
+        pins += p->count[i] * plan->lengths[i];
+        pieces += p->count[i];
+    }
+    return pins + (pieces ? pieces - 1 : 0) * plan->kerf;
+}
+
+// Most valuable pattern for one stock length: an unbounded knapsack with
+// the duals as values. A piece takes its length plus a kerf, the stock
+// one kerf more, as the last piece needs no cut.
+static double cut_price(const cut_plan_t* plan, int stock, const double* dual, cut_pattern_t* p) {
+    double best[PLAN_MAX_STOCK_PINS + PLAN_MAX_STOCK_PINS + 1];
+    int choice[PLAN_MAX_STOCK_PINS + PLAN_MAX_STOCK_PINS + 1];
+    int cap = stock + plan->kerf;
+
+    best[0] = 0;
+    choice[0] = -1;
+    for (int c = 1; c <= cap; c++) {
+        best[c] = best[c - 1];
+        choice[c] = -1;
+        for (int i = 0; i < plan->length_count; i++) {
+            int w = plan->lengths[i] + plan->kerf;
+            if (w <= c && dual[i] > 0 && best[c - w] + dual[i] > best[c] + 1e-12) {
+                best[c] = best[c - w] + dual[i];
+                choice[c] = i;
+            }
+        }
+    }
+    memset(p, 0, sizeof(*p));
+    p->stock = stock;
+    for (int c = cap; c > 0;) {
+        int i = choice[c];
+        if (i < 0) {
+            c--;
+            continue;
+        }
+        p->count[i]++;
+        c -= plan->lengths[i] + plan->kerf;
+    }
+    return best[cap];
+}
+
+// Linear relaxation for demand: fills basis with up to length_count
+// patterns and their (fractional) use, and returns the stock pins of the
+// optimum. Columns are patterns, or surplus pieces when basis[i].stock is 0.
+static double cut_lp(const cut_plan_t* plan, const long* demand, cut_pattern_t* basis, double* x) {
+    int m = plan->length_count;
+    double inverse[PLAN_MAX_LENGTHS][PLAN_MAX_LENGTHS] = { { 0 } };
+    double dual[PLAN_MAX_LENGTHS], column[PLAN_MAX_LENGTHS], dir[PLAN_MAX_LENGTHS];
+
+    // Start from the longest stock cut into one length only
+    int longest = plan->stock[plan->stock_count - 1];
+    for (int i = 0; i < m; i++) {
+        memset(&basis[i], 0, sizeof(basis[i]));
+        basis[i].stock = longest;
+        basis[i].count[i] = (longest + plan->kerf) / (plan->lengths[i] + plan->kerf);
+        inverse[i][i] = 1.0 / basis[i].count[i];
+        x[i] = demand[i] * inverse[i][i];
+    }
+
+    for (int iteration = 0; iteration < PLAN_MAX_ITERATIONS; iteration++) {
+        for (int j = 0; j < m; j++) {
+            dual[j] = 0;
+            for (int i = 0; i < m; i++) dual[j] += basis[i].stock * inverse[i][j];
+        }
+
+        // Entering column: a surplus with a negative dual, else the best
+        // pattern over all stock lengths
+        cut_pattern_t enter = { 0 };
+        double reduced = -1e-9;
+        int surplus = 0;
+        for (int j = 0; j < m; j++) {
+            if (dual[j] < reduced) {
+                memset(&enter, 0, sizeof(enter));
+                enter.count[j] = -1;
+                reduced = dual[j];
+                surplus = 1;
+            }
+        }
+        for (int s = 0; s < plan->stock_count && !surplus; s++) {
+            cut_pattern_t p;
+            double r = plan->stock[s] - cut_price(plan, plan->stock[s], dual, &p);
+            if (r < reduced) {
+                enter = p;
+                reduced = r;
+            }
+        }
+        if (reduced == -1e-9) break;
+
+        for (int i = 0; i < m; i++) column[i] = enter.count[i];
+        int row = -1;
+        double step = INFINITY;
+        for (int i = 0; i < m; i++) {
+            dir[i] = 0;
+            for (int j = 0; j < m; j++) dir[i] += inverse[i][j] * column[j];
+            if (dir[i] > 1e-12 && x[i] / dir[i] < step - 1e-12) {
+                step = x[i] / dir[i];
+                row = i;
+            }
+        }
+        if (row < 0) break;
+
+        double pivot = dir[row];
+        for (int j = 0; j < m; j++) inverse[row][j] /= pivot;
+        for (int i = 0; i < m; i++) {
+            if (i == row) continue;
+            for (int j = 0; j < m; j++) inverse[i][j] -= dir[i] * inverse[row][j];
+            x[i] -= dir[i] * step;
+            if (x[i] < 0) x[i] = 0;
+        }
+        x[row] = step;
+        basis[row] = enter;
+    }
+
+    double total = 0;
+    for (int i = 0; i < m; i++) total += basis[i].stock * x[i];
+    return total;
+}
+
+static int cut_add(cut_plan_t* plan, const cut_pattern_t* p, long times) {
+    for (int i = 0; i < plan->entry_count; i++) {
+        if (memcmp(&plan->entries[i].pattern, p, sizeof(*p)) == 0) {
+            plan->entries[i].times += times;
+            return 0;
+        }
+    }
+    if (grow_array((void**)&plan->entries, &plan->entry_capacity, plan->entry_count + 1, sizeof(cut_entry_t)) < 0) {
+        return -1;
+    }
+    plan->entries[plan->entry_count++] = (cut_entry_t){ *p, times };
+    return 0;
+}
+
+// What rounding leaves over, first fit decreasing into the longest stock;
+// every strip then moves to the shortest stock that still holds it
+static int cut_first_fit(cut_plan_t* plan, long* rest) {
+    int longest = plan->stock[plan->stock_count - 1];
+    cut_pattern_t* open = NULL;
+    int open_count = 0, open_capacity = 0, ret = 0;
+
+    for (int i = 0; i < plan->length_count; i++) {
+        for (; rest[i] > 0; rest[i]--) {
+            int k = 0;
+            for (; k < open_count; k++) {
+                open[k].count[i]++;
+                if (pattern_pins(plan, &open[k]) <= longest) break;
+                open[k].count[i]--;
+            }
+            if (k == open_count) {
+                if (grow_array((void**)&open, &open_capacity, open_count + 1, sizeof(cut_pattern_t)) < 0) {
+                    free(open);
+                    return -1;
+                }
+                memset(&open[open_count], 0, sizeof(cut_pattern_t));
+                open[open_count++].count[i] = 1;
+            }
+        }
+    }
+    for (int k = 0; k < open_count && ret == 0; k++) {
+        int used = pattern_pins(plan, &open[k]);
+        open[k].stock = longest;
+        for (int s = 0; s < plan->stock_count; s++) {
+            if (plan->stock[s] >= used) {
+                open[k].stock = plan->stock[s];
+                break;
+            }
+        }
+        ret = cut_add(plan, &open[k], 1);
+    }
+    free(open);
+    return ret;
+}
+
+static int compare_ints_descending(const void* a, const void* b) {
+    return *(const int*)b - *(const int*)a;
+}
+
+static int compare_cut_entries(const void* a, const void* b) {
+    const cut_entry_t* x = a;
+    const cut_entry_t* y = b;
+    if (x->times != y->times) return x->times < y->times ? 1 : -1;
+    return memcmp(&x->pattern, &y->pattern, sizeof(x->pattern));
+}
+
+// "84=100" terms to plug counts, "50,40" to stock lengths; one JSON line
+// with the cut list on stdout
+int run_cut_plan(const char* first, char** terms, int nterms, const char* stock_list, int kerf) {
+    long plugs[sizeof(plug_specs) / sizeof(plug_specs[0])] = { 0 };
+    long demand[PLAN_MAX_LENGTHS] = { 0 };
+    cut_plan_t plan = { .kerf = kerf };
+    int ret = 1;
+
+    double start = monotonic_us();
+    if (kerf < 0 || kerf > PLAN_MAX_STOCK_PINS) {
+        fprintf(stderr, "Error: --kerf must be 0 to %d pins\n", PLAN_MAX_STOCK_PINS);
+        return 1;
+    }
+    for (int t = -1; t < nterms; t++) {
+        const char* term = t < 0 ? first : terms[t];
+        int pins;
+        long count;
+        char tail;
+        const plug_spec_t* plug = NULL;
+        if (sscanf(term, "%d=%ld%c", &pins, &count, &tail) != 2 || count < 0 || !(plug = find_plug_by_pins(pins))) {
+            fprintf(stderr, "Error: '%s': expected PINS=COUNT with one of the plug sizes\n", term);
+            return 1;
+        }
+        plugs[plug - plug_specs] += count;
+    }
+
+    // Strip lengths, longest first, and the pieces of each
+    for (int i = 0; i < num_plug_specs; i++) {
+        const int strips[2] = { plug_specs[i].pins_x, plug_specs[i].pins_y };
+        for (int k = 0; k < 2 && plugs[i]; k++) {
+            int j = 0;
+            while (j < plan.length_count && plan.lengths[j] != strips[k]) j++;
+            if (j == plan.length_count) plan.lengths[plan.length_count++] = strips[k];
+        }
+    }
+    qsort(plan.lengths, plan.length_count, sizeof(int), compare_ints_descending);
+    for (int i = 0; i < num_plug_specs; i++) {
+        for (int j = 0; j < plan.length_count; j++) {
+            demand[j] += 2 * plugs[i] * ((plug_specs[i].pins_x == plan.lengths[j]) + (plug_specs[i].pins_y == plan.lengths[j]));
+        }
+    }
+
+    char list[256];
+    snprintf(list, sizeof(list), "%s", stock_list ? stock_list : "");
+    char* save = NULL;
+    for (char* item = strtok_r(list, ",", &save); item; item = strtok_r(NULL, ",", &save)) {
+        char* end;
+        long pins = strtol(item, &end, 10);
+        if (*end || pins < 1 || pins > PLAN_MAX_STOCK_PINS || plan.stock_count == PLAN_MAX_STOCK) {
+            fprintf(stderr, "Error: --stock takes up to %d lengths of 1 to %d pins\n", PLAN_MAX_STOCK, PLAN_MAX_STOCK_PINS);
+            return 1;
+        }
+        plan.stock[plan.stock_count++] = pins;
+    }
+    if (!plan.stock_count) plan.stock[plan.stock_count++] = DEFAULT_STOCK_PINS;
+    qsort(plan.stock, plan.stock_count, sizeof(int), compare_ints);
+    if (plan.length_count && plan.lengths[0] > plan.stock[plan.stock_count - 1]) {
+        fprintf(stderr, "Error: %d pin strips do not fit into %d pin stock\n", plan.lengths[0],
+                plan.stock[plan.stock_count - 1]);
+        return 1;
+    }
+
+    // Relax, round down, repeat on the rest
+    cut_pattern_t basis[PLAN_MAX_LENGTHS];
+    double x[PLAN_MAX_LENGTHS];
+    long rest[PLAN_MAX_LENGTHS];
+    memcpy(rest, demand, sizeof(rest));
+    double bound = plan.length_count ? cut_lp(&plan, demand, basis, x) : 0;
+    for (int round = 0; round < PLAN_MAX_ROUNDS; round++) {
+        long left = 0;
+        int progress = 0;
+        for (int i = 0; i < plan.length_count; i++) left += rest[i];
+        if (!left) break;
+        if (round) cut_lp(&plan, rest, basis, x);
+        for (int i = 0; i < plan.length_count; i++) {
+            long times = (long)floor(x[i] + 1e-9);
+            if (basis[i].stock == 0 || times <= 0) continue;
+            if (cut_add(&plan, &basis[i], times) < 0) goto out;
+            for (int j = 0; j < plan.length_count; j++) {
+                rest[j] -= times * basis[i].count[j];
+                if (rest[j] < 0) rest[j] = 0;
+            }
+            progress = 1;
+        }
+        if (!progress) break;
+    }
+    if (cut_first_fit(&plan, rest) < 0) goto out;
+    qsort(plan.entries, plan.entry_count, sizeof(cut_entry_t), compare_cut_entries);
+
+    long sticks = 0, stock_pins = 0, cut[PLAN_MAX_LENGTHS] = { 0 }, piece_pins = 0, spare_pins = 0;
+    for (int e = 0; e < plan.entry_count; e++) {
+        const cut_entry_t* entry = &plan.entries[e];
+        sticks += entry->times;
+        stock_pins += entry->times * entry->pattern.stock;
+        for (int i = 0; i < plan.length_count; i++) cut[i] += entry->times * entry->pattern.count[i];
+    }
+    for (int i = 0; i < plan.length_count; i++) {
+        piece_pins += demand[i] * plan.lengths[i];
+        spare_pins += (cut[i] - demand[i]) * plan.lengths[i];
+    }
+    double elapsed = monotonic_us() - start;
+
+    printf("{\"plugs\":{");
+    for (int i = 0, n = 0; i < num_plug_specs; i++) {
+        if (plugs[i]) printf("%s\"%d\":%ld", n++ ? "," : "", plug_specs[i].pins, plugs[i]);
+    }
+    printf("},\"stock\":[");
+    for (int s = 0; s < plan.stock_count; s++) printf("%s%d", s ? "," : "", plan.stock[s]);
+    printf("],\"kerf\":%d,\"pieces\":{", kerf);
+    for (int i = 0; i < plan.length_count; i++) printf("%s\"%d\":%ld", i ? "," : "", plan.lengths[i], demand[i]);
+    printf("},\"spares\":{");
+    for (int i = 0, n = 0; i < plan.length_count; i++) {
+        if (cut[i] > demand[i]) printf("%s\"%d\":%ld", n++ ? "," : "", plan.lengths[i], cut[i] - demand[i]);
+    }
+    printf("},\"sticks\":%ld,\"stock_pins\":%ld,\"piece_pins\":%ld,\"spare_pins\":%ld,\"waste_pins\":%ld,"
+           "\"waste_percent\":%.2f,\"lp_bound_pins\":%.1f,\"time_ms\":%.3f,\"cuts\":[",
+           sticks, stock_pins, piece_pins, spare_pins, stock_pins - piece_pins,
+           stock_pins ? 100.0 * (stock_pins - piece_pins) / stock_pins : 0.0, bound, elapsed / 1000);
+    for (int e = 0; e < plan.entry_count; e++) {
+        const cut_entry_t* entry = &plan.entries[e];
+        printf("%s{\"stock\":%d,\"count\":%ld,\"pieces\":[", e ? "," : "", entry->pattern.stock, entry->times);
+        for (int i = 0, n = 0; i < plan.length_count; i++) {
+            for (int k = 0; k < entry->pattern.count[i]; k++) printf("%s%d", n++ ? "," : "", plan.lengths[i]);
+        }
+        printf("],\"offcut\":%d}", entry->pattern.stock - pattern_pins(&plan, &entry->pattern));
+    }
+    printf("]}\n");
+    ret = 0;
+
+out:
+    if (ret) fprintf(stderr, "Error: out of memory\n");
+    free(plan.entries);
+    return ret;
+}
@@ -0,0 +1,15 @@
+/* Header strip planner for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#ifndef PLCC_HEADER_PLAN_H
+#define PLCC_HEADER_PLAN_H
+
+#include "plcc-gen.h"
+
+#define DEFAULT_STOCK_PINS 50       // as suggested in the README
+
+int run_cut_plan(const char* first, char** terms, int nterms, const char* stock_list, int kerf);
+
+#endif
@@ -0,0 +1,252 @@
+/* KiCad output formatter for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#include "kicad.h"
+
+static void write_kicad_header(FILE* f, const component_spec_t* spec) {
+    fprintf(f, "(footprint \"%s\" (version 20210228) (generator pcbnew) (layer \"F.Cu\")\n", spec->name);
+    fprintf(f, "  (tedit 60690F97)\n");
+    fprintf(f, "  (descr \"PLCC plug, %d pins, surface mount\")\n", spec->pins);
+    fprintf(f, "  (tags \"plcc smt\")\n");
+    fprintf(f, "  (autoplace_cost180 1)\n");
+    fprintf(f, "  (attr smd)\n");
+}
+
+static void write_kicad_text(FILE* f, const char* type, const char* text, point_t pos, footprint_options_t* opts) {
+    fprintf(f, "  (fp_text %s \"%s\" (at %.0f %.3f -180) (layer \"%s\")\n",
+            type, text, pos.x, pos.y,
+            strcmp(type, "reference") == 0 ? "F.SilkS" : "F.Fab");
+    fprintf(f, "    (effects (font (size %.3f %.3f) (thickness 0.15)))\n", 1.0, 1.0);
+    fprintf(f, "    (tstamp %s)\n", opts->timestamp);
+    fprintf(f, "  )\n");
+}
+
+static void write_kicad_line(FILE* f, line_t* line, footprint_options_t* opts) {
+    fprintf(f, "  (fp_line (start %.3f %.3f) (end %.3f %.3f) (layer \"%s\") (width %g) (tstamp %s))\n",
+            line->start.x, line->start.y, line->end.x, line->end.y,
+            line->layer, line->width, opts->timestamp);
+}
+
+static void write_kicad_pad(FILE* f, pad_t* pad, footprint_options_t* opts) {
+    if (pad->number == 0) {
+        // Via pad (no pin number)
+        fprintf(f, "  (pad \"\" thru_hole circle (at %.3f %.3f) (size %.3f %.3f) ",
+                pad->position.x, pad->position.y, pad->size.x, pad->size.y);
+        fprintf(f, "(drill %.1f) ",
+                pad->drill.diameter);
+        fprintf(f, "(layers %s) ", pad->layers);
+    } else if (pad->type == PAD_THROUGHHOLE) {
+        fprintf(f, "  (pad \"%d\" thru_hole rect (at %.3f %.3f) (locked) (size %.3f %.3f) ",
+                pad->number, pad->position.x, pad->position.y, pad->size.x, pad->size.y);
+        fprintf(f, "(drill %.1f (offset %.3f %.3f)) ",
+                pad->drill.diameter, pad->drill.offset.x, pad->drill.offset.y);
+        fprintf(f, "(layers %s) ", pad->layers);
+    } else {
+        fprintf(f, "  (pad \"%d\" smd rect (at %.3f %.3f) (locked) (size %.3f %.3f) ",
+                pad->number, pad->position.x, pad->position.y, pad->size.x, pad->size.y);
+        fprintf(f, "(layers %s) ", pad->layers);
+    }
+    fprintf(f, "(tstamp %s))\n", opts->timestamp);
+}
+
+static void write_kicad_model(FILE* f, const component_spec_t* spec, footprint_options_t* opts) {
+    fprintf(f, "(model \"${KIPRJMOD}/PLCCplug.3dshapes/PLCCplug-%dpin.%s\"\n", spec->pins,
+            opts->step_model ? "step" : "wrl");
+    fprintf(f, "    (offset (xyz %.1f %.2f 2.5))\n", spec->offset_x, spec->offset_y);
+    fprintf(f, "    (scale (xyz 1 1 1))\n");
+    fprintf(f, "    (rotate (xyz -0 -0 -90))\n");
+    fprintf(f, "  )\n");
+}
+
+// Version 20210228 format, as the library was first published
+void write_kicad_legacy_footprint(FILE* f, footprint_geometry_t* geom, const component_spec_t* spec, footprint_options_t* opts) {
+    write_kicad_header(f, spec);
+
+    // Text elements
+    write_kicad_text(f, "reference", "IC2", geom->text_positions[0], opts);
+    write_kicad_text(f, "value", spec->name, geom->text_positions[1], opts);
+    write_kicad_text(f, "user", "${REFERENCE}", geom->text_positions[2], opts);
+
+    // Silkscreen lines
+    for (int i = 0; i < geom->silkscreen.count; i++) {
+        write_kicad_line(f, &geom->silkscreen.lines[i], opts);
+    }
+
+    // Courtyard lines
+    for (int i = 0; i < geom->courtyard.count; i++) {
+        write_kicad_line(f, &geom->courtyard.lines[i], opts);
+    }
+
+    // Fabrication lines
+    for (int i = 0; i < geom->fab.count; i++) {
+        write_kicad_line(f, &geom->fab.lines[i], opts);
+    }
+
+    // Pads
+    for (int i = 0; i < geom->pad_count; i++) {
+        write_kicad_pad(f, &geom->pads[i], opts);
+    }
+
+    // 3D model
+    write_kicad_model(f, spec, opts);
+
+    fprintf(f, ")\n");
+}
+
+// Current format, laid out the way pcbnew saves it: property fields
+// instead of fp_text, stroke blocks, (uuid) instead of (tstamp) and no
+// tedit. The UUIDs are derived from the part, the variant and the element
+// index, so regenerating a footprint leaves the file unchanged and
+// pcbnew has nothing to upgrade on load.
+
+// Millimetres with at most three decimals and no trailing zeros
+const char* kicad_number(char* buf, size_t len, double v) {
+    snprintf(buf, len, "%.3f", v);
+    char* end = buf + strlen(buf);
+    while (end[-1] == '0') *--end = '\0';
+    if (end[-1] == '.') *--end = '\0';
+    if (strcmp(buf, "-0") == 0) strcpy(buf, "0");
+    return buf;
+}
+
+static uint64_t mix64(uint64_t x) {
+    // splitmix64 finaliser
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+static uint64_t kicad_id_seed(const component_spec_t* spec, const footprint_options_t* opts) {
+    char key[96];
+    int n = snprintf(key, sizeof(key), "%s|%d|%d|%d", spec->name, spec->pins, opts->double_sided, opts->via_outside);
+    return hash_bytes(key, n);
+}
+
+// Next element UUID, in the RFC 9562 version 8 (custom) layout
+const char* kicad_uuid(kicad_ids_t* ids, char* buf, size_t len) {
+    uint64_t hi = mix64(ids->seed + 2 * (uint64_t)ids->next + 1);
+    uint64_t lo = mix64(hi ^ ids->seed);
+    ids->next++;
+    hi = (hi & ~0xf000ULL) | 0x8000ULL;
+    lo = (lo & 0x3fffffffffffffffULL) | 0x8000000000000000ULL;
+    snprintf(buf, len, "%08x-%04x-%04x-%04x-%012llx", (unsigned)(hi >> 32), (unsigned)(hi >> 16) & 0xffff,
+             (unsigned)hi & 0xffff, (unsigned)(lo >> 48), (unsigned long long)(lo & 0xffffffffffffULL));
+    return buf;
+}
+
+// The writers below take the indentation of the enclosing footprint, ""
+// in a library file and "\t" on a board
+void write_kicad_effects(FILE* f, const char* in, double size) {
+    char s[32];
+    kicad_number(s, sizeof(s), size);
+    fprintf(f, "%s\t\t(effects\n%s\t\t\t(font\n%s\t\t\t\t(size %s %s)\n%s\t\t\t\t(thickness 0.15)\n%s\t\t\t)\n%s\t\t)\n",
+            in, in, in, s, s, in, in, in);
+}
+
+// Visible fields sit where the legacy fp_text did; the others are hidden
+static void write_kicad_property(FILE* f, kicad_ids_t* ids, const char* in, const char* name, const char* value,
+                                 const point_t* pos, const char* layer) {
+    char x[32], y[32], id[40];
+    fprintf(f, "%s\t(property \"%s\" \"%s\"\n", in, name, value);
+    if (pos) {
+        fprintf(f, "%s\t\t(at %s %s 180)\n", in, kicad_number(x, sizeof(x), pos->x), kicad_number(y, sizeof(y), pos->y));
+        fprintf(f, "%s\t\t(layer \"%s\")\n", in, layer);
+    } else {
+        fprintf(f, "%s\t\t(at 0 0 0)\n%s\t\t(unlocked yes)\n%s\t\t(layer \"%s\")\n%s\t\t(hide yes)\n", in, in, in, layer, in);
+    }
+    fprintf(f, "%s\t\t(uuid \"%s\")\n", in, kicad_uuid(ids, id, sizeof(id)));
+    write_kicad_effects(f, in, pos ? 1.0 : 1.27);
+    fprintf(f, "%s\t)\n", in);
+}
+
+static void write_kicad_current_line(FILE* f, kicad_ids_t* ids, const char* in, const line_t* line) {
+    char a[32], b[32], c[32], d[32], w[32], id[40];
+    fprintf(f, "%s\t(fp_line\n%s\t\t(start %s %s)\n%s\t\t(end %s %s)\n",
+            in, in, kicad_number(a, sizeof(a), line->start.x), kicad_number(b, sizeof(b), line->start.y),
+            in, kicad_number(c, sizeof(c), line->end.x), kicad_number(d, sizeof(d), line->end.y));
+    fprintf(f, "%s\t\t(stroke\n%s\t\t\t(width %s)\n%s\t\t\t(type solid)\n%s\t\t)\n",
+            in, in, kicad_number(w, sizeof(w), line->width), in, in);
+    fprintf(f, "%s\t\t(layer \"%s\")\n%s\t\t(uuid \"%s\")\n%s\t)\n", in, line->layer, in, kicad_uuid(ids, id, sizeof(id)), in);
+}
+
+// net 0 leaves the pad unconnected, as in the library footprints
+static void write_kicad_current_pad(FILE* f, kicad_ids_t* ids, const char* in, const pad_t* pad,
+                                    int net, const char* net_name) {
+    char x[32], y[32], w[32], h[32], d[32], id[40];
+    if (pad->number == 0) {
+        fprintf(f, "%s\t(pad \"\" thru_hole circle\n", in);
+    } else {
+        fprintf(f, "%s\t(pad \"%d\" %s rect\n", in, pad->number, pad->type == PAD_THROUGHHOLE ? "thru_hole" : "smd");
+    }
+    fprintf(f, "%s\t\t(at %s %s)\n", in, kicad_number(x, sizeof(x), pad->position.x), kicad_number(y, sizeof(y), pad->position.y));
+    if (pad->number) fprintf(f, "%s\t\t(locked yes)\n", in);
+    fprintf(f, "%s\t\t(size %s %s)\n", in, kicad_number(w, sizeof(w), pad->size.x), kicad_number(h, sizeof(h), pad->size.y));
+    if (pad->number == 0) {
+        fprintf(f, "%s\t\t(drill %s)\n", in, kicad_number(d, sizeof(d), pad->drill.diameter));
+    } else if (pad->type == PAD_THROUGHHOLE) {
+        fprintf(f, "%s\t\t(drill %s\n%s\t\t\t(offset %s %s)\n%s\t\t)\n", in, kicad_number(d, sizeof(d), pad->drill.diameter),
+                in, kicad_number(x, sizeof(x), pad->drill.offset.x), kicad_number(y, sizeof(y), pad->drill.offset.y), in);
+    }
+    fprintf(f, "%s\t\t(layers %s)\n", in, pad->layers);
+    if (net) fprintf(f, "%s\t\t(net %d \"%s\")\n", in, net, net_name);
+    fprintf(f, "%s\t\t(uuid \"%s\")\n%s\t)\n", in, kicad_uuid(ids, id, sizeof(id)), in);
+}
+
+// Everything inside the footprint after its position. pad_pins maps each
+// pad to the pin whose net it joins (0 for none); net n of pin p is called
+// "/REFERENCE-p" and numbered net_base + p - 1. NULL leaves all pads
+// unconnected.
+void write_kicad_current_items(FILE* f, kicad_ids_t* ids, const char* in, footprint_geometry_t* geom,
+                               const component_spec_t* spec, footprint_options_t* opts,
+                               const char* reference, const int* pad_pins, int net_base) {
+    char descr[64], id[40], x[32], y[32];
+    snprintf(descr, sizeof(descr), "PLCC plug, %d pins, surface mount", spec->pins);
+
+    fprintf(f, "%s\t(descr \"%s\")\n%s\t(tags \"plcc smt\")\n", in, descr, in);
+    write_kicad_property(f, ids, in, "Reference", reference, &geom->text_positions[0], "F.SilkS");
+    write_kicad_property(f, ids, in, "Value", spec->name, &geom->text_positions[1], "F.Fab");
+    write_kicad_property(f, ids, in, "Footprint", "", NULL, "F.Fab");
+    write_kicad_property(f, ids, in, "Datasheet", "", NULL, "F.Fab");
+    write_kicad_property(f, ids, in, "Description", descr, NULL, "F.Fab");
+    fprintf(f, "%s\t(autoplace_cost180 1)\n%s\t(attr smd)\n", in, in);
+
+    for (int i = 0; i < geom->silkscreen.count; i++) write_kicad_current_line(f, ids, in, &geom->silkscreen.lines[i]);
+    for (int i = 0; i < geom->courtyard.count; i++) write_kicad_current_line(f, ids, in, &geom->courtyard.lines[i]);
+    for (int i = 0; i < geom->fab.count; i++) write_kicad_current_line(f, ids, in, &geom->fab.lines[i]);
+
+    fprintf(f, "%s\t(fp_text user \"${REFERENCE}\"\n%s\t\t(at %s %s 180)\n%s\t\t(layer \"F.Fab\")\n%s\t\t(uuid \"%s\")\n",
+            in, in, kicad_number(x, sizeof(x), geom->text_positions[2].x),
+            kicad_number(y, sizeof(y), geom->text_positions[2].y), in, in, kicad_uuid(ids, id, sizeof(id)));
+    write_kicad_effects(f, in, 1.0);
+    fprintf(f, "%s\t)\n", in);
+
+    for (int i = 0; i < geom->pad_count; i++) {
+        int pin = pad_pins ? pad_pins[i] : 0;
+        char net_name[64] = "";
+        if (pin) {
+            snprintf(net_name, sizeof(net_name), "/%s-%d", reference, pin);
+        }
+        write_kicad_current_pad(f, ids, in, &geom->pads[i], pin ? net_base + pin - 1 : 0, net_name);
+    }
+
+    fprintf(f, "%s\t(model \"${KIPRJMOD}/PLCCplug.3dshapes/PLCCplug-%dpin.%s\"\n", in, spec->pins,
+            opts->step_model ? "step" : "wrl");
+    fprintf(f, "%s\t\t(offset\n%s\t\t\t(xyz %s %s 2.5)\n%s\t\t)\n", in, in, kicad_number(x, sizeof(x), spec->offset_x),
+            kicad_number(y, sizeof(y), spec->offset_y), in);
+    fprintf(f, "%s\t\t(scale\n%s\t\t\t(xyz 1 1 1)\n%s\t\t)\n%s\t\t(rotate\n%s\t\t\t(xyz -0 -0 -90)\n%s\t\t)\n%s\t)\n",
+            in, in, in, in, in, in, in);
+}
+
+void write_kicad_footprint(FILE* f, footprint_geometry_t* geom, const component_spec_t* spec, footprint_options_t* opts) {
+    kicad_ids_t ids = { kicad_id_seed(spec, opts), 0 };
+
+    fprintf(f, "(footprint \"%s\"\n", spec->name);
+    fprintf(f, "\t(version %d)\n\t(generator \"pcbnew\")\n\t(generator_version \"8.0\")\n", KICAD_FORMAT_VERSION);
+    fprintf(f, "\t(layer \"F.Cu\")\n");
+    write_kicad_current_items(f, &ids, "", geom, spec, opts, "IC2", NULL, 0);
+    fprintf(f, ")\n");
+}
@@ -0,0 +1,27 @@
+/* KiCad output formatter for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#ifndef PLCC_KICAD_H
+#define PLCC_KICAD_H
+
+#include "plcc-gen.h"
+
+#define KICAD_FORMAT_VERSION 20240108
+
+typedef struct {
+    uint64_t seed;
+    int next;
+} kicad_ids_t;
+
+void write_kicad_legacy_footprint(FILE* f, footprint_geometry_t* geom, const component_spec_t* spec, footprint_options_t* opts);
+const char* kicad_number(char* buf, size_t len, double v);
+const char* kicad_uuid(kicad_ids_t* ids, char* buf, size_t len);
+void write_kicad_effects(FILE* f, const char* in, double size);
+void write_kicad_current_items(FILE* f, kicad_ids_t* ids, const char* in, footprint_geometry_t* geom,
+                               const component_spec_t* spec, footprint_options_t* opts,
+                               const char* reference, const int* pad_pins, int net_base);
+void write_kicad_footprint(FILE* f, footprint_geometry_t* geom, const component_spec_t* spec, footprint_options_t* opts);
+
+#endif
@@ -0,0 +1,529 @@
+/* Mesh analysis for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#include "mesh-analysis.h"
+#include "mesh.h"
+
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+// Volume, surface area and bounding box of STL files for print quotes. The
+// file is mapped and streamed once: triangles are gathered in blocks whose
+// integrals are computed by a branch free loop the compiler vectorises, and
+// vertices are welded on the fly so a union-find can split the file into
+// its separate parts (one per plug on a plate) without keeping triangles.
+// Volumes come from the divergence theorem and are only meaningful for
+// closed shells.
+
+#define MAX_MATERIALS 32
+
+typedef struct {
+    char name[32];
+    double density;             // g/cm^3
+    double price_cm3;           // per cm^3 of part volume
+    double part_fee;            // handling per part
+    double batch_fee;           // setup per order
+} material_t;
+
+// Example prices in the shop's currency; --materials replaces the table
+static const material_t default_materials[] = {
+    {"PA12", 1.01, 0.28, 0.50, 8.00},     // SLS nylon
+    {"resin", 1.18, 0.22, 0.30, 5.00},    // standard SLA resin
+    {"PLA", 1.24, 0.05, 0.20, 0.00},      // FDM
+};
+
+// Squared doubled area and signed volume of every lane. The square root
+// is left to the caller, as the libm call would keep this loop scalar.
+// Unused lanes hold stale values; callers only read the first count.
+static void triangle_block_integrals(triangle_block_t* t) {
+    for (int i = 0; i < ANALYSE_BLOCK; i++) {
+        double ux = t->bx[i] - t->ax[i], uy = t->by[i] - t->ay[i], uz = t->bz[i] - t->az[i];
+        double vx = t->cx[i] - t->ax[i], vy = t->cy[i] - t->ay[i], vz = t->cz[i] - t->az[i];
+        double nx = uy * vz - uz * vy, ny = uz * vx - ux * vz, nz = ux * vy - uy * vx;
+        t->area[i] = nx * nx + ny * ny + nz * nz;
+        t->volume[i] = (t->ax[i] * (t->by[i] * t->cz[i] - t->bz[i] * t->cy[i]) +
+                        t->ay[i] * (t->bz[i] * t->cx[i] - t->bx[i] * t->cz[i]) +
+                        t->az[i] * (t->bx[i] * t->cy[i] - t->by[i] * t->cx[i])) / 6;
+    }
+}
+
+uint64_t weld_hash(double x, double y, double z) {
+    uint64_t h = 0, bits;
+    const double v[3] = { x + 0.0, y + 0.0, z + 0.0 };   // -0 welds with 0
+    for (int i = 0; i < 3; i++) {
+        memcpy(&bits, &v[i], sizeof(bits));
+        h = (h ^ bits) * 0x9e3779b97f4a7c15ULL;
+        h ^= h >> 29;
+    }
+    return h;
+}
+
+static int analysis_grow(mesh_analysis_t* a) {
+    if (a->vertex_count < a->vertex_capacity) return 0;
+    int cap = a->vertex_capacity ? a->vertex_capacity * 2 : 4096;
+    int* parent = realloc(a->parent, cap * sizeof(int));
+    if (parent) a->parent = parent;
+    mesh_stats_t* stats = realloc(a->stats, cap * sizeof(mesh_stats_t));
+    if (stats) a->stats = stats;
+    if (!parent || !stats) return -1;
+    a->vertex_capacity = cap;
+
+    // Keep the table at most half full
+    int slots = cap * 2;
+    weld_slot_t* table = malloc(slots * sizeof(weld_slot_t));
+    if (!table) return -1;
+    for (int i = 0; i < slots; i++) table[i].id = -1;
+    for (int i = 0; i < a->slot_count; i++) {
+        weld_slot_t* s = &a->slots[i];
+        if (s->id < 0) continue;
+        uint64_t j = weld_hash(s->x, s->y, s->z) & (slots - 1);
+        while (table[j].id >= 0) j = (j + 1) & (slots - 1);
+        table[j] = *s;
+    }
+    free(a->slots);
+    a->slots = table;
+    a->slot_count = slots;
+    return 0;
+}
+
+static int analysis_vertex(mesh_analysis_t* a, double x, double y, double z) {
+    if (a->slot_count) {
+        uint64_t j = weld_hash(x, y, z) & (a->slot_count - 1);
+        for (; a->slots[j].id >= 0; j = (j + 1) & (a->slot_count - 1)) {
+            weld_slot_t* s = &a->slots[j];
+            if (s->x == x && s->y == y && s->z == z) return s->id;
+        }
+    }
+    if (analysis_grow(a) < 0) return -1;
+    uint64_t j = weld_hash(x, y, z) & (a->slot_count - 1);
+    while (a->slots[j].id >= 0) j = (j + 1) & (a->slot_count - 1);
+
+    int id = a->vertex_count++;
+    a->slots[j] = (weld_slot_t){ x, y, z, id };
+    a->parent[id] = id;
+    a->stats[id] = (mesh_stats_t){ 0, 0, { INFINITY, INFINITY, INFINITY }, { -INFINITY, -INFINITY, -INFINITY }, 0 };
+    return id;
+}
+
+static int analysis_find(mesh_analysis_t* a, int v) {
+    while (a->parent[v] != v) {
+        a->parent[v] = a->parent[a->parent[v]];
+        v = a->parent[v];
+    }
+    return v;
+}
+
+static void stats_merge(mesh_stats_t* dst, const mesh_stats_t* src) {
+    dst->volume += src->volume;
+    dst->area += src->area;
+    dst->triangles += src->triangles;
+    for (int k = 0; k < 3; k++) {
+        if (src->min[k] < dst->min[k]) dst->min[k] = src->min[k];
+        if (src->max[k] > dst->max[k]) dst->max[k] = src->max[k];
+    }
+}
+
+static int analysis_union(mesh_analysis_t* a, int u, int v) {
+    u = analysis_find(a, u);
+    v = analysis_find(a, v);
+    if (u == v) return u;
+    if (a->stats[u].triangles < a->stats[v].triangles) {
+        int t = u;
+        u = v;
+        v = t;
+    }
+    a->parent[v] = u;
+    stats_merge(&a->stats[u], &a->stats[v]);
+    return u;
+}
+
+void analysis_flush(mesh_analysis_t* a) {
+    triangle_block_t* t = &a->block;
+    triangle_block_integrals(t);
+
+    for (int i = 0; i < t->count; i++) {
+        const double px[3] = { t->ax[i], t->bx[i], t->cx[i] };
+        const double py[3] = { t->ay[i], t->by[i], t->cy[i] };
+        const double pz[3] = { t->az[i], t->bz[i], t->cz[i] };
+        int root = -1;
+        for (int k = 0; k < 3; k++) {
+            int v = analysis_vertex(a, px[k], py[k], pz[k]);
+            if (v < 0) {
+                a->failed = 1;
+                return;
+            }
+            root = root < 0 ? analysis_find(a, v) : analysis_union(a, root, v);
+        }
+
+        mesh_stats_t* s = &a->stats[root];
+        s->volume += t->volume[i];
+        s->area += sqrt(t->area[i]) / 2;
+        s->triangles++;
+        for (int k = 0; k < 3; k++) {
+            const double p[3] = { px[k], py[k], pz[k] };
+            for (int d = 0; d < 3; d++) {
+                if (p[d] < s->min[d]) s->min[d] = p[d];
+                if (p[d] > s->max[d]) s->max[d] = p[d];
+            }
+        }
+    }
+    a->triangles += t->count;
+    t->count = 0;
+}
+
+void analysis_triangle(mesh_analysis_t* a, const double* v) {
+    if (a->mesh) {
+        if (mesh_reserve(a->mesh, 3, 1) < 0) {
+            a->failed = 1;
+        } else {
+            int first = a->mesh->vertex_count;
+            for (int k = 0; k < 3; k++) mesh_add_vertex(a->mesh, (vec3_t){ v[3 * k], v[3 * k + 1], v[3 * k + 2] });
+            mesh_add_triangle(a->mesh, first, first + 1, first + 2);
+        }
+    }
+    if (!a->have_origin) {
+        a->origin = (vec3_t){ v[0], v[1], v[2] };
+        a->have_origin = 1;
+    }
+    triangle_block_t* t = &a->block;
+    int i = t->count++;
+    t->ax[i] = v[0] - a->origin.x; t->ay[i] = v[1] - a->origin.y; t->az[i] = v[2] - a->origin.z;
+    t->bx[i] = v[3] - a->origin.x; t->by[i] = v[4] - a->origin.y; t->bz[i] = v[5] - a->origin.z;
+    t->cx[i] = v[6] - a->origin.x; t->cy[i] = v[7] - a->origin.y; t->cz[i] = v[8] - a->origin.z;
+    if (t->count == ANALYSE_BLOCK) analysis_flush(a);
+}
+
+// Plain decimal number as written by STL exporters; no locale, no strtod
+const char* parse_stl_number(const char* p, const char* end, double* out) {
+    static const double powers[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+    int negative = 0, exponent = 0, digits = 0;
+    uint64_t mantissa = 0;
+
+    if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+    for (; p < end && isdigit((unsigned char)*p); p++, digits++) {
+        if (mantissa < 1000000000000000000ULL) mantissa = mantissa * 10 + (*p - '0');
+        else exponent++;
+    }
+    if (p < end && *p == '.') {
+        for (p++; p < end && isdigit((unsigned char)*p); p++, digits++) {
+            if (mantissa < 1000000000000000000ULL) {
+                mantissa = mantissa * 10 + (*p - '0');
+                exponent--;
+            }
+        }
+    }
+    if (!digits) return NULL;
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        int sign = 1, e = 0;
+        p++;
+        if (p < end && (*p == '-' || *p == '+')) sign = *p++ == '-' ? -1 : 1;
+        for (; p < end && isdigit((unsigned char)*p); p++) {
+            if (e < 10000) e = e * 10 + (*p - '0');
+        }
+        exponent += sign * e;
+    }
+
+    double v = (double)mantissa;
+    if (exponent >= -22 && exponent <= 22) v = exponent < 0 ? v / powers[-exponent] : v * powers[exponent];
+    else v *= pow(10, exponent);
+    *out = negative ? -v : v;
+    return p;
+}
+
+static int analyse_ascii_stl(mesh_analysis_t* a, const char* p, const char* end) {
+    double v[9];
+    int n = 0;
+
+    while (p < end) {
+        while (p < end && isspace((unsigned char)*p)) p++;
+        if (end - p > 6 && memcmp(p, "vertex", 6) == 0 && isspace((unsigned char)p[6])) {
+            p += 6;
+            for (int k = 0; k < 3; k++) {
+                while (p < end && (*p == ' ' || *p == '\t')) p++;
+                if (!(p = parse_stl_number(p, end, &v[n * 3 + k]))) return -1;
+            }
+            if (++n == 3) {
+                analysis_triangle(a, v);
+                n = 0;
+            }
+        } else if (end - p >= 7 && memcmp(p, "endloop", 7) == 0 && n != 0) {
+            return -1;          // a facet with other than three vertices
+        }
+        const char* eol = memchr(p, '\n', end - p);
+        p = eol ? eol + 1 : end;
+    }
+    return n == 0 ? 0 : -1;
+}
+
+static void analyse_binary_stl(mesh_analysis_t* a, const unsigned char* data, uint32_t count) {
+    const unsigned char* record = data + 84;
+    for (uint32_t i = 0; i < count; i++, record += 50) {
+        float f[9];
+        double v[9];
+        memcpy(f, record + 12, sizeof(f));   // little endian, after the normal
+        for (int k = 0; k < 9; k++) v[k] = f[k];
+        analysis_triangle(a, v);
+    }
+}
+
+static int compare_parts(const void* x, const void* y) {
+    const mesh_stats_t* a = x;
+    const mesh_stats_t* b = y;
+    if (a->min[1] != b->min[1]) return a->min[1] < b->min[1] ? -1 : 1;
+    return (a->min[0] > b->min[0]) - (a->min[0] < b->min[0]);
+}
+
+// One entry per connected part, sorted by position, in input coordinates
+int analysis_parts(const mesh_analysis_t* a, mesh_stats_t** parts, int* part_count) {
+    int n = 0;
+    for (int v = 0; v < a->vertex_count; v++) {
+        if (a->parent[v] == v && a->stats[v].triangles) n++;
+    }
+    *parts = malloc((n ? n : 1) * sizeof(mesh_stats_t));
+    if (!*parts) return -1;
+    *part_count = 0;
+    for (int v = 0; v < a->vertex_count; v++) {
+        if (a->parent[v] != v || !a->stats[v].triangles) continue;
+        mesh_stats_t* s = &(*parts)[(*part_count)++];
+        *s = a->stats[v];
+        const double origin[3] = { a->origin.x, a->origin.y, a->origin.z };
+        for (int k = 0; k < 3; k++) {
+            s->min[k] += origin[k];
+            s->max[k] += origin[k];
+        }
+    }
+    qsort(*parts, *part_count, sizeof(mesh_stats_t), compare_parts);
+    return 0;
+}
+
+void analysis_free(mesh_analysis_t* a) {
+    if (!a) return;
+    free(a->slots);
+    free(a->parent);
+    free(a->stats);
+    free(a);
+}
+
+// Stream one STL file through the analysis
+static int read_stl(const char* path, mesh_analysis_t* a, const char** format) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        fprintf(stderr, "Error: %s: %s\n", path, strerror(errno));
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        fprintf(stderr, "Error: %s: not a regular file\n", path);
+        close(fd);
+        return -1;
+    }
+    size_t size = st.st_size;
+    const unsigned char* data = size ? mmap(NULL, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0) : NULL;
+    close(fd);
+    if (!data || data == MAP_FAILED) {
+        fprintf(stderr, "Error: %s: %s\n", path, size ? strerror(errno) : "empty file");
+        return -1;
+    }
+
+    int ret = -1;
+    TRACE_START(t_analyse);
+    uint32_t count = 0;
+    if (size >= 84) memcpy(&count, data + 80, sizeof(count));
+    // Some exporters start binary headers with "solid" too, so the size
+    // decides first
+    if (size >= 84 && size == 84 + 50 * (uint64_t)count) {
+        *format = "binary";
+        analyse_binary_stl(a, data, count);
+    } else if (size >= 5 && memcmp(data, "solid", 5) == 0) {
+        *format = "ascii";
+        if (analyse_ascii_stl(a, (const char*)data, (const char*)data + size) < 0) {
+            fprintf(stderr, "Error: %s: malformed ASCII STL\n", path);
+            goto out;
+        }
+    } else {
+        fprintf(stderr, "Error: %s: not an STL file\n", path);
+        goto out;
+    }
+    analysis_flush(a);
+    TRACE_STOP(t_analyse, STAGE_MESH, a->triangles);
+    if (a->failed) {
+        fprintf(stderr, "Error: out of memory\n");
+        goto out;
+    }
+    // A quote for nothing is more likely a broken export than an empty part
+    if (a->triangles == 0) {
+        fprintf(stderr, "Error: %s: no triangles\n", path);
+        goto out;
+    }
+    ret = 0;
+
+out:
+    munmap((void*)data, size);
+    return ret;
+}
+
+// Analyse one STL file. On success *parts holds one entry per connected
+// part, sorted by position, in file coordinates.
+int analyse_stl(const char* path, mesh_stats_t** parts, int* part_count, const char** format) {
+    mesh_analysis_t* a = calloc(1, sizeof(*a));
+    int ret = -1;
+    if (a && read_stl(path, a, format) == 0) ret = analysis_parts(a, parts, part_count);
+    analysis_free(a);
+    return ret;
+}
+
+// Triangles of an STL file as a mesh, one vertex per corner
+int load_stl(const char* path, mesh_t* mesh) {
+    mesh_analysis_t* a = calloc(1, sizeof(*a));
+    const char* format = "";
+    int ret = -1;
+    if (a) {
+        a->mesh = mesh;
+        ret = read_stl(path, a, &format);
+    }
+    analysis_free(a);
+    return ret;
+}
+
+// Parts of an in-memory mesh. With quantise, coordinates first go through
+// the six significant digits VRML files are written with.
+int analyse_mesh(const mesh_t* mesh, int quantise, mesh_stats_t** parts, int* part_count) {
+    mesh_analysis_t* a = calloc(1, sizeof(*a));
+    if (!a) return -1;
+    for (int i = 0; i < mesh->triangle_count; i++) {
+        double v[9];
+        for (int k = 0; k < 3; k++) {
+            vec3_t p = mesh->vertices[mesh->triangles[i][k]];
+            const double xyz[3] = { p.x, p.y, p.z };
+            for (int d = 0; d < 3; d++) {
+                char text[32];
+                if (quantise) snprintf(text, sizeof(text), "%g", xyz[d]);
+                v[3 * k + d] = quantise ? strtod(text, NULL) : xyz[d];
+            }
+        }
+        analysis_triangle(a, v);
+    }
+    analysis_flush(a);
+    int ret = a->failed ? -1 : analysis_parts(a, parts, part_count);
+    if (a->failed) fprintf(stderr, "Error: out of memory\n");
+    analysis_free(a);
+    return ret;
+}
+
+// Material table: "NAME DENSITY PRICE_PER_CM3 [PART_FEE [BATCH_FEE]]" per
+// line, # starts a comment
+static int load_materials(const char* path, material_t* materials, int max) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "Error: %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    char line[256];
+    int n = 0, lineno = 0;
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+        line[strcspn(line, "#\r\n")] = '\0';
+        if (line[strspn(line, " \t")] == '\0') continue;
+        material_t m = {0};
+        if (sscanf(line, "%31s %lf %lf %lf %lf", m.name, &m.density, &m.price_cm3, &m.part_fee, &m.batch_fee) < 3 ||
+            m.density <= 0 || m.price_cm3 < 0) {
+            fprintf(stderr, "Error: %s:%d: expected NAME DENSITY PRICE_PER_CM3 [PART_FEE [BATCH_FEE]]\n", path, lineno);
+            fclose(f);
+            return -1;
+        }
+        if (n == max) {
+            fprintf(stderr, "Error: %s: more than %d materials\n", path, max);
+            fclose(f);
+            return -1;
+        }
+        materials[n++] = m;
+    }
+    fclose(f);
+    return n;
+}
+
+static double part_cost(const material_t* m, const mesh_stats_t* s) {
+    return fabs(s->volume) / 1000 * m->price_cm3 + m->part_fee;
+}
+
+// One JSON line per file: per part volume, area, box, mass and unit cost,
+// then the cost of a batch of quantity copies of the whole file
+int run_quote(const char* first, char** files, int nfiles, const char* materials_path,
+              const char* material, int quantity) {
+    material_t materials[MAX_MATERIALS];
+    int material_count = 0;
+    int ret = 0;
+
+    if (materials_path) {
+        if ((material_count = load_materials(materials_path, materials, MAX_MATERIALS)) < 0) return 1;
+    } else {
+        material_count = sizeof(default_materials) / sizeof(default_materials[0]);
+        memcpy(materials, default_materials, sizeof(default_materials));
+    }
+    if (material) {
+        int found = 0;
+        for (int i = 0; i < material_count; i++) {
+            if (strcmp(materials[i].name, material) == 0) materials[found++] = materials[i];
+        }
+        if (!found) {
+            fprintf(stderr, "Error: unknown material '%s'\n", material);
+            return 1;
+        }
+        material_count = found;
+    }
+    if (quantity < 1) quantity = 1;
+
+    for (int f = -1; f < nfiles; f++) {
+        const char* path = f < 0 ? first : files[f];
+        mesh_stats_t* parts = NULL;
+        int count = 0;
+        const char* format = "";
+
+        double start = monotonic_us();
+        if (analyse_stl(path, &parts, &count, &format) < 0) {
+            ret = 1;
+            continue;
+        }
+        double elapsed = monotonic_us() - start;
+
+        mesh_stats_t total = { 0, 0, { INFINITY, INFINITY, INFINITY }, { -INFINITY, -INFINITY, -INFINITY }, 0 };
+        for (int i = 0; i < count; i++) stats_merge(&total, &parts[i]);
+
+        printf("{\"file\":\"%s\",\"format\":\"%s\",\"triangles\":%ld,\"time_ms\":%.3f,"
+               "\"volume_mm3\":%.3f,\"area_mm2\":%.3f,\"parts\":[",
+               path, format, total.triangles, elapsed / 1000, total.volume, total.area);
+        for (int i = 0; i < count; i++) {
+            const mesh_stats_t* s = &parts[i];
+            printf("%s{\"triangles\":%ld,\"volume_mm3\":%.3f,\"area_mm2\":%.3f,"
+                   "\"bbox_mm\":[%.3f,%.3f,%.3f,%.3f,%.3f,%.3f],\"mass_g\":{",
+                   i ? "," : "", s->triangles, s->volume, s->area,
+                   s->min[0], s->min[1], s->min[2], s->max[0], s->max[1], s->max[2]);
+            for (int m = 0; m < material_count; m++) {
+                printf("%s\"%s\":%.3f", m ? "," : "", materials[m].name,
+                       fabs(s->volume) / 1000 * materials[m].density);
+            }
+            printf("},\"cost\":{");
+            for (int m = 0; m < material_count; m++) {
+                printf("%s\"%s\":%.2f", m ? "," : "", materials[m].name, part_cost(&materials[m], s));
+            }
+            printf("}}");
+        }
+        printf("],\"batch\":{\"quantity\":%d,\"cost\":{", quantity);
+        for (int m = 0; m < material_count; m++) {
+            double unit = 0;
+            for (int i = 0; i < count; i++) unit += part_cost(&materials[m], &parts[i]);
+            printf("%s\"%s\":%.2f", m ? "," : "", materials[m].name, unit * quantity + materials[m].batch_fee);
+        }
+        printf("}}}\n");
+        free(parts);
+    }
+    return ret;
+}
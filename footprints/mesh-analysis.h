@@ -0,0 +1,61 @@
+/* Mesh analysis for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#ifndef PLCC_MESH_ANALYSIS_H
+#define PLCC_MESH_ANALYSIS_H
+
+#include "plcc-gen.h"
+#include "mesh.h"
+
+#define ANALYSE_BLOCK 256
+
+typedef struct {
+    double volume;              // signed, mm^3
+    double area;                // mm^2
+    double min[3], max[3];
+    long triangles;
+} mesh_stats_t;
+
+// Structure of arrays, so the integral loop runs over contiguous lanes
+typedef struct {
+    double ax[ANALYSE_BLOCK], ay[ANALYSE_BLOCK], az[ANALYSE_BLOCK];
+    double bx[ANALYSE_BLOCK], by[ANALYSE_BLOCK], bz[ANALYSE_BLOCK];
+    double cx[ANALYSE_BLOCK], cy[ANALYSE_BLOCK], cz[ANALYSE_BLOCK];
+    double volume[ANALYSE_BLOCK], area[ANALYSE_BLOCK];   // area squared and doubled
+    int count;
+} triangle_block_t;
+
+typedef struct {
+    double x, y, z;
+    int id;                     // -1 for an empty slot
+} weld_slot_t;
+
+typedef struct {
+    triangle_block_t block;
+    vec3_t origin;              // first vertex; keeps the tetrahedra small
+    int have_origin;
+    weld_slot_t* slots;         // open addressing, power of two
+    int slot_count;
+    int* parent;                // union-find over welded vertices
+    mesh_stats_t* stats;        // per set, valid at the roots
+    int vertex_count, vertex_capacity;
+    long triangles;
+    mesh_t* mesh;               // if set, also gets every triangle, unwelded
+    int failed;
+} mesh_analysis_t;
+
+uint64_t weld_hash(double x, double y, double z);
+void analysis_flush(mesh_analysis_t* a);
+void analysis_triangle(mesh_analysis_t* a, const double* v);
+const char* parse_stl_number(const char* p, const char* end, double* out);
+int analysis_parts(const mesh_analysis_t* a, mesh_stats_t** parts, int* part_count);
+void analysis_free(mesh_analysis_t* a);
+int analyse_stl(const char* path, mesh_stats_t** parts, int* part_count, const char** format);
+int load_stl(const char* path, mesh_t* mesh);
+int analyse_mesh(const mesh_t* mesh, int quantise, mesh_stats_t** parts, int* part_count);
+int run_quote(const char* first, char** files, int nfiles, const char* materials_path,
+              const char* material, int quantity);
+
+#endif
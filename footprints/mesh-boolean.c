@@ -0,0 +1,1800 @@
+/* Mesh booleans for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#include "mesh-boolean.h"
+#include "mesh-analysis.h"
+#include "mesh.h"
+
+// Union, intersection and difference of closed, outward facing triangle
+// meshes, for the scad evaluator (scad.c). Every triangle is cut along the
+// curves where it meets the other mesh and the pieces are kept or dropped
+// by whether they lie inside it.
+//
+// Candidate triangle pairs come from a bounding volume hierarchy. All
+// topological decisions (which side of a plane a vertex lies on, whether
+// an edge crosses a triangle, whether two faces are coplanar) are made
+// with exact predicates, so the touching and coplanar faces the plug
+// sources are full of are handled consistently. New vertices are rounded
+// to doubles, but every one is computed in a single canonical way from the
+// input elements it stands for, so all triangles sharing it get the same
+// point. The pieces of a cut triangle come from a constrained
+// triangulation in its plane.
+
+#define EXACT_MAX_TERMS 256       // orient3d needs at most 192
+#define BVH_LEAF_SIZE 4
+#define CSG_RAY_ATTEMPTS 16
+#define CSG_COPLANAR_SCAN 16       // partners tried in turn before using the BVH
+#define CSG_WELD_TOLERANCE 1e-12   // relative to the largest coordinate
+#define CDT_BOUNDARY 1            // edge of the triangle being cut
+#define CDT_CURVE 2               // intersection curve, separates regions
+
+// Error free transformations (Shewchuk); expansions are stored in order of
+// increasing magnitude, without zeros except for a lone one
+static inline void two_sum(double a, double b, double* x, double* y) {
+    double s = a + b, bv = s - a, av = s - bv;
+    *x = s;
+    *y = (a - av) + (b - bv);
+}
+
+static inline void two_product(double a, double b, double* x, double* y) {
+    *x = a * b;
+    *y = fma(a, b, -*x);
+}
+
+// h = e + b; h may be e
+static int grow_expansion(const double* e, int elen, double b, double* h) {
+    int hlen = 0;
+    double q = b, hh;
+    for (int i = 0; i < elen; i++) {
+        two_sum(q, e[i], &q, &hh);
+        if (hh != 0) h[hlen++] = hh;
+    }
+    if (q != 0 || hlen == 0) h[hlen++] = q;
+    return hlen;
+}
+
+// h = e + f; h may be e but not f
+static int expansion_sum(const double* e, int elen, const double* f, int flen, double* h) {
+    if (h != e) memcpy(h, e, elen * sizeof(double));
+    int hlen = elen;
+    for (int i = 0; i < flen; i++) {
+        hlen = grow_expansion(h, hlen, f[i], h);
+    }
+    return hlen;
+}
+
+// h = e * b
+static int scale_expansion(const double* e, int elen, double b, double* h) {
+    int hlen = 0;
+    double q, hh, p, t, sum;
+    two_product(e[0], b, &q, &hh);
+    if (hh != 0) h[hlen++] = hh;
+    for (int i = 1; i < elen; i++) {
+        two_product(e[i], b, &p, &t);
+        two_sum(q, t, &sum, &hh);
+        if (hh != 0) h[hlen++] = hh;
+        two_sum(p, sum, &q, &hh);
+        if (hh != 0) h[hlen++] = hh;
+    }
+    if (q != 0 || hlen == 0) h[hlen++] = q;
+    return hlen;
+}
+
+// h = e * f, with e of at most 16 terms
+static int expansion_product(const double* e, int elen, const double* f, int flen, double* h) {
+    double part[2 * 16];
+    int hlen = scale_expansion(e, elen, f[0], h);
+    for (int i = 1; i < flen; i++) {
+        int plen = scale_expansion(e, elen, f[i], part);
+        hlen = expansion_sum(h, hlen, part, plen, h);
+    }
+    return hlen;
+}
+
+static int exact_difference(double a, double b, double* h) {
+    double x, y;
+    two_sum(a, -b, &x, &y);
+    int n = 0;
+    if (y != 0) h[n++] = y;
+    h[n++] = x;
+    return n;
+}
+
+static void negate_expansion(double* e, int elen) {
+    for (int i = 0; i < elen; i++) e[i] = -e[i];
+}
+
+// h = u0 * v1 - u1 * v0 for two term differences
+static int exact_cross(const double* u0, int n0, const double* v1, int n1,
+                       const double* u1, int m1, const double* v0, int m0, double* h) {
+    double l[8], r[8];
+    int nl = expansion_product(u0, n0, v1, n1, l);
+    int nr = expansion_product(u1, m1, v0, m0, r);
+    negate_expansion(r, nr);
+    return expansion_sum(l, nl, r, nr, h);
+}
+
+static int sign_of(double v) {
+    return (v > 0) - (v < 0);
+}
+
+// Sign of the area of (a, b, c): positive if c is left of a -> b
+static int orient2d(double ax, double ay, double bx, double by, double cx, double cy) {
+    double l = (ax - cx) * (by - cy), r = (ay - cy) * (bx - cx);
+    double det = l - r;
+    if (l == 0 && r == 0) return 0;
+    double bound = 3.3306690738754716e-16 * (fabs(l) + fabs(r));
+    if (det > bound || -det > bound) return sign_of(det);
+
+    double acx[2], bcy[2], acy[2], bcx[2], d[16];
+    int nacx = exact_difference(ax, cx, acx), nbcy = exact_difference(by, cy, bcy);
+    int nacy = exact_difference(ay, cy, acy), nbcx = exact_difference(bx, cx, bcx);
+    int nd = exact_cross(acx, nacx, bcy, nbcy, acy, nacy, bcx, nbcx, d);
+    return sign_of(d[nd - 1]);
+}
+
+// Sign of (d - a) . ((b - a) x (c - a)): positive if d lies on the side
+// the normal of the counter-clockwise triangle (a, b, c) points to
+static int orient3d(vec3_t a, vec3_t b, vec3_t c, vec3_t d) {
+    double ux = b.x - a.x, uy = b.y - a.y, uz = b.z - a.z;
+    double vx = c.x - a.x, vy = c.y - a.y, vz = c.z - a.z;
+    double wx = d.x - a.x, wy = d.y - a.y, wz = d.z - a.z;
+    double p1 = uy * vz, p2 = uz * vy, p3 = uz * vx, p4 = ux * vz, p5 = ux * vy, p6 = uy * vx;
+    double det = wx * (p1 - p2) + wy * (p3 - p4) + wz * (p5 - p6);
+    double perm = fabs(wx) * (fabs(p1) + fabs(p2)) + fabs(wy) * (fabs(p3) + fabs(p4)) +
+                  fabs(wz) * (fabs(p5) + fabs(p6));
+    if (perm == 0) return 0;
+    double bound = 7.7715611723761027e-16 * perm;
+    if (det > bound || -det > bound) return sign_of(det);
+
+    double u[3][2], v[3][2], w[3][2];
+    int nu[3], nv[3], nw[3];
+    const double pa[3] = { a.x, a.y, a.z }, pb[3] = { b.x, b.y, b.z };
+    const double pc[3] = { c.x, c.y, c.z }, pd[3] = { d.x, d.y, d.z };
+    for (int k = 0; k < 3; k++) {
+        nu[k] = exact_difference(pb[k], pa[k], u[k]);
+        nv[k] = exact_difference(pc[k], pa[k], v[k]);
+        nw[k] = exact_difference(pd[k], pa[k], w[k]);
+    }
+    double minor[16], term[64], sum[EXACT_MAX_TERMS] = { 0 };
+    int nsum = 1;
+    for (int k = 0; k < 3; k++) {
+        int i = (k + 1) % 3, j = (k + 2) % 3;
+        int nm = exact_cross(u[i], nu[i], v[j], nv[j], u[j], nu[j], v[i], nv[i], minor);
+        int nt = expansion_product(minor, nm, w[k], nw[k], term);
+        nsum = expansion_sum(sum, nsum, term, nt, sum);
+    }
+    return sign_of(sum[nsum - 1]);
+}
+
+typedef struct {
+    const double* boxes;
+    int axis;
+} bvh_sort_t;
+
+static int compare_box_centres(const void* x, const void* y, void* arg) {
+    const bvh_sort_t* s = arg;
+    const double* a = &s->boxes[6 * *(const int*)x + s->axis];
+    const double* b = &s->boxes[6 * *(const int*)y + s->axis];
+    return (a[0] + a[3] > b[0] + b[3]) - (a[0] + a[3] < b[0] + b[3]);
+}
+
+int bvh_build(bvh_t* bvh, const double* boxes, const int* ids, int n) {
+    memset(bvh, 0, sizeof(*bvh));
+    bvh->items = malloc((n ? n : 1) * sizeof(int));
+    bvh->nodes = malloc((n ? 2 * n : 1) * sizeof(bvh_node_t));
+    int* stack = malloc((n ? 2 * n : 1) * sizeof(int));
+    if (!bvh->items || !bvh->nodes || !stack) {
+        free(stack);
+        return -1;
+    }
+    memcpy(bvh->items, ids, n * sizeof(int));
+    bvh->nodes[0] = (bvh_node_t){ { 0 }, { 0 }, -1, 0, n };
+    bvh->node_count = 1;
+
+    int top = 0;
+    stack[top++] = 0;
+    while (top) {
+        bvh_node_t* node = &bvh->nodes[stack[--top]];
+        double clo[3] = { INFINITY, INFINITY, INFINITY }, chi[3] = { -INFINITY, -INFINITY, -INFINITY };
+        for (int k = 0; k < 3; k++) {
+            node->lo[k] = INFINITY;
+            node->hi[k] = -INFINITY;
+        }
+        for (int i = node->first; i < node->first + node->count; i++) {
+            const double* b = &boxes[6 * bvh->items[i]];
+            for (int k = 0; k < 3; k++) {
+                double c = b[k] + b[k + 3];
+                if (b[k] < node->lo[k]) node->lo[k] = b[k];
+                if (b[k + 3] > node->hi[k]) node->hi[k] = b[k + 3];
+                if (c < clo[k]) clo[k] = c;
+                if (c > chi[k]) chi[k] = c;
+            }
+        }
+        if (node->count <= BVH_LEAF_SIZE) continue;
+
+        int axis = 0;
+        for (int k = 1; k < 3; k++) {
+            if (chi[k] - clo[k] > chi[axis] - clo[axis]) axis = k;
+        }
+        bvh_sort_t sort = { boxes, axis };
+        qsort_r(bvh->items + node->first, node->count, sizeof(int), compare_box_centres, &sort);
+
+        int left = bvh->node_count;
+        int half = node->count / 2;
+        bvh->nodes[left] = (bvh_node_t){ { 0 }, { 0 }, -1, node->first, half };
+        bvh->nodes[left + 1] = (bvh_node_t){ { 0 }, { 0 }, -1, node->first + half, node->count - half };
+        node->left = left;
+        bvh->node_count += 2;
+        stack[top++] = left;
+        stack[top++] = left + 1;
+    }
+    free(stack);
+    return 0;
+}
+
+void bvh_free(bvh_t* bvh) {
+    free(bvh->nodes);
+    free(bvh->items);
+    memset(bvh, 0, sizeof(*bvh));
+}
+
+// Items whose boxes touch box (closed intervals), appended to *out
+static int bvh_query_box(const bvh_t* bvh, const double* box, int** out, int* count, int* capacity) {
+    int stack[64], top = 0;
+    if (!bvh->node_count || !bvh->nodes[0].count) return 0;
+    stack[top++] = 0;
+    while (top) {
+        const bvh_node_t* node = &bvh->nodes[stack[--top]];
+        if (node->lo[0] > box[3] || node->hi[0] < box[0] || node->lo[1] > box[4] ||
+            node->hi[1] < box[1] || node->lo[2] > box[5] || node->hi[2] < box[2]) continue;
+        if (node->left >= 0) {
+            stack[top++] = node->left;
+            stack[top++] = node->left + 1;
+            continue;
+        }
+        if (grow_array((void**)out, capacity, *count + node->count, sizeof(int)) < 0) return -1;
+        for (int i = 0; i < node->count; i++) {
+            (*out)[(*count)++] = bvh->items[node->first + i];
+        }
+    }
+    return 0;
+}
+
+// Items whose boxes the segment p -> q may pass through (slab test)
+int bvh_query_segment(const bvh_t* bvh, vec3_t p, vec3_t q, int** out, int* count, int* capacity) {
+    const double o[3] = { p.x, p.y, p.z }, d[3] = { q.x - p.x, q.y - p.y, q.z - p.z };
+    int stack[64], top = 0;
+    if (!bvh->node_count || !bvh->nodes[0].count) return 0;
+    stack[top++] = 0;
+    while (top) {
+        const bvh_node_t* node = &bvh->nodes[stack[--top]];
+        double t0 = 0, t1 = 1;
+        for (int k = 0; k < 3 && t0 <= t1; k++) {
+            double lo = node->lo[k] - 1e-9, hi = node->hi[k] + 1e-9;
+            if (d[k] == 0) {
+                if (o[k] < lo || o[k] > hi) t0 = 2;
+                continue;
+            }
+            double a = (lo - o[k]) / d[k], b = (hi - o[k]) / d[k];
+            if (a > b) {
+                double t = a;
+                a = b;
+                b = t;
+            }
+            if (a > t0) t0 = a;
+            if (b < t1) t1 = b;
+        }
+        if (t0 > t1) continue;
+        if (node->left >= 0) {
+            stack[top++] = node->left;
+            stack[top++] = node->left + 1;
+            continue;
+        }
+        if (grow_array((void**)out, capacity, *count + node->count, sizeof(int)) < 0) return -1;
+        for (int i = 0; i < node->count; i++) {
+            (*out)[(*count)++] = bvh->items[node->first + i];
+        }
+    }
+    return 0;
+}
+
+// Constructed points are identified by the input elements they stand for
+enum {
+    KEY_EDGE_FACE,              // edge (a, b) through the plane of triangle c
+    KEY_EDGE_EDGE,              // edge (a, b) crossing edge (c, d)
+    KEY_SPLIT,                  // segment (a, b) crossing segment (c, d)
+};
+
+typedef struct {
+    int kind, a, b, c, d;
+} csg_key_t;
+
+typedef struct {
+    csg_key_t key;
+    int point;                  // -1 for an empty slot
+} csg_key_slot_t;
+
+typedef struct {
+    int tri, a, b;              // a == b for a lone point
+} csg_segment_t;
+
+typedef struct {
+    int tri, other;
+} csg_coplanar_t;
+
+// A piece of a cut triangle, wound like the triangle
+typedef struct {
+    int v[3];
+    int tri;
+    unsigned char barrier;      // bit k: edge v[k] -> v[k + 1] lies on a curve
+    signed char cls;            // CSG_IN, CSG_OUT, CSG_SAME, CSG_OPPOSITE
+} csg_fragment_t;
+
+enum { CSG_OUT, CSG_IN, CSG_SAME, CSG_OPPOSITE };
+
+typedef struct {
+    mesh_t mesh;                // welded points of both meshes and their triangles
+    int input_points;           // points below this are input vertices
+    int split;                  // triangles of the second mesh start here
+    csg_key_t* keys;            // per constructed point
+    int key_capacity;
+    csg_key_slot_t* slots;      // key -> point, open addressing
+    int slot_count, slot_used;
+    double (*box)[6];
+    vec3_t* normal;
+    unsigned char (*axes)[2];   // projection in which the triangle is counter-clockwise
+    csg_segment_t* segments;
+    int segment_count, segment_capacity;
+    csg_coplanar_t* coplanar;
+    int coplanar_count, coplanar_capacity;
+    csg_fragment_t* fragments;
+    int fragment_count, fragment_capacity;
+    int (*aliases)[2];          // points that fell onto each other in a projection
+    int alias_count, alias_capacity;
+    bvh_t bvh[2];
+    double bounds[2][6];
+    uint64_t seed;              // ray directions
+    int failed;
+} csg_t;
+
+static inline uint64_t hash_mix(uint64_t h) {
+    h *= 0x9e3779b97f4a7c15ULL;
+    return h ^ (h >> 29);
+}
+
+static inline double vec3_get(vec3_t v, int k) {
+    return k == 0 ? v.x : k == 1 ? v.y : v.z;
+}
+
+static inline vec3_t csg_point(const csg_t* c, int p) {
+    return c->mesh.vertices[p];
+}
+
+static uint64_t csg_key_hash(const csg_key_t* k) {
+    uint64_t h = hash_mix((uint64_t)k->kind << 32 | (uint32_t)k->a);
+    h = hash_mix(h ^ ((uint64_t)(uint32_t)k->b << 32 | (uint32_t)k->c));
+    return hash_mix(h ^ (uint32_t)k->d);
+}
+
+static int csg_find_key(const csg_t* c, const csg_key_t* key) {
+    if (!c->slot_count) return -1;
+    uint64_t j = csg_key_hash(key) & (c->slot_count - 1);
+    for (; c->slots[j].point >= 0; j = (j + 1) & (c->slot_count - 1)) {
+        if (memcmp(&c->slots[j].key, key, sizeof(*key)) == 0) return c->slots[j].point;
+    }
+    return -1;
+}
+
+static int csg_add_point(csg_t* c, const csg_key_t* key, vec3_t p) {
+    if (2 * (c->slot_used + 1) > c->slot_count) {
+        int count = c->slot_count ? 2 * c->slot_count : 1024;
+        csg_key_slot_t* slots = malloc(count * sizeof(csg_key_slot_t));
+        if (!slots) return -1;
+        for (int i = 0; i < count; i++) slots[i].point = -1;
+        for (int i = 0; i < c->slot_count; i++) {
+            if (c->slots[i].point < 0) continue;
+            uint64_t j = csg_key_hash(&c->slots[i].key) & (count - 1);
+            while (slots[j].point >= 0) j = (j + 1) & (count - 1);
+            slots[j] = c->slots[i];
+        }
+        free(c->slots);
+        c->slots = slots;
+        c->slot_count = count;
+    }
+    int index = c->mesh.vertex_count - c->input_points;
+    if (mesh_reserve(&c->mesh, 1, 0) < 0 ||
+        grow_array((void**)&c->keys, &c->key_capacity, index + 1, sizeof(csg_key_t)) < 0) return -1;
+    int id = mesh_add_vertex(&c->mesh, p);
+    c->keys[index] = *key;
+
+    uint64_t j = csg_key_hash(key) & (c->slot_count - 1);
+    while (c->slots[j].point >= 0) j = (j + 1) & (c->slot_count - 1);
+    c->slots[j] = (csg_key_slot_t){ *key, id };
+    c->slot_used++;
+    return id;
+}
+
+// A point on an element whose vertices agree in a coordinate gets that
+// coordinate exactly, so crossings on axis aligned faces stay on them
+static vec3_t csg_snap(const csg_t* c, vec3_t x, int a, int b, int d) {
+    vec3_t p = csg_point(c, a), q = csg_point(c, b), r = csg_point(c, d);
+    if (p.x == q.x && p.x == r.x) x.x = p.x;
+    if (p.y == q.y && p.y == r.y) x.y = p.y;
+    if (p.z == q.z && p.z == r.z) x.z = p.z;
+    return x;
+}
+
+// Where edge (a, b) crosses the plane of triangle t
+static vec3_t csg_edge_face_point(const csg_t* c, int a, int b, int t) {
+    const int* v = c->mesh.triangles[t];
+    vec3_t p = csg_point(c, a), q = csg_point(c, b), o = csg_point(c, v[0]);
+    vec3_t n = vec3_cross(vec3_sub(csg_point(c, v[1]), o), vec3_sub(csg_point(c, v[2]), o));
+    double dp = vec3_dot(vec3_sub(p, o), n), dq = vec3_dot(vec3_sub(q, o), n);
+    double s = dp / (dp - dq);
+    if (!(s > 0)) s = 0;
+    if (s > 1) s = 1;
+    vec3_t x = { p.x + s * (q.x - p.x), p.y + s * (q.y - p.y), p.z + s * (q.z - p.z) };
+    return csg_snap(c, x, v[0], v[1], v[2]);
+}
+
+// Closest point on segment (a, b) to the line through (d, e)
+static vec3_t csg_edge_edge_point(const csg_t* c, int a, int b, int d, int e) {
+    vec3_t p = csg_point(c, a), q = csg_point(c, b), r = csg_point(c, d);
+    vec3_t u = vec3_sub(q, p), v = vec3_sub(csg_point(c, e), r), w = vec3_sub(r, p);
+    vec3_t n = vec3_cross(u, v);
+    double nn = vec3_dot(n, n);
+    double s = nn > 0 ? vec3_dot(vec3_cross(w, v), n) / nn : 0;
+    if (!(s > 0)) s = 0;
+    if (s > 1) s = 1;
+    return csg_snap(c, (vec3_t){ p.x + s * u.x, p.y + s * u.y, p.z + s * u.z }, d, e, e);
+}
+
+static int csg_edge_face(csg_t* c, int a, int b, int t) {
+    if (a > b) {
+        int tmp = a;
+        a = b;
+        b = tmp;
+    }
+    csg_key_t key = { KEY_EDGE_FACE, a, b, t, 0 };
+    int id = csg_find_key(c, &key);
+    if (id < 0 && (id = csg_add_point(c, &key, csg_edge_face_point(c, a, b, t))) < 0) c->failed = 1;
+    return id;
+}
+
+// Crossing of (a, b) and (d, e), computed the same way whichever
+// triangle asks
+static int csg_edge_edge(csg_t* c, int kind, int a, int b, int d, int e) {
+    if (a > b) {
+        int tmp = a;
+        a = b;
+        b = tmp;
+    }
+    if (d > e) {
+        int tmp = d;
+        d = e;
+        e = tmp;
+    }
+    if (d < a || (d == a && e < b)) {
+        int ta = a, tb = b;
+        a = d;
+        b = e;
+        d = ta;
+        e = tb;
+    }
+    csg_key_t key = { kind, a, b, d, e };
+    int id = csg_find_key(c, &key);
+    if (id < 0 && (id = csg_add_point(c, &key, csg_edge_edge_point(c, a, b, d, e))) < 0) c->failed = 1;
+    return id;
+}
+
+static int csg_orient2d(const csg_t* c, int proj, int a, int b, int p) {
+    int i = c->axes[proj][0], j = c->axes[proj][1];
+    vec3_t pa = csg_point(c, a), pb = csg_point(c, b), pp = csg_point(c, p);
+    return orient2d(vec3_get(pa, i), vec3_get(pa, j), vec3_get(pb, i), vec3_get(pb, j),
+                    vec3_get(pp, i), vec3_get(pp, j));
+}
+
+static int csg_orient3d(const csg_t* c, int a, int b, int d, int e) {
+    return orient3d(csg_point(c, a), csg_point(c, b), csg_point(c, d), csg_point(c, e));
+}
+
+// Is p, in the plane of triangle t, inside it? Decided in the projection
+// of triangle proj; strict excludes the boundary.
+static int csg_in_triangle(const csg_t* c, int t, int p, int proj, int strict) {
+    const int* v = c->mesh.triangles[t];
+    int s = csg_orient2d(c, proj, v[0], v[1], v[2]);
+    for (int k = 0; k < 3; k++) {
+        int o = s * csg_orient2d(c, proj, v[k], v[(k + 1) % 3], p);
+        if (o < 0 || (strict && o == 0)) return 0;
+    }
+    return 1;
+}
+
+// Do the coplanar segments (p, q) and (d, e) cross in a single point
+// inside both?
+static int csg_proper_crossing(const csg_t* c, int proj, int p, int q, int d, int e) {
+    if (csg_orient2d(c, proj, p, q, d) * csg_orient2d(c, proj, p, q, e) >= 0) return 0;
+    return csg_orient2d(c, proj, d, e, p) * csg_orient2d(c, proj, d, e, q) < 0;
+}
+
+// Is p, on the line through a and b, strictly between them?
+static int csg_between(const csg_t* c, int proj, int a, int b, int p) {
+    vec3_t pa = csg_point(c, a), pb = csg_point(c, b), pp = csg_point(c, p);
+    int k = c->axes[proj][0];
+    if (vec3_get(pa, k) == vec3_get(pb, k)) k = c->axes[proj][1];
+    double lo = vec3_get(pa, k), hi = vec3_get(pb, k), x = vec3_get(pp, k);
+    return lo < hi ? lo < x && x < hi : hi < x && x < lo;
+}
+
+static void csg_add_segment(csg_t* c, int tri, int a, int b) {
+    if (grow_array((void**)&c->segments, &c->segment_capacity, c->segment_count + 1, sizeof(csg_segment_t)) < 0) {
+        c->failed = 1;
+        return;
+    }
+    c->segments[c->segment_count++] = (csg_segment_t){ tri, a, b };
+}
+
+static int csg_add_unique(int* points, int n, int p) {
+    if (p < 0) return n;
+    for (int i = 0; i < n; i++) {
+        if (points[i] == p) return n;
+    }
+    points[n] = p;
+    return n + 1;
+}
+
+// Sort points by their position along direction d and add the pieces
+// between them to both triangles
+static void csg_add_chain(csg_t* c, int* points, int n, vec3_t d, int t, int u) {
+    double key[24];
+    for (int i = 0; i < n; i++) key[i] = vec3_dot(csg_point(c, points[i]), d);
+    for (int i = 1; i < n; i++) {
+        for (int j = i; j > 0 && key[j] < key[j - 1]; j--) {
+            double k = key[j];
+            key[j] = key[j - 1];
+            key[j - 1] = k;
+            int p = points[j];
+            points[j] = points[j - 1];
+            points[j - 1] = p;
+        }
+    }
+    for (int i = 0; i < (n > 1 ? n - 1 : 1); i++) {
+        int b = points[n > 1 ? i + 1 : i];
+        csg_add_segment(c, t, points[i], b);
+        if (u >= 0) csg_add_segment(c, u, points[i], b);
+    }
+}
+
+// Points where edge (p, q), whose ends lie on sides sp and sq of the plane
+// of triangle u, meets u. Ends on the plane are handled as vertices.
+static int csg_edge_triangle(csg_t* c, int p, int q, int sp, int sq, int u, int* points, int n) {
+    const int* v = c->mesh.triangles[u];
+    if (sp == 0 && sq == 0) {
+        for (int k = 0; k < 3; k++) {
+            int d = v[k], e = v[(k + 1) % 3];
+            if (d == p || d == q || e == p || e == q) continue;
+            if (csg_proper_crossing(c, u, p, q, d, e)) {
+                n = csg_add_unique(points, n, csg_edge_edge(c, KEY_EDGE_EDGE, p, q, d, e));
+            }
+        }
+        return n;
+    }
+    if (sp == 0 || sq == 0 || sp == sq) return n;
+
+    int o[3], zeros = 0, positive = 0, negative = 0;
+    for (int k = 0; k < 3; k++) {
+        o[k] = csg_orient3d(c, p, q, v[k], v[(k + 1) % 3]);
+        zeros += o[k] == 0;
+        positive += o[k] > 0;
+        negative += o[k] < 0;
+    }
+    if (positive && negative) return n;
+    if (zeros == 0) return csg_add_unique(points, n, csg_edge_face(c, p, q, u));
+    for (int k = 0; k < 3; k++) {
+        if (o[k] != 0) continue;
+        if (zeros == 1) return csg_add_unique(points, n, csg_edge_edge(c, KEY_EDGE_EDGE, p, q, v[k], v[(k + 1) % 3]));
+        if (o[(k + 2) % 3] == 0) return csg_add_unique(points, n, v[k]);
+    }
+    return n;
+}
+
+// The edges of coplanar triangle from, clipped to triangle into, become
+// curves of into
+static void csg_clip_edges(csg_t* c, int from, int into) {
+    const int* f = c->mesh.triangles[from];
+    const int* v = c->mesh.triangles[into];
+    for (int k = 0; k < 3; k++) {
+        int p = f[k], q = f[(k + 1) % 3], points[8], n = 0;
+        if (csg_in_triangle(c, into, p, into, 0)) n = csg_add_unique(points, n, p);
+        if (csg_in_triangle(c, into, q, into, 0)) n = csg_add_unique(points, n, q);
+        for (int i = 0; i < 3; i++) {
+            int d = v[i], e = v[(i + 1) % 3];
+            if (d != p && d != q && csg_orient2d(c, into, p, q, d) == 0 && csg_between(c, into, p, q, d)) {
+                n = csg_add_unique(points, n, d);
+            }
+            if (d != p && d != q && e != p && e != q && csg_proper_crossing(c, into, p, q, d, e)) {
+                n = csg_add_unique(points, n, csg_edge_edge(c, KEY_EDGE_EDGE, p, q, d, e));
+            }
+        }
+        if (n) csg_add_chain(c, points, n, vec3_sub(csg_point(c, q), csg_point(c, p)), into, -1);
+    }
+}
+
+static void csg_intersect_pair(csg_t* c, int t, int u) {
+    int tv[3], uv[3], st[3], su[3];
+    memcpy(tv, c->mesh.triangles[t], sizeof(tv));
+    memcpy(uv, c->mesh.triangles[u], sizeof(uv));
+    int tpos = 0, tneg = 0, upos = 0, uneg = 0;
+    for (int k = 0; k < 3; k++) {
+        st[k] = csg_orient3d(c, uv[0], uv[1], uv[2], tv[k]);
+        su[k] = csg_orient3d(c, tv[0], tv[1], tv[2], uv[k]);
+        tpos += st[k] > 0;
+        tneg += st[k] < 0;
+        upos += su[k] > 0;
+        uneg += su[k] < 0;
+    }
+    if (tpos == 3 || tneg == 3 || upos == 3 || uneg == 3) return;
+
+    if (!upos && !uneg) {
+        if (grow_array((void**)&c->coplanar, &c->coplanar_capacity, c->coplanar_count + 2, sizeof(csg_coplanar_t)) < 0) {
+            c->failed = 1;
+            return;
+        }
+        c->coplanar[c->coplanar_count++] = (csg_coplanar_t){ t, u };
+        c->coplanar[c->coplanar_count++] = (csg_coplanar_t){ u, t };
+        csg_clip_edges(c, u, t);
+        csg_clip_edges(c, t, u);
+        return;
+    }
+
+    int points[24], n = 0;
+    for (int k = 0; k < 3; k++) {
+        if (!st[k] && csg_in_triangle(c, u, tv[k], u, 0)) n = csg_add_unique(points, n, tv[k]);
+        if (!su[k] && csg_in_triangle(c, t, uv[k], t, 0)) n = csg_add_unique(points, n, uv[k]);
+    }
+    for (int k = 0; k < 3; k++) {
+        n = csg_edge_triangle(c, tv[k], tv[(k + 1) % 3], st[k], st[(k + 1) % 3], u, points, n);
+        n = csg_edge_triangle(c, uv[k], uv[(k + 1) % 3], su[k], su[(k + 1) % 3], t, points, n);
+    }
+    if (n) csg_add_chain(c, points, n, vec3_cross(c->normal[t], c->normal[u]), t, u);
+}
+
+// Constrained triangulation of one cut triangle in its projection. Points
+// are inserted into a large enclosing triangle with Delaunay flips (for
+// shape only; nothing depends on them), then the triangle's subdivided
+// edges and the curves are forced in as constraints, and everything
+// outside the edges is dropped.
+typedef struct {
+    int v[3];                   // counter-clockwise
+    int n[3];                   // neighbour across v[k] -> v[k + 1], -1 outside
+    unsigned char mark[3];      // CDT_BOUNDARY, CDT_CURVE
+    unsigned char outside;
+} cdt_triangle_t;
+
+typedef struct {
+    double (*xy)[2];
+    int* id;                    // csg point, -1 for the enclosing corners
+    int* incident;              // a triangle touching each vertex
+    int vertex_count, vertex_capacity;
+    cdt_triangle_t* tris;
+    int tri_count, tri_capacity;
+    int last;                   // where the previous search ended
+    uint32_t seed;
+    int* vertex_of;             // csg point -> vertex, -1 if not inserted
+    int vertex_of_capacity;
+    int* scratch;
+    int scratch_capacity;
+    csg_t* owner;
+    int axes[2];                // projection of the triangle being cut
+} cdt_t;
+
+static int cdt_orient(const cdt_t* d, int a, int b, int c) {
+    return orient2d(d->xy[a][0], d->xy[a][1], d->xy[b][0], d->xy[b][1], d->xy[c][0], d->xy[c][1]);
+}
+
+static int cdt_add_vertex(cdt_t* d, double x, double y, int id) {
+    if (d->vertex_count == d->vertex_capacity) {
+        int cap = d->vertex_capacity ? 2 * d->vertex_capacity : 64;
+        double (*xy)[2] = realloc(d->xy, cap * sizeof(*xy));
+        if (xy) d->xy = xy;
+        int* ids = realloc(d->id, cap * sizeof(int));
+        if (ids) d->id = ids;
+        int* incident = realloc(d->incident, cap * sizeof(int));
+        if (incident) d->incident = incident;
+        if (!xy || !ids || !incident) return -1;
+        d->vertex_capacity = cap;
+    }
+    int v = d->vertex_count++;
+    d->xy[v][0] = x;
+    d->xy[v][1] = y;
+    d->id[v] = id;
+    d->incident[v] = -1;
+    return v;
+}
+
+static int cdt_new_triangle(cdt_t* d) {
+    if (grow_array((void**)&d->tris, &d->tri_capacity, d->tri_count + 1, sizeof(cdt_triangle_t)) < 0) return -1;
+    memset(&d->tris[d->tri_count], 0, sizeof(cdt_triangle_t));
+    return d->tri_count++;
+}
+
+static void cdt_set(cdt_t* d, int t, int a, int b, int c, int na, int nb, int nc, int ma, int mb, int mc) {
+    cdt_triangle_t* T = &d->tris[t];
+    T->v[0] = a;
+    T->v[1] = b;
+    T->v[2] = c;
+    T->n[0] = na;
+    T->n[1] = nb;
+    T->n[2] = nc;
+    T->mark[0] = ma;
+    T->mark[1] = mb;
+    T->mark[2] = mc;
+    d->incident[a] = d->incident[b] = d->incident[c] = t;
+}
+
+static int cdt_index(const cdt_triangle_t* T, int v) {
+    return T->v[0] == v ? 0 : T->v[1] == v ? 1 : 2;
+}
+
+// Point the neighbour across edge (a, b) of triangle t to tri
+static void cdt_relink(cdt_t* d, int t, int a, int b, int tri) {
+    if (t < 0) return;
+    cdt_triangle_t* T = &d->tris[t];
+    int k = cdt_index(T, a);
+    if (T->v[(k + 1) % 3] == b) T->n[k] = tri;
+}
+
+static int cdt_push(cdt_t* d, int* top, int value) {
+    if (grow_array((void**)&d->scratch, &d->scratch_capacity, *top + 1, sizeof(int)) < 0) return -1;
+    d->scratch[(*top)++] = value;
+    return 0;
+}
+
+// Is d inside the circle through the counter-clockwise a, b, c? Rounding
+// only costs shape here, so clear cases are enough.
+static int cdt_incircle(const cdt_t* d, int a, int b, int c, int p) {
+    double adx = d->xy[a][0] - d->xy[p][0], ady = d->xy[a][1] - d->xy[p][1];
+    double bdx = d->xy[b][0] - d->xy[p][0], bdy = d->xy[b][1] - d->xy[p][1];
+    double cdx = d->xy[c][0] - d->xy[p][0], cdy = d->xy[c][1] - d->xy[p][1];
+    double al = adx * adx + ady * ady, bl = bdx * bdx + bdy * bdy, cl = cdx * cdx + cdy * cdy;
+    double det = al * (bdx * cdy - cdx * bdy) + bl * (cdx * ady - adx * cdy) + cl * (adx * bdy - bdx * ady);
+    double perm = al * (fabs(bdx * cdy) + fabs(cdx * bdy)) + bl * (fabs(cdx * ady) + fabs(adx * cdy)) +
+                  cl * (fabs(adx * bdy) + fabs(bdx * ady));
+    return det > 1e-12 * perm;
+}
+
+// Restore the Delaunay property around edge k of t after an insertion
+static void cdt_legalize(cdt_t* d, int t, int k) {
+    int top = 0, flips = 0;
+    if (cdt_push(d, &top, 3 * t + k) < 0) return;
+    while (top && flips < 64 + 4 * d->tri_count) {
+        int e = d->scratch[--top];
+        t = e / 3;
+        k = e % 3;
+        cdt_triangle_t* T = &d->tris[t];
+        int u = T->n[k];
+        if (u < 0 || T->mark[k]) continue;
+        int a = T->v[k], b = T->v[(k + 1) % 3], p = T->v[(k + 2) % 3];
+        cdt_triangle_t* U = &d->tris[u];
+        int ku = cdt_index(U, b), q = U->v[(ku + 2) % 3];
+        if (!cdt_incircle(d, a, b, p, q)) continue;
+        if (cdt_orient(d, a, q, p) <= 0 || cdt_orient(d, q, b, p) <= 0) continue;
+
+        int n_bp = T->n[(k + 1) % 3], m_bp = T->mark[(k + 1) % 3];
+        int n_pa = T->n[(k + 2) % 3], m_pa = T->mark[(k + 2) % 3];
+        int n_aq = U->n[(ku + 1) % 3], m_aq = U->mark[(ku + 1) % 3];
+        int n_qb = U->n[(ku + 2) % 3], m_qb = U->mark[(ku + 2) % 3];
+        cdt_set(d, t, a, q, p, n_aq, u, n_pa, m_aq, 0, m_pa);
+        cdt_set(d, u, q, b, p, n_qb, n_bp, t, m_qb, m_bp, 0);
+        cdt_relink(d, n_aq, q, a, t);
+        cdt_relink(d, n_bp, p, b, u);
+        flips++;
+        if (cdt_push(d, &top, 3 * t) < 0 || cdt_push(d, &top, 3 * u) < 0) return;
+    }
+}
+
+static int cdt_split_face(cdt_t* d, int t, int p) {
+    int t1 = cdt_new_triangle(d), t2 = cdt_new_triangle(d);
+    if (t1 < 0 || t2 < 0) return -1;
+    cdt_triangle_t old = d->tris[t];
+    int a = old.v[0], b = old.v[1], c = old.v[2];
+    cdt_set(d, t, a, b, p, old.n[0], t1, t2, old.mark[0], 0, 0);
+    cdt_set(d, t1, b, c, p, old.n[1], t2, t, old.mark[1], 0, 0);
+    cdt_set(d, t2, c, a, p, old.n[2], t, t1, old.mark[2], 0, 0);
+    cdt_relink(d, old.n[1], c, b, t1);
+    cdt_relink(d, old.n[2], a, c, t2);
+    cdt_legalize(d, t, 0);
+    cdt_legalize(d, t1, 0);
+    cdt_legalize(d, t2, 0);
+    d->last = t;
+    return 0;
+}
+
+// Split edge k of t, and the triangle on its other side, at p
+static int cdt_split_edge(cdt_t* d, int t, int k, int p) {
+    cdt_triangle_t T = d->tris[t];
+    int a = T.v[k], b = T.v[(k + 1) % 3], c = T.v[(k + 2) % 3], m = T.mark[k];
+    int u = T.n[k];
+    if (u < 0) return -1;
+    cdt_triangle_t U = d->tris[u];
+    int ku = cdt_index(&U, b), dv = U.v[(ku + 2) % 3];
+    int n_bc = T.n[(k + 1) % 3], m_bc = T.mark[(k + 1) % 3];
+    int n_ca = T.n[(k + 2) % 3], m_ca = T.mark[(k + 2) % 3];
+    int n_ad = U.n[(ku + 1) % 3], m_ad = U.mark[(ku + 1) % 3];
+    int n_db = U.n[(ku + 2) % 3], m_db = U.mark[(ku + 2) % 3];
+    int t2 = cdt_new_triangle(d), u2 = cdt_new_triangle(d);
+    if (t2 < 0 || u2 < 0) return -1;
+
+    cdt_set(d, t, a, p, c, u2, t2, n_ca, m, 0, m_ca);
+    cdt_set(d, t2, p, b, c, u, n_bc, t, m, m_bc, 0);
+    cdt_set(d, u, b, p, dv, t2, u2, n_db, m, 0, m_db);
+    cdt_set(d, u2, p, a, dv, t, n_ad, u, m, m_ad, 0);
+    cdt_relink(d, n_bc, c, b, t2);
+    cdt_relink(d, n_ad, dv, a, u2);
+    cdt_legalize(d, t, 2);
+    cdt_legalize(d, t2, 1);
+    cdt_legalize(d, u, 2);
+    cdt_legalize(d, u2, 1);
+    d->last = t;
+    return 0;
+}
+
+// Triangle containing (x, y): where is -1 inside, k on edge k, 3 + k at
+// vertex k. A remembering stochastic walk, with a scan as the fallback.
+static int cdt_locate(cdt_t* d, double x, double y, int* where) {
+    int t = d->last;
+    for (int pass = 0; pass < 2; pass++) {
+        for (int steps = 0, scan = 0; pass ? scan < d->tri_count : steps < 64 + d->tri_count; steps++) {
+            if (pass) t = scan++;
+            const cdt_triangle_t* T = &d->tris[t];
+            int o[3], start = (d->seed = d->seed * 1103515245 + 12345) >> 16, next = -1;
+            for (int i = 0; i < 3; i++) {
+                int k = (start + i) % 3;
+                const double* p = d->xy[T->v[k]];
+                const double* q = d->xy[T->v[(k + 1) % 3]];
+                o[k] = orient2d(p[0], p[1], q[0], q[1], x, y);
+                if (o[k] < 0 && next < 0) next = k;
+            }
+            if (next >= 0) {
+                if (!pass && T->n[next] >= 0) t = T->n[next];
+                else if (!pass) break;
+                continue;
+            }
+            d->last = t;
+            *where = -1;
+            for (int k = 0; k < 3; k++) {
+                if (o[k] != 0) continue;
+                *where = o[(k + 2) % 3] == 0 ? 3 + k : o[(k + 1) % 3] == 0 ? 3 + (k + 1) % 3 : k;
+                break;
+            }
+            return t;
+        }
+    }
+    return -1;
+}
+
+static int cdt_insert(cdt_t* d, double x, double y, int id) {
+    int where, t = cdt_locate(d, x, y, &where);
+    if (t < 0) return -1;
+    if (where >= 3) return d->tris[t].v[where - 3];     // same projection
+    int v = cdt_add_vertex(d, x, y, id);
+    if (v < 0) return -1;
+    d->incident[v] = t;
+    if ((where < 0 ? cdt_split_face(d, t, v) : cdt_split_edge(d, t, where, v)) < 0) return -1;
+    return v;
+}
+
+static void cdt_init(cdt_t* d, double xmin, double ymin, double xmax, double ymax) {
+    double cx = (xmin + xmax) / 2, cy = (ymin + ymax) / 2;
+    double r = 10 * fmax(xmax - xmin, ymax - ymin) + 1;
+    d->vertex_count = d->tri_count = 0;
+    d->last = 0;
+    cdt_add_vertex(d, cx - 2 * r, cy - r, -1);
+    cdt_add_vertex(d, cx + 2 * r, cy - r, -1);
+    cdt_add_vertex(d, cx, cy + 2 * r, -1);
+    cdt_new_triangle(d);
+    cdt_set(d, 0, 0, 1, 2, -1, -1, -1, 0, 0, 0);
+}
+
+// Is x on the same side of a as b, given all three are collinear?
+static int cdt_ahead(const cdt_t* d, int a, int b, int x) {
+    int k = fabs(d->xy[b][0] - d->xy[a][0]) >= fabs(d->xy[b][1] - d->xy[a][1]) ? 0 : 1;
+    return (d->xy[x][k] > d->xy[a][k]) == (d->xy[b][k] > d->xy[a][k]);
+}
+
+static void cdt_mark_edge(cdt_t* d, int t, int k, int mark) {
+    cdt_triangle_t* T = &d->tris[t];
+    int a = T->v[k], b = T->v[(k + 1) % 3], u = T->n[k];
+    T->mark[k] |= mark;
+    if (u >= 0) {
+        cdt_triangle_t* U = &d->tris[u];
+        int ku = cdt_index(U, b);
+        if (U->v[(ku + 1) % 3] == a) U->mark[ku] |= mark;
+    }
+}
+
+// Ear clipping of a counter-clockwise polygon into out (triples)
+static int cdt_triangulate_polygon(const cdt_t* d, int* poly, int m, int* out) {
+    int count = 0;
+    while (m > 3) {
+        int ear = -1;
+        for (int i = 0; i < m && ear < 0; i++) {
+            int a = poly[(i + m - 1) % m], b = poly[i], c = poly[(i + 1) % m];
+            if (cdt_orient(d, a, b, c) <= 0) continue;
+            ear = i;
+            for (int j = 0; j < m; j++) {
+                int w = poly[j];
+                if (w == a || w == b || w == c) continue;
+                if (cdt_orient(d, a, b, w) >= 0 && cdt_orient(d, b, c, w) >= 0 && cdt_orient(d, c, a, w) >= 0) {
+                    ear = -1;
+                    break;
+                }
+            }
+        }
+        if (ear < 0) return -1;
+        out[3 * count] = poly[(ear + m - 1) % m];
+        out[3 * count + 1] = poly[ear];
+        out[3 * count + 2] = poly[(ear + 1) % m];
+        count++;
+        memmove(poly + ear, poly + ear + 1, (m - ear - 1) * sizeof(int));
+        m--;
+    }
+    if (cdt_orient(d, poly[0], poly[1], poly[2]) <= 0) return -1;
+    memcpy(out + 3 * count, poly, 3 * sizeof(int));
+    return count + 1;
+}
+
+// Replace the triangles in removed[] by the ones in tris[] (same number),
+// linking them to each other and to the triangles around the cavity
+static int cdt_fill_cavity(cdt_t* d, const int* removed, const int* tris, int count, int a, int b, int mark) {
+    int n = 3 * count;
+    int* border = malloc(4 * n * sizeof(int));      // from, to, neighbour, mark
+    int* link = malloc(2 * n * sizeof(int));        // neighbour, mark per new edge
+    if (!border || !link) {
+        free(border);
+        free(link);
+        return -1;
+    }
+    int borders = 0, ret = -1;
+    for (int i = 0; i < count; i++) {
+        const cdt_triangle_t* T = &d->tris[removed[i]];
+        for (int k = 0; k < 3; k++) {
+            int inside = 0;
+            for (int j = 0; j < count && !inside; j++) inside = T->n[k] == removed[j];
+            if (inside) continue;
+            int* e = &border[4 * borders++];
+            e[0] = T->v[k];
+            e[1] = T->v[(k + 1) % 3];
+            e[2] = T->n[k];
+            e[3] = T->mark[k];
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        int p = tris[i], q = tris[i % 3 == 2 ? i - 2 : i + 1];
+        int* l = &link[2 * i];
+        l[0] = -2;
+        l[1] = (p == a && q == b) || (p == b && q == a) ? mark : 0;
+        for (int j = 0; j < borders && l[0] == -2; j++) {
+            if (border[4 * j] == p && border[4 * j + 1] == q) {
+                l[0] = border[4 * j + 2];
+                l[1] = border[4 * j + 3];
+            }
+        }
+        for (int j = 0; j < n && l[0] == -2; j++) {
+            if (tris[j] == q && tris[j % 3 == 2 ? j - 2 : j + 1] == p) l[0] = removed[j / 3];
+        }
+        if (l[0] == -2) goto out;
+    }
+    for (int i = 0; i < count; i++) {
+        const int* v = &tris[3 * i];
+        const int* l = &link[6 * i];
+        cdt_set(d, removed[i], v[0], v[1], v[2], l[0], l[2], l[4], l[1], l[3], l[5]);
+        for (int k = 0; k < 3; k++) {
+            if (l[2 * k] < 0) continue;
+            int outside = 1;
+            for (int j = 0; j < count && outside; j++) outside = l[2 * k] != removed[j];
+            if (outside) cdt_relink(d, l[2 * k], v[(k + 1) % 3], v[k], removed[i]);
+        }
+    }
+    d->last = removed[0];
+    ret = 0;
+
+out:
+    free(border);
+    free(link);
+    return ret;
+}
+
+// Force the edge a -> b in, marked. Vertices exactly on the way split it;
+// an already constrained edge on the way is split where they cross.
+static int cdt_constrain(cdt_t* d, int a, int b, int mark) {
+    int targets[64], target_count = 0, guard = 0;
+    targets[target_count++] = b;
+    int *removed = NULL, *left = NULL, *right = NULL, *tris = NULL, *poly = NULL;
+    int removed_cap = 0, left_cap = 0, right_cap = 0, tris_cap = 0, poly_cap = 0;
+    int ret = -1;
+
+    while (target_count) {
+        b = targets[target_count - 1];
+        if (a == b) {
+            target_count--;
+            continue;
+        }
+        if (++guard > 4 * d->tri_count + 64) goto out;
+
+        // The triangle around a through which the edge leaves
+        int t = d->incident[a], start = t, cross = -1, advanced = 0;
+        do {
+            const cdt_triangle_t* T = &d->tris[t];
+            int k = cdt_index(T, a);
+            int x = T->v[(k + 1) % 3], y = T->v[(k + 2) % 3];
+            int ox = cdt_orient(d, a, b, x), oy = cdt_orient(d, a, b, y);
+            if (x == b || (ox == 0 && cdt_ahead(d, a, b, x))) {
+                cdt_mark_edge(d, t, k, mark);
+                a = x;
+                advanced = 1;
+            } else if (y == b || (oy == 0 && cdt_ahead(d, a, b, y))) {
+                cdt_mark_edge(d, t, (k + 2) % 3, mark);
+                a = y;
+                advanced = 1;
+            } else if (ox < 0 && oy > 0) {
+                cross = (k + 1) % 3;
+            } else {
+                t = T->n[(k + 2) % 3];
+            }
+        } while (!advanced && cross < 0 && t >= 0 && t != start);
+        if (advanced) continue;
+        if (cross < 0) goto out;
+
+        // Walk along the edge, collecting the triangles it crosses and the
+        // vertices left and right of it
+        int removed_count = 0, left_count = 0, right_count = 0, end = -1, split = -1;
+        int cur = t, ce = cross;
+        if (grow_array((void**)&left, &left_cap, 1, sizeof(int)) < 0 ||
+            grow_array((void**)&right, &right_cap, 1, sizeof(int)) < 0) goto out;
+        left[left_count++] = d->tris[t].v[(cross + 1) % 3];
+        right[right_count++] = d->tris[t].v[cross];
+        while (end < 0) {
+            const cdt_triangle_t* T = &d->tris[cur];
+            if (grow_array((void**)&removed, &removed_cap, removed_count + 2, sizeof(int)) < 0) goto out;
+            removed[removed_count++] = cur;
+            if (T->mark[ce]) {
+                split = cur;
+                break;
+            }
+            int y = T->v[(ce + 1) % 3], u = T->n[ce];
+            if (u < 0) goto out;
+            const cdt_triangle_t* U = &d->tris[u];
+            int ku = cdt_index(U, y), z = U->v[(ku + 2) % 3];
+            int oz = z == b ? 0 : cdt_orient(d, a, b, z);
+            if (oz == 0) {
+                removed[removed_count++] = u;
+                end = z;
+            } else if (oz > 0) {
+                if (grow_array((void**)&left, &left_cap, left_count + 1, sizeof(int)) < 0) goto out;
+                left[left_count++] = z;
+                ce = (ku + 1) % 3;
+            } else {
+                if (grow_array((void**)&right, &right_cap, right_count + 1, sizeof(int)) < 0) goto out;
+                right[right_count++] = z;
+                ce = (ku + 2) % 3;
+            }
+            cur = u;
+        }
+
+        if (split >= 0) {
+            // Crossing another constraint: add the crossing point to both
+            const cdt_triangle_t* T = &d->tris[split];
+            int x = T->v[ce], y = T->v[(ce + 1) % 3], u = T->n[ce];
+            if (u < 0 || d->id[x] < 0 || d->id[y] < 0 || target_count == 64) goto out;
+            int id = csg_edge_edge(d->owner, KEY_SPLIT, d->id[a], d->id[b], d->id[x], d->id[y]);
+            if (id < 0) goto out;
+            vec3_t p = csg_point(d->owner, id);
+            int v = cdt_add_vertex(d, vec3_get(p, d->axes[0]), vec3_get(p, d->axes[1]), id);
+            if (v < 0) goto out;
+            const cdt_triangle_t* U = &d->tris[u];
+            int pt = T->v[(ce + 2) % 3], pu = U->v[(cdt_index(U, y) + 2) % 3];
+            if (cdt_orient(d, x, v, pt) <= 0 || cdt_orient(d, v, y, pt) <= 0 ||
+                cdt_orient(d, y, v, pu) <= 0 || cdt_orient(d, v, x, pu) <= 0) {
+                d->vertex_count--;
+                goto out;
+            }
+            d->incident[v] = split;
+            if (cdt_split_edge(d, split, ce, v) < 0) goto out;
+            targets[target_count++] = v;
+            continue;
+        }
+
+        // Retriangulate both sides of the new edge
+        int m = left_count + right_count + 2;
+        if (grow_array((void**)&poly, &poly_cap, m, sizeof(int)) < 0 ||
+            grow_array((void**)&tris, &tris_cap, 3 * m, sizeof(int)) < 0) goto out;
+        int n = 0;
+        poly[n++] = a;
+        poly[n++] = end;
+        for (int i = left_count - 1; i >= 0; i--) poly[n++] = left[i];
+        int first = cdt_triangulate_polygon(d, poly, n, tris);
+        n = 0;
+        poly[n++] = end;
+        poly[n++] = a;
+        for (int i = 0; i < right_count; i++) poly[n++] = right[i];
+        int second = first < 0 ? -1 : cdt_triangulate_polygon(d, poly, n, tris + 3 * first);
+        if (second < 0 || first + second != removed_count) goto out;
+        if (cdt_fill_cavity(d, removed, tris, removed_count, a, end, mark) < 0) goto out;
+        a = end;
+    }
+    ret = 0;
+
+out:
+    free(removed);
+    free(left);
+    free(right);
+    free(tris);
+    free(poly);
+    return ret;
+}
+
+static void cdt_free(cdt_t* d) {
+    free(d->xy);
+    free(d->id);
+    free(d->incident);
+    free(d->tris);
+    free(d->vertex_of);
+    free(d->scratch);
+}
+
+// Flood from the enclosing corners up to the triangle's edges
+static void cdt_mark_outside(cdt_t* d) {
+    int top = 0;
+    for (int t = 0; t < d->tri_count; t++) {
+        cdt_triangle_t* T = &d->tris[t];
+        T->outside = T->v[0] < 3 || T->v[1] < 3 || T->v[2] < 3;
+        if (T->outside && cdt_push(d, &top, t) < 0) return;
+    }
+    while (top) {
+        const cdt_triangle_t* T = &d->tris[d->scratch[--top]];
+        for (int k = 0; k < 3; k++) {
+            int u = T->n[k];
+            if (u < 0 || (T->mark[k] & CDT_BOUNDARY) || d->tris[u].outside) continue;
+            d->tris[u].outside = 1;
+            if (cdt_push(d, &top, u) < 0) return;
+        }
+    }
+}
+
+static void csg_add_fragment(csg_t* c, int tri, int a, int b, int d, int barrier) {
+    if (grow_array((void**)&c->fragments, &c->fragment_capacity, c->fragment_count + 1, sizeof(csg_fragment_t)) < 0) {
+        c->failed = 1;
+        return;
+    }
+    c->fragments[c->fragment_count++] = (csg_fragment_t){ { a, b, d }, tri, barrier, -1 };
+}
+
+// Which edge of triangle t a point on it lies on, -1 if inside
+static int csg_site_edge(const csg_t* c, int t, int p) {
+    const int* v = c->mesh.triangles[t];
+    if (p < c->input_points) {
+        for (int k = 0; k < 3; k++) {
+            if (v[k] != p && v[(k + 1) % 3] != p && csg_orient2d(c, t, v[k], v[(k + 1) % 3], p) == 0) return k;
+        }
+        return -1;
+    }
+    const csg_key_t* key = &c->keys[p - c->input_points];
+    if (key->kind == KEY_SPLIT) return -1;
+    for (int k = 0; k < 3; k++) {
+        int a = v[k] < v[(k + 1) % 3] ? v[k] : v[(k + 1) % 3];
+        int b = v[k] ^ v[(k + 1) % 3] ^ a;
+        if (key->a == a && key->b == b) return k;
+        if (key->kind == KEY_EDGE_EDGE && key->c == a && key->d == b) return k;
+    }
+    return -1;
+}
+
+typedef struct {
+    double t;
+    int point;
+} csg_site_t;
+
+static int compare_sites(const void* x, const void* y) {
+    const csg_site_t* a = x;
+    const csg_site_t* b = y;
+    return (a->t > b->t) - (a->t < b->t);
+}
+
+// Triangulate triangle t with its curves in and add the pieces. Returns -1
+// if the triangle's own edges could not be inserted.
+static int csg_cut_triangle(csg_t* c, cdt_t* d, int t, const csg_segment_t* seg, int nseg) {
+    int tv[3];
+    memcpy(tv, c->mesh.triangles[t], sizeof(tv));
+    d->owner = c;
+    d->axes[0] = c->axes[t][0];
+    d->axes[1] = c->axes[t][1];
+    int old = d->vertex_of_capacity;
+    if (grow_array((void**)&d->vertex_of, &d->vertex_of_capacity, c->mesh.vertex_count, sizeof(int)) < 0) return -1;
+    for (int i = old; i < d->vertex_of_capacity; i++) d->vertex_of[i] = -1;
+
+    csg_site_t* sites = malloc(2 * (3 + 2 * nseg) * sizeof(csg_site_t));
+    int* edge = malloc((3 + 2 * nseg) * sizeof(int));
+    if (!sites || !edge) {
+        free(sites);
+        free(edge);
+        return -1;
+    }
+    int count = 0, ret = -1;
+    double lo[2] = { INFINITY, INFINITY }, hi[2] = { -INFINITY, -INFINITY };
+    for (int i = 0; i < 3 + 2 * nseg; i++) {
+        int p = i < 3 ? tv[i] : (i - 3) % 2 ? seg[(i - 3) / 2].b : seg[(i - 3) / 2].a;
+        if (d->vertex_of[p] != -1) continue;
+        d->vertex_of[p] = -2;
+        vec3_t pt = csg_point(c, p);
+        for (int k = 0; k < 2; k++) {
+            double x = vec3_get(pt, d->axes[k]);
+            if (x < lo[k]) lo[k] = x;
+            if (x > hi[k]) hi[k] = x;
+        }
+        sites[count].point = p;
+        edge[count++] = i < 3 ? -1 : csg_site_edge(c, t, p);
+    }
+    cdt_init(d, lo[0], lo[1], hi[0], hi[1]);
+    for (int i = 0; i < count; i++) {
+        vec3_t pt = csg_point(c, sites[i].point);
+        int v = cdt_insert(d, vec3_get(pt, d->axes[0]), vec3_get(pt, d->axes[1]), sites[i].point);
+        if (v < 0) goto out;
+        d->vertex_of[sites[i].point] = v;
+        if (d->id[v] != sites[i].point) {
+            if (grow_array((void**)&c->aliases, &c->alias_capacity, c->alias_count + 1, sizeof(*c->aliases)) < 0) goto out;
+            c->aliases[c->alias_count][0] = sites[i].point;
+            c->aliases[c->alias_count++][1] = d->id[v];
+        }
+    }
+
+    // The edges of t, through the points on them
+    for (int k = 0; k < 3; k++) {
+        vec3_t a = csg_point(c, tv[k]), dir = vec3_sub(csg_point(c, tv[(k + 1) % 3]), a);
+        csg_site_t* chain = sites + count;
+        int n = 0;
+        chain[n++] = (csg_site_t){ -INFINITY, tv[k] };
+        for (int i = 3; i < count; i++) {
+            if (edge[i] == k) chain[n++] = (csg_site_t){ vec3_dot(vec3_sub(csg_point(c, sites[i].point), a), dir), sites[i].point };
+        }
+        chain[n++] = (csg_site_t){ INFINITY, tv[(k + 1) % 3] };
+        qsort(chain, n, sizeof(csg_site_t), compare_sites);
+        for (int i = 0; i + 1 < n; i++) {
+            if (cdt_constrain(d, d->vertex_of[chain[i].point], d->vertex_of[chain[i + 1].point], CDT_BOUNDARY) < 0) goto out;
+        }
+    }
+    for (int i = 0; i < nseg; i++) {
+        if (seg[i].a != seg[i].b) cdt_constrain(d, d->vertex_of[seg[i].a], d->vertex_of[seg[i].b], CDT_CURVE);
+    }
+
+    cdt_mark_outside(d);
+    for (int i = 0; i < d->tri_count; i++) {
+        const cdt_triangle_t* T = &d->tris[i];
+        if (T->outside) continue;
+        int barrier = 0;
+        for (int k = 0; k < 3; k++) {
+            if (T->mark[k] & CDT_CURVE) barrier |= 1 << k;
+        }
+        csg_add_fragment(c, t, d->id[T->v[0]], d->id[T->v[1]], d->id[T->v[2]], barrier);
+    }
+    ret = 0;
+
+out:
+    for (int i = 0; i < count; i++) d->vertex_of[sites[i].point] = -1;
+    free(sites);
+    free(edge);
+    return ret;
+}
+
+// Edge -> fragment, open addressing; keys are never 0
+typedef struct {
+    uint64_t* keys;
+    int* values;
+    int count;                  // power of two
+} csg_edge_map_t;
+
+static int edge_map_init(csg_edge_map_t* m, int n) {
+    m->count = 64;
+    while (m->count < 2 * n) m->count *= 2;
+    m->keys = calloc(m->count, sizeof(uint64_t));
+    m->values = malloc(m->count * sizeof(int));
+    return m->keys && m->values ? 0 : -1;
+}
+
+static void edge_map_free(csg_edge_map_t* m) {
+    free(m->keys);
+    free(m->values);
+}
+
+// The value stored for key, or -1 after storing value
+static int edge_map_insert(csg_edge_map_t* m, uint64_t key, int value) {
+    uint64_t j = hash_mix(key) & (m->count - 1);
+    for (; m->keys[j]; j = (j + 1) & (m->count - 1)) {
+        if (m->keys[j] == key) return m->values[j];
+    }
+    m->keys[j] = key;
+    m->values[j] = value;
+    return -1;
+}
+
+static int edge_map_find(const csg_edge_map_t* m, uint64_t key) {
+    uint64_t j = hash_mix(key) & (m->count - 1);
+    for (; m->keys[j]; j = (j + 1) & (m->count - 1)) {
+        if (m->keys[j] == key) return m->values[j];
+    }
+    return -1;
+}
+
+static uint64_t csg_edge_key(int a, int b, int side) {
+    if (a > b) {
+        int t = a;
+        a = b;
+        b = t;
+    }
+    return (uint64_t)a << 33 | (uint64_t)b << 1 | side;
+}
+
+static vec3_t csg_centroid(const csg_t* c, const csg_fragment_t* f) {
+    vec3_t a = csg_point(c, f->v[0]), b = csg_point(c, f->v[1]), d = csg_point(c, f->v[2]);
+    return (vec3_t){ (a.x + b.x + d.x) / 3, (a.y + b.y + d.y) / 3, (a.z + b.z + d.z) / 3 };
+}
+
+// Is p, taken to lie in the plane of triangle t, inside it?
+static int csg_point_in_triangle(const csg_t* c, int t, vec3_t p, int strict) {
+    const int* v = c->mesh.triangles[t];
+    int i = c->axes[t][0], j = c->axes[t][1];
+    const double* box = c->box[t];
+    if (vec3_get(p, i) < box[i] || vec3_get(p, i) > box[i + 3] ||
+        vec3_get(p, j) < box[j] || vec3_get(p, j) > box[j + 3]) return 0;
+    for (int k = 0; k < 3; k++) {
+        vec3_t a = csg_point(c, v[k]), b = csg_point(c, v[(k + 1) % 3]);
+        int o = orient2d(vec3_get(a, i), vec3_get(a, j), vec3_get(b, i), vec3_get(b, j), vec3_get(p, i), vec3_get(p, j));
+        if (o < 0 || (strict && o == 0)) return 0;
+    }
+    return 1;
+}
+
+static double csg_random(csg_t* c) {
+    c->seed = c->seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (c->seed >> 11) * 0x1p-53;
+}
+
+// Is p inside the closed mesh side? Counts signed crossings of a ray in a
+// random direction, and tries another direction when the ray grazes an
+// edge or a face. -1 if p lies on the surface.
+static int csg_inside(csg_t* c, int side, vec3_t p, int** hits, int* capacity) {
+    const double* b = c->bounds[side];
+    if (p.x < b[0] || p.y < b[1] || p.z < b[2] || p.x > b[3] || p.y > b[4] || p.z > b[5]) return 0;
+    double length = 2 * (b[3] - b[0] + b[4] - b[1] + b[5] - b[2]) + 1;
+    for (int attempt = 0; attempt < CSG_RAY_ATTEMPTS; attempt++) {
+        double z = 2 * csg_random(c) - 1, phi = 2 * M_PI * csg_random(c), r = sqrt(1 - z * z);
+        vec3_t q = { p.x + length * r * cos(phi), p.y + length * r * sin(phi), p.z + length * z };
+        int count = 0, winding = 0, degenerate = 0;
+        if (bvh_query_segment(&c->bvh[side], p, q, hits, &count, capacity) < 0) {
+            c->failed = 1;
+            return 0;
+        }
+        for (int i = 0; i < count && !degenerate; i++) {
+            int t = (*hits)[i];
+            const int* v = c->mesh.triangles[t];
+            vec3_t A = csg_point(c, v[0]), B = csg_point(c, v[1]), C = csg_point(c, v[2]);
+            int s1 = orient3d(A, B, C, p), s2 = orient3d(A, B, C, q);
+            if (s1 == 0) {
+                if (csg_point_in_triangle(c, t, p, 0)) return -1;
+                degenerate = s2 == 0;
+                continue;
+            }
+            if (s2 == 0) {
+                degenerate = 1;
+                continue;
+            }
+            if (s1 == s2) continue;
+            int o0 = orient3d(p, q, A, B), o1 = orient3d(p, q, B, C), o2 = orient3d(p, q, C, A);
+            if ((o0 < 0 || o1 < 0 || o2 < 0) && (o0 > 0 || o1 > 0 || o2 > 0)) continue;
+            if (!o0 || !o1 || !o2) {
+                degenerate = 1;
+                continue;
+            }
+            winding += s1 < 0 ? 1 : -1;
+        }
+        if (!degenerate) return winding > 0;
+    }
+    return 0;
+}
+
+typedef struct {
+    int root;
+    double area;
+    int fragment;
+} csg_region_t;
+
+static int compare_regions(const void* x, const void* y) {
+    const csg_region_t* a = x;
+    const csg_region_t* b = y;
+    if (a->root != b->root) return a->root < b->root ? -1 : 1;
+    if (a->area != b->area) return a->area > b->area ? -1 : 1;
+    return a->fragment - b->fragment;
+}
+
+static int csg_find(int* parent, int x) {
+    while (parent[x] != x) {
+        parent[x] = parent[parent[x]];
+        x = parent[x];
+    }
+    return x;
+}
+
+// Fragments not covered by a coplanar face: those connected without
+// crossing a curve are on the same side of the other mesh, so one ray per
+// connected region decides for all of them.
+static int csg_classify(csg_t* c) {
+    int n = c->fragment_count, m = 0, ret = -1;
+    int* parent = malloc((n ? n : 1) * sizeof(int));
+    csg_region_t* regions = malloc((n ? n : 1) * sizeof(csg_region_t));
+    csg_edge_map_t barriers = { 0 }, edges = { 0 };
+    int* hits = NULL;
+    int hit_capacity = 0;
+    if (!parent || !regions || edge_map_init(&barriers, 3 * n) < 0 || edge_map_init(&edges, 3 * n) < 0) goto out;
+
+    for (int f = 0; f < n; f++) {
+        const csg_fragment_t* F = &c->fragments[f];
+        parent[f] = f;
+        for (int k = 0; k < 3; k++) {
+            if (F->barrier & 1 << k) edge_map_insert(&barriers, csg_edge_key(F->v[k], F->v[(k + 1) % 3], 0), f);
+        }
+    }
+    for (int f = 0; f < n; f++) {
+        const csg_fragment_t* F = &c->fragments[f];
+        if (F->cls >= 0) continue;
+        for (int k = 0; k < 3; k++) {
+            int a = F->v[k], b = F->v[(k + 1) % 3];
+            if (edge_map_find(&barriers, csg_edge_key(a, b, 0)) >= 0) continue;
+            int g = edge_map_insert(&edges, csg_edge_key(a, b, F->tri >= c->split), f);
+            if (g >= 0) parent[csg_find(parent, f)] = csg_find(parent, g);
+        }
+    }
+    for (int f = 0; f < n; f++) {
+        const csg_fragment_t* F = &c->fragments[f];
+        if (F->cls >= 0) continue;
+        vec3_t a = csg_point(c, F->v[0]);
+        vec3_t e = vec3_cross(vec3_sub(csg_point(c, F->v[1]), a), vec3_sub(csg_point(c, F->v[2]), a));
+        regions[m++] = (csg_region_t){ csg_find(parent, f), vec3_dot(e, e), f };
+    }
+    qsort(regions, m, sizeof(csg_region_t), compare_regions);
+
+    for (int i = 0, j; i < m; i = j) {
+        int side = c->fragments[regions[i].fragment].tri < c->split, cls = CSG_OUT;
+        for (j = i; j < m && regions[j].root == regions[i].root; j++) {}
+        for (int k = i; k < j; k++) {
+            int r = csg_inside(c, side, csg_centroid(c, &c->fragments[regions[k].fragment]), &hits, &hit_capacity);
+            if (r >= 0) {
+                cls = r ? CSG_IN : CSG_OUT;
+                break;
+            }
+        }
+        for (int k = i; k < j; k++) c->fragments[regions[k].fragment].cls = cls;
+    }
+    ret = 0;
+
+out:
+    free(parent);
+    free(regions);
+    free(hits);
+    edge_map_free(&barriers);
+    edge_map_free(&edges);
+    return ret;
+}
+
+// 1 to keep a fragment, -1 to keep it reversed
+static int csg_keep(csg_op_t op, int cls, int second) {
+    switch (op) {
+    case CSG_UNION:
+        return cls == CSG_OUT || (cls == CSG_SAME && !second);
+    case CSG_INTERSECTION:
+        return cls == CSG_IN || (cls == CSG_SAME && !second);
+    case CSG_DIFFERENCE:
+        if (second) return cls == CSG_IN ? -1 : 0;
+        return cls == CSG_OUT || cls == CSG_OPPOSITE;
+    }
+    return 0;
+}
+
+// Kept fragments, with points of equal coordinates merged, and so are
+// points that one of the cut triangles could not tell apart
+static int compare_by_x(const void* x, const void* y, void* arg) {
+    const vec3_t* v = arg;
+    double a = v[*(const int*)x].x, b = v[*(const int*)y].x;
+    return (a > b) - (a < b);
+}
+
+// Rounding can leave two constructions of one point a few ulps apart where
+// the same crossing was reached through different elements. Merge points
+// closer than that and drop the triangles that collapse.
+static int csg_weld_close(mesh_t* mesh) {
+    int n = mesh->vertex_count;
+    if (!n) return 0;
+    int* order = malloc(n * sizeof(int));
+    int* parent = malloc(n * sizeof(int));
+    if (!order || !parent) {
+        free(order);
+        free(parent);
+        return -1;
+    }
+    double extent = 1;
+    for (int i = 0; i < n; i++) {
+        vec3_t p = mesh->vertices[i];
+        extent = fmax(extent, fmax(fabs(p.x), fmax(fabs(p.y), fabs(p.z))));
+        order[i] = i;
+        parent[i] = i;
+    }
+    double eps = extent * CSG_WELD_TOLERANCE;
+    qsort_r(order, n, sizeof(int), compare_by_x, mesh->vertices);
+    int merged = 0;
+    for (int i = 0; i < n; i++) {
+        vec3_t p = mesh->vertices[order[i]];
+        for (int j = i + 1; j < n && mesh->vertices[order[j]].x - p.x <= eps; j++) {
+            vec3_t q = mesh->vertices[order[j]];
+            if (fabs(q.y - p.y) > eps || fabs(q.z - p.z) > eps) continue;
+            int a = csg_find(parent, order[i]), b = csg_find(parent, order[j]);
+            if (a != b) {
+                parent[b] = a;
+                merged++;
+            }
+        }
+    }
+    if (merged) {
+        int m = 0;
+        for (int i = 0; i < mesh->triangle_count; i++) {
+            int* t = mesh->triangles[i];
+            int a = csg_find(parent, t[0]), b = csg_find(parent, t[1]), d = csg_find(parent, t[2]);
+            if (a == b || b == d || d == a) continue;
+            mesh->triangles[m][0] = a;
+            mesh->triangles[m][1] = b;
+            mesh->triangles[m++][2] = d;
+        }
+        mesh->triangle_count = m;
+    }
+    free(order);
+    free(parent);
+    return 0;
+}
+
+static int csg_output(const csg_t* c, csg_op_t op, mesh_t* out) {
+    int n = c->mesh.vertex_count, slots = 64, ret = -1;
+    while (slots < 2 * n) slots *= 2;
+    int* map = malloc((n ? n : 1) * sizeof(int));
+    int* parent = malloc((n ? n : 1) * sizeof(int));
+    weld_slot_t* table = malloc(slots * sizeof(weld_slot_t));
+    if (!map || !parent || !table) goto out;
+    for (int i = 0; i < n; i++) {
+        map[i] = -1;
+        parent[i] = i;
+    }
+    for (int i = 0; i < c->alias_count; i++) {
+        parent[csg_find(parent, c->aliases[i][0])] = csg_find(parent, c->aliases[i][1]);
+    }
+    for (int i = 0; i < slots; i++) table[i].id = -1;
+
+    for (int f = 0; f < c->fragment_count; f++) {
+        const csg_fragment_t* F = &c->fragments[f];
+        int keep = csg_keep(op, F->cls, F->tri >= c->split), v[3];
+        if (!keep) continue;
+        for (int k = 0; k < 3; k++) {
+            int p = csg_find(parent, F->v[k]);
+            if (map[p] < 0) {
+                vec3_t x = csg_point(c, p);
+                uint64_t j = weld_hash(x.x, x.y, x.z) & (slots - 1);
+                for (; table[j].id >= 0; j = (j + 1) & (slots - 1)) {
+                    if (table[j].x == x.x && table[j].y == x.y && table[j].z == x.z) break;
+                }
+                if (table[j].id < 0) {
+                    if (mesh_reserve(out, 1, 0) < 0) goto out;
+                    table[j] = (weld_slot_t){ x.x, x.y, x.z, mesh_add_vertex(out, x) };
+                }
+                map[p] = table[j].id;
+            }
+            v[k] = map[p];
+        }
+        if (v[0] == v[1] || v[1] == v[2] || v[2] == v[0]) continue;
+        if (mesh_reserve(out, 0, 1) < 0) goto out;
+        if (keep > 0) mesh_add_triangle(out, v[0], v[1], v[2]);
+        else mesh_add_triangle(out, v[0], v[2], v[1]);
+    }
+    ret = csg_weld_close(out);
+
+out:
+    free(map);
+    free(parent);
+    free(table);
+    return ret;
+}
+
+static int compare_segments(const void* x, const void* y) {
+    const csg_segment_t* a = x;
+    const csg_segment_t* b = y;
+    if (a->tri != b->tri) return a->tri < b->tri ? -1 : 1;
+    if (a->a != b->a) return a->a < b->a ? -1 : 1;
+    return (a->b > b->b) - (a->b < b->b);
+}
+
+static int compare_coplanar(const void* x, const void* y) {
+    const csg_coplanar_t* a = x;
+    const csg_coplanar_t* b = y;
+    if (a->tri != b->tri) return a->tri < b->tri ? -1 : 1;
+    return (a->other > b->other) - (a->other < b->other);
+}
+
+static void csg_free(csg_t* c) {
+    mesh_free(&c->mesh);
+    free(c->keys);
+    free(c->slots);
+    free(c->box);
+    free(c->normal);
+    free(c->axes);
+    free(c->segments);
+    free(c->coplanar);
+    free(c->fragments);
+    free(c->aliases);
+    bvh_free(&c->bvh[0]);
+    bvh_free(&c->bvh[1]);
+}
+
+// Weld each mesh's vertices, drop triangles without area and index the
+// rest of each mesh in its own tree
+static int csg_setup(csg_t* c, const mesh_t* a, const mesh_t* b) {
+    int nv = a->vertex_count + b->vertex_count, nt = a->triangle_count + b->triangle_count;
+    int slots = 64, ret = -1;
+    while (slots < 2 * nv) slots *= 2;
+    int* map = malloc((nv ? nv : 1) * sizeof(int));
+    int* ids = malloc((nt ? nt : 1) * sizeof(int));
+    weld_slot_t* table = malloc(slots * sizeof(weld_slot_t));
+    c->seed = 0x853c49e6748fea9bULL;
+    if (!map || !ids || !table || mesh_reserve(&c->mesh, nv, nt) < 0) goto out;
+    for (int i = 0; i < slots; i++) table[i].id = -1;
+
+    for (int i = 0; i < nv; i++) {
+        vec3_t x = i < a->vertex_count ? a->vertices[i] : b->vertices[i - a->vertex_count];
+        uint64_t j = weld_hash(x.x, x.y, x.z) & (slots - 1);
+        for (; table[j].id >= 0; j = (j + 1) & (slots - 1)) {
+            if (table[j].x == x.x && table[j].y == x.y && table[j].z == x.z) break;
+        }
+        if (table[j].id < 0) table[j] = (weld_slot_t){ x.x, x.y, x.z, mesh_add_vertex(&c->mesh, x) };
+        map[i] = table[j].id;
+    }
+    c->input_points = c->mesh.vertex_count;
+
+    c->box = malloc((nt ? nt : 1) * sizeof(*c->box));
+    c->normal = malloc((nt ? nt : 1) * sizeof(vec3_t));
+    c->axes = malloc((nt ? nt : 1) * sizeof(*c->axes));
+    if (!c->box || !c->normal || !c->axes) goto out;
+    for (int side = 0; side < 2; side++) {
+        const mesh_t* m = side ? b : a;
+        int offset = side ? a->vertex_count : 0;
+        if (side) c->split = c->mesh.triangle_count;
+        for (int k = 0; k < 3; k++) {
+            c->bounds[side][k] = INFINITY;
+            c->bounds[side][k + 3] = -INFINITY;
+        }
+        for (int i = 0; i < m->triangle_count; i++) {
+            int v[3], t = c->mesh.triangle_count;
+            for (int k = 0; k < 3; k++) v[k] = map[offset + m->triangles[i][k]];
+            if (v[0] == v[1] || v[1] == v[2] || v[2] == v[0]) continue;
+            vec3_t p[3] = { csg_point(c, v[0]), csg_point(c, v[1]), csg_point(c, v[2]) };
+
+            // Project along the axis the triangle faces most, keeping the
+            // first two in which it is not a line
+            vec3_t normal = vec3_cross(vec3_sub(p[1], p[0]), vec3_sub(p[2], p[0]));
+            double e[3] = { fabs(normal.x), fabs(normal.y), fabs(normal.z) };
+            int drop = e[0] >= e[1] && e[0] >= e[2] ? 0 : e[1] >= e[2] ? 1 : 2, s = 0;
+            for (int tries = 0; tries < 3 && !s; tries++) {
+                int axis = (drop + tries) % 3, i0 = (axis + 1) % 3, i1 = (axis + 2) % 3;
+                s = orient2d(vec3_get(p[0], i0), vec3_get(p[0], i1), vec3_get(p[1], i0), vec3_get(p[1], i1),
+                             vec3_get(p[2], i0), vec3_get(p[2], i1));
+                c->axes[t][0] = s > 0 ? i0 : i1;
+                c->axes[t][1] = s > 0 ? i1 : i0;
+            }
+            if (!s) continue;
+
+            mesh_add_triangle(&c->mesh, v[0], v[1], v[2]);
+            c->normal[t] = normal;
+            for (int k = 0; k < 3; k++) {
+                double lo = fmin(fmin(vec3_get(p[0], k), vec3_get(p[1], k)), vec3_get(p[2], k));
+                double hi = fmax(fmax(vec3_get(p[0], k), vec3_get(p[1], k)), vec3_get(p[2], k));
+                c->box[t][k] = lo;
+                c->box[t][k + 3] = hi;
+                if (lo < c->bounds[side][k]) c->bounds[side][k] = lo;
+                if (hi > c->bounds[side][k + 3]) c->bounds[side][k + 3] = hi;
+            }
+            ids[t] = t;
+        }
+    }
+    if (bvh_build(&c->bvh[0], &c->box[0][0], ids, c->split) < 0 ||
+        bvh_build(&c->bvh[1], &c->box[0][0], ids + c->split, c->mesh.triangle_count - c->split) < 0) goto out;
+    ret = 0;
+
+out:
+    free(map);
+    free(ids);
+    free(table);
+    return ret;
+}
+
+// Boolean operation on two closed, consistently oriented meshes. Which
+// side of the other mesh every piece lies on is decided with exact
+// predicates on the input and constructed points; constructed points
+// themselves are rounded to doubles.
+int mesh_boolean(const mesh_t* a, const mesh_t* b, csg_op_t op, mesh_t* out) {
+    TRACE_START(t_csg);
+    memset(out, 0, sizeof(*out));
+    csg_t c = { 0 };
+    cdt_t d = { 0 };
+    int* hits = NULL;
+    int hit_count = 0, hit_capacity = 0, ret = -1;
+    if (csg_setup(&c, a, b) < 0) goto out;
+
+    // Meshes whose boxes are apart
+    const double* ba = c.bounds[0];
+    const double* bb = c.bounds[1];
+    if (!c.split || c.split == c.mesh.triangle_count || ba[0] > bb[3] || bb[0] > ba[3] ||
+        ba[1] > bb[4] || bb[1] > ba[4] || ba[2] > bb[5] || bb[2] > ba[5]) {
+        if (op != CSG_INTERSECTION) ret = mesh_append(out, a, &transform_identity);
+        if (ret == 0 && op == CSG_UNION) ret = mesh_append(out, b, &transform_identity);
+        if (op == CSG_INTERSECTION) ret = 0;
+        goto out;
+    }
+
+    for (int t = 0; t < c.split && !c.failed; t++) {
+        hit_count = 0;
+        if (bvh_query_box(&c.bvh[1], c.box[t], &hits, &hit_count, &hit_capacity) < 0) goto out;
+        for (int i = 0; i < hit_count; i++) csg_intersect_pair(&c, t, hits[i]);
+    }
+    if (c.failed) goto out;
+    if (c.segment_count) qsort(c.segments, c.segment_count, sizeof(csg_segment_t), compare_segments);
+    if (c.coplanar_count) qsort(c.coplanar, c.coplanar_count, sizeof(csg_coplanar_t), compare_coplanar);
+
+    for (int t = 0, s = 0, p = 0; t < c.mesh.triangle_count && !c.failed; t++) {
+        int s0 = s, p0 = p, first = c.fragment_count;
+        while (s < c.segment_count && c.segments[s].tri == t) s++;
+        while (p < c.coplanar_count && c.coplanar[p].tri == t) p++;
+        if (s == s0 || csg_cut_triangle(&c, &d, t, c.segments + s0, s - s0) < 0) {
+            c.fragment_count = first;
+            const int* v = c.mesh.triangles[t];
+            csg_add_fragment(&c, t, v[0], v[1], v[2], 0);
+        }
+        for (int f = first; f < c.fragment_count && p > p0; f++) {
+            csg_fragment_t* F = &c.fragments[f];
+            vec3_t x = csg_centroid(&c, F);
+            // Faces with many coplanar partners, such as a plate under a
+            // row of cones, look the candidates up by position instead
+            int* cand = NULL;
+            int n = p - p0;
+            if (n > CSG_COPLANAR_SCAN) {
+                const double at[6] = { x.x, x.y, x.z, x.x, x.y, x.z };
+                hit_count = 0;
+                if (bvh_query_box(&c.bvh[t < c.split], at, &hits, &hit_count, &hit_capacity) < 0) goto out;
+                cand = hits;
+                n = hit_count;
+            }
+            for (int i = 0; i < n; i++) {
+                int u = cand ? cand[i] : c.coplanar[p0 + i].other;
+                if (cand && !bsearch(&(csg_coplanar_t){ t, u }, c.coplanar + p0, p - p0, sizeof(csg_coplanar_t), compare_coplanar)) continue;
+                if (!csg_point_in_triangle(&c, u, x, 1)) continue;
+                F->cls = vec3_dot(c.normal[t], c.normal[u]) > 0 ? CSG_SAME : CSG_OPPOSITE;
+                break;
+            }
+        }
+    }
+    if (c.failed || csg_classify(&c) < 0 || c.failed) goto out;
+    ret = csg_output(&c, op, out);
+
+out:
+    if (ret < 0) mesh_free(out);
+    csg_free(&c);
+    cdt_free(&d);
+    free(hits);
+    TRACE_STOP(t_csg, STAGE_CSG, out->triangle_count);
+    return ret;
+}
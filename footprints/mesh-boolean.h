@@ -0,0 +1,37 @@
+/* Mesh booleans for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#ifndef PLCC_MESH_BOOLEAN_H
+#define PLCC_MESH_BOOLEAN_H
+
+#include "plcc-gen.h"
+#include "mesh.h"
+
+typedef enum {
+    CSG_UNION,
+    CSG_INTERSECTION,
+    CSG_DIFFERENCE
+} csg_op_t;
+
+// Bounding volume hierarchy over boxes (lo[3], hi[3] per item), split at
+// the median along the longest axis of the box centres
+typedef struct {
+    double lo[3], hi[3];
+    int left;                   // first of two children, -1 for a leaf
+    int first, count;           // items of a leaf
+} bvh_node_t;
+
+typedef struct {
+    bvh_node_t* nodes;
+    int node_count;
+    int* items;
+} bvh_t;
+
+int bvh_build(bvh_t* bvh, const double* boxes, const int* ids, int n);
+void bvh_free(bvh_t* bvh);
+int bvh_query_segment(const bvh_t* bvh, vec3_t p, vec3_t q, int** out, int* count, int* capacity);
+int mesh_boolean(const mesh_t* a, const mesh_t* b, csg_op_t op, mesh_t* out);
+
+#endif
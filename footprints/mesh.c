@@ -0,0 +1,343 @@
+/* Triangle meshes for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#include "mesh.h"
+
+#include <unistd.h>
+
+// Triangle meshes for the 3D models. A model is a list of parts, each with
+// its own colour; every part is a set of closed, outward facing shells.
+// Shells may overlap, as the scad sources rely on union().
+
+const transform_t transform_identity = {{ {1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0} }};
+
+transform_t transform_mul(const transform_t* a, const transform_t* b) {
+    transform_t r;
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 4; j++) {
+            r.m[i][j] = a->m[i][0] * b->m[0][j] + a->m[i][1] * b->m[1][j] + a->m[i][2] * b->m[2][j];
+        }
+        r.m[i][3] += a->m[i][3];
+    }
+    return r;
+}
+
+transform_t transform_translate(double x, double y, double z) {
+    transform_t t = transform_identity;
+    t.m[0][3] = x;
+    t.m[1][3] = y;
+    t.m[2][3] = z;
+    return t;
+}
+
+// Exact for multiples of 90 degrees, like OpenSCAD
+void sincos_deg(double deg, double* s, double* c) {
+    double q = deg / 90;
+    if (q == floor(q)) {
+        static const double sines[4] = { 0, 1, 0, -1 };
+        int n = ((int)q % 4 + 4) % 4;
+        *s = sines[n];
+        *c = sines[(n + 1) % 4];
+    } else {
+        *s = sin(deg * M_PI / 180);
+        *c = cos(deg * M_PI / 180);
+    }
+}
+
+// OpenSCAD rotate([x, y, z]): about X first, then Y, then Z
+transform_t transform_rotate(double x, double y, double z) {
+    double sx, cx, sy, cy, sz, cz;
+    sincos_deg(x, &sx, &cx);
+    sincos_deg(y, &sy, &cy);
+    sincos_deg(z, &sz, &cz);
+    transform_t rx = {{ {1, 0, 0, 0}, {0, cx, -sx, 0}, {0, sx, cx, 0} }};
+    transform_t ry = {{ {cy, 0, sy, 0}, {0, 1, 0, 0}, {-sy, 0, cy, 0} }};
+    transform_t rz = {{ {cz, -sz, 0, 0}, {sz, cz, 0, 0}, {0, 0, 1, 0} }};
+    transform_t zy = transform_mul(&rz, &ry);
+    return transform_mul(&zy, &rx);
+}
+
+vec3_t transform_apply(const transform_t* t, vec3_t v) {
+    return (vec3_t){
+        t->m[0][0] * v.x + t->m[0][1] * v.y + t->m[0][2] * v.z + t->m[0][3],
+        t->m[1][0] * v.x + t->m[1][1] * v.y + t->m[1][2] * v.z + t->m[1][3],
+        t->m[2][0] * v.x + t->m[2][1] * v.y + t->m[2][2] * v.z + t->m[2][3],
+    };
+}
+
+int mesh_reserve(mesh_t* mesh, int vertices, int triangles) {
+    if (mesh->vertex_count + vertices > mesh->vertex_capacity) {
+        int cap = mesh->vertex_capacity ? mesh->vertex_capacity : 256;
+        while (cap < mesh->vertex_count + vertices) cap *= 2;
+        vec3_t* v = realloc(mesh->vertices, cap * sizeof(vec3_t));
+        if (!v) return -1;
+        mesh->vertices = v;
+        mesh->vertex_capacity = cap;
+    }
+    if (mesh->triangle_count + triangles > mesh->triangle_capacity) {
+        int cap = mesh->triangle_capacity ? mesh->triangle_capacity : 256;
+        while (cap < mesh->triangle_count + triangles) cap *= 2;
+        int (*t)[3] = realloc(mesh->triangles, cap * sizeof(*t));
+        if (!t) return -1;
+        mesh->triangles = t;
+        mesh->triangle_capacity = cap;
+    }
+    return 0;
+}
+
+// Callers reserve first, so adding cannot fail
+int mesh_add_vertex(mesh_t* mesh, vec3_t v) {
+    mesh->vertices[mesh->vertex_count] = v;
+    return mesh->vertex_count++;
+}
+
+void mesh_add_triangle(mesh_t* mesh, int a, int b, int c) {
+    int* t = mesh->triangles[mesh->triangle_count++];
+    t[0] = a;
+    t[1] = b;
+    t[2] = c;
+}
+
+void mesh_add_quad(mesh_t* mesh, int a, int b, int c, int d) {
+    mesh_add_triangle(mesh, a, b, c);
+    mesh_add_triangle(mesh, a, c, d);
+}
+
+void mesh_free(mesh_t* mesh) {
+    free(mesh->vertices);
+    free(mesh->triangles);
+    memset(mesh, 0, sizeof(*mesh));
+}
+
+// Six times the signed volume enclosed by triangles [first, triangle_count)
+static double mesh_signed_volume(const mesh_t* mesh, int first) {
+    double volume = 0;
+    for (int i = first; i < mesh->triangle_count; i++) {
+        const int* t = mesh->triangles[i];
+        vec3_t a = mesh->vertices[t[0]], b = mesh->vertices[t[1]], c = mesh->vertices[t[2]];
+        volume += vec3_dot(a, vec3_cross(b, c));
+    }
+    return volume;
+}
+
+// Primitives are built with whatever winding is convenient and then
+// flipped as a whole if the shell they form points inwards
+void mesh_orient_shell(mesh_t* mesh, int first) {
+    if (mesh_signed_volume(mesh, first) >= 0) return;
+    for (int i = first; i < mesh->triangle_count; i++) {
+        int tmp = mesh->triangles[i][1];
+        mesh->triangles[i][1] = mesh->triangles[i][2];
+        mesh->triangles[i][2] = tmp;
+    }
+}
+
+// Convex polygon (counter-clockwise in XY) extruded from z0 to z1
+int mesh_prism(mesh_t* mesh, const point_t* poly, int n, double z0, double z1) {
+    if (mesh_reserve(mesh, 2 * n, 4 * n - 4) < 0) return -1;
+    int first = mesh->triangle_count, base = mesh->vertex_count;
+    for (int i = 0; i < n; i++) {
+        mesh_add_vertex(mesh, (vec3_t){ poly[i].x, poly[i].y, z0 });
+        mesh_add_vertex(mesh, (vec3_t){ poly[i].x, poly[i].y, z1 });
+    }
+    for (int i = 1; i + 1 < n; i++) {
+        mesh_add_triangle(mesh, base, base + 2 * (i + 1), base + 2 * i);
+        mesh_add_triangle(mesh, base + 1, base + 2 * i + 1, base + 2 * (i + 1) + 1);
+    }
+    for (int i = 0; i < n; i++) {
+        int j = (i + 1) % n;
+        mesh_add_quad(mesh, base + 2 * i, base + 2 * j, base + 2 * j + 1, base + 2 * i + 1);
+    }
+    mesh_orient_shell(mesh, first);
+    return 0;
+}
+
+int mesh_box(mesh_t* mesh, vec3_t lo, vec3_t hi) {
+    const point_t rect[4] = { {lo.x, lo.y}, {hi.x, lo.y}, {hi.x, hi.y}, {lo.x, hi.y} };
+    return mesh_prism(mesh, rect, 4, lo.z, hi.z);
+}
+
+// Square pyramid, base of half width w at z = 0, apex at (0, 0, h)
+int mesh_pyramid(mesh_t* mesh, double w, double h, const transform_t* t) {
+    if (mesh_reserve(mesh, 5, 6) < 0) return -1;
+    int first = mesh->triangle_count, base = mesh->vertex_count;
+    const double corners[4][2] = { {-w, -w}, {w, -w}, {w, w}, {-w, w} };
+    for (int i = 0; i < 4; i++) {
+        mesh_add_vertex(mesh, transform_apply(t, (vec3_t){ corners[i][0], corners[i][1], 0 }));
+    }
+    int apex = mesh_add_vertex(mesh, transform_apply(t, (vec3_t){ 0, 0, h }));
+    mesh_add_quad(mesh, base + 3, base + 2, base + 1, base);
+    for (int i = 0; i < 4; i++) {
+        mesh_add_triangle(mesh, base + i, base + (i + 1) % 4, apex);
+    }
+    mesh_orient_shell(mesh, first);
+    return 0;
+}
+
+// rotate_extrude(angle=90) of a square of side s centred at (-r, 0),
+// split into the given number of segments
+int mesh_quarter_bend(mesh_t* mesh, double r, double s, int segments, const transform_t* t) {
+    if (mesh_reserve(mesh, 4 * (segments + 1), 8 * segments + 4) < 0) return -1;
+    int first = mesh->triangle_count, base = mesh->vertex_count;
+    const double profile[4][2] = { {-r - s / 2, -s / 2}, {-r + s / 2, -s / 2}, {-r + s / 2, s / 2}, {-r - s / 2, s / 2} };
+
+    for (int i = 0; i <= segments; i++) {
+        double sa, ca;
+        sincos_deg(90.0 * i / segments, &sa, &ca);
+        for (int k = 0; k < 4; k++) {
+            vec3_t v = { profile[k][0] * ca, profile[k][0] * sa, profile[k][1] };
+            mesh_add_vertex(mesh, transform_apply(t, v));
+        }
+    }
+    for (int i = 0; i < segments; i++) {
+        int a = base + 4 * i, b = a + 4;
+        for (int k = 0; k < 4; k++) {
+            int l = (k + 1) % 4;
+            mesh_add_quad(mesh, a + k, a + l, b + l, b + k);
+        }
+    }
+    int last = base + 4 * segments;
+    mesh_add_quad(mesh, base + 3, base + 2, base + 1, base);
+    mesh_add_quad(mesh, last, last + 1, last + 2, last + 3);
+    mesh_orient_shell(mesh, first);
+    return 0;
+}
+
+// Append src transformed by t
+int mesh_append(mesh_t* dst, const mesh_t* src, const transform_t* t) {
+    if (mesh_reserve(dst, src->vertex_count, src->triangle_count) < 0) return -1;
+    int base = dst->vertex_count;
+    for (int i = 0; i < src->vertex_count; i++) {
+        mesh_add_vertex(dst, transform_apply(t, src->vertices[i]));
+    }
+    for (int i = 0; i < src->triangle_count; i++) {
+        const int* tri = src->triangles[i];
+        mesh_add_triangle(dst, base + tri[0], base + tri[1], base + tri[2]);
+    }
+    return 0;
+}
+
+model_part_t* model_add_part(model_t* model, const char* name, double r, double g, double b) {
+    if (model->part_count == MODEL_MAX_PARTS) return NULL;
+    model_part_t* part = &model->parts[model->part_count++];
+    memset(part, 0, sizeof(*part));
+    part->name = name;
+    part->color[0] = r;
+    part->color[1] = g;
+    part->color[2] = b;
+    return part;
+}
+
+void model_free(model_t* model) {
+    for (int i = 0; i < model->part_count; i++) {
+        mesh_free(&model->parts[i].mesh);
+    }
+    model->part_count = 0;
+}
+
+long model_triangle_count(const model_t* model) {
+    long n = 0;
+    for (int i = 0; i < model->part_count; i++) {
+        n += model->parts[i].mesh.triangle_count;
+    }
+    return n;
+}
+
+// ASCII STL in millimetres, as exported by OpenSCAD
+static void write_stl_model(FILE* f, const model_t* model) {
+    fprintf(f, "solid %s\n", model->name);
+    for (int p = 0; p < model->part_count; p++) {
+        const mesh_t* mesh = &model->parts[p].mesh;
+        for (int i = 0; i < mesh->triangle_count; i++) {
+            const int* t = mesh->triangles[i];
+            vec3_t a = mesh->vertices[t[0]], b = mesh->vertices[t[1]], c = mesh->vertices[t[2]];
+            vec3_t n = vec3_cross(vec3_sub(b, a), vec3_sub(c, a));
+            double len = sqrt(vec3_dot(n, n));
+            if (len > 0) {
+                n.x /= len;
+                n.y /= len;
+                n.z /= len;
+            }
+            fprintf(f, "  facet normal %g %g %g\n    outer loop\n", n.x, n.y, n.z);
+            fprintf(f, "      vertex %g %g %g\n", a.x, a.y, a.z);
+            fprintf(f, "      vertex %g %g %g\n", b.x, b.y, b.z);
+            fprintf(f, "      vertex %g %g %g\n", c.x, c.y, c.z);
+            fprintf(f, "    endloop\n  endfacet\n");
+        }
+    }
+    fprintf(f, "endsolid %s\n", model->name);
+}
+
+// VRML 2.0 in KiCad units: one IndexedFaceSet, one colour per face
+static void write_vrml_model(FILE* f, const model_t* model) {
+    const double* base_color = model->part_count ? model->parts[0].color : (const double[3]){ 0.8, 0.8, 0.8 };
+
+    fprintf(f, "#VRML V2.0 utf8\n\nShape {\n\n");
+    fprintf(f, "appearance Appearance { material Material {\n");
+    fprintf(f, "ambientIntensity 0.3\ndiffuseColor %g %g %g\n", base_color[0], base_color[1], base_color[2]);
+    fprintf(f, "specularColor 0.2 0.2 0.2\nshininess 0.3\n} }\n\n");
+    fprintf(f, "geometry IndexedFaceSet {\n\ncreaseAngle 0.5\n\ncoord Coordinate { point [\n");
+    for (int p = 0; p < model->part_count; p++) {
+        const mesh_t* mesh = &model->parts[p].mesh;
+        for (int i = 0; i < mesh->vertex_count; i++) {
+            vec3_t v = mesh->vertices[i];
+            fprintf(f, "%g %g %g,\n", v.x * VRML_SCALE, v.y * VRML_SCALE, v.z * VRML_SCALE);
+        }
+    }
+    fprintf(f, "] }\n\ncoordIndex [\n");
+    int base = 0;
+    for (int p = 0; p < model->part_count; p++) {
+        const mesh_t* mesh = &model->parts[p].mesh;
+        for (int i = 0; i < mesh->triangle_count; i++) {
+            const int* t = mesh->triangles[i];
+            fprintf(f, "%d,%d,%d,-1\n", base + t[0], base + t[1], base + t[2]);
+        }
+        base += mesh->vertex_count;
+    }
+    fprintf(f, "]\n\ncolorPerVertex FALSE\n\ncolor Color { color [\n");
+    for (int p = 0; p < model->part_count; p++) {
+        const double* c = model->parts[p].color;
+        fprintf(f, " %g %g %g,\n", c[0], c[1], c[2]);
+    }
+    fprintf(f, "] }\n\ncolorIndex [\n");
+    for (int p = 0; p < model->part_count; p++) {
+        for (int i = 0; i < model->parts[p].mesh.triangle_count; i++) {
+            fprintf(f, "%d ", p);
+        }
+    }
+    fprintf(f, "]\n\n}\n\n}\n");
+}
+
+const mesh_writer_t mesh_writers[] = {
+    {"stl", "stl", write_stl_model},
+    {"wrl", "wrl", write_vrml_model},
+};
+
+const int num_mesh_writers = sizeof(mesh_writers) / sizeof(mesh_writers[0]);
+
+const mesh_writer_t* find_mesh_writer(const char* name) {
+    for (int i = 0; i < num_mesh_writers; i++) {
+        if (strcmp(mesh_writers[i].name, name) == 0) {
+            return &mesh_writers[i];
+        }
+    }
+    return NULL;
+}
+
+// Format a model into a freshly allocated buffer
+char* render_model(const model_t* model, const mesh_writer_t* writer, size_t* size) {
+    char* data = NULL;
+    FILE* f = open_memstream(&data, size);
+    if (!f) return NULL;
+
+    TRACE_START(t_write);
+    writer->write(f, model);
+    TRACE_STOP(t_write, STAGE_WRITER, model_triangle_count(model));
+
+    if (fclose(f) != 0) {
+        free(data);
+        return NULL;
+    }
+    return data;
+}
@@ -0,0 +1,86 @@
+/* Triangle meshes for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#ifndef PLCC_MESH_H
+#define PLCC_MESH_H
+
+#include "plcc-gen.h"
+
+#define MODEL_MAX_PARTS 4
+#define VRML_SCALE 0.3937         // KiCad VRML units, as scale_factor in the Makefile
+
+typedef struct {
+    double x, y, z;
+} vec3_t;
+
+typedef struct {
+    vec3_t* vertices;
+    int vertex_count, vertex_capacity;
+    int (*triangles)[3];
+    int triangle_count, triangle_capacity;
+} mesh_t;
+
+typedef struct {
+    const char* name;
+    double color[3];
+    mesh_t mesh;
+} model_part_t;
+
+typedef struct {
+    char name[64];
+    model_part_t parts[MODEL_MAX_PARTS];
+    int part_count;
+} model_t;
+
+// Affine transform, row major 3x4
+typedef struct {
+    double m[3][4];
+} transform_t;
+
+static inline vec3_t vec3_sub(vec3_t a, vec3_t b) {
+    return (vec3_t){ a.x - b.x, a.y - b.y, a.z - b.z };
+}
+
+static inline vec3_t vec3_cross(vec3_t a, vec3_t b) {
+    return (vec3_t){ a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+
+static inline double vec3_dot(vec3_t a, vec3_t b) {
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+typedef struct {
+    const char* name;
+    const char* extension;
+    void (*write)(FILE* f, const model_t* model);
+} mesh_writer_t;
+
+extern const transform_t transform_identity;
+extern const mesh_writer_t mesh_writers[];
+extern const int num_mesh_writers;
+
+transform_t transform_mul(const transform_t* a, const transform_t* b);
+transform_t transform_translate(double x, double y, double z);
+void sincos_deg(double deg, double* s, double* c);
+transform_t transform_rotate(double x, double y, double z);
+vec3_t transform_apply(const transform_t* t, vec3_t v);
+int mesh_reserve(mesh_t* mesh, int vertices, int triangles);
+int mesh_add_vertex(mesh_t* mesh, vec3_t v);
+void mesh_add_triangle(mesh_t* mesh, int a, int b, int c);
+void mesh_add_quad(mesh_t* mesh, int a, int b, int c, int d);
+void mesh_free(mesh_t* mesh);
+void mesh_orient_shell(mesh_t* mesh, int first);
+int mesh_prism(mesh_t* mesh, const point_t* poly, int n, double z0, double z1);
+int mesh_box(mesh_t* mesh, vec3_t lo, vec3_t hi);
+int mesh_pyramid(mesh_t* mesh, double w, double h, const transform_t* t);
+int mesh_quarter_bend(mesh_t* mesh, double r, double s, int segments, const transform_t* t);
+int mesh_append(mesh_t* dst, const mesh_t* src, const transform_t* t);
+model_part_t* model_add_part(model_t* model, const char* name, double r, double g, double b);
+void model_free(model_t* model);
+long model_triangle_count(const model_t* model);
+const mesh_writer_t* find_mesh_writer(const char* name);
+char* render_model(const model_t* model, const mesh_writer_t* writer, size_t* size);
+
+#endif
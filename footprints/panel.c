@@ -0,0 +1,456 @@
+/* Test coupon panel for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#include "panel.h"
+#include "check.h"
+#include "geometry.h"
+#include "kicad.h"
+#include "preview.h"
+#include "server.h"
+
+// Tiles footprint variants onto a .kicad_pcb test board. Each entry uses
+// the request grammar of the server (part, options, spec=...) plus an
+// optional repeat count "xN". Cells are shelf packed: sorted by height
+// once, then filled row by row, so placement stays O(n log n).
+
+#define PANEL_MAX_ENTRIES 1024
+#define PANEL_MAX_ITEMS 10000
+#define PANEL_GAP 3.0             // between cells, mm
+#define PANEL_EDGE_MARGIN 5.0     // cells to board edge, mm
+#define PANEL_LABEL_HEIGHT 2.5    // below each cell, mm
+#define FANOUT_LENGTH 1.5         // pad edge to the first test point, mm
+#define FANOUT_STAGGER 1.3        // extra reach for every other pin, mm
+#define TEST_POINT_SIZE 1.0
+#define TEST_POINT_DRILL 0.5
+#define FANOUT_WIDTH 0.25
+
+typedef struct {
+    component_spec_t spec;
+    footprint_options_t opts;
+    footprint_geometry_t* geom;
+    int* pad_pins;        // net of each pad, see write_kicad_current_items
+    point_t* test_points; // one per pin when fanning out
+    bounds_t bounds;      // footprint, fanout and label
+    int count;
+} panel_entry_t;
+
+typedef struct {
+    int entry;
+    double x, y;          // top left corner of the cell
+} panel_item_t;
+
+static const sweep_param_t sweep_params[] = {
+    {"pad-width", offsetof(component_spec_t, pad_width)},
+    {"pitch", offsetof(component_spec_t, pitch)},
+    {"body-a", offsetof(component_spec_t, body.a)},
+    {"body-b", offsetof(component_spec_t, body.b)},
+    {"body-c", offsetof(component_spec_t, body.c)},
+    {"body-d", offsetof(component_spec_t, body.d)},
+};
+
+// "pad-width=-0.1:0.1:0.05" adds -0.1, -0.05, .. 0.1 to every entry
+int parse_sweep(const char* text, panel_sweep_t* sweep) {
+    const char* eq = strchr(text, '=');
+    memset(sweep, 0, sizeof(*sweep));
+    for (size_t i = 0; eq && i < sizeof(sweep_params) / sizeof(sweep_params[0]); i++) {
+        if (strncmp(text, sweep_params[i].name, eq - text) == 0 && !sweep_params[i].name[eq - text]) {
+            sweep->param = &sweep_params[i];
+        }
+    }
+    if (!sweep->param || sscanf(eq + 1, "%lf:%lf:%lf", &sweep->from, &sweep->to, &sweep->step) != 3 ||
+        sweep->step <= 0 || sweep->to < sweep->from) {
+        fprintf(stderr, "Error: invalid sweep '%s' (PARAM=FROM:TO:STEP, PARAM one of", text);
+        for (size_t i = 0; i < sizeof(sweep_params) / sizeof(sweep_params[0]); i++) {
+            fprintf(stderr, " %s", sweep_params[i].name);
+        }
+        fprintf(stderr, ")\n");
+        return -1;
+    }
+    return 0;
+}
+
+int sweep_step_count(const panel_sweep_t* sweep) {
+    return (int)floor((sweep->to - sweep->from) / sweep->step + 1e-9) + 1;
+}
+
+// Offset the swept parameter of spec by the value of step; returns it
+double apply_sweep(component_spec_t* spec, const panel_sweep_t* sweep, int step) {
+    double delta = sweep->from + step * sweep->step;
+    *(double*)((char*)spec + sweep->param->offset) += delta;
+    return delta;
+}
+
+static int compare_items_by_height(const void* a, const void* b, void* arg) {
+    const panel_entry_t* entries = arg;
+    const bounds_t* ba = &entries[((const panel_item_t*)a)->entry].bounds;
+    const bounds_t* bb = &entries[((const panel_item_t*)b)->entry].bounds;
+    double ha = ba->max_y - ba->min_y, hb = bb->max_y - bb->min_y;
+    if (ha != hb) return ha < hb ? 1 : -1;
+    return ((const panel_item_t*)a)->entry - ((const panel_item_t*)b)->entry;
+}
+
+// Pins join their own net; vias the net of the nearest pin
+static int* panel_pad_pins(const footprint_geometry_t* geom) {
+    int* pins = calloc(geom->pad_count ? geom->pad_count : 1, sizeof(int));
+    if (!pins) return NULL;
+    for (int i = 0; i < geom->pad_count; i++) {
+        const pad_t* p = &geom->pads[i];
+        if (p->number) {
+            pins[i] = p->number;
+            continue;
+        }
+        double best = 1e9;
+        for (int j = 0; j < geom->pad_count; j++) {
+            const pad_t* q = &geom->pads[j];
+            double d = hypot(q->position.x - p->position.x, q->position.y - p->position.y);
+            if (q->number && d < best) {
+                best = d;
+                pins[i] = q->number;
+            }
+        }
+    }
+    return pins;
+}
+
+// Centre of a pad's copper, which KiCad puts at the drill offset from the
+// pad position; the fanout starts here
+static point_t pad_copper(const pad_t* p) {
+    point_t c = { p->position.x + p->drill.offset.x, p->position.y + p->drill.offset.y };
+    return c;
+}
+
+// Test point straight out from the pad's outer edge, staggered so that
+// neighbouring test points do not collide at 1.27mm pitch
+static point_t fanout_point(const pad_t* p) {
+    double reach = FANOUT_LENGTH + (p->number % 2 ? 0 : FANOUT_STAGGER) + TEST_POINT_SIZE / 2;
+    point_t t = pad_copper(p);
+    if (p->size.x > p->size.y) {
+        t.x += (t.x < 0 ? -1 : 1) * (p->size.x / 2 + reach);
+    } else {
+        t.y += (t.y < 0 ? -1 : 1) * (p->size.y / 2 + reach);
+    }
+    return t;
+}
+
+static int prepare_panel_entry(panel_entry_t* e, int fanout) {
+    e->geom = generate_geometry(&e->spec, &e->opts);
+    if (!e->geom) return -1;
+    e->bounds = geometry_bounds(e->geom);
+    for (int i = 0; i < 3; i++) {
+        bounds_add(&e->bounds, e->geom->text_positions[i].x, e->geom->text_positions[i].y - 1);
+        bounds_add(&e->bounds, e->geom->text_positions[i].x, e->geom->text_positions[i].y + 1);
+    }
+
+    if (fanout) {
+        e->pad_pins = panel_pad_pins(e->geom);
+        e->test_points = calloc(e->spec.pins + 1, sizeof(point_t));
+        if (!e->pad_pins || !e->test_points) return -1;
+        for (int i = 0; i < e->geom->pad_count; i++) {
+            const pad_t* p = &e->geom->pads[i];
+            if (p->number < 1 || p->number > e->spec.pins) continue;
+            point_t t = fanout_point(p);
+            e->test_points[p->number] = t;
+            bounds_add(&e->bounds, t.x - TEST_POINT_SIZE / 2, t.y - TEST_POINT_SIZE / 2);
+            bounds_add(&e->bounds, t.x + TEST_POINT_SIZE / 2, t.y + TEST_POINT_SIZE / 2);
+        }
+    }
+    e->bounds.max_y += PANEL_LABEL_HEIGHT;
+    return 0;
+}
+
+static void write_panel_header(FILE* f, double width, double height, const panel_entry_t* entries,
+                               const panel_item_t* items, int item_count) {
+    static const char* layers[] = {
+        "(0 \"F.Cu\" signal)", "(31 \"B.Cu\" signal)",
+        "(32 \"B.Adhes\" user \"B.Adhesive\")", "(33 \"F.Adhes\" user \"F.Adhesive\")",
+        "(34 \"B.Paste\" user)", "(35 \"F.Paste\" user)",
+        "(36 \"B.SilkS\" user \"B.Silkscreen\")", "(37 \"F.SilkS\" user \"F.Silkscreen\")",
+        "(38 \"B.Mask\" user)", "(39 \"F.Mask\" user)",
+        "(40 \"Dwgs.User\" user \"User.Drawings\")", "(41 \"Cmts.User\" user \"User.Comments\")",
+        "(44 \"Edge.Cuts\" user)", "(45 \"Margin\" user)",
+        "(46 \"B.CrtYd\" user \"B.Courtyard\")", "(47 \"F.CrtYd\" user \"F.Courtyard\")",
+        "(48 \"B.Fab\" user)", "(49 \"F.Fab\" user)",
+    };
+
+    fprintf(f, "(kicad_pcb\n\t(version %d)\n\t(generator \"pcbnew\")\n\t(generator_version \"8.0\")\n",
+            KICAD_FORMAT_VERSION);
+    fprintf(f, "\t(general\n\t\t(thickness 1.6)\n\t\t(legacy_teardrops no)\n\t)\n");
+    fprintf(f, "\t(paper \"User\" %.0f %.0f)\n", ceil(width + 20), ceil(height + 20));
+    fprintf(f, "\t(title_block\n\t\t(title \"PLCC plug test coupon\")\n\t)\n");
+    fprintf(f, "\t(layers\n");
+    for (size_t i = 0; i < sizeof(layers) / sizeof(layers[0]); i++) {
+        fprintf(f, "\t\t%s\n", layers[i]);
+    }
+    fprintf(f, "\t)\n");
+    fprintf(f, "\t(setup\n\t\t(pad_to_mask_clearance 0)\n\t\t(allow_soldermask_bridges_in_footprints no)\n\t)\n");
+
+    // Nets are numbered in placement order, see write_panel
+    fprintf(f, "\t(net 0 \"\")\n");
+    int net = 1;
+    for (int i = 0; i < item_count; i++) {
+        const panel_entry_t* e = &entries[items[i].entry];
+        if (!e->pad_pins) continue;
+        for (int pin = 1; pin <= e->spec.pins; pin++) {
+            fprintf(f, "\t(net %d \"/U%d-%d\")\n", net++, i + 1, pin);
+        }
+    }
+}
+
+// Footprints go through the library writer, so the board is in the same
+// format and its UUIDs are just as stable: one sequence for the whole
+// board, in placement order
+static void write_panel(FILE* f, panel_entry_t* entries, panel_item_t* items, int item_count,
+                        double width, double height) {
+    kicad_ids_t ids = { hash_bytes("PLCCplug panel", 14), 0 };
+    char id[40], x[32], y[32], x2[32], y2[32];
+
+    write_panel_header(f, width, height, entries, items, item_count);
+
+    int net_base = 1;
+    for (int i = 0; i < item_count; i++) {
+        panel_entry_t* e = &entries[items[i].entry];
+        char reference[16];
+        snprintf(reference, sizeof(reference), "U%d", i + 1);
+
+        // Footprint origin relative to the cell corner
+        double ox = items[i].x - e->bounds.min_x;
+        double oy = items[i].y - e->bounds.min_y;
+
+        fprintf(f, "\t(footprint \"PLCCplug:%s\"\n\t\t(layer \"F.Cu\")\n", e->spec.name);
+        fprintf(f, "\t\t(uuid \"%s\")\n", kicad_uuid(&ids, id, sizeof(id)));
+        fprintf(f, "\t\t(at %s %s)\n", kicad_number(x, sizeof(x), ox), kicad_number(y, sizeof(y), oy));
+        write_kicad_current_items(f, &ids, "\t", e->geom, &e->spec, &e->opts, reference, e->pad_pins, net_base);
+        fprintf(f, "\t)\n");
+
+        fprintf(f, "\t(gr_text \"%s%s%s\"\n", e->spec.name, e->opts.double_sided ? "" : " SS",
+                e->opts.via_outside ? " VO" : "");
+        fprintf(f, "\t\t(at %s %s 0)\n\t\t(layer \"F.SilkS\")\n\t\t(uuid \"%s\")\n",
+                kicad_number(x, sizeof(x), ox + (e->bounds.min_x + e->bounds.max_x) / 2),
+                kicad_number(y, sizeof(y), oy + e->bounds.max_y - PANEL_LABEL_HEIGHT / 2),
+                kicad_uuid(&ids, id, sizeof(id)));
+        write_kicad_effects(f, "", 1.0);
+        fprintf(f, "\t)\n");
+
+        if (e->pad_pins) {
+            for (int p = 0; p < e->geom->pad_count; p++) {
+                const pad_t* pad = &e->geom->pads[p];
+                if (pad->number < 1 || pad->number > e->spec.pins) continue;
+                point_t s = pad_copper(pad), t = e->test_points[pad->number];
+                int net = net_base + pad->number - 1;
+                fprintf(f, "\t(segment\n\t\t(start %s %s)\n\t\t(end %s %s)\n\t\t(width %g)\n",
+                        kicad_number(x, sizeof(x), ox + s.x), kicad_number(y, sizeof(y), oy + s.y),
+                        kicad_number(x2, sizeof(x2), ox + t.x), kicad_number(y2, sizeof(y2), oy + t.y), FANOUT_WIDTH);
+                fprintf(f, "\t\t(layer \"F.Cu\")\n\t\t(net %d)\n\t\t(uuid \"%s\")\n\t)\n", net, kicad_uuid(&ids, id, sizeof(id)));
+                fprintf(f, "\t(via\n\t\t(at %s %s)\n\t\t(size %g)\n\t\t(drill %g)\n\t\t(layers \"F.Cu\" \"B.Cu\")\n",
+                        x2, y2, TEST_POINT_SIZE, TEST_POINT_DRILL);
+                fprintf(f, "\t\t(net %d)\n\t\t(uuid \"%s\")\n\t)\n", net, kicad_uuid(&ids, id, sizeof(id)));
+            }
+            net_base += e->spec.pins;
+        }
+    }
+
+    // Board outline
+    const point_t corners[4] = { {0, 0}, {width, 0}, {width, height}, {0, height} };
+    for (int i = 0; i < 4; i++) {
+        point_t a = corners[i], b = corners[(i + 1) % 4];
+        fprintf(f, "\t(gr_line\n\t\t(start %s %s)\n\t\t(end %s %s)\n",
+                kicad_number(x, sizeof(x), a.x + 10), kicad_number(y, sizeof(y), a.y + 10),
+                kicad_number(x2, sizeof(x2), b.x + 10), kicad_number(y2, sizeof(y2), b.y + 10));
+        fprintf(f, "\t\t(stroke\n\t\t\t(width 0.1)\n\t\t\t(type default)\n\t\t)\n\t\t(layer \"Edge.Cuts\")\n\t\t(uuid \"%s\")\n\t)\n",
+                kicad_uuid(&ids, id, sizeof(id)));
+    }
+    fprintf(f, ")\n");
+}
+
+// Shelf packing; returns the panel size including the edge margin
+static void place_panel_items(panel_entry_t* entries, panel_item_t* items, int item_count,
+                              double* width, double* height) {
+    double area = 0, widest = 0;
+    for (int i = 0; i < item_count; i++) {
+        const bounds_t* b = &entries[items[i].entry].bounds;
+        double w = b->max_x - b->min_x + PANEL_GAP, h = b->max_y - b->min_y + PANEL_GAP;
+        area += w * h;
+        if (w > widest) widest = w;
+    }
+    double row_limit = fmax(widest, sqrt(area) * 1.2);
+
+    qsort_r(items, item_count, sizeof(panel_item_t), compare_items_by_height, entries);
+
+    // Board origin at (10, 10) so the panel sits on the sheet
+    double x = 0, y = 0, shelf = 0, used_w = 0;
+    for (int i = 0; i < item_count; i++) {
+        const bounds_t* b = &entries[items[i].entry].bounds;
+        double w = b->max_x - b->min_x, h = b->max_y - b->min_y;
+        if (x > 0 && x + w > row_limit) {
+            y += shelf + PANEL_GAP;
+            x = 0;
+            shelf = 0;
+        }
+        items[i].x = 10 + PANEL_EDGE_MARGIN + x;
+        items[i].y = 10 + PANEL_EDGE_MARGIN + y;
+        x += w + PANEL_GAP;
+        if (h > shelf) shelf = h;
+        if (x - PANEL_GAP > used_w) used_w = x - PANEL_GAP;
+    }
+    *width = used_w + 2 * PANEL_EDGE_MARGIN;
+    *height = y + shelf + 2 * PANEL_EDGE_MARGIN;
+}
+
+// Remove an "xN" repeat count from line and return it
+static int panel_entry_count(char* line) {
+    int count = 1;
+    size_t len = 0;
+    char* save = NULL;
+    char copy[REQUEST_MAX];
+    snprintf(copy, sizeof(copy), "%s", line);
+    for (char* tok = strtok_r(copy, " \t\r\n", &save); tok; tok = strtok_r(NULL, " \t\r\n", &save)) {
+        char* end;
+        if (tok[0] == 'x' && isdigit((unsigned char)tok[1])) {
+            long n = strtol(tok + 1, &end, 10);
+            if (*end == '\0') {
+                count = n > 0 && n <= PANEL_MAX_ITEMS ? (int)n : 0;
+                continue;
+            }
+        }
+        len += snprintf(line + len, REQUEST_MAX - len, "%s%s", len ? " " : "", tok);
+    }
+    line[len] = '\0';
+    return count;
+}
+
+static int add_panel_entry(panel_entry_t* entries, int* count, char* text, const panel_sweep_t* sweep) {
+    char line[REQUEST_MAX], err[256];
+    request_t req;
+    snprintf(line, sizeof(line), "%s", text);
+    int repeat = panel_entry_count(line);
+    if (parse_request(line, &req, err, sizeof(err)) < 0 || req.format != OUTPUT_FOOTPRINT) {
+        fprintf(stderr, "Error: panel entry '%s': %s\n", text, req.format != OUTPUT_FOOTPRINT ? "not a footprint" : err);
+        return -1;
+    }
+    if (repeat < 1) {
+        fprintf(stderr, "Error: panel entry '%s': invalid count\n", text);
+        return -1;
+    }
+
+    int steps = sweep ? sweep_step_count(sweep) : 1;
+    for (int s = 0; s < steps; s++) {
+        if (*count == PANEL_MAX_ENTRIES) {
+            fprintf(stderr, "Error: more than %d panel entries\n", PANEL_MAX_ENTRIES);
+            return -1;
+        }
+        panel_entry_t* e = &entries[(*count)++];
+        memset(e, 0, sizeof(*e));
+        e->spec = req.spec;
+        e->opts = req.opts;
+        e->count = repeat;
+        if (sweep) {
+            double delta = apply_sweep(&e->spec, sweep, s);
+            char name[sizeof(e->spec.name)];
+            snprintf(name, sizeof(name), "%.20s_%s%+.3f", req.spec.name, sweep->param->name, delta);
+            memcpy(e->spec.name, name, sizeof(name));
+            if (!validate_spec(&e->spec)) {
+                fprintf(stderr, "Error: %s: sweep leaves an invalid spec\n", e->spec.name);
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+// Entries from argv, or from list_path (one per line, # comments), or the
+// whole catalog in all four variants
+int run_panel(const char* outfile, char** args, int nargs, const char* list_path,
+              const char* sweep_text, int fanout) {
+    panel_entry_t* entries = calloc(PANEL_MAX_ENTRIES, sizeof(panel_entry_t));
+    panel_item_t* items = NULL;
+    panel_sweep_t sweep_storage, *sweep = NULL;
+    int entry_count = 0, item_count = 0, ret = 1;
+
+    if (!entries) goto out;
+    if (sweep_text) {
+        if (parse_sweep(sweep_text, &sweep_storage) < 0) goto out;
+        sweep = &sweep_storage;
+    }
+
+    if (list_path) {
+        FILE* list = fopen(list_path, "r");
+        if (!list) {
+            fprintf(stderr, "Error: %s: %s\n", list_path, strerror(errno));
+            goto out;
+        }
+        char line[REQUEST_MAX];
+        int bad = 0;
+        while (!bad && fgets(line, sizeof(line), list)) {
+            char* p = line + strspn(line, " \t");
+            if (*p == '#' || *p == '\n' || *p == '\0') continue;
+            line[strcspn(line, "\r\n#")] = '\0';
+            bad = add_panel_entry(entries, &entry_count, line, sweep) < 0;
+        }
+        fclose(list);
+        if (bad) goto out;
+    }
+    for (int i = 0; i < nargs; i++) {
+        if (add_panel_entry(entries, &entry_count, args[i], sweep) < 0) goto out;
+    }
+    if (!list_path && nargs == 0) {
+        for (int s = 0; s < num_component_specs; s++) {
+            for (size_t v = 0; v < sizeof(check_variants) / sizeof(check_variants[0]); v++) {
+                char line[128];
+                snprintf(line, sizeof(line), "%.31s %s %s", component_specs[s].name,
+                         check_variants[v].double_sided ? "double-sided" : "single-sided",
+                         check_variants[v].via_outside ? "via-outside" : "via-inside");
+                if (add_panel_entry(entries, &entry_count, line, sweep) < 0) goto out;
+            }
+        }
+    }
+
+    // Geometry once per entry, however often it is placed
+    for (int i = 0; i < entry_count; i++) {
+        if (prepare_panel_entry(&entries[i], fanout) < 0) {
+            fprintf(stderr, "Error: %s: failed to generate geometry\n", entries[i].spec.name);
+            goto out;
+        }
+        item_count += entries[i].count;
+    }
+    if (item_count > PANEL_MAX_ITEMS) {
+        fprintf(stderr, "Error: %d footprints, at most %d fit a panel\n", item_count, PANEL_MAX_ITEMS);
+        goto out;
+    }
+    items = calloc(item_count ? item_count : 1, sizeof(panel_item_t));
+    if (!items) goto out;
+    for (int i = 0, n = 0; i < entry_count; i++) {
+        for (int k = 0; k < entries[i].count; k++) {
+            items[n++].entry = i;
+        }
+    }
+
+    double width, height;
+    TRACE_START(t_place);
+    place_panel_items(entries, items, item_count, &width, &height);
+    TRACE_STOP(t_place, STAGE_GEOMETRY, item_count);
+
+    FILE* f = outfile ? fopen(outfile, "w") : stdout;
+    if (!f) {
+        perror("Error opening output file");
+        goto out;
+    }
+    TRACE_START(t_write);
+    write_panel(f, entries, items, item_count, width, height);
+    TRACE_STOP(t_write, STAGE_WRITER, item_count);
+    ret = ferror(f) != 0;
+    if (outfile && fclose(f) != 0) ret = 1;
+    if (ret) fprintf(stderr, "Error: failed to write panel\n");
+    else fprintf(stderr, "%d footprints on a %.1f x %.1f mm panel\n", item_count, width, height);
+
+out:
+    for (int i = 0; entries && i < entry_count; i++) {
+        free_geometry(entries[i].geom);
+        free(entries[i].pad_pins);
+        free(entries[i].test_points);
+    }
+    free(entries);
+    free(items);
+    return ret;
+}
@@ -0,0 +1,27 @@
+/* Test coupon panel for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#ifndef PLCC_PANEL_H
+#define PLCC_PANEL_H
+
+#include "plcc-gen.h"
+
+typedef struct {
+    const char* name;
+    size_t offset;
+} sweep_param_t;
+
+typedef struct {
+    const sweep_param_t* param;
+    double from, to, step;
+} panel_sweep_t;
+
+int parse_sweep(const char* text, panel_sweep_t* sweep);
+int sweep_step_count(const panel_sweep_t* sweep);
+double apply_sweep(component_spec_t* spec, const panel_sweep_t* sweep, int step);
+int run_panel(const char* outfile, char** args, int nargs, const char* list_path,
+              const char* sweep_text, int fanout);
+
+#endif
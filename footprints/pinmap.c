@@ -0,0 +1,374 @@
+/* Pin maps for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#include "pinmap.h"
+#include "check.h"
+#include "geometry.h"
+#include "preview-tools.h"
+#include "server.h"
+
+// Adapter and interposer boards wire the pins of a plug footprint to those
+// of a target footprint. Either side is a server request ("84 single-sided",
+// spec=...) or a .kicad_mod file. Catalog parts are located by pin_locate;
+// footprints from files get a table from pin number to pad. Both make a
+// pin lookup constant time, so a map costs O(pins) however it is ordered.
+
+#define PIN_MAP_NET_MAX 64
+
+typedef enum {
+    PIN_MAP_CSV,
+    PIN_MAP_JSON,
+    PIN_MAP_KICAD_NET
+} pin_map_format_t;
+
+static const char* const pin_map_formats[] = { "csv", "json", "kicad-net" };
+static const char* const pin_side_names[] = { "top", "right", "bottom", "left", "" };
+
+typedef struct {
+    char footprint[96];       // LIBRARY:NAME, as the netlist references it
+    char value[64];
+    component_spec_t spec;    // parts given as requests
+    int parametric;
+    footprint_geometry_t* geom;  // footprints read from a file
+    int* pads;                // pad index by pin number, -1 where there is none
+    int max_pin;
+} pin_map_t;
+
+typedef struct {
+    int plug, target;         // pin numbers
+    int net;
+} pin_connection_t;
+
+static int pin_map_lookup(const pin_map_t* m, int number, pin_info_t* pin) {
+    if (m->parametric) return pin_locate(&m->spec, number, pin);
+    if (number < 1 || number > m->max_pin || m->pads[number] < 0) return -1;
+    const pad_t* pad = &m->geom->pads[m->pads[number]];
+    pin->number = number;
+    pin->side = SIDE_NONE;
+    pin->index = -1;
+    pin->position.x = pad->position.x + pad->drill.offset.x;
+    pin->position.y = pad->position.y + pad->drill.offset.y;
+    pin->size = pad->size;
+    return 0;
+}
+
+static int pin_map_pins(const pin_map_t* m) {
+    return m->parametric ? m->spec.pins : m->max_pin;
+}
+
+static int pin_map_open_file(pin_map_t* m, const char* path) {
+    size_t size;
+    char* data = read_file(path, &size);
+    if (!data) {
+        fprintf(stderr, "Error: %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    m->geom = load_kicad_footprint(data, size);
+    free(data);
+    if (!m->geom) {
+        fprintf(stderr, "Error: %s: cannot parse footprint\n", path);
+        return -1;
+    }
+
+    for (int i = 0; i < m->geom->pad_count; i++) {
+        if (m->geom->pads[i].number > m->max_pin) m->max_pin = m->geom->pads[i].number;
+    }
+    m->pads = malloc((m->max_pin + 1) * sizeof(int));
+    if (!m->pads) return -1;
+    for (int i = 0; i <= m->max_pin; i++) m->pads[i] = -1;
+    // Vias and pads without a numeric name have number 0 and stay unmapped
+    for (int i = 0; i < m->geom->pad_count; i++) {
+        int n = m->geom->pads[i].number;
+        if (n > 0 && m->pads[n] < 0) m->pads[n] = i;
+    }
+
+    // ../Lib.pretty/Name.kicad_mod is Lib:Name
+    const char* base = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+    int name_len = (int)strcspn(base, ".");
+    const char* lib = base;
+    int lib_len = 0;
+    if (base - path > 7 && strncmp(base - 8, ".pretty/", 8) == 0) {
+        const char* end = base - 8;
+        lib = end;
+        while (lib > path && lib[-1] != '/') lib--;
+        lib_len = (int)(end - lib);
+    }
+    snprintf(m->value, sizeof(m->value), "%.*s", name_len, base);
+    snprintf(m->footprint, sizeof(m->footprint), "%.*s%s%.*s", lib_len, lib, lib_len ? ":" : "", name_len, base);
+    return 0;
+}
+
+static int pin_map_open(pin_map_t* m, const char* text) {
+    memset(m, 0, sizeof(*m));
+    size_t len = strlen(text);
+    if (len > 10 && strcmp(text + len - 10, ".kicad_mod") == 0) return pin_map_open_file(m, text);
+
+    char line[REQUEST_MAX], err[256];
+    request_t req;
+    snprintf(line, sizeof(line), "%s", text);
+    if (parse_request(line, &req, err, sizeof(err)) < 0) {
+        fprintf(stderr, "Error: '%s': %s\n", text, err);
+        return -1;
+    }
+    m->spec = req.spec;
+    m->parametric = 1;
+    const char* suffix = "";
+    for (size_t v = 0; v < sizeof(check_variants) / sizeof(check_variants[0]); v++) {
+        if (check_variants[v].double_sided == req.opts.double_sided && check_variants[v].via_outside == req.opts.via_outside) {
+            suffix = check_variants[v].suffix;
+        }
+    }
+    snprintf(m->value, sizeof(m->value), "%s", m->spec.name);
+    snprintf(m->footprint, sizeof(m->footprint), "PLCCplug:%s%s", m->spec.name, suffix);
+    return 0;
+}
+
+static void pin_map_close(pin_map_t* m) {
+    free_geometry(m->geom);
+    free(m->pads);
+}
+
+// Net names end up quoted in every output format
+static int valid_net_name(const char* name) {
+    if (!*name || strlen(name) >= PIN_MAP_NET_MAX) return 0;
+    for (const char* p = name; *p; p++) {
+        if (!isgraph((unsigned char)*p) || *p == '"' || *p == '\\') return 0;
+    }
+    return 1;
+}
+
+// A pin belongs to one net; listing it again is fine as long as the net
+// is the same, which is how several pins are tied together
+static int pin_map_assign(int* nets, int pin, int net, const char* side, char (*names)[PIN_MAP_NET_MAX]) {
+    if (nets[pin] >= 0 && nets[pin] != net) {
+        fprintf(stderr, "Error: %s pin %d is on nets %s and %s\n", side, pin, names[nets[pin]], names[net]);
+        return -1;
+    }
+    nets[pin] = net;
+    return 0;
+}
+
+static void write_pin_map_csv(FILE* f, const pin_map_t* plug, const pin_map_t* target,
+                              const pin_connection_t* conns, int count, char (*names)[PIN_MAP_NET_MAX]) {
+    fprintf(f, "net,plug_pin,plug_side,plug_index,plug_x,plug_y,target_pin,target_side,target_index,target_x,target_y\n");
+    for (int i = 0; i < count; i++) {
+        pin_info_t p, t;
+        pin_map_lookup(plug, conns[i].plug, &p);
+        pin_map_lookup(target, conns[i].target, &t);
+        fprintf(f, "%s", names[conns[i].net]);
+        const pin_info_t* sides[2] = { &p, &t };
+        for (int k = 0; k < 2; k++) {
+            const pin_info_t* s = sides[k];
+            fprintf(f, ",%d,%s,", s->number, pin_side_names[s->side]);
+            if (s->index >= 0) fprintf(f, "%d", s->index);
+            fprintf(f, ",%.3f,%.3f", s->position.x, s->position.y);
+        }
+        fprintf(f, "\n");
+    }
+}
+
+static void write_pin_map_json(FILE* f, const pin_map_t* plug, const pin_map_t* target,
+                               const pin_connection_t* conns, int count, char (*names)[PIN_MAP_NET_MAX]) {
+    for (int i = 0; i < count; i++) {
+        pin_info_t p, t;
+        pin_map_lookup(plug, conns[i].plug, &p);
+        pin_map_lookup(target, conns[i].target, &t);
+        fprintf(f, "{\"net\":\"%s\"", names[conns[i].net]);
+        const pin_info_t* sides[2] = { &p, &t };
+        for (int k = 0; k < 2; k++) {
+            const pin_info_t* s = sides[k];
+            const char* key = k ? "target" : "plug";
+            fprintf(f, ",\"%s_pin\":%d", key, s->number);
+            if (s->side == SIDE_NONE) fprintf(f, ",\"%s_side\":null,\"%s_index\":null", key, key);
+            else fprintf(f, ",\"%s_side\":\"%s\",\"%s_index\":%d", key, pin_side_names[s->side], key, s->index);
+            fprintf(f, ",\"%s_x\":%.3f,\"%s_y\":%.3f", key, s->position.x, key, s->position.y);
+        }
+        fprintf(f, "}\n");
+    }
+}
+
+// KiCad netlist (export version E), for Update PCB from netlist in pcbnew.
+// The plug is P1 and the target J1.
+static int write_pin_map_netlist(FILE* f, const pin_map_t* plug, const pin_map_t* target, const char* source,
+                                 const pin_connection_t* conns, int count, char (*names)[PIN_MAP_NET_MAX], int net_count) {
+    // Connections grouped by net, in order of first use
+    int* first = malloc((net_count + 1) * sizeof(int));
+    int* order = malloc((count ? count : 1) * sizeof(int));
+    uint8_t* plug_done = calloc(pin_map_pins(plug) + 1, 1);
+    uint8_t* target_done = calloc(pin_map_pins(target) + 1, 1);
+    if (!first || !order || !plug_done || !target_done) {
+        free(first);
+        free(order);
+        free(plug_done);
+        free(target_done);
+        return -1;
+    }
+    memset(first, 0, (net_count + 1) * sizeof(int));
+    for (int i = 0; i < count; i++) first[conns[i].net + 1]++;
+    for (int n = 0; n < net_count; n++) first[n + 1] += first[n];
+    for (int i = 0; i < count; i++) order[first[conns[i].net]++] = i;
+    for (int n = net_count; n > 0; n--) first[n] = first[n - 1];
+    first[0] = 0;
+
+    fprintf(f, "(export (version \"E\")\n");
+    fprintf(f, "  (design\n    (source \"%s\")\n    (tool \"plcc-gen\"))\n", source);
+    fprintf(f, "  (components\n");
+    fprintf(f, "    (comp (ref \"P1\")\n      (value \"%s\")\n      (footprint \"%s\"))\n", plug->value, plug->footprint);
+    fprintf(f, "    (comp (ref \"J1\")\n      (value \"%s\")\n      (footprint \"%s\")))\n", target->value, target->footprint);
+    fprintf(f, "  (nets");
+    for (int n = 0; n < net_count; n++) {
+        fprintf(f, "\n    (net (code \"%d\") (name \"%s\")", n + 1, names[n]);
+        for (int k = first[n]; k < first[n + 1]; k++) {
+            const pin_connection_t* c = &conns[order[k]];
+            if (!plug_done[c->plug]) fprintf(f, "\n      (node (ref \"P1\") (pin \"%d\"))", c->plug);
+            if (!target_done[c->target]) fprintf(f, "\n      (node (ref \"J1\") (pin \"%d\"))", c->target);
+            plug_done[c->plug] = target_done[c->target] = 1;
+        }
+        fprintf(f, ")");
+    }
+    fprintf(f, "))\n");
+
+    free(first);
+    free(order);
+    free(plug_done);
+    free(target_done);
+    return 0;
+}
+
+typedef struct {
+    pin_map_t plug, target;
+    pin_connection_t* conns;
+    char (*names)[PIN_MAP_NET_MAX];
+    int* plug_nets;           // net of every pin, -1 while unconnected
+    int* target_nets;
+    int count, net_count;
+} pin_mapping_t;
+
+static int pin_mapping_add(pin_mapping_t* m, int p, int t, const char* net) {
+    char name[PIN_MAP_NET_MAX];
+    if (*net) snprintf(name, sizeof(name), "%s", net);
+    else snprintf(name, sizeof(name), "/P1-%d", p);
+
+    int id = 0;
+    while (id < m->net_count && strcmp(m->names[id], name) != 0) id++;
+    if (id == m->net_count) memcpy(m->names[m->net_count++], name, sizeof(name));
+    if (pin_map_assign(m->plug_nets, p, id, "plug", m->names) < 0 ||
+        pin_map_assign(m->target_nets, t, id, "target", m->names) < 0) return -1;
+    m->conns[m->count++] = (pin_connection_t){ p, t, id };
+    return 0;
+}
+
+// "PLUG_PIN TARGET_PIN [NET]" per line, blanks or commas between, # comments
+static int read_pin_mapping(pin_mapping_t* m, const char* path, char* data, size_t size) {
+    int line_no = 0;
+    for (char* line = data; line < data + size; ) {
+        char* end = memchr(line, '\n', data + size - line);
+        if (!end) end = data + size;
+        *end = '\0';
+        char* next = end + 1;
+        line_no++;
+        line[strcspn(line, "#\r")] = '\0';
+
+        char* fields[4];
+        char* save = NULL;
+        int n = 0;
+        for (char* tok = strtok_r(line, " \t,", &save); tok && n < 4; tok = strtok_r(NULL, " \t,", &save)) {
+            fields[n++] = tok;
+        }
+        line = next;
+        if (n == 0) continue;
+
+        char *end_p = "", *end_t = "";
+        int p = n >= 2 ? (int)strtol(fields[0], &end_p, 10) : 0;
+        int t = n >= 2 ? (int)strtol(fields[1], &end_t, 10) : 0;
+        if (n < 2 || n > 3 || *end_p || *end_t || (n == 3 && !valid_net_name(fields[2]))) {
+            fprintf(stderr, "Error: %s:%d: expected PLUG_PIN TARGET_PIN [NET]\n", path, line_no);
+            return -1;
+        }
+        pin_info_t info;
+        const pin_map_t* missing = pin_map_lookup(&m->plug, p, &info) < 0 ? &m->plug :
+                                   pin_map_lookup(&m->target, t, &info) < 0 ? &m->target : NULL;
+        if (missing) {
+            fprintf(stderr, "Error: %s:%d: %s has no pin %d\n", path, line_no, missing->value, missing == &m->plug ? p : t);
+            return -1;
+        }
+        if (pin_mapping_add(m, p, t, n == 3 ? fields[2] : "") < 0) return -1;
+    }
+    return 0;
+}
+
+// Connections from map_path, or pin n to pin n for every pin both sides have
+int run_pin_map(const char* plug_text, const char* target_text, const char* map_path,
+                const char* format_name, const char* outfile) {
+    pin_mapping_t m;
+    char* data = NULL;
+    size_t size = 0;
+    int ret = 1;
+
+    int format = -1;
+    for (size_t i = 0; i < sizeof(pin_map_formats) / sizeof(pin_map_formats[0]); i++) {
+        if (strcmp(format_name, pin_map_formats[i]) == 0) format = i;
+    }
+    if (format < 0) {
+        fprintf(stderr, "Error: unknown pin map format '%s' (csv, json, kicad-net)\n", format_name);
+        return 1;
+    }
+    memset(&m, 0, sizeof(m));
+    if (pin_map_open(&m.plug, plug_text) < 0) goto out;
+    if (pin_map_open(&m.target, target_text ? target_text : plug_text) < 0) goto out;
+
+    int plug_pins = pin_map_pins(&m.plug), target_pins = pin_map_pins(&m.target);
+    int capacity = plug_pins;
+    if (map_path) {
+        if (!(data = read_file(map_path, &size))) {
+            fprintf(stderr, "Error: %s: %s\n", map_path, strerror(errno));
+            goto out;
+        }
+        capacity = 1;
+        for (size_t i = 0; i < size; i++) capacity += data[i] == '\n';
+    }
+    m.conns = malloc((capacity ? capacity : 1) * sizeof(*m.conns));
+    m.names = malloc((capacity ? capacity : 1) * sizeof(*m.names));
+    m.plug_nets = malloc((plug_pins + 1) * sizeof(int));
+    m.target_nets = malloc((target_pins + 1) * sizeof(int));
+    if (!m.conns || !m.names || !m.plug_nets || !m.target_nets) goto out;
+    for (int i = 0; i <= plug_pins; i++) m.plug_nets[i] = -1;
+    for (int i = 0; i <= target_pins; i++) m.target_nets[i] = -1;
+
+    if (map_path) {
+        if (read_pin_mapping(&m, map_path, data, size) < 0) goto out;
+    } else {
+        for (int pin = 1; pin <= plug_pins; pin++) {
+            pin_info_t info;
+            if (pin_map_lookup(&m.target, pin, &info) < 0) continue;
+            if (pin_mapping_add(&m, pin, pin, "") < 0) goto out;
+        }
+    }
+
+    FILE* f = outfile ? fopen(outfile, "w") : stdout;
+    if (!f) {
+        perror("Error opening output file");
+        goto out;
+    }
+    int err = 0;
+    if (format == PIN_MAP_CSV) write_pin_map_csv(f, &m.plug, &m.target, m.conns, m.count, m.names);
+    else if (format == PIN_MAP_JSON) write_pin_map_json(f, &m.plug, &m.target, m.conns, m.count, m.names);
+    else err = write_pin_map_netlist(f, &m.plug, &m.target, map_path ? map_path : "pin n to pin n",
+                                     m.conns, m.count, m.names, m.net_count);
+    ret = err || ferror(f) != 0;
+    if (outfile && fclose(f) != 0) ret = 1;
+    if (ret) fprintf(stderr, "Error: failed to write pin map\n");
+    else fprintf(stderr, "%d connections on %d nets\n", m.count, m.net_count);
+
+out:
+    pin_map_close(&m.plug);
+    pin_map_close(&m.target);
+    free(data);
+    free(m.conns);
+    free(m.names);
+    free(m.plug_nets);
+    free(m.target_nets);
+    return ret;
+}
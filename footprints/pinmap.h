@@ -0,0 +1,14 @@
+/* Pin maps for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#ifndef PLCC_PINMAP_H
+#define PLCC_PINMAP_H
+
+#include "plcc-gen.h"
+
+int run_pin_map(const char* plug_text, const char* target_text, const char* map_path,
+                const char* format_name, const char* outfile);
+
+#endif
@@ -1,646 +1,209 @@
+
 /* KiCAD footprint generator for APW9328 PLCC plugs - Version 2
  * Complete rewrite with data-driven geometry engine
  * GPL-2
  * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
  */
 
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <getopt.h>
-#include <math.h>
-#include <time.h>
-
-// ============================================================================
-// CORE DATA STRUCTURES
-// ============================================================================
-
-typedef struct {
-    double x, y;
-} point_t;
-
-typedef struct {
-    point_t start, end;
-    double width;
-    char layer[32];
-} line_t;
-
-typedef enum {
-    PAD_SMD,
-    PAD_THROUGHHOLE
-} pad_type_t;
-
-typedef struct {
-    double diameter;
-    point_t offset;
-} drill_info_t;
-
-typedef struct {
-    int number;
-    point_t position;
-    point_t size;
-    pad_type_t type;
-    drill_info_t drill;
-    char layers[64];
-} pad_t;
-
-typedef struct {
-    double a, b, c, d;  // Body dimensions from datasheet
-} dimensions_t;
-
-typedef struct {
-    char name[32];
-    int pins;
-    int pins_x, pins_y;
-    double pitch;
-    dimensions_t body;
-    double pad_width;
-    double offset_x, offset_y; 
-} component_spec_t;
-
-typedef struct {
-    int double_sided;     // 1 = throughhole with vias, 0 = SMD only
-    int via_outside;      // 1 = vias outside, 0 = vias inside
-    char timestamp[64];   // UUID for KiCad
-} footprint_options_t;
-
-typedef struct {
-    pad_t pads[128];
-    int pad_count;
-    line_t silkscreen_lines[64];
-    int silkscreen_count;
-    line_t fab_lines[64];
-    int fab_count;
-    line_t courtyard_lines[8];
-    int courtyard_count;
-    point_t text_positions[3];  // reference, value, user
-} footprint_geometry_t;
-
-// ============================================================================
-// COMPONENT SPECIFICATIONS
-// ============================================================================
-
-static component_spec_t component_specs[] = {
-    {"APW9322",  20,  5,  5, 1.27, {15.00,  8.70, 15.00,  8.70}, 0.9,  6.05,  -6.05},
-    {"APW9323",  28,  7,  7, 1.27, {17.40, 11.15, 17.40, 11.15}, 0.9,  7.25,  -7.25},
-    {"APW9324",  32,  7,  9, 1.27, {17.40, 11.15, 19.90, 13.60}, 0.9,  7.25,  -8.40},
-    {"APW9325",  44, 11, 11, 1.27, {22.50, 16.40, 22.50, 16.40}, 0.9,  9.90,  -9.90},
-    {"APW9326",  52, 13, 13, 1.27, {25.10, 18.90, 25.10, 18.90}, 0.9, 11.10, -11.10},
-    {"APW9327",  68, 17, 17, 1.27, {30.10, 23.90, 30.10, 23.90}, 0.9, 13.60, -13.60},
-    {"APW9328",  84, 21, 21, 1.27, {36.60, 27.50, 36.60, 27.50}, 0.9, 16.35, -16.35},
-};
+#include "plcc-gen.h"
+#include "backends.h"
+#include "bench.h"
+#include "bundle.h"
+#include "catalog.h"
+#include "check.h"
+#include "geometry.h"
+#include "header-model.h"
+#include "header-plan.h"
+#include "mesh-analysis.h"
+#include "mesh.h"
+#include "panel.h"
+#include "pinmap.h"
+#include "precompiled.h"
+#include "preview-tools.h"
+#include "preview.h"
+#include "printability.h"
+#include "scad.h"
+#include "server.h"
+#include "shard.h"
+#include "step.h"
+#include "watch.h"
 
-static int num_component_specs = sizeof(component_specs) / sizeof(component_specs[0]);
+#include <getopt.h>
 
-// ============================================================================
-// UTILITY FUNCTIONS
-// ============================================================================
+// Write a rendered file to path, or to stdout if path is NULL
+static int write_output(const char* path, const char* data, size_t size) {
+    TRACE_START(t_io);
+    FILE* output = stdout;
+    int ret = 0;
 
-static component_spec_t* find_component_by_pins(int pins) {
-    for (int i = 0; i < num_component_specs; i++) {
-        if (component_specs[i].pins == pins) {
-            return &component_specs[i];
+    if (path) {
+        output = fopen(path, "w");
+        if (!output) {
+            perror("Error opening output file");
+            return 1;
         }
     }
-    return NULL;
-}
-
-static void generate_timestamp(char* buffer, size_t size) {
-    // Use zero timestamp like the original
-    snprintf(buffer, size, "00000000-0000-0000-0000-000000000000");
-}
 
-// ============================================================================
-// GEOMETRY CALCULATION ENGINE
-// ============================================================================
-
-static void calculate_pin_positions(footprint_geometry_t* geom, component_spec_t* spec, footprint_options_t* opts) {
-    double pitch = spec->pitch;
-    double a = spec->body.a;
-    double c = spec->body.c;
-    double d = spec->body.d;
-    double pad_width = spec->pad_width;
-    double pad_length = (c - d) / 2;
-
-    double pins_width = spec->pins_x * pitch;
-    double pins_height = spec->pins_y * pitch;
-
-    geom->pad_count = 0;
-
-    // Calculate pin ranges exactly like the original
-    int cp[10];
-    cp[0] = 1;
-    cp[1] = cp[0] + (spec->pins_x / 2);
-    cp[2] = cp[1] + 1;
-    cp[3] = cp[2] + (spec->pins_y - 1);
-    cp[4] = cp[3] + 1;
-    cp[5] = cp[4] + (spec->pins_x - 1);
-    cp[6] = cp[5] + 1;
-    cp[7] = cp[6] + (spec->pins_y - 1);
-    cp[8] = cp[7] + 1;
-    cp[9] = spec->pins;
-
-    // Top 1 - exactly like original
-    double sx = pad_width;
-    double sy = pad_length;
-    double px = 0;
-    double py = -(c - pad_length) / 2;
-    for (int i = cp[0]; i <= cp[1]; i++) {
-        pad_t* pad = &geom->pads[geom->pad_count++];
-        pad->number = i;
-        pad->position.x = px;
-        pad->position.y = py;
-        pad->size.x = sx;
-        pad->size.y = sy;
-        pad->type = opts->double_sided ? PAD_THROUGHHOLE : PAD_SMD;
-
-        if (pad->type == PAD_THROUGHHOLE) {
-            pad->drill.diameter = 0.3;
-            double ox = (sx > sy) ? (px < 0 ? sx/4 : -sx/4) : 0;
-            double oy = (sx <= sy) ? (py < 0 ? sy/4 : -sy/4) : 0;
-            if (!opts->via_outside) {
-                ox *= -1;
-                oy *= -1;
-            }
-            pad->drill.offset.x = ox;
-            pad->drill.offset.y = oy;
-            pad->position.x = px - ox;
-            pad->position.y = py - oy;
-            strcpy(pad->layers, "\"*.Cu\" \"*.Mask\"");
-        } else {
-            strcpy(pad->layers, "\"F.Cu\" \"F.Paste\" \"F.Mask\"");
-
-            // Add via pad if via_outside is enabled for single-sided
-            if (opts->via_outside) {
-                pad_t* via_pad = &geom->pads[geom->pad_count++];
-                via_pad->number = 0; // Via pads don't have pin numbers
-                double ox = (sx > sy) ? (px < 0 ? sx/4 : -sx/4) : 0;
-                double oy = (sx <= sy) ? (py < 0 ? sy/4 : -sy/4) : 0;
-                // For via_outside, we want the via on the opposite side (outside)
-                via_pad->position.x = px - ox;
-                via_pad->position.y = py - oy;
-                via_pad->size.x = 0.6;
-                via_pad->size.y = 0.6;
-                via_pad->type = PAD_THROUGHHOLE;
-                via_pad->drill.diameter = 0.3;
-                via_pad->drill.offset.x = 0;
-                via_pad->drill.offset.y = 0;
-                strcpy(via_pad->layers, "\"*.Cu\" \"*.Mask\"");
-            }
-        }
-        px += pitch;
-    }
-
-    // Right
-    sx = pad_length; sy = pad_width;
-    px = (a - pad_length) / 2;
-    py = -(pins_height - pitch) / 2;
-    for (int i = cp[2]; i <= cp[3]; i++) {
-        pad_t* pad = &geom->pads[geom->pad_count++];
-        pad->number = i;
-        pad->position.x = px;
-        pad->position.y = py;
-        pad->size.x = sx;
-        pad->size.y = sy;
-        pad->type = opts->double_sided ? PAD_THROUGHHOLE : PAD_SMD;
-
-        if (pad->type == PAD_THROUGHHOLE) {
-            pad->drill.diameter = 0.3;
-            double ox = (sx > sy) ? (px < 0 ? sx/4 : -sx/4) : 0;
-            double oy = (sx <= sy) ? (py < 0 ? sy/4 : -sy/4) : 0;
-            if (!opts->via_outside) {
-                ox *= -1;
-                oy *= -1;
-            }
-            pad->drill.offset.x = ox;
-            pad->drill.offset.y = oy;
-            pad->position.x = px - ox;
-            pad->position.y = py - oy;
-            strcpy(pad->layers, "\"*.Cu\" \"*.Mask\"");
-        } else {
-            strcpy(pad->layers, "\"F.Cu\" \"F.Paste\" \"F.Mask\"");
-
-            // Add via pad if via_outside is enabled for single-sided
-            if (opts->via_outside) {
-                pad_t* via_pad = &geom->pads[geom->pad_count++];
-                via_pad->number = 0; // Via pads don't have pin numbers
-                double ox = (sx > sy) ? (px < 0 ? sx/4 : -sx/4) : 0;
-                double oy = (sx <= sy) ? (py < 0 ? sy/4 : -sy/4) : 0;
-                // For via_outside, we want the via on the opposite side (outside)
-                via_pad->position.x = px - ox;
-                via_pad->position.y = py - oy;
-                via_pad->size.x = 0.6;
-                via_pad->size.y = 0.6;
-                via_pad->type = PAD_THROUGHHOLE;
-                via_pad->drill.diameter = 0.3;
-                via_pad->drill.offset.x = 0;
-                via_pad->drill.offset.y = 0;
-                strcpy(via_pad->layers, "\"*.Cu\" \"*.Mask\"");
-            }
-        }
-        py += pitch;
-    }
-
-    // Bottom
-    sx = pad_width; sy = pad_length;
-    px = (pins_width - pitch) / 2;
-    py = (c - pad_length) / 2;
-    for (int i = cp[4]; i <= cp[5]; i++) {
-        pad_t* pad = &geom->pads[geom->pad_count++];
-        pad->number = i;
-        pad->position.x = px;
-        pad->position.y = py;
-        pad->size.x = sx;
-        pad->size.y = sy;
-        pad->type = opts->double_sided ? PAD_THROUGHHOLE : PAD_SMD;
-
-        if (pad->type == PAD_THROUGHHOLE) {
-            pad->drill.diameter = 0.3;
-            double ox = (sx > sy) ? (px < 0 ? sx/4 : -sx/4) : 0;
-            double oy = (sx <= sy) ? (py < 0 ? sy/4 : -sy/4) : 0;
-            if (!opts->via_outside) {
-                ox *= -1;
-                oy *= -1;
-            }
-            pad->drill.offset.x = ox;
-            pad->drill.offset.y = oy;
-            pad->position.x = px - ox;
-            pad->position.y = py - oy;
-            strcpy(pad->layers, "\"*.Cu\" \"*.Mask\"");
-        } else {
-            strcpy(pad->layers, "\"F.Cu\" \"F.Paste\" \"F.Mask\"");
-
-            // Add via pad if via_outside is enabled for single-sided
-            if (opts->via_outside) {
-                pad_t* via_pad = &geom->pads[geom->pad_count++];
-                via_pad->number = 0; // Via pads don't have pin numbers
-                double ox = (sx > sy) ? (px < 0 ? sx/4 : -sx/4) : 0;
-                double oy = (sx <= sy) ? (py < 0 ? sy/4 : -sy/4) : 0;
-                // For via_outside, we want the via on the opposite side (outside)
-                via_pad->position.x = px - ox;
-                via_pad->position.y = py - oy;
-                via_pad->size.x = 0.6;
-                via_pad->size.y = 0.6;
-                via_pad->type = PAD_THROUGHHOLE;
-                via_pad->drill.diameter = 0.3;
-                via_pad->drill.offset.x = 0;
-                via_pad->drill.offset.y = 0;
-                strcpy(via_pad->layers, "\"*.Cu\" \"*.Mask\"");
-            }
-        }
-        px -= pitch;
-    }
-
-    // Left
-    sx = pad_length; sy = pad_width;
-    px = -(a - pad_length) / 2;
-    py = (pins_height - pitch) / 2;
-    for (int i = cp[6]; i <= cp[7]; i++) {
-        pad_t* pad = &geom->pads[geom->pad_count++];
-        pad->number = i;
-        pad->position.x = px;
-        pad->position.y = py;
-        pad->size.x = sx;
-        pad->size.y = sy;
-        pad->type = opts->double_sided ? PAD_THROUGHHOLE : PAD_SMD;
-
-        if (pad->type == PAD_THROUGHHOLE) {
-            pad->drill.diameter = 0.3;
-            double ox = (sx > sy) ? (px < 0 ? sx/4 : -sx/4) : 0;
-            double oy = (sx <= sy) ? (py < 0 ? sy/4 : -sy/4) : 0;
-            if (!opts->via_outside) {
-                ox *= -1;
-                oy *= -1;
-            }
-            pad->drill.offset.x = ox;
-            pad->drill.offset.y = oy;
-            pad->position.x = px - ox;
-            pad->position.y = py - oy;
-            strcpy(pad->layers, "\"*.Cu\" \"*.Mask\"");
-        } else {
-            strcpy(pad->layers, "\"F.Cu\" \"F.Paste\" \"F.Mask\"");
-
-            // Add via pad if via_outside is enabled for single-sided
-            if (opts->via_outside) {
-                pad_t* via_pad = &geom->pads[geom->pad_count++];
-                via_pad->number = 0; // Via pads don't have pin numbers
-                double ox = (sx > sy) ? (px < 0 ? sx/4 : -sx/4) : 0;
-                double oy = (sx <= sy) ? (py < 0 ? sy/4 : -sy/4) : 0;
-                // For via_outside, we want the via on the opposite side (outside)
-                via_pad->position.x = px - ox;
-                via_pad->position.y = py - oy;
-                via_pad->size.x = 0.6;
-                via_pad->size.y = 0.6;
-                via_pad->type = PAD_THROUGHHOLE;
-                via_pad->drill.diameter = 0.3;
-                via_pad->drill.offset.x = 0;
-                via_pad->drill.offset.y = 0;
-                strcpy(via_pad->layers, "\"*.Cu\" \"*.Mask\"");
-            }
-        }
-        py -= pitch;
-    }
-
-    // Top 2
-    sx = pad_width; sy = pad_length;
-    px = -(pins_width - pitch) / 2;
-    py = -(c - pad_length) / 2;
-    for (int i = cp[8]; i <= cp[9]; i++) {
-        pad_t* pad = &geom->pads[geom->pad_count++];
-        pad->number = i;
-        pad->position.x = px;
-        pad->position.y = py;
-        pad->size.x = sx;
-        pad->size.y = sy;
-        pad->type = opts->double_sided ? PAD_THROUGHHOLE : PAD_SMD;
-
-        if (pad->type == PAD_THROUGHHOLE) {
-            pad->drill.diameter = 0.3;
-            double ox = (sx > sy) ? (px < 0 ? sx/4 : -sx/4) : 0;
-            double oy = (sx <= sy) ? (py < 0 ? sy/4 : -sy/4) : 0;
-            if (!opts->via_outside) {
-                ox *= -1;
-                oy *= -1;
-            }
-            pad->drill.offset.x = ox;
-            pad->drill.offset.y = oy;
-            pad->position.x = px - ox;
-            pad->position.y = py - oy;
-            strcpy(pad->layers, "\"*.Cu\" \"*.Mask\"");
-        } else {
-            strcpy(pad->layers, "\"F.Cu\" \"F.Paste\" \"F.Mask\"");
-
-            // Add via pad if via_outside is enabled for single-sided
-            if (opts->via_outside) {
-                pad_t* via_pad = &geom->pads[geom->pad_count++];
-                via_pad->number = 0; // Via pads don't have pin numbers
-                double ox = (sx > sy) ? (px < 0 ? sx/4 : -sx/4) : 0;
-                double oy = (sx <= sy) ? (py < 0 ? sy/4 : -sy/4) : 0;
-                // For via_outside, we want the via on the opposite side (outside)
-                via_pad->position.x = px - ox;
-                via_pad->position.y = py - oy;
-                via_pad->size.x = 0.6;
-                via_pad->size.y = 0.6;
-                via_pad->type = PAD_THROUGHHOLE;
-                via_pad->drill.diameter = 0.3;
-                via_pad->drill.offset.x = 0;
-                via_pad->drill.offset.y = 0;
-                strcpy(via_pad->layers, "\"*.Cu\" \"*.Mask\"");
-            }
-        }
-        px += pitch;
+    if (fwrite(data, 1, size, output) != size) {
+        perror("Error writing output");
+        ret = 1;
     }
-}
-
-static void generate_silkscreen_lines(footprint_geometry_t* geom, component_spec_t* spec, const char* layer) {
-    // Copy exact logic from original kicad_mod_silkscreen function
-    line_t* lines = geom->silkscreen_lines;
-    int* count = &geom->silkscreen_count;
-
-    double ox, oy;
-    ox = spec->body.a / 2;
-    oy = spec->body.c / 2;
-
-    double x1,x2,x3,x4;
-    double y1,y2,y3,y4;
-
-    x1 = -ox - 0.2; y1 = -oy - 0.2;
-    x2 = ox + 0.2; y2 = -oy - 0.2;
-    x3 = ox + 0.2; y3 = oy + 0.2;
-    x4 = -ox - 0.2; y4 = oy + 0.2;
-
-    // right line
-    lines[(*count)++] = (line_t){{x2, y2 + 1}, {x3, y3}, 0.12, ""};
-    strcpy(lines[*count-1].layer, layer);
-
-    // left line
-    lines[(*count)++] = (line_t){{x4, y4}, {x1, y1}, 0.12, ""};
-    strcpy(lines[*count-1].layer, layer);
-
-    // bottom line
-    lines[(*count)++] = (line_t){{x3, y3}, {x4, y4}, 0.12, ""};
-    strcpy(lines[*count-1].layer, layer);
-
-    // \ <--
-    lines[(*count)++] = (line_t){{x2-1,y2}, {x2,y2+1}, 0.12, ""};
-    strcpy(lines[*count-1].layer, layer);
-
-    // top line left of 1
-    lines[(*count)++] = (line_t){{x1, y1}, {-1.0, y1}, 0.12, ""};
-    strcpy(lines[*count-1].layer, layer);
-
-    // top line right of 1
-    lines[(*count)++] = (line_t){{1.0, y1}, {x2-1, y2}, 0.12, ""};
-    strcpy(lines[*count-1].layer, layer);
-
-    // Calculate dynamic coordinates by scaling the 84-pin values proportionally
-    // Scale coordinates proportionally based on body size relative to 84-pin APW9328
-    double scale_x = spec->body.a / 36.60;  // APW9328 body.a
-    double scale_y = spec->body.c / 36.60;  // APW9328 body.c
-
-    double right_pad_inner = 13.675 * scale_x;
-    double right_pad_outer = 14.175 * scale_x;
-    double right_edge_outer = 15.325 * scale_x;
-    double top_pad_edge = -14.8 * scale_y;
-    double top_edge_inner = -13.65 * scale_y;
-    double top_edge_gap = -13.15 * scale_y;
-    double bottom_pad_edge = 15.85 * scale_y;
-    double bottom_edge_gap = 14.2 * scale_y;
-
-    // right horiz edge top
-    lines[(*count)++] = (line_t){{right_pad_inner, top_pad_edge}, {right_pad_outer, top_pad_edge}, 0.1, ""};
-    strcpy(lines[*count-1].layer, layer);
-
-    // \ <--
-    lines[(*count)++] = (line_t){{right_pad_outer, top_pad_edge}, {right_edge_outer, top_edge_inner}, 0.1, ""};
-    strcpy(lines[*count-1].layer, layer);
-
-    // left horiz edge top
-    lines[(*count)++] = (line_t){{-right_pad_inner, top_pad_edge}, {-right_edge_outer, top_pad_edge}, 0.1, ""};
-    strcpy(lines[*count-1].layer, layer);
-
-    // right vert edge top
-    lines[(*count)++] = (line_t){{right_edge_outer, top_edge_inner}, {right_edge_outer, top_edge_gap}, 0.1, ""};
-    strcpy(lines[*count-1].layer, layer);
-
-    // right vert line bottom
-    lines[(*count)++] = (line_t){{right_edge_outer, bottom_pad_edge}, {right_edge_outer, bottom_edge_gap}, 0.1, ""};
-    strcpy(lines[*count-1].layer, layer);
-
-    // left hor line bottom
-    lines[(*count)++] = (line_t){{-right_pad_inner, bottom_pad_edge}, {-right_edge_outer, bottom_pad_edge}, 0.1, ""};
-    strcpy(lines[*count-1].layer, layer);
-
-    // left vert line bottom
-    lines[(*count)++] = (line_t){{-right_edge_outer, bottom_pad_edge}, {-right_edge_outer, bottom_edge_gap}, 0.1, ""};
-    strcpy(lines[*count-1].layer, layer);
-
-    // left vert line top
-    lines[(*count)++] = (line_t){{-right_edge_outer, top_pad_edge}, {-right_edge_outer, top_edge_gap}, 0.1, ""};
-    strcpy(lines[*count-1].layer, layer);
-
-    // right vert line bottom
-    lines[(*count)++] = (line_t){{right_pad_inner, bottom_pad_edge}, {right_edge_outer, bottom_pad_edge}, 0.1, ""};
-    strcpy(lines[*count-1].layer, layer);
-}
-
-static void generate_courtyard_lines(footprint_geometry_t* geom, component_spec_t* spec) {
-    // Simple rectangular courtyard
-    double ox = spec->body.a / 2;
-    double oy = spec->body.c / 2;
-
-    line_t* lines = geom->courtyard_lines;
-    geom->courtyard_count = 4;
-
-    lines[0] = (line_t){{-ox, -oy}, {ox, -oy}, 0.05, "F.CrtYd"};
-    lines[1] = (line_t){{-ox, oy}, {-ox, -oy}, 0.05, "F.CrtYd"};
-    lines[2] = (line_t){{ox, oy}, {-ox, oy}, 0.05, "F.CrtYd"};
-    lines[3] = (line_t){{ox, -oy}, {ox, oy}, 0.05, "F.CrtYd"};
-}
-
-static void generate_fabrication_lines(footprint_geometry_t* geom, component_spec_t* spec) {
-    // Scale fabrication coordinates proportionally based on body size relative to 84-pin APW9328
-    line_t* lines = geom->fab_lines;
-    int* count = &geom->fab_count;
-
-    double scale_x = spec->body.a / 36.60;  // APW9328 body.a
-    double scale_y = spec->body.c / 36.60;  // APW9328 body.c
-
-    lines[(*count)++] = (line_t){{-18 * scale_x, -17.475 * scale_y}, {17 * scale_x, -17.475 * scale_y}, 0.1, "F.Fab"};
-    lines[(*count)++] = (line_t){{18 * scale_x, 18.525 * scale_y}, {-18 * scale_x, 18.525 * scale_y}, 0.1, "F.Fab"};
-    lines[(*count)++] = (line_t){{18 * scale_x, -16.475 * scale_y}, {18 * scale_x, 18.525 * scale_y}, 0.1, "F.Fab"};
-    lines[(*count)++] = (line_t){{-18 * scale_x, 18.525 * scale_y}, {-18 * scale_x, -17.475 * scale_y}, 0.1, "F.Fab"};
-    lines[(*count)++] = (line_t){{17 * scale_x, -17.475 * scale_y}, {18 * scale_x, -16.475 * scale_y}, 0.1, "F.Fab"};
-    lines[(*count)++] = (line_t){{-16.73 * scale_x, -16.205 * scale_y}, {16.73 * scale_x, -16.205 * scale_y}, 0.1, "F.Fab"};
-    lines[(*count)++] = (line_t){{-16.73 * scale_x, 17.255 * scale_y}, {-16.73 * scale_x, -16.205 * scale_y}, 0.1, "F.Fab"};
-    lines[(*count)++] = (line_t){{15.175 * scale_x, 15.7 * scale_y}, {-15.175 * scale_x, 15.7 * scale_y}, 0.1, "F.Fab"};
-    lines[(*count)++] = (line_t){{-15.175 * scale_x, 15.7 * scale_y}, {-15.175 * scale_x, -14.65 * scale_y}, 0.1, "F.Fab"};
-    lines[(*count)++] = (line_t){{-15.175 * scale_x, -14.65 * scale_y}, {14.175 * scale_x, -14.65 * scale_y}, 0.1, "F.Fab"};
-    lines[(*count)++] = (line_t){{15.175 * scale_x, -13.65 * scale_y}, {15.175 * scale_x, 15.7 * scale_y}, 0.1, "F.Fab"};
-    lines[(*count)++] = (line_t){{16.73 * scale_x, 17.255 * scale_y}, {-16.73 * scale_x, 17.255 * scale_y}, 0.1, "F.Fab"};
-    lines[(*count)++] = (line_t){{0, -16.475 * scale_y}, {-0.5 * scale_x, -17.475 * scale_y}, 0.1, "F.Fab"};
-    lines[(*count)++] = (line_t){{0.5 * scale_x, -17.475 * scale_y}, {0, -16.475 * scale_y}, 0.1, "F.Fab"};
-    lines[(*count)++] = (line_t){{16.73 * scale_x, -16.205 * scale_y}, {16.73 * scale_x, 17.255 * scale_y}, 0.1, "F.Fab"};
-    lines[(*count)++] = (line_t){{14.175 * scale_x, -14.65 * scale_y}, {15.175 * scale_x, -13.65 * scale_y}, 0.1, "F.Fab"};
-}
-
-static void calculate_text_positions(footprint_geometry_t* geom, component_spec_t* spec) {
-    double offset = spec->body.a / 2 + 1.0;
-
-    geom->text_positions[0] = (point_t){0, -offset};      // reference
-    geom->text_positions[1] = (point_t){0, offset + 0.5}; // value
-    geom->text_positions[2] = (point_t){0, 0.525};        // user
-}
-
-static footprint_geometry_t* generate_geometry(component_spec_t* spec, footprint_options_t* opts) {
-    footprint_geometry_t* geom = calloc(1, sizeof(footprint_geometry_t));
-    if (!geom) return NULL;
-
-    calculate_pin_positions(geom, spec, opts);
-    generate_silkscreen_lines(geom, spec, "F.SilkS");
-    generate_silkscreen_lines(geom, spec, "B.SilkS");
-    generate_courtyard_lines(geom, spec);
-    generate_fabrication_lines(geom, spec);
-    calculate_text_positions(geom, spec);
-
-    return geom;
-}
 
-// ============================================================================
-// KICAD OUTPUT FORMATTER
-// ============================================================================
-
-static void write_kicad_header(FILE* f, component_spec_t* spec) {
-    fprintf(f, "(footprint \"%s\" (version 20210228) (generator pcbnew) (layer \"F.Cu\")\n", spec->name);
-    fprintf(f, "  (tedit 60690F97)\n");
-    fprintf(f, "  (descr \"PLCC plug, %d pins, surface mount\")\n", spec->pins);
-    fprintf(f, "  (tags \"plcc smt\")\n");
-    fprintf(f, "  (autoplace_cost180 1)\n");
-    fprintf(f, "  (attr smd)\n");
-}
-
-static void write_kicad_text(FILE* f, const char* type, const char* text, point_t pos, footprint_options_t* opts) {
-    fprintf(f, "  (fp_text %s \"%s\" (at %.0f %.3f -180) (layer \"%s\")\n",
-            type, text, pos.x, pos.y,
-            strcmp(type, "reference") == 0 ? "F.SilkS" : "F.Fab");
-    fprintf(f, "    (effects (font (size %.3f %.3f) (thickness 0.15)))\n", 1.0, 1.0);
-    fprintf(f, "    (tstamp %s)\n", opts->timestamp);
-    fprintf(f, "  )\n");
-}
-
-static void write_kicad_line(FILE* f, line_t* line, footprint_options_t* opts) {
-    fprintf(f, "  (fp_line (start %.3f %.3f) (end %.3f %.3f) (layer \"%s\") (width %g) (tstamp %s))\n",
-            line->start.x, line->start.y, line->end.x, line->end.y,
-            line->layer, line->width, opts->timestamp);
-}
-
-static void write_kicad_pad(FILE* f, pad_t* pad, footprint_options_t* opts) {
-    if (pad->number == 0) {
-        // Via pad (no pin number)
-        fprintf(f, "  (pad \"\" thru_hole circle (at %.3f %.3f) (size %.3f %.3f) ",
-                pad->position.x, pad->position.y, pad->size.x, pad->size.y);
-        fprintf(f, "(drill %.1f) ",
-                pad->drill.diameter);
-        fprintf(f, "(layers %s) ", pad->layers);
-    } else if (pad->type == PAD_THROUGHHOLE) {
-        fprintf(f, "  (pad \"%d\" thru_hole rect (at %.3f %.3f) (locked) (size %.3f %.3f) ",
-                pad->number, pad->position.x, pad->position.y, pad->size.x, pad->size.y);
-        fprintf(f, "(drill %.1f (offset %.3f %.3f)) ",
-                pad->drill.diameter, pad->drill.offset.x, pad->drill.offset.y);
-        fprintf(f, "(layers %s) ", pad->layers);
-    } else {
-        fprintf(f, "  (pad \"%d\" smd rect (at %.3f %.3f) (locked) (size %.3f %.3f) ",
-                pad->number, pad->position.x, pad->position.y, pad->size.x, pad->size.y);
-        fprintf(f, "(layers %s) ", pad->layers);
-    }
-    fprintf(f, "(tstamp %s))\n", opts->timestamp);
+    if (path && fclose(output) != 0) {
+        perror("Error closing output file");
+        ret = 1;
+    }
+    TRACE_STOP(t_io, STAGE_FILE_IO, size);
+    return ret;
 }
 
-static void write_kicad_model(FILE* f, component_spec_t* spec) {
-    fprintf(f, "(model \"${KIPRJMOD}/PLCCplug.3dshapes/PLCCplug-%dpin.wrl\"\n", spec->pins);
-    fprintf(f, "    (offset (xyz %.1f %.2f 2.5))\n", spec->offset_x, spec->offset_y);
-    fprintf(f, "    (scale (xyz 1 1 1))\n");
-    fprintf(f, "    (rotate (xyz -0 -0 -90))\n");
-    fprintf(f, "  )\n");
+// Plug and header models built from plug_specs; STEP holds the body and
+// the pins, unless header_only
+static int run_step_model(int pins, int header_only, const char* outfile) {
+    const plug_spec_t* plug = find_plug_by_pins(pins);
+    if (!plug) {
+        fprintf(stderr, "Error: Unsupported pin count %d\n", pins);
+        return 1;
+    }
+    size_t size = 0;
+    char* data = render_step_model(plug, !header_only, 1, &size);
+    if (!data) {
+        fprintf(stderr, "Error: failed to build STEP model\n");
+        return 1;
+    }
+    int ret = write_output(outfile, data, size);
+    free(data);
+    return ret;
 }
 
-static void write_kicad_footprint(FILE* f, footprint_geometry_t* geom, component_spec_t* spec, footprint_options_t* opts) {
-    write_kicad_header(f, spec);
-
-    // Text elements
-    write_kicad_text(f, "reference", "IC2", geom->text_positions[0], opts);
-    write_kicad_text(f, "value", spec->name, geom->text_positions[1], opts);
-    write_kicad_text(f, "user", "${REFERENCE}", geom->text_positions[2], opts);
-
-    // Silkscreen lines
-    for (int i = 0; i < geom->silkscreen_count; i++) {
-        write_kicad_line(f, &geom->silkscreen_lines[i], opts);
+static int run_header_model(int pins, const char* format, int bend_segments, const char* outfile) {
+    if (strcmp(format, "step") == 0) {
+        return run_step_model(pins, 1, outfile);
+    }
+    const mesh_writer_t* writer = find_mesh_writer(format);
+    const plug_spec_t* plug = find_plug_by_pins(pins);
+    if (!writer) {
+        fprintf(stderr, "Error: unknown mesh format '%s' (stl, wrl, step)\n", format);
+        return 1;
+    }
+    if (!plug) {
+        fprintf(stderr, "Error: Unsupported pin count %d\n", pins);
+        return 1;
     }
 
-    // Courtyard lines
-    for (int i = 0; i < geom->courtyard_count; i++) {
-        write_kicad_line(f, &geom->courtyard_lines[i], opts);
+    model_t model;
+    if (build_header_model(&model, plug, bend_segments) < 0) {
+        fprintf(stderr, "Error: failed to build header model\n");
+        return 1;
     }
+    size_t size = 0;
+    char* data = render_model(&model, writer, &size);
+    model_free(&model);
+    if (!data) {
+        fprintf(stderr, "Error: failed to format %s output\n", writer->name);
+        return 1;
+    }
+    int ret = write_output(outfile, data, size);
+    free(data);
+    return ret;
+}
 
-    // Fabrication lines
-    for (int i = 0; i < geom->fab_count; i++) {
-        write_kicad_line(f, &geom->fab_lines[i], opts);
+// Evaluate path with the -D assignments in defines and write the union of
+// everything it instantiates to output (STL or VRML by extension, STL on
+// stdout without one). With reference, compare the result against an STL
+// or VRML rendering of the same file, part by part.
+static int run_scad(const char* path, char** defines, int define_count, const char* output, const char* reference) {
+    mesh_t mesh = { 0 };
+    model_t model = { 0 };
+    int ret = 1;
+
+    double start = monotonic_us();
+    if (scad_render(path, defines, define_count, 0, &mesh) < 0) goto out;
+    double elapsed = monotonic_us() - start;
+    fprintf(stderr, "Rendered %s: %d triangles in %.1f ms\n", path, mesh.triangle_count, elapsed / 1000);
+
+    const char* ext = output ? strrchr(output, '.') : NULL;
+    int vrml = ext && strcmp(ext, ".wrl") == 0;
+    if (output || !reference) {
+        const char* base = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+        snprintf(model.name, sizeof(model.name), "%.*s", (int)strcspn(base, "."), base);
+        model_part_t* part = model_add_part(&model, "body", 0.97647, 0.843137, 0.172549);
+        if (!part || mesh_append(&part->mesh, &mesh, &transform_identity) < 0) goto out;
+        // The scad sources scale VRML models themselves
+        for (int i = 0; vrml && i < part->mesh.vertex_count; i++) {
+            vec3_t* v = &part->mesh.vertices[i];
+            *v = (vec3_t){ v->x / VRML_SCALE, v->y / VRML_SCALE, v->z / VRML_SCALE };
+        }
+        size_t size = 0;
+        char* data = render_model(&model, find_mesh_writer(vrml ? "wrl" : "stl"), &size);
+        if (!data) {
+            fprintf(stderr, "Error: out of memory\n");
+            goto out;
+        }
+        int err = output ? write_output(output, data, size) : fwrite(data, 1, size, stdout) != size;
+        free(data);
+        if (err) goto out;
     }
 
-    // Pads
-    for (int i = 0; i < geom->pad_count; i++) {
-        write_kicad_pad(f, &geom->pads[i], opts);
+    if (reference) {
+        mesh_stats_t *ours = NULL, *theirs = NULL;
+        int our_count = 0, their_count = 0;
+        const char* format = "";
+        size_t len = strlen(reference);
+        // VRML files carry six digits; round ours the same way
+        int quantise = len > 4 && strcmp(reference + len - 4, ".wrl") == 0;
+        int err = quantise ? analyse_vrml(reference, &theirs, &their_count) : analyse_stl(reference, &theirs, &their_count, &format);
+        if (err < 0 || analyse_mesh(&mesh, quantise, &ours, &our_count) < 0) {
+            free(theirs);
+            goto out;
+        }
+        // OpenSCAD keeps or drops zero thickness sheets between touching
+        // solids depending on how its transforms round, which shows in
+        // the area only; the VRML files were made that way
+        double tolerance = quantise ? 1e-4 : 1e-6, area_tolerance = quantise ? 1e-2 : 1e-6, area_error;
+        double error = scad_compare_parts(ours, our_count, theirs, their_count, &area_error);
+        int match = error <= tolerance && area_error <= area_tolerance;
+        printf("{\"file\":\"%s\",\"reference\":\"%s\",\"triangles\":%d,\"parts\":%d,\"reference_parts\":%d,"
+               "\"max_error\":%.3g,\"area_error\":%.3g,\"time_ms\":%.3f,\"match\":%s}\n",
+               path, reference, mesh.triangle_count, our_count, their_count, isinf(error) ? -1 : error,
+               isinf(area_error) ? -1 : area_error, elapsed / 1000, match ? "true" : "false");
+        free(ours);
+        free(theirs);
+        if (!match) goto out;
     }
+    ret = 0;
 
-    // 3D model
-    write_kicad_model(f, spec);
+out:
+    mesh_free(&mesh);
+    model_free(&model);
+    return ret;
+}
 
-    fprintf(f, ")\n");
+// "out/APW9328.kicad_mod" + eagle -> "out/APW9328.lbr"
+static void output_path_for_format(char* path, size_t len, const char* outfile, const footprint_writer_t* writer) {
+    const char* base = strrchr(outfile, '/');
+    const char* dot = strrchr(base ? base : outfile, '.');
+    int stem = dot ? (int)(dot - outfile) : (int)strlen(outfile);
+    snprintf(path, len, "%.*s.%s", stem, outfile, writer->extension);
 }
 
-// ============================================================================
-// COMMAND LINE INTERFACE
-// ============================================================================
+static int parse_formats(char* list, const footprint_writer_t** formats, int max) {
+    int n = 0;
+    char* save = NULL;
+    for (char* name = strtok_r(list, ",", &save); name; name = strtok_r(NULL, ",", &save)) {
+        const footprint_writer_t* writer = find_footprint_writer(name);
+        if (!writer) {
+            fprintf(stderr, "Error: Unknown output format '%s'\n", name);
+            return -1;
+        }
+        if (n == max) {
+            fprintf(stderr, "Error: Too many output formats\n");
+            return -1;
+        }
+        formats[n++] = writer;
+    }
+    return n;
+}
 
 static void print_usage(const char *prog_name) {
     printf("Usage: %s -p|--pins PINS [-o|--outfile FILE] [--double-sided] [--via-outside]\n", prog_name);
@@ -651,15 +214,219 @@ static void print_usage(const char *prog_name) {
     printf("  -d, --double-sided     Use double-sided pads with vias (default: enabled)\n");
     printf("  -s, --single-sided     Use single-sided SMD pads only\n");
     printf("  -v, --via-outside      Add vias on the outside of the footprint (default: inside)\n");
+    printf("  -f, --format LIST      Comma separated output formats: kicad, kicad-legacy, eagle, svg, png (default: kicad)\n");
+    printf("                         With several formats, each goes to --outfile with its own extension\n");
     printf("  -h, --help            Show this help message\n");
+    printf("\nServer mode:\n");
+    printf("      --serve            Answer newline-delimited requests on stdin\n");
+    printf("      --socket PATH      With --serve, listen on a Unix socket instead\n");
+    printf("      --connect PATH     Send requests from stdin to a running server\n");
+    printf("      --cache-size N     Number of rendered results to keep (default: %d)\n", DEFAULT_CACHE_SIZE);
+    printf("      --root DIR         Library root holding the model directories (default: %s)\n", DEFAULT_LIBRARY_ROOT);
+    printf("\nInstrumentation:\n");
+    printf("      --trace FILE       Write per-stage timings as Chrome trace JSON\n");
+    printf("      --stats            Print a per-stage timing summary to stderr\n");
+    printf("\nBenchmarks:\n");
+    printf("      --bench            Time generation and writing of the whole catalog (JSON lines on stdout)\n");
+    printf("      --bench-iterations N  Timed iterations per case (default: %d)\n", BENCH_DEFAULT_ITERATIONS);
+    printf("      --bench-filter TEXT   Only run cases whose name contains TEXT\n");
+    printf("      --bench-compare OLD NEW  Report cases whose median regressed (see --bench-threshold)\n");
+    printf("      --bench-threshold PCT    Allowed slowdown in percent (default: 10)\n");
+    printf("\nPrecompiled footprints:\n");
+    printf("      --no-precompiled   Always run the geometry engine, even for standard parts\n");
+    printf("      --emit-precompiled FILE  Write the standard catalog as a C header (build step)\n");
+    printf("\nRegression check:\n");
+    printf("      --check DIR        Compare all variants with the library in DIR and with apw.c\n");
+    printf("      --step-check [FILE...]  Check that the STEP models are well formed and their shells\n");
+    printf("                         closed (default: the plug models as built now)\n");
+    printf("      --verbose          Also list allowed differences\n");
+    printf("\nPreviews:\n");
+    printf("      --contact-sheet FILE  Render every catalog variant into one PNG\n");
+    printf("      --against DIR      With --contact-sheet, overlay the differences to the library in DIR\n");
+    printf("      --tile PX          Contact sheet tile size in pixels (default: %d)\n", DEFAULT_TILE_SIZE);
+    printf("      --diff-overlay OLD NEW  Render the differences between two .kicad_mod files to --outfile\n");
+    printf("  -j, --jobs N           Render tiles on N threads (default: number of CPUs)\n");
+    printf("\n3D models:\n");
+    printf("      --header-model FORMAT  Write the pin header strips for --pins as stl, wrl or step\n");
+    printf("      --plug-model step  Write the plug with its header strips for --pins as STEP\n");
+    printf("      --step-model       Reference the .step model from footprints instead of the .wrl\n");
+    printf("      --bend-segments N  Segments per pin bend (default: %d)\n", DEFAULT_BEND_SEGMENTS);
+    printf("      --emit-scad-specs FILE  Write the plug dimensions for plccplug.scad (build step)\n");
+    printf("\nPrint quotes:\n");
+    printf("      --quote FILE [FILE...]  Volume, area, box and cost of each part of STL files (JSON lines)\n");
+    printf("      --materials FILE   Material price table: NAME DENSITY PRICE_PER_CM3 [PART_FEE [BATCH_FEE]]\n");
+    printf("      --material NAME    Only quote this material\n");
+    printf("      --quantity N       Copies per batch (default: 1)\n");
+    printf("\nLibrary catalog:\n");
+    printf("      --index FILE [DIR...]  Index the .pretty directories into FILE; without DIRs, rescan the indexed ones\n");
+    printf("      --find FILE [TERM...]  List the footprints in index FILE matching all TERMs (JSON lines)\n");
+    printf("                         TERM is FIELD OP VALUE, OP one of = < <= > >=, or FIELD=LOW..HIGH;\n");
+    printf("                         fields: pins, pads, pitch, width, height, size, body-width, body-height (mm),\n");
+    printf("                         plus type=smd|tht|npth and name=PATTERN\n");
+    printf("\nLibrary bundles:\n");
+    printf("      --bundle FILE [DIR...]  Pack DIRs (default: the model directories under --root) into FILE\n");
+    printf("      --bundle-list FILE  List the members of a bundle (JSON lines)\n");
+    printf("      --bundle-extract FILE [MEMBER...]  Write MEMBERs to --outfile or stdout; without MEMBERs,\n");
+    printf("                         update the files under --root whose contents differ\n");
+    printf("      --bundle-delta OLD NEW  Write the changes from bundle OLD to NEW to --outfile\n");
+    printf("      --bundle-apply OLD DELTA  Rebuild the new bundle from OLD and a delta into --outfile\n");
+    printf("\nSharded runs:\n");
+    printf("      --run DIR [ENTRY...]  Render every entry, expanded by the --sweep grid, into DIR\n");
+    printf("                         (default: whole catalog); ENTRY is a server request\n");
+    printf("      --run-list FILE    Read run entries from FILE, one per line\n");
+    printf("      --shard I/N        Only render slice I (0 <= I < N) of the run\n");
+    printf("      --merge DIR SHARD_DIR...  Verify the shards of a run and combine them into DIR\n");
+    printf("\nWatch mode:\n");
+    printf("      --watch            Regenerate the footprints and models in --root whose inputs change\n");
+    printf("      --specs FILE       With --watch, parts (NAME,PINS_X,PINS_Y,PITCH,A,B,C,D,PAD_WIDTH[,OFFSET_X,OFFSET_Y])\n");
+    printf("                         replacing or extending the built-in catalog\n");
+    printf("      --openscad PROG    OpenSCAD binary for the models, also timed by --bench (default: %s)\n", DEFAULT_OPENSCAD);
+    printf("\nScad evaluator:\n");
+    printf("      --scad FILE        Render an OpenSCAD file without OpenSCAD, to --outfile (.stl or .wrl)\n");
+    printf("                         or STL on stdout; covers what plccplug.scad and angle_header.scad use\n");
+    printf("  -D, --define NAME=VALUE  Override a variable of the --scad file, like openscad -D\n");
+    printf("      --compare FILE     Check the rendering part by part against an STL or VRML file (JSON line)\n");
+    printf("\nPrintability:\n");
+    printf("      --printability FILE...  Slice STL or scad files layer by layer and report narrow walls and gaps,\n");
+    printf("                         overhangs and thin steps (JSON lines); scad files for every plug size and\n");
+    printf("                         pin tolerance, with -D assignments and on --jobs threads\n");
+    printf("      --printer NAME     Only check for one printer: fdm-0.4, fdm-0.2, resin, PA12\n");
+    printf("      --layer-height MM  Slice at this layer height instead of the printer's\n");
+    printf("      --verbose          Also print every layer and list the regions\n");
+    printf("\nHeader strip planner:\n");
+    printf("      --cut-plan PINS=COUNT...  Cut list for the header strips of a batch of plugs (JSON line)\n");
+    printf("      --stock LIST       Comma separated stock strip lengths in pins (default: %d)\n", DEFAULT_STOCK_PINS);
+    printf("      --kerf N           Pins lost to every cut (default: 0)\n");
+    printf("\nTest coupons:\n");
+    printf("      --panel FILE [ENTRY...]  Place footprints on a .kicad_pcb panel (default: whole catalog)\n");
+    printf("                         ENTRY is a server request such as \"84 single-sided x4\"\n");
+    printf("      --panel-list FILE  Read panel entries from FILE, one per line\n");
+    printf("      --sweep PARAM=FROM:TO:STEP  Add a tolerance sweep of every entry (up to %d for --run)\n", MAX_SWEEPS);
+    printf("      --fanout           Route every pin to a test point\n");
+    printf("\nPin maps:\n");
+    printf("      --pin-map PLUG     Connect the pins of PLUG to --map-target, one row per connection\n");
+    printf("                         (side, index along the side and pad centre of both pins)\n");
+    printf("      --map-target T     Target footprint (default: PLUG itself); PLUG and T are server\n");
+    printf("                         requests such as \"84 single-sided\" or .kicad_mod files\n");
+    printf("      --map FILE         Connections, \"PLUG_PIN TARGET_PIN [NET]\" per line (default: pin n to pin n)\n");
+    printf("      --map-format F     csv, json (JSON lines) or kicad-net (default: csv)\n");
 }
 
+enum {
+    OPT_SERVE = 256,
+    OPT_SOCKET,
+    OPT_CONNECT,
+    OPT_CACHE_SIZE,
+    OPT_ROOT,
+    OPT_TRACE,
+    OPT_STATS,
+    OPT_BENCH,
+    OPT_BENCH_ITERATIONS,
+    OPT_BENCH_FILTER,
+    OPT_BENCH_COMPARE,
+    OPT_BENCH_THRESHOLD,
+    OPT_CHECK,
+    OPT_STEP_CHECK,
+    OPT_VERBOSE,
+    OPT_CONTACT_SHEET,
+    OPT_AGAINST,
+    OPT_TILE,
+    OPT_DIFF_OVERLAY,
+    OPT_PANEL,
+    OPT_PANEL_LIST,
+    OPT_SWEEP,
+    OPT_FANOUT,
+    OPT_HEADER_MODEL,
+    OPT_BEND_SEGMENTS,
+    OPT_PLUG_MODEL,
+    OPT_STEP_MODEL,
+    OPT_QUOTE,
+    OPT_MATERIALS,
+    OPT_MATERIAL,
+    OPT_QUANTITY,
+    OPT_INDEX,
+    OPT_FIND,
+    OPT_NO_PRECOMPILED,
+    OPT_EMIT_PRECOMPILED,
+    OPT_EMIT_SCAD_SPECS,
+    OPT_WATCH,
+    OPT_SPECS,
+    OPT_OPENSCAD,
+    OPT_RUN,
+    OPT_RUN_LIST,
+    OPT_SHARD,
+    OPT_MERGE,
+    OPT_SCAD,
+    OPT_COMPARE,
+    OPT_PRINTABILITY,
+    OPT_PRINTER,
+    OPT_LAYER_HEIGHT,
+    OPT_CUT_PLAN,
+    OPT_STOCK,
+    OPT_KERF,
+    OPT_BUNDLE,
+    OPT_BUNDLE_LIST,
+    OPT_BUNDLE_EXTRACT,
+    OPT_BUNDLE_DELTA,
+    OPT_BUNDLE_APPLY,
+    OPT_PIN_MAP,
+    OPT_MAP_TARGET,
+    OPT_MAP,
+    OPT_MAP_FORMAT
+};
+
 int main(int argc, char *argv[]) {
     int opt;
     char *outfile = NULL;
-    FILE *output = stdout;
     int pins_specified = 0;
     int pins = 0;
+    int serve = 0;
+    char *socket_path = NULL;
+    char *connect_path = NULL;
+    char *root = DEFAULT_LIBRARY_ROOT;
+    int cache_size = DEFAULT_CACHE_SIZE;
+    char *trace_path = NULL;
+    int stats = 0;
+    int bench = 0;
+    int bench_iterations = BENCH_DEFAULT_ITERATIONS;
+    char *bench_filter = NULL;
+    char *bench_baseline = NULL;
+    double bench_threshold = 10.0;
+    char *check_library = NULL;
+    int step_check = 0;
+    int verbose = 0;
+    char *contact_sheet = NULL;
+    char *against = NULL;
+    int tile = DEFAULT_TILE_SIZE;
+    char *diff_old = NULL;
+    int jobs = default_jobs();
+    char *panel = NULL;
+    char *panel_list = NULL;
+    char *sweeps[MAX_SWEEPS + 1];
+    int num_sweeps = 0;
+    int fanout = 0;
+    char *header_model = NULL;
+    char *plug_model = NULL;
+    char *quote = NULL, *materials = NULL, *material = NULL;
+    int quantity = 1;
+    char *index_path = NULL, *find_path = NULL;
+    char *emit_path = NULL, *emit_scad_path = NULL;
+    int watch = 0;
+    char *specs_path = NULL;
+    char *openscad = DEFAULT_OPENSCAD;
+    char *run_dir = NULL, *run_list = NULL, *shard = NULL, *merge_dir = NULL;
+    char *scad = NULL, *compare = NULL;
+    char *printability = NULL, *printer = NULL;
+    double layer_height = 0;
+    char *cut_plan = NULL, *stock = NULL;
+    int kerf = 0;
+    char *bundle = NULL, *bundle_list = NULL, *bundle_extract = NULL, *bundle_delta = NULL, *bundle_apply = NULL;
+    char *pin_map = NULL, *map_target = NULL, *map_path = NULL, *map_format = "csv";
+    char *defines[SCAD_MAX_DEFINES];
+    int num_defines = 0;
+    int bend_segments = DEFAULT_BEND_SEGMENTS;
+    const footprint_writer_t* formats[MAX_OUTPUT_FORMATS] = { &footprint_writers[0] };
+    int num_formats = 1;
 
     footprint_options_t opts = {
         .double_sided = 1,
@@ -675,11 +442,74 @@ int main(int argc, char *argv[]) {
         {"double-sided", no_argument, 0, 'd'},
         {"single-sided", no_argument, 0, 's'},
         {"via-outside", no_argument, 0, 'v'},
+        {"format", required_argument, 0, 'f'},
         {"help", no_argument, 0, 'h'},
+        {"serve", no_argument, 0, OPT_SERVE},
+        {"socket", required_argument, 0, OPT_SOCKET},
+        {"connect", required_argument, 0, OPT_CONNECT},
+        {"cache-size", required_argument, 0, OPT_CACHE_SIZE},
+        {"root", required_argument, 0, OPT_ROOT},
+        {"trace", required_argument, 0, OPT_TRACE},
+        {"stats", no_argument, 0, OPT_STATS},
+        {"bench", no_argument, 0, OPT_BENCH},
+        {"bench-iterations", required_argument, 0, OPT_BENCH_ITERATIONS},
+        {"bench-filter", required_argument, 0, OPT_BENCH_FILTER},
+        {"bench-compare", required_argument, 0, OPT_BENCH_COMPARE},
+        {"bench-threshold", required_argument, 0, OPT_BENCH_THRESHOLD},
+        {"check", required_argument, 0, OPT_CHECK},
+        {"step-check", no_argument, 0, OPT_STEP_CHECK},
+        {"verbose", no_argument, 0, OPT_VERBOSE},
+        {"contact-sheet", required_argument, 0, OPT_CONTACT_SHEET},
+        {"against", required_argument, 0, OPT_AGAINST},
+        {"tile", required_argument, 0, OPT_TILE},
+        {"diff-overlay", required_argument, 0, OPT_DIFF_OVERLAY},
+        {"jobs", required_argument, 0, 'j'},
+        {"panel", required_argument, 0, OPT_PANEL},
+        {"panel-list", required_argument, 0, OPT_PANEL_LIST},
+        {"sweep", required_argument, 0, OPT_SWEEP},
+        {"fanout", no_argument, 0, OPT_FANOUT},
+        {"header-model", required_argument, 0, OPT_HEADER_MODEL},
+        {"bend-segments", required_argument, 0, OPT_BEND_SEGMENTS},
+        {"plug-model", required_argument, 0, OPT_PLUG_MODEL},
+        {"step-model", no_argument, 0, OPT_STEP_MODEL},
+        {"quote", required_argument, 0, OPT_QUOTE},
+        {"materials", required_argument, 0, OPT_MATERIALS},
+        {"material", required_argument, 0, OPT_MATERIAL},
+        {"quantity", required_argument, 0, OPT_QUANTITY},
+        {"index", required_argument, 0, OPT_INDEX},
+        {"find", required_argument, 0, OPT_FIND},
+        {"no-precompiled", no_argument, 0, OPT_NO_PRECOMPILED},
+        {"emit-precompiled", required_argument, 0, OPT_EMIT_PRECOMPILED},
+        {"emit-scad-specs", required_argument, 0, OPT_EMIT_SCAD_SPECS},
+        {"watch", no_argument, 0, OPT_WATCH},
+        {"specs", required_argument, 0, OPT_SPECS},
+        {"openscad", required_argument, 0, OPT_OPENSCAD},
+        {"run", required_argument, 0, OPT_RUN},
+        {"run-list", required_argument, 0, OPT_RUN_LIST},
+        {"shard", required_argument, 0, OPT_SHARD},
+        {"merge", required_argument, 0, OPT_MERGE},
+        {"scad", required_argument, 0, OPT_SCAD},
+        {"define", required_argument, 0, 'D'},
+        {"compare", required_argument, 0, OPT_COMPARE},
+        {"printability", required_argument, 0, OPT_PRINTABILITY},
+        {"printer", required_argument, 0, OPT_PRINTER},
+        {"layer-height", required_argument, 0, OPT_LAYER_HEIGHT},
+        {"cut-plan", required_argument, 0, OPT_CUT_PLAN},
+        {"stock", required_argument, 0, OPT_STOCK},
+        {"kerf", required_argument, 0, OPT_KERF},
+        {"bundle", required_argument, 0, OPT_BUNDLE},
+        {"bundle-list", required_argument, 0, OPT_BUNDLE_LIST},
+        {"bundle-extract", required_argument, 0, OPT_BUNDLE_EXTRACT},
+        {"bundle-delta", required_argument, 0, OPT_BUNDLE_DELTA},
+        {"bundle-apply", required_argument, 0, OPT_BUNDLE_APPLY},
+        {"pin-map", required_argument, 0, OPT_PIN_MAP},
+        {"map-target", required_argument, 0, OPT_MAP_TARGET},
+        {"map", required_argument, 0, OPT_MAP},
+        {"map-format", required_argument, 0, OPT_MAP_FORMAT},
         {0, 0, 0, 0}
     };
 
-    while ((opt = getopt_long(argc, argv, "p:o:dsvh", long_options, NULL)) != -1) {
+    while ((opt = getopt_long(argc, argv, "p:o:dsvf:j:D:h", long_options, NULL)) != -1) {
         switch (opt) {
         case 'p':
             pins = atoi(optarg);
@@ -697,49 +527,411 @@ int main(int argc, char *argv[]) {
         case 'v':
             opts.via_outside = 1;
             break;
+        case 'f':
+            num_formats = parse_formats(optarg, formats, MAX_OUTPUT_FORMATS);
+            if (num_formats <= 0) return 1;
+            break;
+        case 'j':
+            jobs = atoi(optarg);
+            if (jobs < 1) jobs = 1;
+            break;
         case 'h':
             print_usage(argv[0]);
             return 0;
+        case OPT_SERVE:
+            serve = 1;
+            break;
+        case OPT_SOCKET:
+            socket_path = optarg;
+            break;
+        case OPT_CONNECT:
+            connect_path = optarg;
+            break;
+        case OPT_CACHE_SIZE:
+            cache_size = atoi(optarg);
+            break;
+        case OPT_ROOT:
+            root = optarg;
+            break;
+        case OPT_TRACE:
+            trace_path = optarg;
+            break;
+        case OPT_STATS:
+            stats = 1;
+            break;
+        case OPT_BENCH:
+            bench = 1;
+            break;
+        case OPT_BENCH_ITERATIONS:
+            bench_iterations = atoi(optarg);
+            break;
+        case OPT_BENCH_FILTER:
+            bench_filter = optarg;
+            break;
+        case OPT_BENCH_COMPARE:
+            bench_baseline = optarg;
+            break;
+        case OPT_BENCH_THRESHOLD:
+            bench_threshold = atof(optarg);
+            break;
+        case OPT_CHECK:
+            check_library = optarg;
+            break;
+        case OPT_STEP_CHECK:
+            step_check = 1;
+            break;
+        case OPT_VERBOSE:
+            verbose = 1;
+            break;
+        case OPT_CONTACT_SHEET:
+            contact_sheet = optarg;
+            break;
+        case OPT_AGAINST:
+            against = optarg;
+            break;
+        case OPT_TILE:
+            tile = atoi(optarg);
+            break;
+        case OPT_DIFF_OVERLAY:
+            diff_old = optarg;
+            break;
+        case OPT_PANEL:
+            panel = optarg;
+            break;
+        case OPT_PANEL_LIST:
+            panel_list = optarg;
+            break;
+        case OPT_SWEEP:
+            if (num_sweeps <= MAX_SWEEPS) sweeps[num_sweeps++] = optarg;
+            break;
+        case OPT_FANOUT:
+            fanout = 1;
+            break;
+        case OPT_HEADER_MODEL:
+            header_model = optarg;
+            break;
+        case OPT_BEND_SEGMENTS:
+            bend_segments = atoi(optarg);
+            break;
+        case OPT_PLUG_MODEL:
+            plug_model = optarg;
+            break;
+        case OPT_STEP_MODEL:
+            opts.step_model = 1;
+            break;
+        case OPT_QUOTE:
+            quote = optarg;
+            break;
+        case OPT_MATERIALS:
+            materials = optarg;
+            break;
+        case OPT_MATERIAL:
+            material = optarg;
+            break;
+        case OPT_QUANTITY:
+            quantity = atoi(optarg);
+            break;
+        case OPT_INDEX:
+            index_path = optarg;
+            break;
+        case OPT_FIND:
+            find_path = optarg;
+            break;
+        case OPT_NO_PRECOMPILED:
+            use_precompiled = 0;
+            break;
+        case OPT_EMIT_PRECOMPILED:
+            emit_path = optarg;
+            break;
+        case OPT_EMIT_SCAD_SPECS:
+            emit_scad_path = optarg;
+            break;
+        case OPT_WATCH:
+            watch = 1;
+            break;
+        case OPT_SPECS:
+            specs_path = optarg;
+            break;
+        case OPT_OPENSCAD:
+            openscad = optarg;
+            break;
+        case OPT_RUN:
+            run_dir = optarg;
+            break;
+        case OPT_RUN_LIST:
+            run_list = optarg;
+            break;
+        case OPT_SHARD:
+            shard = optarg;
+            break;
+        case OPT_MERGE:
+            merge_dir = optarg;
+            break;
+        case OPT_SCAD:
+            scad = optarg;
+            break;
+        case 'D':
+            if (num_defines == SCAD_MAX_DEFINES) {
+                fprintf(stderr, "Error: more than %d -D assignments\n", SCAD_MAX_DEFINES);
+                return 1;
+            }
+            defines[num_defines++] = optarg;
+            break;
+        case OPT_COMPARE:
+            compare = optarg;
+            break;
+        case OPT_PRINTABILITY:
+            printability = optarg;
+            break;
+        case OPT_PRINTER:
+            printer = optarg;
+            break;
+        case OPT_LAYER_HEIGHT:
+            layer_height = atof(optarg);
+            if (layer_height <= 0) {
+                fprintf(stderr, "Error: --layer-height must be positive\n");
+                return 1;
+            }
+            break;
+        case OPT_CUT_PLAN:
+            cut_plan = optarg;
+            break;
+        case OPT_STOCK:
+            stock = optarg;
+            break;
+        case OPT_KERF:
+            kerf = atoi(optarg);
+            break;
+        case OPT_BUNDLE:
+            bundle = optarg;
+            break;
+        case OPT_BUNDLE_LIST:
+            bundle_list = optarg;
+            break;
+        case OPT_BUNDLE_EXTRACT:
+            bundle_extract = optarg;
+            break;
+        case OPT_BUNDLE_DELTA:
+            bundle_delta = optarg;
+            break;
+        case OPT_BUNDLE_APPLY:
+            bundle_apply = optarg;
+            break;
+        case OPT_PIN_MAP:
+            pin_map = optarg;
+            break;
+        case OPT_MAP_TARGET:
+            map_target = optarg;
+            break;
+        case OPT_MAP:
+            map_path = optarg;
+            break;
+        case OPT_MAP_FORMAT:
+            map_format = optarg;
+            break;
         default:
             print_usage(argv[0]);
             return 1;
         }
     }
 
+    if (trace_path || stats) {
+#ifdef PLCC_TRACE
+        trace_enable(trace_path, stats);
+#else
+        fprintf(stderr, "Error: plcc-gen was built without instrumentation (PLCC_TRACE)\n");
+        return 1;
+#endif
+    }
+
+    if (connect_path) {
+        return run_client(connect_path);
+    }
+
+    if (bench_baseline) {
+        if (optind >= argc) {
+            fprintf(stderr, "Error: --bench-compare needs the new results file as well\n");
+            return 1;
+        }
+        return compare_benchmarks(bench_baseline, argv[optind], bench_threshold);
+    }
+
+    if (emit_path) {
+        return emit_precompiled(emit_path);
+    }
+
+    if (emit_scad_path) {
+        return emit_scad_specs(emit_scad_path);
+    }
+
+    if (bench) {
+        return run_benchmarks(bench_iterations, bench_filter, root, openscad) | finish_instrumentation();
+    }
+
+    if (check_library) {
+        return run_check(check_library, verbose) | finish_instrumentation();
+    }
+
+    if (step_check) {
+        return run_step_check(argv + optind, argc - optind) | finish_instrumentation();
+    }
+
+    if (contact_sheet) {
+        return run_contact_sheet(contact_sheet, against, tile, jobs) | finish_instrumentation();
+    }
+
+    if (diff_old) {
+        if (optind >= argc || !outfile) {
+            fprintf(stderr, "Error: --diff-overlay needs the new footprint and --outfile\n");
+            return 1;
+        }
+        return run_diff_overlay(diff_old, argv[optind], outfile);
+    }
+
+    if (panel) {
+        if (num_sweeps > 1) {
+            fprintf(stderr, "Error: --panel takes one --sweep\n");
+            return 1;
+        }
+        return run_panel(panel, argv + optind, argc - optind, panel_list, num_sweeps ? sweeps[0] : NULL, fanout) |
+               finish_instrumentation();
+    }
+
+    if (run_dir) {
+        return run_sharded(run_dir, argv + optind, argc - optind, run_list, sweeps, num_sweeps, shard, root, jobs) |
+               finish_instrumentation();
+    }
+
+    if (merge_dir) {
+        return run_merge(merge_dir, argv + optind, argc - optind) | finish_instrumentation();
+    }
+
+    if (quote) {
+        return run_quote(quote, argv + optind, argc - optind, materials, material, quantity) | finish_instrumentation();
+    }
+
+    if (index_path) {
+        return run_index(index_path, argv + optind, argc - optind) | finish_instrumentation();
+    }
+
+    if (find_path) {
+        return run_find(find_path, argv + optind, argc - optind) | finish_instrumentation();
+    }
+
+    if (bundle) {
+        return run_bundle(bundle, argv + optind, argc - optind, root) | finish_instrumentation();
+    }
+
+    if (bundle_list) {
+        return run_bundle_list(bundle_list) | finish_instrumentation();
+    }
+
+    if (bundle_extract) {
+        return run_bundle_extract(bundle_extract, argv + optind, argc - optind, root, outfile) |
+               finish_instrumentation();
+    }
+
+    if (bundle_delta || bundle_apply) {
+        if (optind >= argc) {
+            fprintf(stderr, "Error: --bundle-%s needs a second bundle\n", bundle_delta ? "delta" : "apply");
+            return 1;
+        }
+        if (bundle_delta) return run_bundle_delta(bundle_delta, argv[optind], outfile) | finish_instrumentation();
+        return run_bundle_apply(bundle_apply, argv[optind], outfile) | finish_instrumentation();
+    }
+
+    if (scad) {
+        return run_scad(scad, defines, num_defines, outfile, compare) | finish_instrumentation();
+    }
+
+    if (pin_map) {
+        return run_pin_map(pin_map, map_target, map_path, map_format, outfile) | finish_instrumentation();
+    }
+
+    if (cut_plan) {
+        return run_cut_plan(cut_plan, argv + optind, argc - optind, stock, kerf);
+    }
+
+    if (printability) {
+        return run_printability(printability, argv + optind, argc - optind, defines, num_defines, printer,
+                                layer_height, verbose, jobs) | finish_instrumentation();
+    }
+
+    if (watch) {
+        return run_watch(root, specs_path, openscad, jobs, argv);
+    }
+
+    if (serve) {
+        return run_server(socket_path, root, cache_size) | finish_instrumentation();
+    }
+
     if (!pins_specified) {
         fprintf(stderr, "Error: --pins option is required\n");
         print_usage(argv[0]);
         return 1;
     }
 
-    component_spec_t* spec = find_component_by_pins(pins);
+    if (header_model) {
+        return run_header_model(pins, header_model, bend_segments, outfile) | finish_instrumentation();
+    }
+
+    if (plug_model) {
+        if (strcmp(plug_model, "step") != 0) {
+            fprintf(stderr, "Error: unknown plug model format '%s' (step)\n", plug_model);
+            return 1;
+        }
+        return run_step_model(pins, 0, outfile) | finish_instrumentation();
+    }
+
+    const component_spec_t* spec = find_component_by_pins(pins);
     if (!spec) {
         fprintf(stderr, "Error: Unsupported pin count %d\n", pins);
         fprintf(stderr, "Supported pin counts: 20, 28, 32, 44, 52, 68, 84\n");
         return 1;
     }
 
-    if (outfile) {
-        output = fopen(outfile, "w");
-        if (!output) {
-            perror("Error opening output file");
-            return 1;
+    if (num_formats > 1 && !outfile) {
+        fprintf(stderr, "Error: several output formats need --outfile\n");
+        return 1;
+    }
+
+    if (num_formats == 1 && formats[0] == &footprint_writers[0]) {
+        size_t size = 0;
+        char* data = precompiled_footprint(spec, &opts, &size);
+        if (data) {
+            int ret = write_output(outfile, data, size);
+            free(data);
+            return ret | finish_instrumentation();
         }
     }
 
+    // One geometry pass feeds every selected backend
     footprint_geometry_t* geometry = generate_geometry(spec, &opts);
     if (!geometry) {
         fprintf(stderr, "Error: Failed to generate geometry\n");
         return 1;
     }
 
-    write_kicad_footprint(output, geometry, spec, &opts);
-
-    free(geometry);
+    int ret = 0;
+    for (int i = 0; i < num_formats && ret == 0; i++) {
+        size_t size = 0;
+        char* data = render_footprint(geometry, spec, &opts, formats[i], &size);
+        if (!data) {
+            fprintf(stderr, "Error: Failed to format %s output\n", formats[i]->name);
+            ret = 1;
+            break;
+        }
 
-    if (outfile && output != stdout) {
-        fclose(output);
+        char path[4096];
+        const char* target = outfile;
+        if (num_formats > 1) {
+            output_path_for_format(path, sizeof(path), outfile, formats[i]);
+            target = path;
+        }
+        ret = write_output(target, data, size);
+        free(data);
     }
 
-    return 0;
+    free_geometry(geometry);
+    return ret | finish_instrumentation();
 }
@@ -0,0 +1,201 @@
+/* KiCAD footprint generator for APW9328 PLCC plugs - Version 2
+ * Types, part tables and helpers shared by every module of plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#ifndef PLCC_GEN_H
+#define PLCC_GEN_H
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <stdint.h>
+#include <limits.h>
+#include <stddef.h>
+#include <errno.h>
+#include <pthread.h>
+
+// ============================================================================
+// CORE DATA STRUCTURES
+// ============================================================================
+
+typedef struct {
+    double x, y;
+} point_t;
+
+typedef struct {
+    point_t start, end;
+    double width;
+    char layer[32];
+} line_t;
+
+typedef enum {
+    PAD_SMD,
+    PAD_THROUGHHOLE
+} pad_type_t;
+
+typedef struct {
+    double diameter;
+    point_t offset;
+} drill_info_t;
+
+typedef struct {
+    int number;
+    point_t position;
+    point_t size;
+    pad_type_t type;
+    drill_info_t drill;
+    char layers[64];
+} pad_t;
+
+typedef struct {
+    double a, b, c, d;  // Body dimensions from datasheet
+} dimensions_t;
+
+typedef struct {
+    char name[32];
+    int pins;
+    int pins_x, pins_y;
+    double pitch;
+    dimensions_t body;
+    double pad_width;
+    double offset_x, offset_y; 
+} component_spec_t;
+
+typedef struct {
+    int double_sided;     // 1 = throughhole with vias, 0 = SMD only
+    int via_outside;      // 1 = vias outside, 0 = vias inside
+    char timestamp[64];   // UUID for KiCad
+    int step_model;       // 1 = reference the STEP model instead of the VRML one
+} footprint_options_t;
+
+typedef enum {
+    SIDE_TOP,
+    SIDE_RIGHT,
+    SIDE_BOTTOM,
+    SIDE_LEFT,
+    SIDE_NONE             // pads of footprints read from a file
+} pin_side_t;
+
+typedef struct {
+    int number;
+    pin_side_t side;
+    int index;            // along the side, clockwise from its first pin
+    point_t position;     // pad centre
+    point_t size;
+} pin_info_t;
+
+typedef struct {
+    line_t* lines;
+    int count;
+    int capacity;
+} line_list_t;
+
+typedef struct {
+    pad_t* pads;          // one slot per pin plus one per via
+    int pad_count;
+    int pad_capacity;
+    line_list_t silkscreen;
+    line_list_t fab;
+    line_list_t courtyard;
+    point_t text_positions[3];  // reference, value, user
+} footprint_geometry_t;
+
+typedef struct {
+    int pins;
+    double a, b, c, d;    // plug (bottom) and lid (top) plate sizes
+    int pins_x, pins_y;
+} plug_spec_t;
+
+// ============================================================================
+// COMPONENT SPECIFICATIONS (specs.c)
+// ============================================================================
+
+// One per PART() in plcc-specs.def, so the tables have their size in
+// every module
+#define PART(...) + 1
+enum { NUM_PARTS = 0
+#include "plcc-specs.def"
+};
+#undef PART
+
+extern const component_spec_t component_specs[NUM_PARTS];
+extern const int num_component_specs;
+extern const plug_spec_t plug_specs[NUM_PARTS];
+extern const int num_plug_specs;
+
+const component_spec_t* find_component_by_pins(int pins);
+const plug_spec_t* find_plug_by_pins(int pins);
+const component_spec_t* find_component_by_name(const char* name);
+int validate_spec(const component_spec_t* spec);
+
+// ============================================================================
+// UTILITY FUNCTIONS (util.c)
+// ============================================================================
+
+int grow_array(void** array, int* capacity, int need, size_t size);
+uint64_t hash_bytes(const void* data, size_t len);
+void generate_timestamp(char* buffer, size_t size);
+int compare_ints(const void* a, const void* b);
+int compare_double(const void* a, const void* b);
+char* read_file(const char* path, size_t* size);
+char* read_text_file(const char* path, size_t* size);
+int replace_file(const char* path, const char* data, size_t size);
+
+typedef void (*parallel_fn_t)(void* ctx, int index);
+
+int default_jobs(void);
+void parallel_for(int count, int jobs, parallel_fn_t fn, void* ctx);
+
+// ============================================================================
+// INSTRUMENTATION (trace.c)
+// ============================================================================
+
+typedef enum {
+    STAGE_GEOMETRY,
+    STAGE_PINS,
+    STAGE_SILKSCREEN,
+    STAGE_COURTYARD,
+    STAGE_FAB,
+    STAGE_TEXT,
+    STAGE_WRITER,
+    STAGE_FILE_IO,
+    STAGE_MESH,
+    STAGE_VALIDATE,
+    STAGE_REQUEST,
+    STAGE_INDEX,
+    STAGE_QUERY,
+    STAGE_CSG,
+    STAGE_COUNT
+} trace_stage_t;
+
+double monotonic_us(void);
+int finish_instrumentation(void);
+
+#ifdef PLCC_TRACE
+
+extern int trace_active;
+
+void trace_record(trace_stage_t stage, double start_us, long items);
+void trace_enable(const char* path, int summary);
+
+#define TRACE_START(var) double var = trace_active ? monotonic_us() : 0
+#define TRACE_STOP(var, stage, items) \
+    do { if (trace_active) trace_record(stage, var, items); } while (0)
+
+#else
+
+#define TRACE_START(var) do { } while (0)
+#define TRACE_STOP(var, stage, items) do { } while (0)
+
+#endif
+
+#endif
@@ -0,0 +1,173 @@
+/* PNG encoder for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#include "png.h"
+
+// Minimal RGB PNG writer. The image data is deflated with the fixed Huffman
+// code; the only matches tried are the previous pixel and the pixel above,
+// which is all a flat-coloured preview needs to compress well.
+
+typedef struct {
+    uint8_t* data;
+    size_t len, cap;
+    uint32_t bits;
+    int nbits;
+} bitstream_t;
+
+static uint32_t crc_table[256];
+
+static void crc_init(void) {
+    for (uint32_t n = 0; n < 256; n++) {
+        uint32_t c = n;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? 0xedb88320U ^ (c >> 1) : c >> 1;
+        }
+        crc_table[n] = c;
+    }
+}
+
+static uint32_t crc32_update(uint32_t crc, const uint8_t* p, size_t len) {
+    crc = ~crc;
+    while (len--) {
+        crc = crc_table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static int bits_put(bitstream_t* bs, uint32_t value, int count) {
+    bs->bits |= value << bs->nbits;
+    bs->nbits += count;
+    while (bs->nbits >= 8) {
+        if (bs->len == bs->cap) {
+            size_t cap = bs->cap ? bs->cap * 2 : 65536;
+            uint8_t* d = realloc(bs->data, cap);
+            if (!d) return -1;
+            bs->data = d;
+            bs->cap = cap;
+        }
+        bs->data[bs->len++] = bs->bits & 0xff;
+        bs->bits >>= 8;
+        bs->nbits -= 8;
+    }
+    return 0;
+}
+
+// Huffman codes are stored most significant bit first
+static int bits_put_code(bitstream_t* bs, uint32_t code, int count) {
+    uint32_t rev = 0;
+    for (int i = 0; i < count; i++) {
+        rev = (rev << 1) | ((code >> i) & 1);
+    }
+    return bits_put(bs, rev, count);
+}
+
+static int deflate_symbol(bitstream_t* bs, int sym) {
+    if (sym < 144) return bits_put_code(bs, 0x30 + sym, 8);
+    if (sym < 256) return bits_put_code(bs, 0x190 + sym - 144, 9);
+    if (sym < 280) return bits_put_code(bs, sym - 256, 7);
+    return bits_put_code(bs, 0xc0 + sym - 280, 8);
+}
+
+static int deflate_match(bitstream_t* bs, int length, int distance) {
+    static const int len_base[] = {3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,35,43,51,59,67,83,99,115,131,163,195,227,258};
+    static const int len_extra[] = {0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0};
+    static const int dist_base[] = {1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,257,385,513,769,1025,1537,
+                                    2049,3073,4097,6145,8193,12289,16385,24577};
+    static const int dist_extra[] = {0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13};
+
+    int l = 28;
+    while (len_base[l] > length) l--;
+    int d = 29;
+    while (dist_base[d] > distance) d--;
+
+    if (deflate_symbol(bs, 257 + l) < 0) return -1;
+    if (len_extra[l] && bits_put(bs, length - len_base[l], len_extra[l]) < 0) return -1;
+    if (bits_put_code(bs, d, 5) < 0) return -1;
+    if (dist_extra[d] && bits_put(bs, distance - dist_base[d], dist_extra[d]) < 0) return -1;
+    return 0;
+}
+
+// zlib stream of raw, using back references at the given distances only
+static int zlib_compress(bitstream_t* bs, const uint8_t* raw, size_t len, const int* distances, int ndist) {
+    uint32_t a = 1, b = 0;
+    for (size_t i = 0; i < len; i++) {
+        a = (a + raw[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+
+    if (bits_put(bs, 0x78, 8) < 0 || bits_put(bs, 0x01, 8) < 0) return -1;
+    if (bits_put(bs, 1, 1) < 0 || bits_put(bs, 1, 2) < 0) return -1;   // final block, fixed Huffman
+
+    size_t i = 0;
+    while (i < len) {
+        int best = 0, best_dist = 0;
+        for (int k = 0; k < ndist; k++) {
+            size_t d = distances[k];
+            if (d > i || d > 32768) continue;
+            int n = 0;
+            while (n < 258 && i + n < len && raw[i + n] == raw[i + n - d]) n++;
+            if (n > best) {
+                best = n;
+                best_dist = (int)d;
+            }
+        }
+        if (best >= 3) {
+            if (deflate_match(bs, best, best_dist) < 0) return -1;
+            i += best;
+        } else {
+            if (deflate_symbol(bs, raw[i++]) < 0) return -1;
+        }
+    }
+    if (deflate_symbol(bs, 256) < 0) return -1;
+    if (bs->nbits && bits_put(bs, 0, 8 - bs->nbits) < 0) return -1;
+
+    uint8_t adler[4] = { b >> 8, b & 0xff, a >> 8, a & 0xff };
+    for (int k = 0; k < 4; k++) {
+        if (bits_put(bs, adler[k], 8) < 0) return -1;
+    }
+    return 0;
+}
+
+static void png_chunk(FILE* f, const char* type, const uint8_t* data, size_t len) {
+    uint8_t head[8] = { len >> 24, len >> 16, len >> 8, len, type[0], type[1], type[2], type[3] };
+    uint32_t crc = crc32_update(0, head + 4, 4);
+    crc = crc32_update(crc, data, len);
+    uint8_t tail[4] = { crc >> 24, crc >> 16, crc >> 8, crc };
+    fwrite(head, 1, 8, f);
+    if (len) fwrite(data, 1, len, f);
+    fwrite(tail, 1, 4, f);
+}
+
+int write_png(FILE* f, const uint8_t* rgb, int width, int height) {
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    size_t row = (size_t)width * 3 + 1;
+    uint8_t* raw = malloc(row * height);
+    if (!raw) return -1;
+
+    for (int y = 0; y < height; y++) {
+        raw[y * row] = 0;   // filter: none
+        memcpy(raw + y * row + 1, rgb + (size_t)y * width * 3, width * 3);
+    }
+
+    bitstream_t bs = {0};
+    int distances[] = { 3, (int)row };
+    int ret = zlib_compress(&bs, raw, row * height, distances, 2);
+    free(raw);
+    if (ret < 0) {
+        free(bs.data);
+        return -1;
+    }
+
+    if (!crc_table[1]) crc_init();
+    uint8_t ihdr[13] = { width >> 24, width >> 16, width >> 8, width,
+                         height >> 24, height >> 16, height >> 8, height,
+                         8, 2, 0, 0, 0 };   // 8 bit RGB
+    fwrite(signature, 1, 8, f);
+    png_chunk(f, "IHDR", ihdr, sizeof(ihdr));
+    png_chunk(f, "IDAT", bs.data, bs.len);
+    png_chunk(f, "IEND", NULL, 0);
+    free(bs.data);
+    return ferror(f) ? -1 : 0;
+}
@@ -0,0 +1,13 @@
+/* PNG encoder for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#ifndef PLCC_PNG_H
+#define PLCC_PNG_H
+
+#include "plcc-gen.h"
+
+int write_png(FILE* f, const uint8_t* rgb, int width, int height);
+
+#endif
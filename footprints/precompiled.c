@@ -0,0 +1,252 @@
+/* Precompiled footprints for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#include "precompiled.h"
+#include "backends.h"
+
+#include <unistd.h>
+
+// The KiCad output of the standard catalog only depends on the generator
+// itself, so the build renders it once with --emit-precompiled and links
+// the result back in (PLCC_PRECOMPILED, see the Makefile). Each footprint
+// is packed on its own with a small LZ77 coder in the LZ4 block layout, so
+// serving one costs a single pass over about 2 KiB of packed data instead
+// of a geometry run. Anything else (custom specs, other formats, STEP
+// model references) still goes through the engine.
+
+#define LZ_HASH_BITS 14
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 65535
+
+typedef struct {
+    int pins;
+    int double_sided, via_outside;
+    uint32_t offset;            // into precompiled_data
+    uint32_t packed_size, size;
+} precompiled_footprint_t;
+
+#ifdef PLCC_PRECOMPILED
+#include "precompiled-data.h"
+#else
+static const uint8_t* const precompiled_data = NULL;
+static const precompiled_footprint_t* const precompiled_footprints = NULL;
+static const int num_precompiled_footprints = 0;
+#endif
+
+int use_precompiled = 1;
+
+static uint8_t* lz_length(uint8_t* out, size_t n) {
+    for (; n >= 255; n -= 255) *out++ = 255;
+    *out++ = (uint8_t)n;
+    return out;
+}
+
+// Literals followed by a match, or only literals if match_len is zero
+static uint8_t* lz_sequence(uint8_t* out, const uint8_t* literals, size_t literal_len,
+                            size_t offset, size_t match_len) {
+    size_t m = match_len ? match_len - LZ_MIN_MATCH : 0;
+    *out++ = (uint8_t)((literal_len < 15 ? literal_len : 15) << 4 | (m < 15 ? m : 15));
+    if (literal_len >= 15) out = lz_length(out, literal_len - 15);
+    memcpy(out, literals, literal_len);
+    out += literal_len;
+    if (match_len) {
+        *out++ = offset & 0xff;
+        *out++ = offset >> 8;
+        if (m >= 15) out = lz_length(out, m - 15);
+    }
+    return out;
+}
+
+static uint32_t lz_hash(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return (v * 2654435761U) >> (32 - LZ_HASH_BITS);
+}
+
+// Greedy packing; out needs size + size / 255 + 16 bytes
+size_t lz_pack(const uint8_t* in, size_t size, uint8_t* out) {
+    static uint32_t table[1 << LZ_HASH_BITS];   // last position + 1
+    uint8_t* o = out;
+    size_t anchor = 0, i = 0;
+
+    memset(table, 0, sizeof(table));
+    while (i + LZ_MIN_MATCH <= size) {
+        uint32_t h = lz_hash(in + i);
+        size_t candidate = table[h];
+        table[h] = i + 1;
+        if (!candidate || i - (candidate - 1) > LZ_MAX_OFFSET || memcmp(in + candidate - 1, in + i, LZ_MIN_MATCH) != 0) {
+            i++;
+            continue;
+        }
+        size_t ref = candidate - 1, len = LZ_MIN_MATCH;
+        while (i + len < size && in[ref + len] == in[i + len]) len++;
+        o = lz_sequence(o, in + anchor, i - anchor, i - ref, len);
+        for (size_t k = i + 1; k < i + len && k + LZ_MIN_MATCH <= size; k++) table[lz_hash(in + k)] = k + 1;
+        i += len;
+        anchor = i;
+    }
+    o = lz_sequence(o, in + anchor, size - anchor, 0, 0);
+    return o - out;
+}
+
+// Returns 0 if in unpacks to exactly size bytes
+int lz_unpack(const uint8_t* in, size_t in_size, uint8_t* out, size_t size) {
+    const uint8_t* end = in + in_size;
+    size_t o = 0;
+
+    while (in < end) {
+        uint8_t token = *in++, b;
+        size_t literals = token >> 4, len = token & 15;
+        if (literals == 15) {
+            do {
+                if (in == end) return -1;
+                literals += b = *in++;
+            } while (b == 255);
+        }
+        if (literals > (size_t)(end - in) || literals > size - o) return -1;
+        memcpy(out + o, in, literals);
+        in += literals;
+        o += literals;
+        if (in == end) break;   // the last sequence has no match
+
+        if (end - in < 2) return -1;
+        size_t offset = in[0] | in[1] << 8;
+        in += 2;
+        if (len == 15) {
+            do {
+                if (in == end) return -1;
+                len += b = *in++;
+            } while (b == 255);
+        }
+        len += LZ_MIN_MATCH;
+        if (!offset || offset > o || len > size - o) return -1;
+        if (offset >= len) {
+            memcpy(out + o, out + o - offset, len);
+            o += len;
+        } else {
+            // Overlapping match: repeats the last offset bytes
+            for (size_t k = 0; k < len; k++, o++) out[o] = out[o - offset];
+        }
+    }
+    return o == size ? 0 : -1;
+}
+
+// Unpacked KiCad footprint of a standard part, or NULL if it has to be
+// generated
+char* precompiled_footprint(const component_spec_t* spec, const footprint_options_t* opts, size_t* size) {
+    const component_spec_t* s = find_component_by_pins(spec->pins);
+    if (!use_precompiled || opts->step_model || !s || strcmp(s->name, spec->name) != 0 ||
+        s->pins_x != spec->pins_x || s->pins_y != spec->pins_y || s->pitch != spec->pitch ||
+        memcmp(&s->body, &spec->body, sizeof(s->body)) != 0 || s->pad_width != spec->pad_width ||
+        s->offset_x != spec->offset_x || s->offset_y != spec->offset_y) {
+        return NULL;
+    }
+
+    for (int i = 0; i < num_precompiled_footprints; i++) {
+        const precompiled_footprint_t* p = &precompiled_footprints[i];
+        if (p->pins != spec->pins || p->double_sided != opts->double_sided || p->via_outside != opts->via_outside) {
+            continue;
+        }
+        TRACE_START(t_unpack);
+        char* data = malloc(p->size ? p->size : 1);
+        if (data && lz_unpack(precompiled_data + p->offset, p->packed_size, (uint8_t*)data, p->size) < 0) {
+            free(data);
+            data = NULL;
+        }
+        TRACE_STOP(t_unpack, STAGE_WRITER, data ? p->size : 0);
+        if (data) *size = p->size;
+        return data;
+    }
+    return NULL;
+}
+
+// Render the standard catalog as the C header the final build includes
+int emit_precompiled(const char* path) {
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        perror("Error opening output file");
+        return 1;
+    }
+    fprintf(f, "// Generated by plcc-gen --emit-precompiled; do not edit\n\n");
+    fprintf(f, "static const uint8_t precompiled_data[] = {");
+
+    precompiled_footprint_t table[4 * sizeof(component_specs) / sizeof(component_specs[0])];
+    int count = 0, ret = 0;
+    uint32_t offset = 0;
+    for (int i = 0; i < num_component_specs && ret == 0; i++) {
+        for (int v = 0; v < 4 && ret == 0; v++) {
+            footprint_options_t opts = { !(v & 2), v & 1, {0} };
+            generate_timestamp(opts.timestamp, sizeof(opts.timestamp));
+            size_t size = 0;
+            char* data = render_kicad_footprint(&component_specs[i], &opts, &size);
+            uint8_t* packed = data ? malloc(size + size / 255 + 16) : NULL;
+            if (!packed || count == (int)(sizeof(table) / sizeof(table[0]))) {
+                fprintf(stderr, "Error: failed to render %s\n", component_specs[i].name);
+                free(data);
+                free(packed);
+                ret = 1;
+                break;
+            }
+            size_t packed_size = lz_pack((const uint8_t*)data, size, packed);
+            for (size_t k = 0; k < packed_size; k++) {
+                fprintf(f, "%s0x%02x,", (offset + k) % 16 ? " " : "\n    ", packed[k]);
+            }
+            table[count++] = (precompiled_footprint_t){
+                component_specs[i].pins, opts.double_sided, opts.via_outside,
+                offset, packed_size, size
+            };
+            offset += packed_size;
+            free(packed);
+            free(data);
+        }
+    }
+
+    fprintf(f, "\n};\n\nstatic const precompiled_footprint_t precompiled_footprints[] = {\n");
+    for (int i = 0; i < count; i++) {
+        const precompiled_footprint_t* p = &table[i];
+        fprintf(f, "    {%d, %d, %d, %u, %u, %u},\n", p->pins, p->double_sided, p->via_outside,
+                p->offset, p->packed_size, p->size);
+    }
+    fprintf(f, "};\n\nstatic const int num_precompiled_footprints = %d;\n", count);
+    if (fclose(f) != 0) ret = 1;
+    if (ret) {
+        unlink(path);
+    } else {
+        fprintf(stderr, "%s: %d footprints, %u bytes packed\n", path, count, offset);
+    }
+    return ret;
+}
+
+// Write the plug dimensions of plcc-specs.def as the OpenSCAD include that
+// plug() in plccplug.scad reads. One line per plug, so that --watch can
+// tell which models a change affects.
+int emit_scad_specs(const char* path) {
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        perror("Error opening output file");
+        return 1;
+    }
+    fprintf(f, "// Generated by plcc-gen --emit-scad-specs from footprints/plcc-specs.def and\n"
+               "// footprints/plcc-plug.def; do not edit\n"
+               "//\n"
+               "// [pins, A, B, C, D, px, py]: plccplug(A, B, C, D, px, py) renders the plug\n\n"
+               "plug_specs = [\n");
+    for (int i = 0; i < num_plug_specs; i++) {
+        const plug_spec_t* p = &plug_specs[i];
+        fprintf(f, "    [%d, %5.2f, %5.2f, %5.2f, %5.2f, %2d, %2d]%s // %s\n", p->pins, p->a, p->b, p->c, p->d,
+                p->pins_x, p->pins_y, i + 1 < num_plug_specs ? "," : " ", component_specs[i].name);
+    }
+    fprintf(f, "];\n\n// Dimensions of every plug, from footprints/plcc-plug.def\n\n");
+#define PLUG_PARAM(name, scad_name, value, description) \
+    fprintf(f, "// %s\n%s = %g;\n", description, #scad_name, (double)(value));
+#include "plcc-plug.def"
+#undef PLUG_PARAM
+    if (fclose(f) != 0) {
+        perror("Error writing output file");
+        unlink(path);
+        return 1;
+    }
+    return 0;
+}
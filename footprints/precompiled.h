@@ -0,0 +1,19 @@
+/* Precompiled footprints for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#ifndef PLCC_PRECOMPILED_H
+#define PLCC_PRECOMPILED_H
+
+#include "plcc-gen.h"
+
+extern int use_precompiled;
+
+size_t lz_pack(const uint8_t* in, size_t size, uint8_t* out);
+int lz_unpack(const uint8_t* in, size_t in_size, uint8_t* out, size_t size);
+char* precompiled_footprint(const component_spec_t* spec, const footprint_options_t* opts, size_t* size);
+int emit_precompiled(const char* path);
+int emit_scad_specs(const char* path);
+
+#endif
@@ -0,0 +1,260 @@
+/* Preview tools for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#include "preview-tools.h"
+#include "check.h"
+#include "geometry.h"
+#include "png.h"
+#include "preview.h"
+
+// Contact sheet of every catalog variant and difference overlays between
+// two versions of a footprint, for reviewing geometry changes without KiCad.
+
+// Read a .kicad_mod back into geometry (pads and lines only)
+footprint_geometry_t* load_kicad_footprint(const char* data, size_t size) {
+    element_set_t set;
+    if (parse_footprint_elements(data, size, &set) < 0) {
+        free_element_set(&set);
+        return NULL;
+    }
+
+    footprint_geometry_t* geom = calloc(1, sizeof(footprint_geometry_t));
+    if (geom) {
+        geom->pad_capacity = set.count[ELEM_PAD] + set.count[ELEM_VIA];
+        geom->pads = calloc(geom->pad_capacity ? geom->pad_capacity : 1, sizeof(pad_t));
+    }
+    if (!geom || !geom->pads) {
+        free(geom);
+        free_element_set(&set);
+        return NULL;
+    }
+
+    for (int i = 0; i < set.total; i++) {
+        const char* e = set.text[i];
+        const char* s;
+        if (set.cls[i] == ELEM_PAD || set.cls[i] == ELEM_VIA) {
+            pad_t* p = &geom->pads[geom->pad_count++];
+            p->number = set.cls[i] == ELEM_PAD ? atoi(e + 6) : 0;
+            p->type = strstr(e, " thru_hole ") ? PAD_THROUGHHOLE : PAD_SMD;
+            if ((s = strstr(e, "(at "))) sscanf(s, "(at %lf %lf", &p->position.x, &p->position.y);
+            if ((s = strstr(e, "(size "))) sscanf(s, "(size %lf %lf", &p->size.x, &p->size.y);
+            if ((s = strstr(e, "(drill "))) sscanf(s, "(drill %lf", &p->drill.diameter);
+            if ((s = strstr(e, "(offset "))) sscanf(s, "(offset %lf %lf", &p->drill.offset.x, &p->drill.offset.y);
+        } else if (set.cls[i] == ELEM_SILKSCREEN || set.cls[i] == ELEM_FAB || set.cls[i] == ELEM_COURTYARD) {
+            line_t l = {0};
+            if ((s = strstr(e, "(start "))) sscanf(s, "(start %lf %lf", &l.start.x, &l.start.y);
+            if ((s = strstr(e, "(end "))) sscanf(s, "(end %lf %lf", &l.end.x, &l.end.y);
+            if ((s = strstr(e, "(width "))) sscanf(s, "(width %lf", &l.width);
+            if ((s = strstr(e, "(layer \""))) sscanf(s, "(layer \"%31[^\"]", l.layer);
+
+            line_list_t* list = set.cls[i] == ELEM_SILKSCREEN ? &geom->silkscreen :
+                                set.cls[i] == ELEM_FAB ? &geom->fab : &geom->courtyard;
+            if (grow_array((void**)&list->lines, &list->capacity, list->count + 1, sizeof(line_t)) < 0) {
+                free_geometry(geom);
+                free_element_set(&set);
+                return NULL;
+            }
+            list->lines[list->count++] = l;
+        }
+    }
+    free_element_set(&set);
+    return geom;
+}
+
+static footprint_geometry_t* load_kicad_file(const char* path) {
+    size_t size = 0;
+    char* data = read_file(path, &size);
+    if (!data) {
+        fprintf(stderr, "Error: %s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+    footprint_geometry_t* geom = load_kicad_footprint(data, size);
+    if (!geom) fprintf(stderr, "Error: %s: cannot parse footprint\n", path);
+    free(data);
+    return geom;
+}
+
+// Overlay two renderings: unchanged pixels are dimmed, pixels only in the
+// old version red, only in the new one green, changed colour yellow.
+// Returns the number of differing pixels.
+static long overlay_difference(canvas_t* out, const canvas_t* old_c, const canvas_t* new_c) {
+    long changed = 0;
+    for (int y = 0; y < out->height; y++) {
+        const uint8_t* o = old_c->pixels + (size_t)y * old_c->stride;
+        const uint8_t* n = new_c->pixels + (size_t)y * new_c->stride;
+        uint8_t* d = out->pixels + (size_t)y * out->stride;
+        for (int x = 0; x < out->width; x++, o += 3, n += 3, d += 3) {
+            int o_bg = o[0] == color_background.r && o[1] == color_background.g && o[2] == color_background.b;
+            int n_bg = n[0] == color_background.r && n[1] == color_background.g && n[2] == color_background.b;
+            int diff = abs(o[0] - n[0]) + abs(o[1] - n[1]) + abs(o[2] - n[2]);
+            rgb_t c;
+            if (diff <= 24) {
+                int grey = (n[0] + n[1] + n[2]) / 6 + 8;
+                c = (rgb_t){ grey, grey, grey };
+                if (n_bg) c = color_background;
+            } else {
+                changed++;
+                c = n_bg ? (rgb_t){0xff, 0x40, 0x40} : o_bg ? (rgb_t){0x40, 0xff, 0x40} : (rgb_t){0xff, 0xe0, 0x40};
+            }
+            d[0] = c.r;
+            d[1] = c.g;
+            d[2] = c.b;
+        }
+    }
+    return changed;
+}
+
+// Render old and new geometry onto c as a difference overlay
+static long render_difference(canvas_t* c, const footprint_geometry_t* old_geom, const footprint_geometry_t* new_geom) {
+    bounds_t b = geometry_bounds(old_geom), bn = geometry_bounds(new_geom);
+    bounds_add(&b, bn.min_x, bn.min_y);
+    bounds_add(&b, bn.max_x, bn.max_y);
+
+    canvas_t views[2];
+    long changed = -1;
+    for (int i = 0; i < 2; i++) {
+        views[i] = *c;
+        views[i].stride = c->width * 3;
+        views[i].pixels = malloc((size_t)views[i].stride * c->height);
+    }
+    if (views[0].pixels && views[1].pixels) {
+        for (int i = 0; i < 2; i++) {
+            canvas_fit(&views[i], b, c->scale);
+            canvas_clear(&views[i], color_background);
+            render_geometry(&views[i], i == 0 ? old_geom : new_geom);
+        }
+        changed = overlay_difference(c, &views[0], &views[1]);
+    }
+    free(views[0].pixels);
+    free(views[1].pixels);
+    return changed;
+}
+
+static int write_png_file(const char* path, const canvas_t* c) {
+    FILE* f = path ? fopen(path, "wb") : stdout;
+    if (!f) {
+        perror("Error opening output file");
+        return 1;
+    }
+    int ret = write_png(f, c->pixels, c->width, c->height) < 0;
+    if (path && fclose(f) != 0) ret = 1;
+    if (ret) fprintf(stderr, "Error: failed to write PNG\n");
+    return ret;
+}
+
+int run_diff_overlay(const char* old_path, const char* new_path, const char* outfile) {
+    footprint_geometry_t* old_geom = load_kicad_file(old_path);
+    footprint_geometry_t* new_geom = load_kicad_file(new_path);
+    int ret = 1;
+
+    if (old_geom && new_geom) {
+        bounds_t b = geometry_bounds(old_geom), bn = geometry_bounds(new_geom);
+        bounds_add(&b, bn.min_x, bn.min_y);
+        bounds_add(&b, bn.max_x, bn.max_y);
+
+        canvas_t c = {0};
+        c.width = (int)ceil((b.max_x - b.min_x + 2 * PREVIEW_MARGIN_MM) * PREVIEW_PX_PER_MM);
+        c.height = (int)ceil((b.max_y - b.min_y + 2 * PREVIEW_MARGIN_MM) * PREVIEW_PX_PER_MM);
+        c.stride = c.width * 3;
+        c.scale = PREVIEW_PX_PER_MM;
+        c.pixels = malloc((size_t)c.stride * c.height);
+        long changed = c.pixels ? render_difference(&c, old_geom, new_geom) : -1;
+        if (changed >= 0) {
+            fprintf(stderr, "%ld changed pixels\n", changed);
+            ret = write_png_file(outfile, &c);
+        }
+        free(c.pixels);
+    }
+    free_geometry(old_geom);
+    free_geometry(new_geom);
+    return ret;
+}
+
+typedef struct {
+    uint8_t* pixels;
+    int width, stride, tile, columns;
+    const char* against;     // library to diff with, or NULL
+    long changed[64];
+    int failed[64];
+} contact_sheet_t;
+
+static void render_contact_tile(void* ctx, int index) {
+    contact_sheet_t* sheet = ctx;
+    const component_spec_t* spec = &component_specs[index / 4];
+    int v = index % 4;
+    int tx = (index % sheet->columns) * sheet->tile;
+    int ty = (index / sheet->columns) * (sheet->tile + LABEL_HEIGHT);
+
+    canvas_t label = {
+        .pixels = sheet->pixels + (size_t)ty * sheet->stride + tx * 3,
+        .width = sheet->tile, .height = LABEL_HEIGHT, .stride = sheet->stride,
+    };
+    canvas_t c = label;
+    c.pixels += (size_t)LABEL_HEIGHT * sheet->stride;
+    c.height = sheet->tile;
+    canvas_clear(&label, (rgb_t){0x28, 0x2c, 0x30});
+    canvas_clear(&c, color_background);
+
+    footprint_options_t opts = { check_variants[v].double_sided, check_variants[v].via_outside, {0} };
+    generate_timestamp(opts.timestamp, sizeof(opts.timestamp));
+    footprint_geometry_t* geom = generate_geometry(spec, &opts);
+    if (!geom) {
+        sheet->failed[index] = 1;
+        return;
+    }
+
+    char text[96];
+    snprintf(text, sizeof(text), "%s%s", spec->name, check_variants[v].suffix);
+    if (sheet->against) {
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/%s.kicad_mod", sheet->against, text);
+        footprint_geometry_t* old_geom = load_kicad_file(path);
+        if (old_geom) {
+            bounds_t b = geometry_bounds(geom);
+            canvas_fit(&c, b, 0);
+            sheet->changed[index] = render_difference(&c, old_geom, geom);
+            free_geometry(old_geom);
+        } else {
+            sheet->failed[index] = 1;
+        }
+        if (sheet->changed[index]) strcat(text, " *");
+    } else {
+        canvas_fit(&c, geometry_bounds(geom), 0);
+        render_geometry(&c, geom);
+    }
+    draw_text(&label, 4, (LABEL_HEIGHT - 7) / 2, text, 1, color_text);
+    free_geometry(geom);
+}
+
+int run_contact_sheet(const char* outfile, const char* against, int tile, int jobs) {
+    contact_sheet_t sheet = { .tile = tile > 32 ? tile : DEFAULT_TILE_SIZE, .columns = 4, .against = against };
+    int tiles = num_component_specs * 4;
+    int rows = (tiles + sheet.columns - 1) / sheet.columns;
+
+    sheet.width = sheet.columns * sheet.tile;
+    sheet.stride = sheet.width * 3;
+    int height = rows * (sheet.tile + LABEL_HEIGHT);
+    sheet.pixels = calloc((size_t)sheet.stride, height);
+    if (!sheet.pixels) {
+        fprintf(stderr, "Error: out of memory\n");
+        return 1;
+    }
+
+    parallel_for(tiles, jobs, render_contact_tile, &sheet);
+
+    int ret = 0;
+    for (int i = 0; i < tiles; i++) {
+        if (sheet.failed[i]) {
+            ret = 1;
+        } else if (against && sheet.changed[i]) {
+            printf("%s%s: %ld changed pixels\n", component_specs[i / 4].name, check_variants[i % 4].suffix, sheet.changed[i]);
+        }
+    }
+
+    canvas_t c = { .pixels = sheet.pixels, .width = sheet.width, .height = height, .stride = sheet.stride };
+    ret |= write_png_file(outfile, &c);
+    free(sheet.pixels);
+    return ret;
+}
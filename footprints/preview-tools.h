@@ -0,0 +1,15 @@
+/* Preview tools for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#ifndef PLCC_PREVIEW_TOOLS_H
+#define PLCC_PREVIEW_TOOLS_H
+
+#include "plcc-gen.h"
+
+footprint_geometry_t* load_kicad_footprint(const char* data, size_t size);
+int run_diff_overlay(const char* old_path, const char* new_path, const char* outfile);
+int run_contact_sheet(const char* outfile, const char* against, int tile, int jobs);
+
+#endif
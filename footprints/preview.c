@@ -0,0 +1,330 @@
+/* Preview renderer for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#include "preview.h"
+#include "png.h"
+
+const rgb_t color_background = {0x10, 0x14, 0x18};
+static const rgb_t color_copper = {0xc8, 0x34, 0x34};
+static const rgb_t color_via = {0xc8, 0xa0, 0x30};
+static const rgb_t color_drill = {0x20, 0x20, 0x20};
+static const rgb_t color_front_silk = {0xf2, 0xed, 0xa1};
+static const rgb_t color_back_silk = {0xe8, 0xb2, 0xa7};
+static const rgb_t color_fab = {0xaf, 0xaf, 0xaf};
+static const rgb_t color_courtyard = {0xff, 0x26, 0xe2};
+const rgb_t color_text = {0xff, 0xff, 0xff};
+
+// Pads are drawn the KiCad way: the copper at the pad position plus the
+// drill offset, the hole at the pad position
+static point_t pad_copper(const pad_t* p) {
+    point_t c = { p->position.x + p->drill.offset.x, p->position.y + p->drill.offset.y };
+    return c;
+}
+
+static const char* layer_svg_color(const char* layer) {
+    if (strcmp(layer, "F.SilkS") == 0) return "#f2eda1";
+    if (strcmp(layer, "B.SilkS") == 0) return "#e8b2a7";
+    if (strcmp(layer, "F.CrtYd") == 0) return "#ff26e2";
+    return "#afafaf";
+}
+
+static rgb_t layer_color(const char* layer) {
+    if (strcmp(layer, "F.SilkS") == 0) return color_front_silk;
+    if (strcmp(layer, "B.SilkS") == 0) return color_back_silk;
+    if (strcmp(layer, "F.CrtYd") == 0) return color_courtyard;
+    return color_fab;
+}
+
+void canvas_clear(canvas_t* c, rgb_t color) {
+    for (int y = 0; y < c->height; y++) {
+        uint8_t* p = c->pixels + (size_t)y * c->stride;
+        for (int x = 0; x < c->width; x++, p += 3) {
+            p[0] = color.r;
+            p[1] = color.g;
+            p[2] = color.b;
+        }
+    }
+}
+
+static void blend_pixel(canvas_t* c, int x, int y, rgb_t color, double alpha) {
+    if (x < 0 || y < 0 || x >= c->width || y >= c->height || alpha <= 0) return;
+    if (alpha > 1) alpha = 1;
+    uint8_t* p = c->pixels + (size_t)y * c->stride + x * 3;
+    p[0] = (uint8_t)(p[0] + (color.r - p[0]) * alpha);
+    p[1] = (uint8_t)(p[1] + (color.g - p[1]) * alpha);
+    p[2] = (uint8_t)(p[2] + (color.b - p[2]) * alpha);
+}
+
+static double to_px(const canvas_t* c, double v, double centre, int size) {
+    return (v - centre) * c->scale + size / 2.0;
+}
+
+static void fill_rect(canvas_t* c, double x0, double y0, double x1, double y1, rgb_t color) {
+    double px0 = to_px(c, x0, c->cx, c->width), px1 = to_px(c, x1, c->cx, c->width);
+    double py0 = to_px(c, y0, c->cy, c->height), py1 = to_px(c, y1, c->cy, c->height);
+    for (int y = (int)floor(py0); y < (int)ceil(py1); y++) {
+        double cov_y = fmin(py1, y + 1) - fmax(py0, y);
+        for (int x = (int)floor(px0); x < (int)ceil(px1); x++) {
+            double cov_x = fmin(px1, x + 1) - fmax(px0, x);
+            blend_pixel(c, x, y, color, cov_x * cov_y);
+        }
+    }
+}
+
+static void fill_circle(canvas_t* c, double wx, double wy, double r, rgb_t color) {
+    double px = to_px(c, wx, c->cx, c->width), py = to_px(c, wy, c->cy, c->height);
+    double pr = r * c->scale;
+    for (int y = (int)floor(py - pr - 1); y <= (int)ceil(py + pr + 1); y++) {
+        for (int x = (int)floor(px - pr - 1); x <= (int)ceil(px + pr + 1); x++) {
+            double d = hypot(x + 0.5 - px, y + 0.5 - py);
+            blend_pixel(c, x, y, color, pr - d + 0.5);
+        }
+    }
+}
+
+static void stroke_segment(canvas_t* c, point_t a, point_t b, double width, rgb_t color) {
+    double ax = to_px(c, a.x, c->cx, c->width), ay = to_px(c, a.y, c->cy, c->height);
+    double bx = to_px(c, b.x, c->cx, c->width), by = to_px(c, b.y, c->cy, c->height);
+    double hw = fmax(width * c->scale, 1.0) / 2;
+    double dx = bx - ax, dy = by - ay;
+    double len2 = dx * dx + dy * dy;
+
+    for (int y = (int)floor(fmin(ay, by) - hw - 1); y <= (int)ceil(fmax(ay, by) + hw + 1); y++) {
+        for (int x = (int)floor(fmin(ax, bx) - hw - 1); x <= (int)ceil(fmax(ax, bx) + hw + 1); x++) {
+            double qx = x + 0.5 - ax, qy = y + 0.5 - ay;
+            double t = len2 > 0 ? (qx * dx + qy * dy) / len2 : 0;
+            if (t < 0) t = 0; else if (t > 1) t = 1;
+            double d = hypot(qx - t * dx, qy - t * dy);
+            blend_pixel(c, x, y, color, hw - d + 0.5);
+        }
+    }
+}
+
+// 5x7 bitmap font, one byte per row, bit 4 is the leftmost column
+static const char font_chars[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ-._/:";
+static const uint8_t font_glyphs[][7] = {
+    {0x0E,0x11,0x13,0x15,0x19,0x11,0x0E}, {0x04,0x0C,0x04,0x04,0x04,0x04,0x0E},
+    {0x0E,0x11,0x01,0x02,0x04,0x08,0x1F}, {0x1F,0x02,0x04,0x02,0x01,0x11,0x0E},
+    {0x02,0x06,0x0A,0x12,0x1F,0x02,0x02}, {0x1F,0x10,0x1E,0x01,0x01,0x11,0x0E},
+    {0x06,0x08,0x10,0x1E,0x11,0x11,0x0E}, {0x1F,0x01,0x02,0x04,0x08,0x08,0x08},
+    {0x0E,0x11,0x11,0x0E,0x11,0x11,0x0E}, {0x0E,0x11,0x11,0x0F,0x01,0x02,0x0C},
+    {0x0E,0x11,0x11,0x1F,0x11,0x11,0x11}, {0x1E,0x11,0x11,0x1E,0x11,0x11,0x1E},
+    {0x0E,0x11,0x10,0x10,0x10,0x11,0x0E}, {0x1C,0x12,0x11,0x11,0x11,0x12,0x1C},
+    {0x1F,0x10,0x10,0x1E,0x10,0x10,0x1F}, {0x1F,0x10,0x10,0x1E,0x10,0x10,0x10},
+    {0x0E,0x11,0x10,0x17,0x11,0x11,0x0F}, {0x11,0x11,0x11,0x1F,0x11,0x11,0x11},
+    {0x0E,0x04,0x04,0x04,0x04,0x04,0x0E}, {0x07,0x02,0x02,0x02,0x02,0x12,0x0C},
+    {0x11,0x12,0x14,0x18,0x14,0x12,0x11}, {0x10,0x10,0x10,0x10,0x10,0x10,0x1F},
+    {0x11,0x1B,0x15,0x15,0x11,0x11,0x11}, {0x11,0x11,0x19,0x15,0x13,0x11,0x11},
+    {0x0E,0x11,0x11,0x11,0x11,0x11,0x0E}, {0x1E,0x11,0x11,0x1E,0x10,0x10,0x10},
+    {0x0E,0x11,0x11,0x11,0x15,0x12,0x0D}, {0x1E,0x11,0x11,0x1E,0x14,0x12,0x11},
+    {0x0F,0x10,0x10,0x0E,0x01,0x01,0x1E}, {0x1F,0x04,0x04,0x04,0x04,0x04,0x04},
+    {0x11,0x11,0x11,0x11,0x11,0x11,0x0E}, {0x11,0x11,0x11,0x11,0x11,0x0A,0x04},
+    {0x11,0x11,0x11,0x15,0x15,0x15,0x0A}, {0x11,0x11,0x0A,0x04,0x0A,0x11,0x11},
+    {0x11,0x11,0x11,0x0A,0x04,0x04,0x04}, {0x1F,0x01,0x02,0x04,0x08,0x10,0x1F},
+    {0x00,0x00,0x00,0x1F,0x00,0x00,0x00}, {0x00,0x00,0x00,0x00,0x00,0x0C,0x0C},
+    {0x00,0x00,0x00,0x00,0x00,0x00,0x1F}, {0x00,0x01,0x02,0x04,0x08,0x10,0x00},
+    {0x00,0x0C,0x0C,0x00,0x0C,0x0C,0x00},
+};
+
+// Draw text with its top left corner at pixel (x, y), each font dot size px
+void draw_text(canvas_t* c, int x, int y, const char* text, int size, rgb_t color) {
+    for (; *text; text++, x += 6 * size) {
+        const char* g = strchr(font_chars, toupper((unsigned char)*text));
+        if (!g || !*text) continue;
+        const uint8_t* glyph = font_glyphs[g - font_chars];
+        for (int row = 0; row < 7; row++) {
+            for (int col = 0; col < 5; col++) {
+                if (!(glyph[row] & (0x10 >> col))) continue;
+                for (int dy = 0; dy < size; dy++) {
+                    for (int dx = 0; dx < size; dx++) {
+                        blend_pixel(c, x + col * size + dx, y + row * size + dy, color, 1);
+                    }
+                }
+            }
+        }
+    }
+}
+
+void bounds_add(bounds_t* b, double x, double y) {
+    if (x < b->min_x) b->min_x = x;
+    if (x > b->max_x) b->max_x = x;
+    if (y < b->min_y) b->min_y = y;
+    if (y > b->max_y) b->max_y = y;
+}
+
+bounds_t geometry_bounds(const footprint_geometry_t* geom) {
+    bounds_t b = { 1e9, 1e9, -1e9, -1e9 };
+    for (int i = 0; i < geom->pad_count; i++) {
+        const pad_t* p = &geom->pads[i];
+        point_t at = pad_copper(p);
+        bounds_add(&b, at.x - p->size.x / 2, at.y - p->size.y / 2);
+        bounds_add(&b, at.x + p->size.x / 2, at.y + p->size.y / 2);
+    }
+    const line_t* sets[] = { geom->silkscreen.lines, geom->fab.lines, geom->courtyard.lines };
+    const int counts[] = { geom->silkscreen.count, geom->fab.count, geom->courtyard.count };
+    for (int s = 0; s < 3; s++) {
+        for (int i = 0; i < counts[s]; i++) {
+            bounds_add(&b, sets[s][i].start.x, sets[s][i].start.y);
+            bounds_add(&b, sets[s][i].end.x, sets[s][i].end.y);
+        }
+    }
+    if (b.min_x > b.max_x) b = (bounds_t){ -1, -1, 1, 1 };
+    return b;
+}
+
+// Centre the canvas on the bounds; scale 0 means fit the canvas
+void canvas_fit(canvas_t* c, bounds_t b, double scale) {
+    double w = b.max_x - b.min_x + 2 * PREVIEW_MARGIN_MM;
+    double h = b.max_y - b.min_y + 2 * PREVIEW_MARGIN_MM;
+    c->cx = (b.min_x + b.max_x) / 2;
+    c->cy = (b.min_y + b.max_y) / 2;
+    c->scale = scale > 0 ? scale : fmin(c->width / w, c->height / h);
+}
+
+static void render_lines(canvas_t* c, const line_t* lines, int count) {
+    for (int i = 0; i < count; i++) {
+        stroke_segment(c, lines[i].start, lines[i].end, lines[i].width, layer_color(lines[i].layer));
+    }
+}
+
+void render_geometry(canvas_t* c, const footprint_geometry_t* geom) {
+    render_lines(c, geom->courtyard.lines, geom->courtyard.count);
+    render_lines(c, geom->fab.lines, geom->fab.count);
+
+    for (int i = 0; i < geom->pad_count; i++) {
+        const pad_t* p = &geom->pads[i];
+        point_t at = pad_copper(p);
+        if (p->number == 0) {
+            fill_circle(c, at.x, at.y, p->size.x / 2, color_via);
+        } else {
+            fill_rect(c, at.x - p->size.x / 2, at.y - p->size.y / 2,
+                      at.x + p->size.x / 2, at.y + p->size.y / 2, color_copper);
+        }
+    }
+    for (int i = 0; i < geom->pad_count; i++) {
+        const pad_t* p = &geom->pads[i];
+        if (p->type == PAD_THROUGHHOLE) {
+            fill_circle(c, p->position.x, p->position.y, p->drill.diameter / 2, color_drill);
+        }
+    }
+
+    // Back silkscreen first so the front one ends up on top
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < geom->silkscreen.count; i++) {
+            const line_t* l = &geom->silkscreen.lines[i];
+            if ((strcmp(l->layer, "B.SilkS") == 0) == (pass == 0)) {
+                stroke_segment(c, l->start, l->end, l->width, layer_color(l->layer));
+            }
+        }
+    }
+
+    // Pin numbers, one size for all pads so the labels line up; skipped
+    // when even the smallest size does not fit inside the pads
+    double avail = 1e9;
+    int digits = 1;
+    for (int i = 0; i < geom->pad_count; i++) {
+        const pad_t* p = &geom->pads[i];
+        if (p->number == 0) continue;
+        avail = fmin(avail, fmin(p->size.x, p->size.y));
+        if (p->number >= 10 && digits < 2) digits = 2;
+        if (p->number >= 100) digits = 3;
+    }
+    // Library files round to 1um; keep that from flipping the text size
+    int size = (int)((avail * c->scale + 1e-3) / (6 * digits));
+    if (size > 3) size = 3;
+    if (size < 1) return;
+
+    for (int i = 0; i < geom->pad_count; i++) {
+        const pad_t* p = &geom->pads[i];
+        if (p->number == 0) continue;
+        char num[16];
+        int len = snprintf(num, sizeof(num), "%d", p->number);
+        point_t at = pad_copper(p);
+        int px = (int)lround(to_px(c, at.x, c->cx, c->width)) - (6 * len - 1) * size / 2;
+        int py = (int)lround(to_px(c, at.y, c->cy, c->height)) - 7 * size / 2;
+        draw_text(c, px, py, num, size, color_text);
+    }
+}
+
+void write_png_footprint(FILE* f, footprint_geometry_t* geom, const component_spec_t* spec, footprint_options_t* opts) {
+    (void)spec;
+    (void)opts;
+    bounds_t b = geometry_bounds(geom);
+    canvas_t c = {0};
+    c.width = (int)ceil((b.max_x - b.min_x + 2 * PREVIEW_MARGIN_MM) * PREVIEW_PX_PER_MM);
+    c.height = (int)ceil((b.max_y - b.min_y + 2 * PREVIEW_MARGIN_MM) * PREVIEW_PX_PER_MM);
+    c.stride = c.width * 3;
+    c.pixels = malloc((size_t)c.stride * c.height);
+    if (!c.pixels) return;
+
+    canvas_fit(&c, b, PREVIEW_PX_PER_MM);
+    canvas_clear(&c, color_background);
+    render_geometry(&c, geom);
+    write_png(f, c.pixels, c.width, c.height);
+    free(c.pixels);
+}
+
+static void write_svg_line(FILE* f, const line_t* l) {
+    fprintf(f, "<line x1=\"%.3f\" y1=\"%.3f\" x2=\"%.3f\" y2=\"%.3f\" stroke=\"%s\" stroke-width=\"%g\"/>\n",
+            l->start.x, l->start.y, l->end.x, l->end.y, layer_svg_color(l->layer), l->width);
+}
+
+void write_svg_footprint(FILE* f, footprint_geometry_t* geom, const component_spec_t* spec, footprint_options_t* opts) {
+    (void)opts;
+    bounds_t b = geometry_bounds(geom);
+    double m = PREVIEW_MARGIN_MM;
+
+    fprintf(f, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+    fprintf(f, "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%.2fmm\" height=\"%.2fmm\" viewBox=\"%.3f %.3f %.3f %.3f\">\n",
+            b.max_x - b.min_x + 2 * m, b.max_y - b.min_y + 2 * m,
+            b.min_x - m, b.min_y - m, b.max_x - b.min_x + 2 * m, b.max_y - b.min_y + 2 * m);
+    fprintf(f, "<title>%s</title>\n", spec->name);
+    fprintf(f, "<rect x=\"%.3f\" y=\"%.3f\" width=\"%.3f\" height=\"%.3f\" fill=\"#101418\"/>\n",
+            b.min_x - m, b.min_y - m, b.max_x - b.min_x + 2 * m, b.max_y - b.min_y + 2 * m);
+
+    fprintf(f, "<g stroke-linecap=\"round\">\n");
+    for (int i = 0; i < geom->courtyard.count; i++) write_svg_line(f, &geom->courtyard.lines[i]);
+    for (int i = 0; i < geom->fab.count; i++) write_svg_line(f, &geom->fab.lines[i]);
+    fprintf(f, "</g>\n");
+
+    fprintf(f, "<g fill=\"#c83434\">\n");
+    for (int i = 0; i < geom->pad_count; i++) {
+        pad_t* p = &geom->pads[i];
+        point_t at = pad_copper(p);
+        if (p->number == 0) {
+            fprintf(f, "<circle cx=\"%.3f\" cy=\"%.3f\" r=\"%.3f\" fill=\"#c8a030\"/>\n",
+                    at.x, at.y, p->size.x / 2);
+        } else {
+            fprintf(f, "<rect x=\"%.3f\" y=\"%.3f\" width=\"%.3f\" height=\"%.3f\"/>\n",
+                    at.x - p->size.x / 2, at.y - p->size.y / 2, p->size.x, p->size.y);
+        }
+    }
+    fprintf(f, "</g>\n<g fill=\"#202020\">\n");
+    for (int i = 0; i < geom->pad_count; i++) {
+        pad_t* p = &geom->pads[i];
+        if (p->type == PAD_THROUGHHOLE) {
+            fprintf(f, "<circle cx=\"%.3f\" cy=\"%.3f\" r=\"%.3f\"/>\n",
+                    p->position.x, p->position.y, p->drill.diameter / 2);
+        }
+    }
+    fprintf(f, "</g>\n<g stroke-linecap=\"round\">\n");
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < geom->silkscreen.count; i++) {
+            line_t* l = &geom->silkscreen.lines[i];
+            if ((strcmp(l->layer, "B.SilkS") == 0) == (pass == 0)) write_svg_line(f, l);
+        }
+    }
+    fprintf(f, "</g>\n");
+
+    fprintf(f, "<g fill=\"#ffffff\" font-family=\"monospace\" font-size=\"0.5\" text-anchor=\"middle\" dominant-baseline=\"central\">\n");
+    for (int i = 0; i < geom->pad_count; i++) {
+        pad_t* p = &geom->pads[i];
+        if (p->number) {
+            point_t at = pad_copper(p);
+            fprintf(f, "<text x=\"%.3f\" y=\"%.3f\">%d</text>\n", at.x, at.y, p->number);
+        }
+    }
+    fprintf(f, "</g>\n</svg>\n");
+}
@@ -0,0 +1,44 @@
+/* Preview renderer for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#ifndef PLCC_PREVIEW_H
+#define PLCC_PREVIEW_H
+
+#include "plcc-gen.h"
+
+#define PREVIEW_PX_PER_MM 40.0
+#define PREVIEW_MARGIN_MM 1.5
+#define DEFAULT_TILE_SIZE 480
+#define LABEL_HEIGHT 18
+
+typedef struct {
+    uint8_t r, g, b;
+} rgb_t;
+
+// A view onto an RGB buffer; world (mm) maps to pixels around the centre
+typedef struct {
+    uint8_t* pixels;
+    int width, height, stride;
+    double scale;          // pixels per mm
+    double cx, cy;         // world coordinate at the canvas centre
+} canvas_t;
+
+typedef struct {
+    double min_x, min_y, max_x, max_y;
+} bounds_t;
+
+extern const rgb_t color_background;
+extern const rgb_t color_text;
+
+void canvas_clear(canvas_t* c, rgb_t color);
+void draw_text(canvas_t* c, int x, int y, const char* text, int size, rgb_t color);
+void bounds_add(bounds_t* b, double x, double y);
+bounds_t geometry_bounds(const footprint_geometry_t* geom);
+void canvas_fit(canvas_t* c, bounds_t b, double scale);
+void render_geometry(canvas_t* c, const footprint_geometry_t* geom);
+void write_png_footprint(FILE* f, footprint_geometry_t* geom, const component_spec_t* spec, footprint_options_t* opts);
+void write_svg_footprint(FILE* f, footprint_geometry_t* geom, const component_spec_t* spec, footprint_options_t* opts);
+
+#endif
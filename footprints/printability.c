@@ -0,0 +1,628 @@
+/* Printability analysis for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#include "printability.h"
+#include "mesh-analysis.h"
+#include "mesh-boolean.h"
+#include "mesh.h"
+#include "scad.h"
+
+// Layer by layer check of a model against what a printer can resolve. A
+// sweep over the triangles sorted by lowest z cuts the mesh in the middle
+// of every layer; each cut triangle gives one segment with the material on
+// its left, and the segments are chained into loops by their end points.
+// From the middle of every segment one ray looks straight into the
+// material and one straight into the void, as far as the printer's
+// resolution: the nearest segment hit is the local wall or gap width. Runs
+// of too narrow segments along a loop are features, and features that
+// overlap from one layer to the next form a region. Overhangs are downward
+// facing triangles steeper than the printer allows; thin steps are flat
+// faces closer together than a layer.
+
+#define MAX_PRINTERS 8
+#define PRINT_MAX_VARIANTS 64
+
+typedef struct {
+    char name[32];
+    double resolution;          // narrowest wall or gap, mm
+    double layer;               // layer height, mm
+    double overhang;            // steepest unsupported face, degrees from vertical
+} printer_t;
+
+// Rough figures; --printer picks one, --layer-height overrides the layer
+static const printer_t default_printers[] = {
+    {"fdm-0.4", 0.45, 0.20, 45},    // lines come out a bit wider than the nozzle
+    {"fdm-0.2", 0.25, 0.10, 45},
+    {"resin", 0.10, 0.05, 45},      // two 50 um pixels
+    {"PA12", 0.30, 0.10, 90},       // SLS; the powder carries overhangs
+};
+
+enum { PRINT_WALL, PRINT_GAP };
+
+static const char* const print_kind_names[] = { "wall", "gap" };
+
+typedef struct {
+    double x0, y0, x1, y1;      // material on the left going from 0 to 1
+    double width[2];            // wall and gap; INFINITY if wide enough
+    int next;                   // following segment of the loop, -1 if none
+    int seen;
+} slice_segment_t;
+
+typedef struct {
+    int kind;                   // PRINT_WALL or PRINT_GAP
+    int layer;
+    double width;
+    double box[4];              // x0 y0 x1 y1
+    int parent;                 // union-find, joining layers into regions
+    int layers, last_layer;     // at the roots, over the whole region
+} print_feature_t;
+
+typedef struct {
+    int islands, holes;
+    double area;
+    int features[2];
+    double narrowest[2];
+    double overhang;
+} print_layer_t;
+
+typedef struct {
+    const printer_t* printer;
+    slice_segment_t* segments;
+    int segment_count, segment_capacity;
+    int* table;                 // segments by start point, open addressing
+    int table_capacity;
+    double* boxes;
+    int box_capacity;
+    int* ids;
+    int id_capacity;
+    int* hits;
+    int hit_count, hit_capacity;
+    int* path;
+    int path_capacity;
+    print_feature_t* features;
+    int feature_count, feature_capacity;
+    int failed;
+} slicer_t;
+
+static double triangle_zmin(const mesh_t* mesh, int t) {
+    const int* v = mesh->triangles[t];
+    return fmin(mesh->vertices[v[0]].z, fmin(mesh->vertices[v[1]].z, mesh->vertices[v[2]].z));
+}
+
+static double triangle_zmax(const mesh_t* mesh, int t) {
+    const int* v = mesh->triangles[t];
+    return fmax(mesh->vertices[v[0]].z, fmax(mesh->vertices[v[1]].z, mesh->vertices[v[2]].z));
+}
+
+static int compare_triangle_zmin(const void* x, const void* y, void* arg) {
+    double a = triangle_zmin(arg, *(const int*)x), b = triangle_zmin(arg, *(const int*)y);
+    return (a > b) - (a < b);
+}
+
+// Where plane z crosses edge a-b. The end points are ordered first, so
+// both triangles sharing the edge get the same bits.
+static void slice_point(vec3_t a, vec3_t b, double z, double* x, double* y) {
+    if (a.z > b.z) {
+        vec3_t t = a;
+        a = b;
+        b = t;
+    }
+    double t = (z - a.z) / (b.z - a.z);
+    *x = a.x + t * (b.x - a.x);
+    *y = a.y + t * (b.y - a.y);
+}
+
+// The segment where plane z cuts triangle t. Vertices on the plane count
+// as above it, which keeps the loops closed; returns 0 if the plane misses
+// the triangle or only touches it.
+static int slice_triangle(const mesh_t* mesh, int t, double z, slice_segment_t* s) {
+    vec3_t v[3];
+    int above = 0, k = 0;
+    for (int i = 0; i < 3; i++) {
+        v[i] = mesh->vertices[mesh->triangles[t][i]];
+        above += v[i].z >= z;
+    }
+    if (above == 0 || above == 3) return 0;
+    // k is the vertex alone on its side of the plane
+    for (int i = 0; i < 3; i++) {
+        if ((v[i].z >= z) == (above == 1)) k = i;
+    }
+    vec3_t a = v[k], b = v[(k + 1) % 3], c = v[(k + 2) % 3];
+    if (above == 1) {
+        slice_point(a, b, z, &s->x0, &s->y0);
+        slice_point(c, a, z, &s->x1, &s->y1);
+    } else {
+        slice_point(c, a, z, &s->x0, &s->y0);
+        slice_point(a, b, z, &s->x1, &s->y1);
+    }
+    if (s->x0 == s->x1 && s->y0 == s->y1) return 0;
+    s->width[PRINT_WALL] = s->width[PRINT_GAP] = INFINITY;
+    s->next = -1;
+    s->seen = 0;
+    return 1;
+}
+
+// Link every segment to the one starting where it ends
+static int slice_chain(slicer_t* sl) {
+    int n = sl->segment_count, size = 16;
+    while (size < 2 * n) size *= 2;
+    if (grow_array((void**)&sl->table, &sl->table_capacity, size, sizeof(int)) < 0) return -1;
+    memset(sl->table, -1, size * sizeof(int));
+    for (int i = 0; i < n; i++) {
+        const slice_segment_t* s = &sl->segments[i];
+        uint64_t j = weld_hash(s->x0, s->y0, 0) & (size - 1);
+        while (sl->table[j] >= 0) j = (j + 1) & (size - 1);
+        sl->table[j] = i;
+    }
+    for (int i = 0; i < n; i++) {
+        slice_segment_t* s = &sl->segments[i];
+        uint64_t j = weld_hash(s->x1, s->y1, 0) & (size - 1);
+        for (; sl->table[j] >= 0; j = (j + 1) & (size - 1)) {
+            const slice_segment_t* o = &sl->segments[sl->table[j]];
+            if (o->x0 == s->x1 && o->y0 == s->y1) {
+                s->next = sl->table[j];
+                break;
+            }
+        }
+    }
+    return 0;
+}
+
+// Distance along o + t * d, 0 < t <= 1, to the nearest segment other than
+// self; INFINITY if there is none
+static double slice_ray(slicer_t* sl, const bvh_t* bvh, int self, double z,
+                        double ox, double oy, double dx, double dy) {
+    double best = INFINITY;
+    sl->hit_count = 0;
+    if (bvh_query_segment(bvh, (vec3_t){ ox, oy, z }, (vec3_t){ ox + dx, oy + dy, z },
+                          &sl->hits, &sl->hit_count, &sl->hit_capacity) < 0) {
+        sl->failed = 1;
+        return best;
+    }
+    for (int i = 0; i < sl->hit_count; i++) {
+        const slice_segment_t* s = &sl->segments[sl->hits[i]];
+        if (sl->hits[i] == self) continue;
+        double ex = s->x1 - s->x0, ey = s->y1 - s->y0;
+        double wx = s->x0 - ox, wy = s->y0 - oy;
+        double denom = dx * ey - dy * ex;
+        if (denom == 0) continue;
+        double t = (wx * ey - wy * ex) / denom, u = (wx * dy - wy * dx) / denom;
+        if (t > 1e-9 && t <= 1 && u >= 0 && u <= 1 && t < best) best = t;
+    }
+    return best * hypot(dx, dy);
+}
+
+static int slice_add_feature(slicer_t* sl, int kind, int layer, const int* run, int n) {
+    if (grow_array((void**)&sl->features, &sl->feature_capacity, sl->feature_count + 1, sizeof(print_feature_t)) < 0) {
+        return -1;
+    }
+    print_feature_t* f = &sl->features[sl->feature_count];
+    *f = (print_feature_t){ kind, layer, INFINITY, { INFINITY, INFINITY, -INFINITY, -INFINITY },
+                            sl->feature_count, 1, layer };
+    for (int i = 0; i < n; i++) {
+        const slice_segment_t* s = &sl->segments[run[i]];
+        f->width = fmin(f->width, s->width[kind]);
+        f->box[0] = fmin(f->box[0], fmin(s->x0, s->x1));
+        f->box[1] = fmin(f->box[1], fmin(s->y0, s->y1));
+        f->box[2] = fmax(f->box[2], fmax(s->x0, s->x1));
+        f->box[3] = fmax(f->box[3], fmax(s->y0, s->y1));
+    }
+    sl->feature_count++;
+    return 0;
+}
+
+// Runs of narrow segments along one loop or open chain
+static int slice_runs(slicer_t* sl, int layer, const int* path, int n, int closed, print_layer_t* out) {
+    double limit = sl->printer->resolution - 1e-9;
+    for (int kind = 0; kind < 2; kind++) {
+        int start = 0;
+        if (closed) {
+            // begin behind a wide segment, so no run wraps around
+            while (start < n && sl->segments[path[start]].width[kind] < limit) start++;
+            if (start == n) {
+                if (slice_add_feature(sl, kind, layer, path, n) < 0) return -1;
+                out->features[kind]++;
+                continue;
+            }
+        }
+        int run = 0;
+        for (int i = 0; i <= n; i++) {
+            int j = (start + i) % n;
+            if (i < n && sl->segments[path[j]].width[kind] < limit) {
+                sl->path[n + run++] = path[j];
+                continue;
+            }
+            if (!run) continue;
+            if (slice_add_feature(sl, kind, layer, sl->path + n, run) < 0) return -1;
+            out->features[kind]++;
+            run = 0;
+        }
+    }
+    return 0;
+}
+
+// Widths, loops and narrow features of the current layer's segments
+static int slice_layer(slicer_t* sl, int layer, double z, print_layer_t* out) {
+    int n = sl->segment_count;
+    double reach = sl->printer->resolution;
+    bvh_t bvh;
+
+    out->narrowest[PRINT_WALL] = out->narrowest[PRINT_GAP] = INFINITY;
+    if (!n) return 0;
+    if (slice_chain(sl) < 0 ||
+        grow_array((void**)&sl->boxes, &sl->box_capacity, 6 * n, sizeof(double)) < 0 ||
+        grow_array((void**)&sl->ids, &sl->id_capacity, n, sizeof(int)) < 0 ||
+        grow_array((void**)&sl->path, &sl->path_capacity, 2 * n, sizeof(int)) < 0) return -1;
+    for (int i = 0; i < n; i++) {
+        const slice_segment_t* s = &sl->segments[i];
+        double* b = &sl->boxes[6 * i];
+        b[0] = fmin(s->x0, s->x1);
+        b[1] = fmin(s->y0, s->y1);
+        b[3] = fmax(s->x0, s->x1);
+        b[4] = fmax(s->y0, s->y1);
+        b[2] = b[5] = z;
+        sl->ids[i] = i;
+        out->area += (s->x0 * s->y1 - s->x1 * s->y0) / 2;
+    }
+    if (bvh_build(&bvh, sl->boxes, sl->ids, n) < 0) return -1;
+
+    for (int i = 0; i < n; i++) {
+        slice_segment_t* s = &sl->segments[i];
+        double dx = s->x1 - s->x0, dy = s->y1 - s->y0, len = hypot(dx, dy);
+        double mx = (s->x0 + s->x1) / 2, my = (s->y0 + s->y1) / 2;
+        double nx = -dy / len * reach, ny = dx / len * reach;
+        s->width[PRINT_WALL] = slice_ray(sl, &bvh, i, z, mx, my, nx, ny);
+        s->width[PRINT_GAP] = slice_ray(sl, &bvh, i, z, mx, my, -nx, -ny);
+        for (int k = 0; k < 2; k++) out->narrowest[k] = fmin(out->narrowest[k], s->width[k]);
+    }
+    bvh_free(&bvh);
+    if (sl->failed) return -1;
+
+    for (int i = 0; i < n; i++) {
+        if (sl->segments[i].seen) continue;
+        int count = 0;
+        for (int j = i; j >= 0 && !sl->segments[j].seen; j = sl->segments[j].next) {
+            sl->segments[j].seen = 1;
+            sl->path[count++] = j;
+        }
+        int closed = sl->segments[sl->path[count - 1]].next == i;
+        if (closed) {
+            double area = 0;
+            for (int j = 0; j < count; j++) {
+                const slice_segment_t* s = &sl->segments[sl->path[j]];
+                area += s->x0 * s->y1 - s->x1 * s->y0;
+            }
+            if (area > 0) out->islands++;
+            else out->holes++;
+        }
+        if (slice_runs(sl, layer, sl->path, count, closed, out) < 0) return -1;
+    }
+    return 0;
+}
+
+static int feature_find(print_feature_t* f, int i) {
+    while (f[i].parent != i) {
+        f[i].parent = f[f[i].parent].parent;
+        i = f[i].parent;
+    }
+    return i;
+}
+
+// Join features of one layer to overlapping ones of the same kind below.
+// The lower index stays the root, so roots come first in layer order.
+static void slice_join(slicer_t* sl, int below, int first) {
+    double margin = sl->printer->resolution;
+    print_feature_t* f = sl->features;
+    for (int i = first; i < sl->feature_count; i++) {
+        for (int j = below; j < first; j++) {
+            if (f[i].kind != f[j].kind || f[i].box[0] > f[j].box[2] + margin || f[j].box[0] > f[i].box[2] + margin ||
+                f[i].box[1] > f[j].box[3] + margin || f[j].box[1] > f[i].box[3] + margin) continue;
+            int a = feature_find(f, i), b = feature_find(f, j);
+            if (a < b) f[b].parent = a;
+            else if (b < a) f[a].parent = b;
+        }
+    }
+}
+
+static void slicer_free(slicer_t* sl) {
+    free(sl->segments);
+    free(sl->table);
+    free(sl->boxes);
+    free(sl->ids);
+    free(sl->hits);
+    free(sl->path);
+    free(sl->features);
+}
+
+static void print_json_width(FILE* f, double w) {
+    if (isinf(w)) fprintf(f, "null");
+    else fprintf(f, "%.3f", w);
+}
+
+// Slice mesh for one printer and write a JSON line about it to f, preceded
+// by one line per layer with verbose
+static int print_analyse(const mesh_t* mesh, const printer_t* printer, const char* label, int verbose, FILE* f) {
+    slicer_t sl = { .printer = printer };
+    print_layer_t* layers = NULL;
+    int *order = NULL, *active = NULL;
+    double* levels = NULL;
+    int ret = -1;
+    double start = monotonic_us();
+
+    int count = mesh->triangle_count;
+    if (!count) {
+        fprintf(stderr, "Error: %s: empty model\n", label);
+        return -1;
+    }
+    double zmin = INFINITY, zmax = -INFINITY;
+    for (int t = 0; t < count; t++) {
+        zmin = fmin(zmin, triangle_zmin(mesh, t));
+        zmax = fmax(zmax, triangle_zmax(mesh, t));
+    }
+    double h = printer->layer;
+    int layer_count = (int)ceil((zmax - zmin) / h - 1e-9);
+    if (layer_count < 1) layer_count = 1;
+
+    layers = calloc(layer_count, sizeof(print_layer_t));
+    order = malloc(count * sizeof(int));
+    active = malloc(count * sizeof(int));
+    levels = malloc(count * sizeof(double));
+    if (!layers || !order || !active || !levels) goto out;
+    for (int t = 0; t < count; t++) order[t] = t;
+    qsort_r(order, count, sizeof(int), compare_triangle_zmin, (void*)mesh);
+
+    // Sweep: triangles join when the plane reaches their lowest point and
+    // leave once it passes their highest
+    int next = 0, active_count = 0;
+    for (int layer = 0, below = 0; layer < layer_count; layer++) {
+        double z = zmin + (layer + 0.5) * h;
+        while (next < count && triangle_zmin(mesh, order[next]) <= z) active[active_count++] = order[next++];
+        int kept = 0;
+        sl.segment_count = 0;
+        for (int i = 0; i < active_count; i++) {
+            int t = active[i];
+            if (triangle_zmax(mesh, t) < z) continue;
+            active[kept++] = t;
+            if (grow_array((void**)&sl.segments, &sl.segment_capacity, sl.segment_count + 1, sizeof(slice_segment_t)) < 0) {
+                goto out;
+            }
+            sl.segment_count += slice_triangle(mesh, t, z, &sl.segments[sl.segment_count]);
+        }
+        active_count = kept;
+        int first = sl.feature_count;
+        if (slice_layer(&sl, layer, z, &layers[layer]) < 0) goto out;
+        slice_join(&sl, below, first);
+        below = first;
+    }
+
+    // Overhangs by face, off the build plate; flat faces give the steps
+    double sin_limit = sin(printer->overhang * M_PI / 180), overhang = 0;
+    int level_count = 0;
+    for (int t = 0; t < count; t++) {
+        const int* v = mesh->triangles[t];
+        vec3_t a = mesh->vertices[v[0]], b = mesh->vertices[v[1]], c = mesh->vertices[v[2]];
+        vec3_t n = vec3_cross(vec3_sub(b, a), vec3_sub(c, a));
+        double len = sqrt(vec3_dot(n, n));
+        if (len == 0) continue;
+        if (a.z == b.z && b.z == c.z) levels[level_count++] = a.z;
+        if (-n.z / len > sin_limit + 1e-9 && triangle_zmax(mesh, t) > zmin) {
+            int layer = (int)(((a.z + b.z + c.z) / 3 - zmin) / h);
+            if (layer >= layer_count) layer = layer_count - 1;
+            layers[layer].overhang += -n.z / 2;
+            overhang += -n.z / 2;
+        }
+    }
+    levels[level_count++] = zmin;
+    levels[level_count++] = zmax;
+    qsort(levels, level_count, sizeof(double), compare_double);
+
+    // Regions: the roots, with the layers of all their features
+    int regions[2] = { 0, 0 };
+    double narrowest[2] = { INFINITY, INFINITY };
+    print_feature_t* ft = sl.features;
+    for (int i = 0; i < sl.feature_count; i++) {
+        int r = feature_find(ft, i);
+        narrowest[ft[i].kind] = fmin(narrowest[ft[i].kind], ft[i].width);
+        if (r == i) {
+            regions[ft[i].kind]++;
+            continue;
+        }
+        if (ft[i].layer != ft[r].last_layer) {
+            ft[r].layers++;
+            ft[r].last_layer = ft[i].layer;
+        }
+        ft[r].width = fmin(ft[r].width, ft[i].width);
+        for (int k = 0; k < 2; k++) {
+            ft[r].box[k] = fmin(ft[r].box[k], ft[i].box[k]);
+            ft[r].box[k + 2] = fmax(ft[r].box[k + 2], ft[i].box[k + 2]);
+        }
+    }
+
+    double elapsed = monotonic_us() - start;
+    for (int i = 0; verbose && i < layer_count; i++) {
+        const print_layer_t* l = &layers[i];
+        fprintf(f, "{\"model\":\"%s\",\"printer\":\"%s\",\"layer\":%d,\"z_mm\":%.3f,\"islands\":%d,\"holes\":%d,"
+                   "\"area_mm2\":%.3f,\"narrow_walls\":%d,\"min_wall_mm\":",
+                label, printer->name, i, zmin + (i + 0.5) * h, l->islands, l->holes, l->area, l->features[PRINT_WALL]);
+        print_json_width(f, l->narrowest[PRINT_WALL]);
+        fprintf(f, ",\"narrow_gaps\":%d,\"min_gap_mm\":", l->features[PRINT_GAP]);
+        print_json_width(f, l->narrowest[PRINT_GAP]);
+        fprintf(f, ",\"overhang_mm2\":%.3f}\n", l->overhang);
+    }
+
+    fprintf(f, "{\"model\":\"%s\",\"printer\":\"%s\",\"resolution_mm\":%g,\"layer_mm\":%g,\"overhang_deg\":%g,"
+               "\"triangles\":%d,\"layers\":%d,\"time_ms\":%.3f",
+            label, printer->name, printer->resolution, h, printer->overhang, count, layer_count, elapsed / 1000);
+    for (int kind = 0; kind < 2; kind++) {
+        fprintf(f, ",\"narrow_%ss\":{\"regions\":%d,\"min_mm\":", print_kind_names[kind], regions[kind]);
+        print_json_width(f, narrowest[kind]);
+        fprintf(f, "}");
+    }
+    fprintf(f, ",\"overhang_mm2\":%.3f,\"thin_steps\":[", overhang);
+    int thin = 0;
+    for (int i = 1, last = 0; i < level_count; i++) {
+        if (levels[i] - levels[last] < 1e-6) continue;
+        if (levels[i] - levels[last] < h - 1e-9) {
+            fprintf(f, "%s[%.3f,%.3f]", thin++ ? "," : "", levels[last], levels[i]);
+        }
+        last = i;
+    }
+    fprintf(f, "],\"printable\":%s,\"needs_support\":%s",
+            regions[PRINT_WALL] || regions[PRINT_GAP] || thin ? "false" : "true", overhang > 0 ? "true" : "false");
+    if (verbose) {
+        fprintf(f, ",\"regions\":[");
+        for (int i = 0, n = 0; i < sl.feature_count; i++) {
+            if (ft[i].parent != i) continue;
+            fprintf(f, "%s{\"kind\":\"%s\",\"z_mm\":[%.3f,%.3f],\"layers\":%d,\"width_mm\":%.3f,"
+                       "\"bbox_mm\":[%.3f,%.3f,%.3f,%.3f]}",
+                    n++ ? "," : "", print_kind_names[ft[i].kind], zmin + (ft[i].layer + 0.5) * h,
+                    zmin + (ft[i].last_layer + 0.5) * h, ft[i].layers, ft[i].width,
+                    ft[i].box[0], ft[i].box[1], ft[i].box[2], ft[i].box[3]);
+        }
+        fprintf(f, "]");
+    }
+    fprintf(f, "}\n");
+    ret = 0;
+
+out:
+    if (ret < 0) fprintf(stderr, "Error: %s: out of memory\n", label);
+    slicer_free(&sl);
+    free(layers);
+    free(order);
+    free(active);
+    free(levels);
+    return ret;
+}
+
+// One model to check: an STL file, or a scad file with its -D assignments
+typedef struct {
+    const char* path;
+    char* defines[SCAD_MAX_DEFINES];
+    int define_count;
+    char variant[3][32];        // the swept assignments
+    char label[256];
+    char* output;
+    size_t size;
+    int failed;
+} print_item_t;
+
+typedef struct {
+    print_item_t* items;
+    const printer_t* printers;
+    int printer_count;
+    int verbose;
+} print_batch_t;
+
+static void print_item(void* ctx, int index) {
+    print_batch_t* batch = ctx;
+    print_item_t* item = &batch->items[index];
+    mesh_t mesh = { 0 };
+    size_t len = strlen(item->path);
+
+    int scad = len > 5 && strcmp(item->path + len - 5, ".scad") == 0;
+    if ((scad ? scad_render(item->path, item->defines, item->define_count, 1, &mesh) : load_stl(item->path, &mesh)) < 0) {
+        item->failed = 1;
+        return;
+    }
+    FILE* f = open_memstream(&item->output, &item->size);
+    if (!f) {
+        item->failed = 1;
+        mesh_free(&mesh);
+        return;
+    }
+    for (int i = 0; i < batch->printer_count; i++) {
+        if (print_analyse(&mesh, &batch->printers[i], item->label, batch->verbose, f) < 0) item->failed = 1;
+    }
+    fclose(f);
+    mesh_free(&mesh);
+}
+
+static int has_define(char** defines, int count, const char* name) {
+    size_t len = strlen(name);
+    for (int i = 0; i < count; i++) {
+        if (strncmp(defines[i], name, len) == 0 && (defines[i][len] == '=' || defines[i][len] == ' ')) return 1;
+    }
+    return 0;
+}
+
+// Check every file for every printer, scad files for every plug size and
+// both pin tolerances (output_pins, clumsy_printer) unless -D fixes them,
+// at scale_factor 1 unless -D sets one.
+// The models are rendered and sliced on jobs threads; output keeps the
+// order of the files.
+int run_printability(const char* first, char** files, int nfiles, char** defines, int define_count,
+                     const char* printer, double layer_height, int verbose, int jobs) {
+    printer_t printers[MAX_PRINTERS];
+    int printer_count = 0;
+    print_item_t* items = calloc((nfiles + 1) * PRINT_MAX_VARIANTS, sizeof(print_item_t));
+    int count = 0, ret = 0;
+
+    if (!items) {
+        fprintf(stderr, "Error: out of memory\n");
+        return 1;
+    }
+    for (size_t i = 0; i < sizeof(default_printers) / sizeof(default_printers[0]); i++) {
+        if (printer && strcmp(default_printers[i].name, printer) != 0) continue;
+        printers[printer_count] = default_printers[i];
+        if (layer_height > 0) printers[printer_count].layer = layer_height;
+        printer_count++;
+    }
+    if (!printer_count) {
+        fprintf(stderr, "Error: unknown printer '%s'\n", printer);
+        free(items);
+        return 1;
+    }
+    if (define_count > SCAD_MAX_DEFINES - 3) {
+        fprintf(stderr, "Error: more than %d -D assignments\n", SCAD_MAX_DEFINES - 3);
+        free(items);
+        return 1;
+    }
+
+    for (int f = -1; f < nfiles; f++) {
+        const char* path = f < 0 ? first : files[f];
+        size_t len = strlen(path);
+        int scad = len > 5 && strcmp(path + len - 5, ".scad") == 0;
+        int sizes = scad && !has_define(defines, define_count, "output_pins") ? num_plug_specs : 1;
+        int tolerances = scad && !has_define(defines, define_count, "clumsy_printer") ? 2 : 1;
+        int unscaled = scad && !has_define(defines, define_count, "scale_factor");
+        for (int s = 0; s < sizes; s++) {
+            for (int t = 0; t < tolerances; t++) {
+                print_item_t* item = &items[count++];
+                item->path = path;
+                snprintf(item->label, sizeof(item->label), "%s", path);
+                if (!scad) continue;
+                memcpy(item->defines, defines, define_count * sizeof(char*));
+                item->define_count = define_count;
+                if (sizes > 1) {
+                    snprintf(item->variant[0], sizeof(item->variant[0]), "output_pins=%d", plug_specs[s].pins);
+                    item->defines[item->define_count++] = item->variant[0];
+                }
+                if (tolerances > 1) {
+                    snprintf(item->variant[1], sizeof(item->variant[1]), "clumsy_printer=%d", t);
+                    item->defines[item->define_count++] = item->variant[1];
+                }
+                // plccplug.scad only defaults it for all_versions
+                if (unscaled) {
+                    snprintf(item->variant[2], sizeof(item->variant[2]), "scale_factor=1");
+                    item->defines[item->define_count++] = item->variant[2];
+                }
+                for (int i = 0; i < item->define_count; i++) {
+                    size_t used = strlen(item->label);
+                    snprintf(item->label + used, sizeof(item->label) - used, " %s", item->defines[i]);
+                }
+            }
+        }
+    }
+
+    print_batch_t batch = { items, printers, printer_count, verbose };
+    parallel_for(count, jobs, print_item, &batch);
+    for (int i = 0; i < count; i++) {
+        if (items[i].output) fwrite(items[i].output, 1, items[i].size, stdout);
+        if (items[i].failed) ret = 1;
+        free(items[i].output);
+    }
+    free(items);
+    return ret;
+}
@@ -0,0 +1,14 @@
+/* Printability analysis for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#ifndef PLCC_PRINTABILITY_H
+#define PLCC_PRINTABILITY_H
+
+#include "plcc-gen.h"
+
+int run_printability(const char* first, char** files, int nfiles, char** defines, int define_count,
+                     const char* printer, double layer_height, int verbose, int jobs);
+
+#endif
@@ -0,0 +1,1756 @@
+/* OpenSCAD evaluator for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#include "scad.h"
+#include "mesh-analysis.h"
+#include "mesh-boolean.h"
+#include "mesh.h"
+
+// Renders the models from their OpenSCAD sources without OpenSCAD. Only the
+// part of the language plccplug.scad and angle_header.scad are written in
+// is understood: modules, for, if/else, assignments, use <...>, include
+// <...>, the primitives cube, cylinder, polyhedron, square and circle,
+// translate, rotate, scale, mirror, color, union, difference,
+// intersection, rotate_extrude and echo, with the usual expressions and a
+// handful of builtin functions.
+//
+// Primitives are tessellated the way OpenSCAD does it ($fn, $fa, $fs) and
+// combined with mesh_boolean(), so the result describes the same solid as
+// an OpenSCAD render, down to the facets.
+
+#define SCAD_MAX_ARGS 16
+#define SCAD_MAX_FILES 8
+#define SCAD_MAX_DEPTH 100          // nested module calls
+#define SCAD_MAX_LOOP 1000000       // elements of one for loop
+#define SCAD_ARENA_BLOCK 65536
+#define SCAD_GRID_FINE 0.00000095367431640625
+#define SCAD_SNAP 4294967296.0       // vertex grid, 2^-32 mm
+
+enum { TOK_EOF, TOK_NUMBER, TOK_STRING, TOK_IDENT, TOK_PATH, TOK_OP };
+enum { OP_EQ = 256, OP_NE, OP_LE, OP_GE, OP_AND, OP_OR };
+
+enum {
+    EXPR_NUMBER, EXPR_STRING, EXPR_BOOL, EXPR_UNDEF, EXPR_VAR, EXPR_VECTOR,
+    EXPR_RANGE, EXPR_UNARY, EXPR_BINARY, EXPR_TERNARY, EXPR_CALL, EXPR_INDEX,
+};
+
+enum { STMT_ASSIGN, STMT_CALL, STMT_IF, STMT_FOR, STMT_BLOCK, STMT_MODULE };
+
+enum { VAL_UNDEF, VAL_BOOL, VAL_NUMBER, VAL_STRING, VAL_VECTOR, VAL_RANGE };
+
+typedef struct scad_block {
+    struct scad_block* next;
+    size_t used, size;
+    max_align_t data[];
+} scad_block_t;
+
+typedef struct scad_expr scad_expr_t;
+struct scad_expr {
+    int kind;                   // EXPR_*
+    int op;                     // unary and binary operators
+    int line;
+    double number;
+    const char* name;           // variable or function name, string text
+    scad_expr_t** args;         // operands, elements or call arguments
+    const char** arg_names;     // call arguments; NULL entries are positional
+    int arg_count;
+};
+
+typedef struct scad_stmt scad_stmt_t;
+
+typedef struct {
+    scad_stmt_t** items;
+    int count;
+} scad_body_t;
+
+typedef struct scad_file scad_file_t;
+
+typedef struct {
+    const char* name;
+    const char** params;
+    scad_expr_t** defaults;     // NULL entries have no default
+    int param_count;
+    scad_body_t body;
+    scad_file_t* file;          // names in the body resolve here
+} scad_module_t;
+
+struct scad_stmt {
+    int kind;                   // STMT_*
+    int line;
+    char modifier;              // '*', '%', '#', '!' or 0
+    const char* name;           // assignment target or called module
+    scad_expr_t* value;         // assigned value or condition
+    scad_expr_t** args;         // call arguments or loop ranges
+    const char** arg_names;     // argument names or loop variables
+    int arg_count;
+    scad_body_t body;           // children, then branch, loop body
+    scad_body_t other;          // else branch
+    scad_module_t* module;      // STMT_MODULE
+};
+
+typedef struct scad_scope scad_scope_t;
+
+struct scad_file {
+    const char* path;
+    scad_body_t body;
+    scad_file_t* uses[SCAD_MAX_FILES];
+    int use_count;
+    scad_scope_t* scope;        // top level assignments
+};
+
+typedef struct scad_value scad_value_t;
+struct scad_value {
+    int type;                   // VAL_*
+    double number;              // number, bool, first of a range
+    double step, end;           // range
+    const char* string;
+    scad_value_t* items;        // vector
+    int count;
+};
+
+struct scad_scope {
+    scad_scope_t* parent;       // lexically enclosing scope
+    scad_scope_t* caller;       // module scopes: where $ variables continue
+    scad_file_t* file;          // where module names resolve
+    const char** names;
+    scad_value_t* values;
+    int count, capacity;
+};
+
+typedef struct {
+    point_t* points;
+    int count;
+} scad_polygon_t;
+
+// What a statement produced: solids in world coordinates, or outlines
+// below rotate_extrude
+typedef struct {
+    mesh_t* solids;
+    int solid_count, solid_capacity;
+    scad_polygon_t* polygons;
+    int polygon_count, polygon_capacity;
+} scad_shapes_t;
+
+typedef struct {
+    scad_value_t values[SCAD_MAX_ARGS];
+    const char* names[SCAD_MAX_ARGS];
+    int count;
+} scad_args_t;
+
+typedef struct {
+    scad_block_t* arena;
+    scad_file_t* files[SCAD_MAX_FILES];
+    int file_count;
+    scad_scope_t* root;         // $fn, $fa, $fs
+    int depth;
+    int failed;
+    int quiet;                  // no ECHO output
+} scad_t;
+
+typedef struct {
+    scad_t* s;
+    const char* path;
+    const char* p;
+    const char* end;
+    int line;
+    int kind;                   // TOK_*
+    int op;
+    double number;
+    char* text;
+    int token_line;
+    int depth;                  // of nested include <>
+} scad_lexer_t;
+
+static const scad_value_t scad_undef = { VAL_UNDEF, 0, 0, 0, NULL, NULL, 0 };
+
+static void* scad_alloc(scad_t* s, size_t size) {
+    size = (size + sizeof(max_align_t) - 1) / sizeof(max_align_t) * sizeof(max_align_t);
+    scad_block_t* b = s->arena;
+    if (!b || b->used + size > b->size) {
+        size_t bytes = size > SCAD_ARENA_BLOCK ? size : SCAD_ARENA_BLOCK;
+        b = malloc(sizeof(scad_block_t) + bytes);
+        if (!b) {
+            if (!s->failed) fprintf(stderr, "Error: out of memory\n");
+            s->failed = 1;
+            return NULL;
+        }
+        b->next = s->arena;
+        b->used = 0;
+        b->size = bytes;
+        s->arena = b;
+    }
+    void* p = (char*)b->data + b->used;
+    b->used += size;
+    memset(p, 0, size);
+    return p;
+}
+
+static char* scad_strndup(scad_t* s, const char* text, size_t len) {
+    char* p = scad_alloc(s, len + 1);
+    if (p) memcpy(p, text, len);
+    return p;
+}
+
+static void scad_free(scad_t* s) {
+    while (s->arena) {
+        scad_block_t* next = s->arena->next;
+        free(s->arena);
+        s->arena = next;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Parser
+// ---------------------------------------------------------------------------
+
+static void scad_syntax_error(scad_lexer_t* l, const char* what) {
+    if (!l->s->failed) fprintf(stderr, "Error: %s:%d: %s\n", l->path, l->token_line, what);
+    l->s->failed = 1;
+    l->kind = TOK_EOF;
+}
+
+static void scad_next(scad_lexer_t* l) {
+    for (;;) {
+        while (l->p < l->end && isspace((unsigned char)*l->p)) {
+            if (*l->p++ == '\n') l->line++;
+        }
+        if (l->end - l->p >= 2 && l->p[0] == '/' && l->p[1] == '/') {
+            while (l->p < l->end && *l->p != '\n') l->p++;
+        } else if (l->end - l->p >= 2 && l->p[0] == '/' && l->p[1] == '*') {
+            for (l->p += 2; l->p < l->end && !(l->end - l->p >= 2 && l->p[0] == '*' && l->p[1] == '/'); l->p++) {
+                if (*l->p == '\n') l->line++;
+            }
+            l->p = l->p < l->end ? l->p + 2 : l->end;
+        } else {
+            break;
+        }
+    }
+    l->token_line = l->line;
+    if (l->s->failed || l->p >= l->end) {
+        l->kind = TOK_EOF;
+        return;
+    }
+
+    const char* start = l->p;
+    char c = *l->p;
+    if (isdigit((unsigned char)c) || (c == '.' && l->p + 1 < l->end && isdigit((unsigned char)l->p[1]))) {
+        char* endp;
+        l->number = strtod(start, &endp);
+        l->p = endp;
+        l->kind = TOK_NUMBER;
+    } else if (isalpha((unsigned char)c) || c == '_' || c == '$') {
+        while (l->p < l->end && (isalnum((unsigned char)*l->p) || *l->p == '_' || *l->p == '$')) l->p++;
+        l->text = scad_strndup(l->s, start, l->p - start);
+        l->kind = TOK_IDENT;
+    } else if (c == '"') {
+        char* out = scad_alloc(l->s, l->end - l->p);
+        size_t n = 0;
+        for (l->p++; l->p < l->end && *l->p != '"'; l->p++) {
+            if (*l->p == '\\' && l->p + 1 < l->end) {
+                l->p++;
+                c = *l->p == 'n' ? '\n' : *l->p == 't' ? '\t' : *l->p;
+            } else {
+                c = *l->p;
+            }
+            if (out) out[n++] = c;
+        }
+        if (l->p >= l->end) {
+            scad_syntax_error(l, "unterminated string");
+            return;
+        }
+        l->p++;
+        l->text = out;
+        l->kind = TOK_STRING;
+    } else {
+        static const struct {
+            char text[3];
+            int op;
+        } pairs[] = { {"==", OP_EQ}, {"!=", OP_NE}, {"<=", OP_LE}, {">=", OP_GE}, {"&&", OP_AND}, {"||", OP_OR} };
+        l->kind = TOK_OP;
+        l->op = c;
+        l->p++;
+        for (size_t i = 0; i < sizeof(pairs) / sizeof(pairs[0]); i++) {
+            if (l->p < l->end && c == pairs[i].text[0] && *l->p == pairs[i].text[1]) {
+                l->op = pairs[i].op;
+                l->p++;
+                break;
+            }
+        }
+    }
+}
+
+static int scad_is_op(const scad_lexer_t* l, int op) {
+    return l->kind == TOK_OP && l->op == op;
+}
+
+static int scad_is_word(const scad_lexer_t* l, const char* word) {
+    return l->kind == TOK_IDENT && strcmp(l->text, word) == 0;
+}
+
+static int scad_expect(scad_lexer_t* l, int op) {
+    if (scad_is_op(l, op)) {
+        scad_next(l);
+        return 0;
+    }
+    char what[32];
+    snprintf(what, sizeof(what), "expected '%c'", op);
+    scad_syntax_error(l, what);
+    return -1;
+}
+
+static scad_expr_t* scad_new_expr(scad_lexer_t* l, int kind) {
+    scad_expr_t* e = scad_alloc(l->s, sizeof(scad_expr_t));
+    if (e) {
+        e->kind = kind;
+        e->line = l->token_line;
+    }
+    return e;
+}
+
+// Growing argument lists live in the arena; the old copy is just left there
+static int scad_push_arg(scad_t* s, scad_expr_t*** args, const char*** names, int* count, scad_expr_t* e, const char* name) {
+    if ((*count & (*count - 1)) == 0) {
+        int cap = *count ? 2 * *count : 1;
+        scad_expr_t** a = scad_alloc(s, cap * sizeof(*a));
+        const char** n = scad_alloc(s, cap * sizeof(*n));
+        if (!a || !n) return -1;
+        if (*count) {
+            memcpy(a, *args, *count * sizeof(*a));
+            memcpy(n, *names, *count * sizeof(*n));
+        }
+        *args = a;
+        *names = n;
+    }
+    (*args)[*count] = e;
+    (*names)[(*count)++] = name;
+    return 0;
+}
+
+static scad_expr_t* scad_parse_expr(scad_lexer_t* l);
+
+// NAME = EXPR or EXPR, up to the closing parenthesis
+static int scad_parse_args(scad_lexer_t* l, scad_expr_t*** args, const char*** names, int* count) {
+    if (scad_expect(l, '(') < 0) return -1;
+    while (!scad_is_op(l, ')') && l->kind != TOK_EOF) {
+        const char* name = NULL;
+        if (l->kind == TOK_IDENT) {
+            // Peek for "NAME =" without a token of lookahead
+            const char* q = l->p;
+            while (q < l->end && isspace((unsigned char)*q)) q++;
+            if (q < l->end && *q == '=' && !(q + 1 < l->end && q[1] == '=')) {
+                name = l->text;
+                scad_next(l);
+                scad_next(l);
+            }
+        }
+        scad_expr_t* e = scad_parse_expr(l);
+        if (!e || scad_push_arg(l->s, args, names, count, e, name) < 0) return -1;
+        if (!scad_is_op(l, ',')) break;
+        scad_next(l);
+    }
+    return scad_expect(l, ')');
+}
+
+static scad_expr_t* scad_parse_primary(scad_lexer_t* l) {
+    scad_expr_t* e = NULL;
+    if (l->kind == TOK_NUMBER) {
+        if ((e = scad_new_expr(l, EXPR_NUMBER))) e->number = l->number;
+        scad_next(l);
+    } else if (l->kind == TOK_STRING) {
+        if ((e = scad_new_expr(l, EXPR_STRING))) e->name = l->text;
+        scad_next(l);
+    } else if (scad_is_word(l, "true") || scad_is_word(l, "false")) {
+        if ((e = scad_new_expr(l, EXPR_BOOL))) e->number = scad_is_word(l, "true");
+        scad_next(l);
+    } else if (scad_is_word(l, "undef")) {
+        e = scad_new_expr(l, EXPR_UNDEF);
+        scad_next(l);
+    } else if (l->kind == TOK_IDENT) {
+        if (!(e = scad_new_expr(l, EXPR_VAR))) return NULL;
+        e->name = l->text;
+        scad_next(l);
+        if (scad_is_op(l, '(')) {
+            e->kind = EXPR_CALL;
+            if (scad_parse_args(l, &e->args, &e->arg_names, &e->arg_count) < 0) return NULL;
+        }
+    } else if (scad_is_op(l, '(')) {
+        scad_next(l);
+        e = scad_parse_expr(l);
+        if (scad_expect(l, ')') < 0) return NULL;
+    } else if (scad_is_op(l, '[')) {
+        // [a, b, ...] or [begin : end] or [begin : step : end]
+        if (!(e = scad_new_expr(l, EXPR_VECTOR))) return NULL;
+        scad_next(l);
+        while (!scad_is_op(l, ']') && l->kind != TOK_EOF) {
+            scad_expr_t* item = scad_parse_expr(l);
+            if (!item || scad_push_arg(l->s, &e->args, &e->arg_names, &e->arg_count, item, NULL) < 0) return NULL;
+            if (scad_is_op(l, ':')) {
+                if (e->arg_count != 1 && e->kind != EXPR_RANGE) break;
+                e->kind = EXPR_RANGE;
+            } else if (!scad_is_op(l, ',') || e->kind == EXPR_RANGE) {
+                break;
+            }
+            scad_next(l);
+        }
+        if (scad_expect(l, ']') < 0) return NULL;
+        if (e->kind == EXPR_RANGE && e->arg_count != 2 && e->arg_count != 3) {
+            scad_syntax_error(l, "malformed range");
+            return NULL;
+        }
+    } else {
+        scad_syntax_error(l, "expected an expression");
+        return NULL;
+    }
+    while (e && scad_is_op(l, '[')) {
+        scad_expr_t* index = scad_new_expr(l, EXPR_INDEX);
+        scad_next(l);
+        scad_expr_t* i = scad_parse_expr(l);
+        if (!index || !i || scad_expect(l, ']') < 0) return NULL;
+        if (scad_push_arg(l->s, &index->args, &index->arg_names, &index->arg_count, e, NULL) < 0 ||
+            scad_push_arg(l->s, &index->args, &index->arg_names, &index->arg_count, i, NULL) < 0) return NULL;
+        e = index;
+    }
+    return e;
+}
+
+static scad_expr_t* scad_parse_unary(scad_lexer_t* l) {
+    if (scad_is_op(l, '-') || scad_is_op(l, '!') || scad_is_op(l, '+')) {
+        scad_expr_t* e = scad_new_expr(l, EXPR_UNARY);
+        if (!e) return NULL;
+        e->op = l->op;
+        scad_next(l);
+        scad_expr_t* operand = scad_parse_unary(l);
+        if (!operand || scad_push_arg(l->s, &e->args, &e->arg_names, &e->arg_count, operand, NULL) < 0) return NULL;
+        return e;
+    }
+    return scad_parse_primary(l);
+}
+
+static int scad_precedence(const scad_lexer_t* l) {
+    if (l->kind != TOK_OP) return 0;
+    switch (l->op) {
+    case OP_OR: return 1;
+    case OP_AND: return 2;
+    case OP_EQ: case OP_NE: return 3;
+    case '<': case '>': case OP_LE: case OP_GE: return 4;
+    case '+': case '-': return 5;
+    case '*': case '/': case '%': return 6;
+    default: return 0;
+    }
+}
+
+static scad_expr_t* scad_parse_binary(scad_lexer_t* l, int min) {
+    scad_expr_t* left = scad_parse_unary(l);
+    int prec;
+    while (left && (prec = scad_precedence(l)) >= min && prec > 0) {
+        scad_expr_t* e = scad_new_expr(l, EXPR_BINARY);
+        if (!e) return NULL;
+        e->op = l->op;
+        scad_next(l);
+        scad_expr_t* right = scad_parse_binary(l, prec + 1);
+        if (!right || scad_push_arg(l->s, &e->args, &e->arg_names, &e->arg_count, left, NULL) < 0 ||
+            scad_push_arg(l->s, &e->args, &e->arg_names, &e->arg_count, right, NULL) < 0) return NULL;
+        left = e;
+    }
+    return left;
+}
+
+static scad_expr_t* scad_parse_expr(scad_lexer_t* l) {
+    scad_expr_t* e = scad_parse_binary(l, 1);
+    if (!e || !scad_is_op(l, '?')) return e;
+    scad_expr_t* t = scad_new_expr(l, EXPR_TERNARY);
+    scad_next(l);
+    scad_expr_t* a = scad_parse_expr(l);
+    if (!t || !a || scad_expect(l, ':') < 0) return NULL;
+    scad_expr_t* b = scad_parse_expr(l);
+    if (!b) return NULL;
+    scad_push_arg(l->s, &t->args, &t->arg_names, &t->arg_count, e, NULL);
+    scad_push_arg(l->s, &t->args, &t->arg_names, &t->arg_count, a, NULL);
+    scad_push_arg(l->s, &t->args, &t->arg_names, &t->arg_count, b, NULL);
+    return l->s->failed ? NULL : t;
+}
+
+static int scad_push_stmt(scad_t* s, scad_body_t* body, scad_stmt_t* st) {
+    if ((body->count & (body->count - 1)) == 0) {
+        scad_stmt_t** items = scad_alloc(s, (body->count ? 2 * body->count : 1) * sizeof(*items));
+        if (!items) return -1;
+        if (body->count) memcpy(items, body->items, body->count * sizeof(*items));
+        body->items = items;
+    }
+    body->items[body->count++] = st;
+    return 0;
+}
+
+static scad_file_t* scad_load(scad_t* s, const char* path);
+static int scad_parse_statement(scad_lexer_t* l, scad_file_t* file, scad_body_t* body);
+
+// A child statement or a { } block of them
+static int scad_parse_children(scad_lexer_t* l, scad_file_t* file, scad_body_t* body) {
+    if (scad_is_op(l, ';')) {
+        scad_next(l);
+        return 0;
+    }
+    if (!scad_is_op(l, '{')) return scad_parse_statement(l, file, body);
+    scad_next(l);
+    while (!scad_is_op(l, '}')) {
+        if (l->kind == TOK_EOF) {
+            scad_syntax_error(l, "expected '}'");
+            return -1;
+        }
+        if (scad_parse_statement(l, file, body) < 0) return -1;
+    }
+    scad_next(l);
+    return 0;
+}
+
+static int scad_parse_statement(scad_lexer_t* l, scad_file_t* file, scad_body_t* body) {
+    scad_t* s = l->s;
+    scad_stmt_t* st = scad_alloc(s, sizeof(scad_stmt_t));
+    if (!st) return -1;
+    st->line = l->token_line;
+
+    if (scad_is_op(l, ';')) {
+        scad_next(l);
+        return 0;
+    }
+    if (scad_is_op(l, '{')) {
+        st->kind = STMT_BLOCK;
+        if (scad_parse_children(l, file, &st->body) < 0) return -1;
+        return scad_push_stmt(s, body, st);
+    }
+    if (scad_is_op(l, '*') || scad_is_op(l, '%') || scad_is_op(l, '#') || scad_is_op(l, '!')) {
+        char modifier = l->op;
+        scad_next(l);
+        int first = body->count;
+        if (scad_parse_statement(l, file, body) < 0) return -1;
+        if (body->count > first) body->items[first]->modifier = modifier;
+        return 0;
+    }
+    if (l->kind != TOK_IDENT) {
+        scad_syntax_error(l, "expected a statement");
+        return -1;
+    }
+
+    if (scad_is_word(l, "use") || scad_is_word(l, "include")) {
+        int include = scad_is_word(l, "include");
+        const char* q = l->p;
+        while (q < l->end && isspace((unsigned char)*q)) q++;
+        const char* close = q < l->end && *q == '<' ? memchr(q, '>', l->end - q) : NULL;
+        if (!close) {
+            scad_syntax_error(l, "expected <file>");
+            return -1;
+        }
+        // Relative to the including file
+        const char* slash = strrchr(l->path, '/');
+        char path[4096];
+        snprintf(path, sizeof(path), "%.*s%.*s", slash ? (int)(slash - l->path + 1) : 0, l->path,
+                 (int)(close - q - 1), q + 1);
+        l->p = close + 1;
+        scad_next(l);
+        if (include) {
+            // The statements of the file take the place of the include
+            if (l->depth == SCAD_MAX_FILES) {
+                scad_syntax_error(l, "include <> nested too deeply");
+                return -1;
+            }
+            size_t size = 0;
+            char* text = read_file(path, &size);
+            if (!text) {
+                fprintf(stderr, "Error: %s: %s\n", path, strerror(errno));
+                l->s->failed = 1;
+                return -1;
+            }
+            scad_lexer_t inner = { l->s, scad_strndup(l->s, path, strlen(path)), text, text + size, 1,
+                                   TOK_EOF, 0, 0, NULL, 1, l->depth + 1 };
+            int ret = inner.path ? 0 : -1;
+            if (ret == 0) scad_next(&inner);
+            while (ret == 0 && inner.kind != TOK_EOF) ret = scad_parse_statement(&inner, file, body);
+            free(text);
+            return ret < 0 || l->s->failed ? -1 : 0;
+        }
+        scad_file_t* used = scad_load(s, path);
+        if (!used) return -1;
+        if (file->use_count < SCAD_MAX_FILES) file->uses[file->use_count++] = used;
+        return 0;
+    }
+
+    if (scad_is_word(l, "module")) {
+        scad_module_t* m = scad_alloc(s, sizeof(scad_module_t));
+        scad_next(l);
+        if (!m || l->kind != TOK_IDENT) {
+            scad_syntax_error(l, "expected a module name");
+            return -1;
+        }
+        m->name = l->text;
+        m->file = file;
+        scad_next(l);
+        if (scad_parse_args(l, &m->defaults, &m->params, &m->param_count) < 0) return -1;
+        // Parameters were parsed as arguments: "a = 1" or a bare name
+        for (int i = 0; i < m->param_count; i++) {
+            if (m->params[i]) continue;
+            if (m->defaults[i]->kind != EXPR_VAR) {
+                scad_syntax_error(l, "malformed module parameter");
+                return -1;
+            }
+            m->params[i] = m->defaults[i]->name;
+            m->defaults[i] = NULL;
+        }
+        if (scad_parse_children(l, file, &m->body) < 0) return -1;
+        st->kind = STMT_MODULE;
+        st->name = m->name;
+        st->module = m;
+        return scad_push_stmt(s, body, st);
+    }
+
+    if (scad_is_word(l, "function")) {
+        scad_syntax_error(l, "function definitions are not supported");
+        return -1;
+    }
+
+    if (scad_is_word(l, "if")) {
+        st->kind = STMT_IF;
+        scad_next(l);
+        if (scad_expect(l, '(') < 0 || !(st->value = scad_parse_expr(l)) || scad_expect(l, ')') < 0) return -1;
+        if (scad_parse_children(l, file, &st->body) < 0) return -1;
+        if (scad_is_word(l, "else")) {
+            scad_next(l);
+            if (scad_parse_children(l, file, &st->other) < 0) return -1;
+        }
+        return scad_push_stmt(s, body, st);
+    }
+
+    if (scad_is_word(l, "for")) {
+        st->kind = STMT_FOR;
+        scad_next(l);
+        if (scad_parse_args(l, &st->args, &st->arg_names, &st->arg_count) < 0) return -1;
+        for (int i = 0; i < st->arg_count; i++) {
+            if (!st->arg_names[i]) {
+                scad_syntax_error(l, "expected VARIABLE = RANGE in for()");
+                return -1;
+            }
+        }
+        if (scad_parse_children(l, file, &st->body) < 0) return -1;
+        return scad_push_stmt(s, body, st);
+    }
+
+    st->name = l->text;
+    scad_next(l);
+    if (scad_is_op(l, '=')) {
+        st->kind = STMT_ASSIGN;
+        scad_next(l);
+        if (!(st->value = scad_parse_expr(l)) || scad_expect(l, ';') < 0) return -1;
+        return scad_push_stmt(s, body, st);
+    }
+    st->kind = STMT_CALL;
+    if (scad_parse_args(l, &st->args, &st->arg_names, &st->arg_count) < 0) return -1;
+    if (scad_parse_children(l, file, &st->body) < 0) return -1;
+    return scad_push_stmt(s, body, st);
+}
+
+static int scad_parse(scad_t* s, scad_file_t* file, const char* path, const char* text, size_t size) {
+    scad_lexer_t l = { s, path, text, text + size, 1, TOK_EOF, 0, 0, NULL, 1 };
+    scad_next(&l);
+    while (l.kind != TOK_EOF) {
+        if (scad_parse_statement(&l, file, &file->body) < 0) return -1;
+    }
+    return s->failed ? -1 : 0;
+}
+
+static scad_file_t* scad_load(scad_t* s, const char* path) {
+    for (int i = 0; i < s->file_count; i++) {
+        if (strcmp(s->files[i]->path, path) == 0) return s->files[i];
+    }
+    if (s->file_count == SCAD_MAX_FILES) {
+        fprintf(stderr, "Error: %s: too many files\n", path);
+        s->failed = 1;
+        return NULL;
+    }
+    size_t size = 0;
+    char* text = read_file(path, &size);
+    if (!text) {
+        fprintf(stderr, "Error: %s: %s\n", path, strerror(errno));
+        s->failed = 1;
+        return NULL;
+    }
+    scad_file_t* file = scad_alloc(s, sizeof(scad_file_t));
+    if (file) {
+        file->path = scad_strndup(s, path, strlen(path));
+        s->files[s->file_count++] = file;
+    }
+    int ret = file ? scad_parse(s, file, file->path, text, size) : -1;
+    free(text);
+    return ret < 0 ? NULL : file;
+}
+
+// ---------------------------------------------------------------------------
+// Values and scopes
+// ---------------------------------------------------------------------------
+
+static void scad_warning(scad_t* s, const scad_file_t* file, int line, const char* fmt, ...) {
+    (void)s;
+    va_list ap;
+    va_start(ap, fmt);
+    fprintf(stderr, "WARNING: ");
+    vfprintf(stderr, fmt, ap);
+    fprintf(stderr, " in file %s, line %d\n", file ? file->path : "-", line);
+    va_end(ap);
+}
+
+static scad_scope_t* scad_new_scope(scad_t* s, scad_scope_t* parent, scad_scope_t* caller, scad_file_t* file) {
+    scad_scope_t* scope = scad_alloc(s, sizeof(scad_scope_t));
+    if (scope) {
+        scope->parent = parent;
+        scope->caller = caller;
+        scope->file = file ? file : parent ? parent->file : NULL;
+    }
+    return scope;
+}
+
+static void scad_define(scad_t* s, scad_scope_t* scope, const char* name, scad_value_t value) {
+    for (int i = 0; i < scope->count; i++) {
+        if (strcmp(scope->names[i], name) == 0) {
+            scope->values[i] = value;
+            return;
+        }
+    }
+    if (scope->count == scope->capacity) {
+        int cap = scope->capacity ? 2 * scope->capacity : 8;
+        const char** names = scad_alloc(s, cap * sizeof(*names));
+        scad_value_t* values = scad_alloc(s, cap * sizeof(*values));
+        if (!names || !values) return;
+        if (scope->count) {
+            memcpy(names, scope->names, scope->count * sizeof(*names));
+            memcpy(values, scope->values, scope->count * sizeof(*values));
+        }
+        scope->names = names;
+        scope->values = values;
+        scope->capacity = cap;
+    }
+    scope->names[scope->count] = name;
+    scope->values[scope->count++] = value;
+}
+
+// Plain names follow the lexical scopes; $ variables are dynamic and
+// continue in the caller of each module
+static const scad_value_t* scad_lookup(const scad_scope_t* scope, const char* name) {
+    int dynamic = name[0] == '$';
+    while (scope) {
+        for (int i = scope->count - 1; i >= 0; i--) {
+            if (strcmp(scope->names[i], name) == 0) return &scope->values[i];
+        }
+        scope = dynamic && scope->caller ? scope->caller : scope->parent;
+    }
+    return NULL;
+}
+
+static int scad_truth(const scad_value_t* v) {
+    switch (v->type) {
+    case VAL_BOOL: case VAL_NUMBER: return v->number != 0;
+    case VAL_STRING: return v->string[0] != '\0';
+    case VAL_VECTOR: return v->count > 0;
+    case VAL_RANGE: return 1;
+    default: return 0;
+    }
+}
+
+static scad_value_t scad_number(double x) {
+    return (scad_value_t){ VAL_NUMBER, x, 0, 0, NULL, NULL, 0 };
+}
+
+static scad_value_t scad_bool(int x) {
+    return (scad_value_t){ VAL_BOOL, x != 0, 0, 0, NULL, NULL, 0 };
+}
+
+static scad_value_t scad_vector(scad_t* s, int count) {
+    scad_value_t v = { VAL_VECTOR, 0, 0, 0, NULL, NULL, count };
+    v.items = scad_alloc(s, (count ? count : 1) * sizeof(scad_value_t));
+    if (!v.items) v.count = 0;
+    return v;
+}
+
+// Numbers print like OpenSCAD prints them: six significant digits
+static void scad_format(FILE* f, const scad_value_t* v, int quote) {
+    switch (v->type) {
+    case VAL_BOOL: fputs(v->number ? "true" : "false", f); break;
+    case VAL_NUMBER: fprintf(f, "%g", v->number + 0.0); break;
+    case VAL_STRING: fprintf(f, quote ? "\"%s\"" : "%s", v->string); break;
+    case VAL_RANGE: fprintf(f, "[%g : %g : %g]", v->number, v->step, v->end); break;
+    case VAL_VECTOR:
+        fputc('[', f);
+        for (int i = 0; i < v->count; i++) {
+            if (i) fputs(", ", f);
+            scad_format(f, &v->items[i], 1);
+        }
+        fputc(']', f);
+        break;
+    default: fputs("undef", f); break;
+    }
+}
+
+static int scad_equal(const scad_value_t* a, const scad_value_t* b) {
+    if (a->type != b->type) return 0;
+    switch (a->type) {
+    case VAL_UNDEF: return 1;
+    case VAL_BOOL: case VAL_NUMBER: return a->number == b->number;
+    case VAL_STRING: return strcmp(a->string, b->string) == 0;
+    case VAL_RANGE: return a->number == b->number && a->step == b->step && a->end == b->end;
+    default:
+        if (a->count != b->count) return 0;
+        for (int i = 0; i < a->count; i++) {
+            if (!scad_equal(&a->items[i], &b->items[i])) return 0;
+        }
+        return 1;
+    }
+}
+
+// Element-wise arithmetic on numbers and vectors; undef for anything else
+static scad_value_t scad_arith(scad_t* s, int op, const scad_value_t* a, const scad_value_t* b) {
+    if (a->type == VAL_NUMBER && b->type == VAL_NUMBER) {
+        switch (op) {
+        case '+': return scad_number(a->number + b->number);
+        case '-': return scad_number(a->number - b->number);
+        case '*': return scad_number(a->number * b->number);
+        case '/': return scad_number(a->number / b->number);
+        case '%': return scad_number(fmod(a->number, b->number));
+        }
+    }
+    if (a->type == VAL_VECTOR && b->type == VAL_VECTOR && (op == '+' || op == '-')) {
+        int n = a->count < b->count ? a->count : b->count;
+        scad_value_t v = scad_vector(s, n);
+        for (int i = 0; i < v.count; i++) v.items[i] = scad_arith(s, op, &a->items[i], &b->items[i]);
+        return v;
+    }
+    if (a->type == VAL_VECTOR && b->type == VAL_NUMBER && (op == '*' || op == '/')) {
+        scad_value_t v = scad_vector(s, a->count);
+        for (int i = 0; i < v.count; i++) v.items[i] = scad_arith(s, op, &a->items[i], b);
+        return v;
+    }
+    if (a->type == VAL_NUMBER && b->type == VAL_VECTOR && op == '*') {
+        scad_value_t v = scad_vector(s, b->count);
+        for (int i = 0; i < v.count; i++) v.items[i] = scad_arith(s, op, a, &b->items[i]);
+        return v;
+    }
+    return scad_undef;
+}
+
+static scad_value_t scad_eval(scad_t* s, const scad_expr_t* e, scad_scope_t* scope);
+
+typedef struct {
+    const char* name;
+    int args;                   // exact count, or -1 for one or more
+    double (*fn)(double, double);
+} scad_math_t;
+
+static double scad_sin(double x, double y) { (void)y; double a, b; sincos_deg(x, &a, &b); return a; }
+static double scad_cos(double x, double y) { (void)y; double a, b; sincos_deg(x, &a, &b); return b; }
+static double scad_tan(double x, double y) { (void)y; return tan(x * M_PI / 180); }
+static double scad_atan2(double y, double x) { return atan2(y, x) * 180 / M_PI; }
+static double scad_sqrt(double x, double y) { (void)y; return sqrt(x); }
+static double scad_abs(double x, double y) { (void)y; return fabs(x); }
+static double scad_floor(double x, double y) { (void)y; return floor(x); }
+static double scad_ceil(double x, double y) { (void)y; return ceil(x); }
+static double scad_round(double x, double y) { (void)y; return round(x); }
+static double scad_min(double x, double y) { return x < y ? x : y; }
+static double scad_max(double x, double y) { return x > y ? x : y; }
+
+static const scad_math_t scad_math[] = {
+    {"sin", 1, scad_sin}, {"cos", 1, scad_cos}, {"tan", 1, scad_tan},
+    {"atan2", 2, scad_atan2}, {"sqrt", 1, scad_sqrt}, {"pow", 2, pow},
+    {"abs", 1, scad_abs}, {"floor", 1, scad_floor}, {"ceil", 1, scad_ceil},
+    {"round", 1, scad_round}, {"min", -1, scad_min}, {"max", -1, scad_max},
+};
+
+static scad_value_t scad_call_function(scad_t* s, const scad_expr_t* e, scad_scope_t* scope) {
+    if (strcmp(e->name, "is_undef") == 0 && e->arg_count == 1) {
+        // No warning for the variable being asked about
+        if (e->args[0]->kind == EXPR_VAR) return scad_bool(!scad_lookup(scope, e->args[0]->name) ||
+                                                            scad_lookup(scope, e->args[0]->name)->type == VAL_UNDEF);
+        scad_value_t v = scad_eval(s, e->args[0], scope);
+        return scad_bool(v.type == VAL_UNDEF);
+    }
+
+    scad_value_t args[SCAD_MAX_ARGS];
+    int n = e->arg_count < SCAD_MAX_ARGS ? e->arg_count : SCAD_MAX_ARGS;
+    for (int i = 0; i < n; i++) args[i] = scad_eval(s, e->args[i], scope);
+
+    if (strcmp(e->name, "str") == 0) {
+        char* text = NULL;
+        size_t size = 0;
+        FILE* f = open_memstream(&text, &size);
+        if (!f) return scad_undef;
+        for (int i = 0; i < n; i++) scad_format(f, &args[i], 0);
+        fclose(f);
+        scad_value_t v = { VAL_STRING, 0, 0, 0, scad_strndup(s, text, size), NULL, 0 };
+        free(text);
+        return v.string ? v : scad_undef;
+    }
+    if (strcmp(e->name, "len") == 0 && n == 1) {
+        if (args[0].type == VAL_VECTOR) return scad_number(args[0].count);
+        if (args[0].type == VAL_STRING) return scad_number(strlen(args[0].string));
+        return scad_undef;
+    }
+    for (size_t i = 0; i < sizeof(scad_math) / sizeof(scad_math[0]); i++) {
+        const scad_math_t* m = &scad_math[i];
+        if (strcmp(e->name, m->name) != 0) continue;
+        // min() and max() take numbers or one vector of them
+        const scad_value_t* x = args;
+        int count = n;
+        if (m->args < 0 && n == 1 && args[0].type == VAL_VECTOR) {
+            x = args[0].items;
+            count = args[0].count;
+        }
+        if (m->args >= 0 ? count != m->args : count < 1) break;
+        for (int k = 0; k < count; k++) {
+            if (x[k].type != VAL_NUMBER) return scad_undef;
+        }
+        double r = x[0].number;
+        if (m->args == 1) r = m->fn(r, 0);
+        else if (m->args == 2) r = m->fn(r, x[1].number);
+        else for (int k = 1; k < count; k++) r = m->fn(r, x[k].number);
+        return scad_number(r);
+    }
+    scad_warning(s, scope->file, e->line, "Ignoring unknown function '%s'", e->name);
+    return scad_undef;
+}
+
+static scad_value_t scad_eval(scad_t* s, const scad_expr_t* e, scad_scope_t* scope) {
+    if (s->failed) return scad_undef;
+    switch (e->kind) {
+    case EXPR_NUMBER: return scad_number(e->number);
+    case EXPR_BOOL: return scad_bool(e->number != 0);
+    case EXPR_STRING: return (scad_value_t){ VAL_STRING, 0, 0, 0, e->name, NULL, 0 };
+    case EXPR_UNDEF: return scad_undef;
+    case EXPR_VAR: {
+        const scad_value_t* v = scad_lookup(scope, e->name);
+        if (v) return *v;
+        scad_warning(s, scope->file, e->line, "Ignoring unknown variable '%s'", e->name);
+        return scad_undef;
+    }
+    case EXPR_VECTOR: {
+        scad_value_t v = scad_vector(s, e->arg_count);
+        for (int i = 0; i < v.count; i++) v.items[i] = scad_eval(s, e->args[i], scope);
+        return v;
+    }
+    case EXPR_RANGE: {
+        scad_value_t a = scad_eval(s, e->args[0], scope);
+        scad_value_t b = scad_eval(s, e->args[1], scope);
+        scad_value_t c = e->arg_count == 3 ? scad_eval(s, e->args[2], scope) : scad_number(1);
+        if (a.type != VAL_NUMBER || b.type != VAL_NUMBER || c.type != VAL_NUMBER) return scad_undef;
+        scad_value_t v = { VAL_RANGE, a.number, b.number, c.number, NULL, NULL, 0 };
+        if (e->arg_count == 2) {
+            // [begin : end]; a reversed one is swapped, as OpenSCAD does
+            v.step = 1;
+            v.end = b.number;
+            if (v.end < v.number) {
+                v.end = a.number;
+                v.number = b.number;
+            }
+        }
+        return v;
+    }
+    case EXPR_UNARY: {
+        scad_value_t v = scad_eval(s, e->args[0], scope);
+        if (e->op == '!') return scad_bool(!scad_truth(&v));
+        if (e->op == '+') return v;
+        scad_value_t minus = scad_number(-1);
+        return scad_arith(s, '*', &minus, &v);
+    }
+    case EXPR_BINARY: {
+        scad_value_t a = scad_eval(s, e->args[0], scope);
+        if (e->op == OP_AND && !scad_truth(&a)) return scad_bool(0);
+        if (e->op == OP_OR && scad_truth(&a)) return scad_bool(1);
+        scad_value_t b = scad_eval(s, e->args[1], scope);
+        switch (e->op) {
+        case OP_AND: case OP_OR: return scad_bool(scad_truth(&b));
+        case OP_EQ: return scad_bool(scad_equal(&a, &b));
+        case OP_NE: return scad_bool(!scad_equal(&a, &b));
+        case '<': case '>': case OP_LE: case OP_GE:
+            if (a.type != VAL_NUMBER || b.type != VAL_NUMBER) return scad_undef;
+            return scad_bool(e->op == '<' ? a.number < b.number : e->op == '>' ? a.number > b.number :
+                             e->op == OP_LE ? a.number <= b.number : a.number >= b.number);
+        default: return scad_arith(s, e->op, &a, &b);
+        }
+    }
+    case EXPR_TERNARY: {
+        scad_value_t c = scad_eval(s, e->args[0], scope);
+        return scad_eval(s, e->args[scad_truth(&c) ? 1 : 2], scope);
+    }
+    case EXPR_INDEX: {
+        scad_value_t v = scad_eval(s, e->args[0], scope);
+        scad_value_t i = scad_eval(s, e->args[1], scope);
+        if (i.type != VAL_NUMBER || i.number < 0) return scad_undef;
+        size_t k = (size_t)i.number;
+        if (v.type == VAL_VECTOR && k < (size_t)v.count) return v.items[k];
+        if (v.type == VAL_STRING && k < strlen(v.string)) {
+            return (scad_value_t){ VAL_STRING, 0, 0, 0, scad_strndup(s, v.string + k, 1), NULL, 0 };
+        }
+        return scad_undef;
+    }
+    case EXPR_CALL: return scad_call_function(s, e, scope);
+    }
+    return scad_undef;
+}
+
+// Arguments of a call, evaluated in the calling scope
+static void scad_eval_args(scad_t* s, const scad_stmt_t* st, scad_scope_t* scope, scad_args_t* args) {
+    args->count = 0;
+    for (int i = 0; i < st->arg_count && args->count < SCAD_MAX_ARGS; i++) {
+        args->names[args->count] = st->arg_names[i];
+        args->values[args->count++] = scad_eval(s, st->args[i], scope);
+    }
+}
+
+// Named argument, or the positional one at index pos (-1 for none)
+static const scad_value_t* scad_arg(const scad_args_t* args, const char* name, int pos) {
+    for (int i = 0; i < args->count; i++) {
+        if (args->names[i] && strcmp(args->names[i], name) == 0) return &args->values[i];
+    }
+    for (int i = 0, k = 0; i < args->count; i++) {
+        if (args->names[i]) continue;
+        if (k++ == pos) return &args->values[i];
+    }
+    return NULL;
+}
+
+static double scad_arg_number(const scad_args_t* args, const char* name, int pos, double fallback) {
+    const scad_value_t* v = scad_arg(args, name, pos);
+    return v && v->type == VAL_NUMBER ? v->number : fallback;
+}
+
+// Special variables given to the call or inherited from the caller
+static double scad_special(const scad_args_t* args, const scad_scope_t* scope, const char* name) {
+    const scad_value_t* v = scad_arg(args, name, -1);
+    if (!v) v = scad_lookup(scope, name);
+    return v && v->type == VAL_NUMBER ? v->number : 0;
+}
+
+// A number or a vector of up to three numbers, missing ones as fallback
+static int scad_arg_vec3(const scad_args_t* args, const char* name, int pos, double fallback, double out[3]) {
+    const scad_value_t* v = scad_arg(args, name, pos);
+    out[0] = out[1] = out[2] = fallback;
+    if (!v) return 0;
+    if (v->type == VAL_NUMBER) {
+        out[0] = out[1] = out[2] = v->number;
+        return 1;
+    }
+    if (v->type != VAL_VECTOR) return -1;
+    for (int i = 0; i < v->count && i < 3; i++) {
+        if (v->items[i].type != VAL_NUMBER) return -1;
+        out[i] = v->items[i].number;
+    }
+    return 2;
+}
+
+// ---------------------------------------------------------------------------
+// Geometry
+// ---------------------------------------------------------------------------
+
+static void shapes_free(scad_shapes_t* sh) {
+    for (int i = 0; i < sh->solid_count; i++) mesh_free(&sh->solids[i]);
+    free(sh->solids);
+    free(sh->polygons);         // points live in the arena
+    memset(sh, 0, sizeof(*sh));
+}
+
+// Takes over the mesh
+static int shapes_add_solid(scad_t* s, scad_shapes_t* sh, mesh_t* mesh) {
+    if (!mesh->triangle_count) {
+        mesh_free(mesh);
+        return 0;
+    }
+    if (grow_array((void**)&sh->solids, &sh->solid_capacity, sh->solid_count + 1, sizeof(mesh_t)) < 0) {
+        mesh_free(mesh);
+        s->failed = 1;
+        return -1;
+    }
+    sh->solids[sh->solid_count++] = *mesh;
+    memset(mesh, 0, sizeof(*mesh));
+    return 0;
+}
+
+static int shapes_add_polygon(scad_t* s, scad_shapes_t* sh, point_t* points, int count) {
+    if (grow_array((void**)&sh->polygons, &sh->polygon_capacity, sh->polygon_count + 1, sizeof(scad_polygon_t)) < 0) {
+        s->failed = 1;
+        return -1;
+    }
+    sh->polygons[sh->polygon_count++] = (scad_polygon_t){ points, count };
+    return 0;
+}
+
+// Union of all solids, pairing neighbours so the operands stay balanced.
+// Consumes the solids.
+static int shapes_union(scad_t* s, scad_shapes_t* sh, mesh_t* out) {
+    memset(out, 0, sizeof(*out));
+    int n = sh->solid_count;
+    while (n > 1 && !s->failed) {
+        int m = 0;
+        for (int i = 0; i < n; i += 2) {
+            if (i + 1 == n) {
+                sh->solids[m++] = sh->solids[i];
+                continue;
+            }
+            mesh_t r;
+            if (mesh_boolean(&sh->solids[i], &sh->solids[i + 1], CSG_UNION, &r) < 0) s->failed = 1;
+            mesh_free(&sh->solids[i]);
+            mesh_free(&sh->solids[i + 1]);
+            sh->solids[m++] = r;
+        }
+        n = m;
+    }
+    if (n == 1) *out = sh->solids[0];
+    else for (int i = 0; i < n; i++) mesh_free(&sh->solids[i]);
+    sh->solid_count = 0;
+    if (s->failed) {
+        mesh_free(out);
+        fprintf(stderr, "Error: union failed\n");
+        return -1;
+    }
+    return 0;
+}
+
+static double scad_snap(double x) {
+    return round(x * SCAD_SNAP) / SCAD_SNAP;
+}
+
+// Moves a primitive into place and turns it outwards, which also undoes
+// the inversion of mirroring transforms. Vertices are snapped to a fine
+// grid: faces the source puts in one plane through different chains of
+// transforms would otherwise be a rounding error apart and leave sheets
+// of zero thickness behind, which OpenSCAD does not.
+static void scad_place(mesh_t* mesh, const transform_t* t) {
+    for (int i = 0; i < mesh->vertex_count; i++) {
+        vec3_t v = transform_apply(t, mesh->vertices[i]);
+        mesh->vertices[i] = (vec3_t){ scad_snap(v.x), scad_snap(v.y), scad_snap(v.z) };
+    }
+    mesh_orient_shell(mesh, 0);
+}
+
+// Number of segments of a circle of radius r, as OpenSCAD picks it
+static int scad_fragments(double r, double fn, double fs, double fa) {
+    if (r < SCAD_GRID_FINE) return 3;
+    if (fn > 0) return fn >= 3 ? (int)fn : 3;
+    return (int)ceil(fmax(fmin(360 / fa, r * 2 * M_PI / fs), 5));
+}
+
+static int scad_fragments_of(const scad_args_t* args, const scad_scope_t* scope, double r) {
+    return scad_fragments(r, scad_special(args, scope, "$fn"), scad_special(args, scope, "$fs"),
+                          scad_special(args, scope, "$fa"));
+}
+
+static int scad_cube(scad_t* s, const scad_args_t* args, const transform_t* t, scad_shapes_t* out) {
+    double size[3];
+    scad_arg_vec3(args, "size", 0, 1, size);
+    const scad_value_t* center = scad_arg(args, "center", 1);
+    if (size[0] <= 0 || size[1] <= 0 || size[2] <= 0) return 0;
+    vec3_t lo = { 0, 0, 0 };
+    if (center && scad_truth(center)) lo = (vec3_t){ -size[0] / 2, -size[1] / 2, -size[2] / 2 };
+    mesh_t mesh = { 0 };
+    if (mesh_box(&mesh, lo, (vec3_t){ lo.x + size[0], lo.y + size[1], lo.z + size[2] }) < 0) {
+        s->failed = 1;
+        return -1;
+    }
+    scad_place(&mesh, t);
+    return shapes_add_solid(s, out, &mesh);
+}
+
+static int scad_cylinder(scad_t* s, const scad_args_t* args, const scad_scope_t* scope, const transform_t* t,
+                         scad_shapes_t* out) {
+    double h = scad_arg_number(args, "h", 0, 1);
+    double r = scad_arg_number(args, "r", -1, 1);
+    if (scad_arg(args, "d", -1)) r = scad_arg_number(args, "d", -1, 2) / 2;
+    double r1 = scad_arg_number(args, "r1", 1, r), r2 = scad_arg_number(args, "r2", 2, r);
+    if (scad_arg(args, "d1", -1)) r1 = scad_arg_number(args, "d1", -1, 2) / 2;
+    if (scad_arg(args, "d2", -1)) r2 = scad_arg_number(args, "d2", -1, 2) / 2;
+    const scad_value_t* center = scad_arg(args, "center", 3);
+    if (h <= 0 || r1 < 0 || r2 < 0 || (r1 <= 0 && r2 <= 0)) return 0;
+
+    int n = scad_fragments_of(args, scope, fmax(r1, r2));
+    double z0 = center && scad_truth(center) ? -h / 2 : 0, z1 = z0 + h;
+    mesh_t mesh = { 0 };
+    if (mesh_reserve(&mesh, 2 * n, 4 * n) < 0) {
+        s->failed = 1;
+        return -1;
+    }
+    // Rings, or a single apex where a radius is zero
+    const double radius[2] = { r1, r2 }, z[2] = { z0, z1 };
+    int ring[2];
+    for (int k = 0; k < 2; k++) {
+        ring[k] = mesh.vertex_count;
+        if (radius[k] <= 0) {
+            mesh_add_vertex(&mesh, (vec3_t){ 0, 0, z[k] });
+            continue;
+        }
+        for (int i = 0; i < n; i++) {
+            double sa, ca;
+            sincos_deg(360.0 * i / n, &sa, &ca);
+            mesh_add_vertex(&mesh, (vec3_t){ radius[k] * ca, radius[k] * sa, z[k] });
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        int j = (i + 1) % n;
+        if (r1 <= 0) mesh_add_triangle(&mesh, ring[0], ring[1] + j, ring[1] + i);
+        else if (r2 <= 0) mesh_add_triangle(&mesh, ring[0] + i, ring[0] + j, ring[1]);
+        else mesh_add_quad(&mesh, ring[0] + i, ring[0] + j, ring[1] + j, ring[1] + i);
+    }
+    for (int k = 0; k < 2; k++) {
+        if (radius[k] <= 0) continue;
+        for (int i = 1; i + 1 < n; i++) {
+            if (k) mesh_add_triangle(&mesh, ring[1], ring[1] + i, ring[1] + i + 1);
+            else mesh_add_triangle(&mesh, ring[0], ring[0] + i + 1, ring[0] + i);
+        }
+    }
+    scad_place(&mesh, t);
+    return shapes_add_solid(s, out, &mesh);
+}
+
+static int scad_polyhedron(scad_t* s, const scad_stmt_t* st, const scad_args_t* args, const scad_scope_t* scope,
+                           const transform_t* t, scad_shapes_t* out) {
+    const scad_value_t* points = scad_arg(args, "points", 0);
+    const scad_value_t* faces = scad_arg(args, "faces", 1);
+    if (!faces) faces = scad_arg(args, "triangles", -1);
+    if (!points || !faces || points->type != VAL_VECTOR || faces->type != VAL_VECTOR) {
+        scad_warning(s, scope->file, st->line, "polyhedron() needs points and faces");
+        return 0;
+    }
+    mesh_t mesh = { 0 };
+    if (mesh_reserve(&mesh, points->count, 0) < 0) goto fail;
+    for (int i = 0; i < points->count; i++) {
+        const scad_value_t* p = &points->items[i];
+        double xyz[3] = { 0, 0, 0 };
+        for (int k = 0; k < 3 && p->type == VAL_VECTOR && k < p->count; k++) {
+            if (p->items[k].type == VAL_NUMBER) xyz[k] = p->items[k].number;
+        }
+        mesh_add_vertex(&mesh, (vec3_t){ xyz[0], xyz[1], xyz[2] });
+    }
+    // Faces are clockwise seen from outside; fan them the other way round
+    for (int f = 0; f < faces->count; f++) {
+        const scad_value_t* face = &faces->items[f];
+        if (face->type != VAL_VECTOR || face->count < 3) continue;
+        int v[3];
+        for (int i = face->count - 1, k = 0; i >= 0; i--, k++) {
+            double x = face->items[i].type == VAL_NUMBER ? face->items[i].number : -1;
+            if (x < 0 || x >= points->count) {
+                scad_warning(s, scope->file, st->line, "polyhedron() face index out of range");
+                mesh_free(&mesh);
+                return 0;
+            }
+            v[k < 2 ? k : 2] = (int)x;
+            if (k >= 2) {
+                if (mesh_reserve(&mesh, 0, 1) < 0) goto fail;
+                mesh_add_triangle(&mesh, v[0], v[1], v[2]);
+                v[1] = v[2];
+            }
+        }
+    }
+    scad_place(&mesh, t);
+    return shapes_add_solid(s, out, &mesh);
+
+fail:
+    mesh_free(&mesh);
+    s->failed = 1;
+    return -1;
+}
+
+// 2D outlines keep only x and y of the transformed points
+static int scad_outline(scad_t* s, const point_t* points, int count, const transform_t* t, scad_shapes_t* out) {
+    point_t* p = scad_alloc(s, count * sizeof(point_t));
+    if (!p) return -1;
+    for (int i = 0; i < count; i++) {
+        vec3_t v = transform_apply(t, (vec3_t){ points[i].x, points[i].y, 0 });
+        p[i] = (point_t){ v.x, v.y };
+    }
+    return shapes_add_polygon(s, out, p, count);
+}
+
+static int scad_square(scad_t* s, const scad_args_t* args, const transform_t* t, scad_shapes_t* out) {
+    double size[3];
+    scad_arg_vec3(args, "size", 0, 1, size);
+    const scad_value_t* center = scad_arg(args, "center", 1);
+    if (size[0] <= 0 || size[1] <= 0) return 0;
+    double x = 0, y = 0;
+    if (center && scad_truth(center)) {
+        x = -size[0] / 2;
+        y = -size[1] / 2;
+    }
+    const point_t rect[4] = { {x, y}, {x + size[0], y}, {x + size[0], y + size[1]}, {x, y + size[1]} };
+    return scad_outline(s, rect, 4, t, out);
+}
+
+static int scad_circle(scad_t* s, const scad_args_t* args, const scad_scope_t* scope, const transform_t* t,
+                       scad_shapes_t* out) {
+    double r = scad_arg_number(args, "r", 0, 1);
+    if (scad_arg(args, "d", -1)) r = scad_arg_number(args, "d", -1, 2) / 2;
+    if (r <= 0) return 0;
+    int n = scad_fragments_of(args, scope, r);
+    point_t* p = malloc(n * sizeof(point_t));
+    if (!p) {
+        s->failed = 1;
+        return -1;
+    }
+    for (int i = 0; i < n; i++) {
+        double sa, ca;
+        sincos_deg(360.0 * i / n, &sa, &ca);
+        p[i] = (point_t){ r * ca, r * sa };
+    }
+    int ret = scad_outline(s, p, n, t, out);
+    free(p);
+    return ret;
+}
+
+// Sweeps the outlines of the children around Z, starting from the X axis
+// for a partial turn. Each outline becomes its own solid.
+static int scad_rotate_extrude(scad_t* s, const scad_args_t* args, const scad_scope_t* scope, const transform_t* t,
+                               const scad_shapes_t* children, scad_shapes_t* out) {
+    double angle = scad_arg_number(args, "angle", -1, 360);
+    if (angle > 360) angle = 360;
+    if (angle < -360) angle = -360;
+    int full = fabs(angle) == 360;
+    double min_x = 0, max_x = 0;
+    for (int i = 0; i < children->polygon_count; i++) {
+        for (int k = 0; k < children->polygons[i].count; k++) {
+            min_x = fmin(min_x, children->polygons[i].points[k].x);
+            max_x = fmax(max_x, children->polygons[i].points[k].x);
+        }
+    }
+    if (min_x < 0 && max_x > 0) {
+        fprintf(stderr, "Error: all points for rotate_extrude() must have the same X coordinate sign\n");
+        s->failed = 1;
+        return -1;
+    }
+    int n = (int)ceil(fmax(scad_fragments_of(args, scope, max_x - min_x) * fabs(angle) / 360, 1));
+
+    for (int i = 0; i < children->polygon_count; i++) {
+        const point_t* p = children->polygons[i].points;
+        int m = children->polygons[i].count, rings = full ? n : n + 1;
+        mesh_t mesh = { 0 };
+        if (mesh_reserve(&mesh, m * rings, 2 * m * n + 2 * m) < 0) {
+            s->failed = 1;
+            return -1;
+        }
+        for (int j = 0; j < rings; j++) {
+            double sa, ca;
+            sincos_deg(full ? -90 + j * 360.0 / n : 90 - j * angle / n, &sa, &ca);
+            for (int k = 0; k < m; k++) mesh_add_vertex(&mesh, (vec3_t){ p[k].x * sa, p[k].x * ca, p[k].y });
+        }
+        for (int j = 0; j < n; j++) {
+            int a = j * m, b = (j + 1) % rings * m;
+            for (int k = 0; k < m; k++) {
+                int l = (k + 1) % m;
+                mesh_add_quad(&mesh, a + k, a + l, b + l, b + k);
+            }
+        }
+        if (!full) {
+            for (int k = 1; k + 1 < m; k++) {
+                mesh_add_triangle(&mesh, 0, k + 1, k);
+                mesh_add_triangle(&mesh, n * m, n * m + k, n * m + k + 1);
+            }
+        }
+        scad_place(&mesh, t);
+        if (shapes_add_solid(s, out, &mesh) < 0) return -1;
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Statements
+// ---------------------------------------------------------------------------
+
+static int scad_eval_body(scad_t* s, const scad_body_t* body, scad_scope_t* scope, const transform_t* t,
+                          scad_shapes_t* out, int groups);
+
+// Assignments of a body take effect before anything in it is instantiated,
+// in order of first appearance, with the value of the last one
+static void scad_eval_assignments(scad_t* s, const scad_body_t* body, scad_scope_t* scope) {
+    for (int i = 0; i < body->count && !s->failed; i++) {
+        const scad_stmt_t* st = body->items[i];
+        if (st->kind != STMT_ASSIGN) continue;
+        int seen = 0, last = i;
+        for (int j = 0; j < i && !seen; j++) {
+            seen = body->items[j]->kind == STMT_ASSIGN && strcmp(body->items[j]->name, st->name) == 0;
+        }
+        if (seen) continue;
+        for (int j = i + 1; j < body->count; j++) {
+            if (body->items[j]->kind == STMT_ASSIGN && strcmp(body->items[j]->name, st->name) == 0) last = j;
+        }
+        scad_define(s, scope, st->name, scad_eval(s, body->items[last]->value, scope));
+    }
+}
+
+// Children in a scope of their own
+static int scad_eval_children(scad_t* s, const scad_body_t* body, scad_scope_t* scope, const transform_t* t,
+                              scad_shapes_t* out, int groups) {
+    scad_scope_t* inner = scad_new_scope(s, scope, NULL, NULL);
+    return inner ? scad_eval_body(s, body, inner, t, out, groups) : -1;
+}
+
+static const scad_module_t* scad_find_module(const scad_file_t* file, const char* name) {
+    for (int f = -1; f < file->use_count; f++) {
+        const scad_body_t* body = f < 0 ? &file->body : &file->uses[f]->body;
+        for (int i = 0; i < body->count; i++) {
+            if (body->items[i]->kind == STMT_MODULE && strcmp(body->items[i]->name, name) == 0) {
+                return body->items[i]->module;
+            }
+        }
+    }
+    return NULL;
+}
+
+static int scad_call_module(scad_t* s, const scad_stmt_t* st, const scad_module_t* m, const scad_args_t* args,
+                            scad_scope_t* scope, const transform_t* t, scad_shapes_t* out) {
+    if (s->depth >= SCAD_MAX_DEPTH) {
+        fprintf(stderr, "Error: %s:%d: modules nested too deep\n", scope->file->path, st->line);
+        s->failed = 1;
+        return -1;
+    }
+    scad_scope_t* params = scad_new_scope(s, m->file->scope, scope, m->file);
+    scad_scope_t* body = params ? scad_new_scope(s, params, NULL, NULL) : NULL;
+    if (!body) return -1;
+
+    int positional = 0;
+    for (int i = 0; i < args->count; i++) {
+        const char* name = args->names[i];
+        if (!name) {
+            if (positional < m->param_count) scad_define(s, params, m->params[positional], args->values[i]);
+            positional++;
+            continue;
+        }
+        int known = name[0] == '$';
+        for (int k = 0; k < m->param_count && !known; k++) known = strcmp(m->params[k], name) == 0;
+        if (known) scad_define(s, params, name, args->values[i]);
+        else scad_warning(s, scope->file, st->line, "variable %s not specified as parameter", name);
+    }
+    for (int k = 0; k < m->param_count; k++) {
+        int bound = 0;
+        for (int i = 0; i < params->count && !bound; i++) bound = strcmp(params->names[i], m->params[k]) == 0;
+        if (!bound) scad_define(s, params, m->params[k], m->defaults[k] ? scad_eval(s, m->defaults[k], params) : scad_undef);
+    }
+
+    s->depth++;
+    int ret = scad_eval_body(s, &m->body, body, t, out, 0);
+    s->depth--;
+    return ret;
+}
+
+static int scad_eval_statement(scad_t* s, const scad_stmt_t* st, scad_scope_t* scope, const transform_t* t,
+                               scad_shapes_t* out);
+
+static int scad_eval_for(scad_t* s, const scad_stmt_t* st, int var, scad_scope_t* scope, const transform_t* t,
+                         scad_shapes_t* out) {
+    if (var == st->arg_count) return scad_eval_body(s, &st->body, scope, t, out, 0);
+    scad_value_t v = scad_eval(s, st->args[var], scope);
+    long count = v.type == VAL_VECTOR ? v.count : v.type == VAL_RANGE ? 0 : 1;
+    if (v.type == VAL_RANGE) {
+        if (v.step == 0 || (v.step > 0) != (v.end >= v.number)) return 0;
+        double steps = floor((v.end - v.number) / v.step);
+        if (!(steps < SCAD_MAX_LOOP)) {
+            fprintf(stderr, "Error: %s:%d: for() range too large\n", scope->file->path, st->line);
+            s->failed = 1;
+            return -1;
+        }
+        count = (long)steps + 1;
+    }
+    for (long i = 0; i < count && !s->failed; i++) {
+        scad_scope_t* inner = scad_new_scope(s, scope, NULL, NULL);
+        if (!inner) return -1;
+        scad_value_t x = v.type == VAL_VECTOR ? v.items[i] : v.type == VAL_RANGE ? scad_number(v.number + i * v.step) : v;
+        scad_define(s, inner, st->arg_names[var], x);
+        if (scad_eval_for(s, st, var + 1, inner, t, out) < 0) return -1;
+    }
+    return 0;
+}
+
+// Boolean operations: the first child against the union of the others,
+// or all children against each other for intersection()
+static int scad_boolean(scad_t* s, const scad_stmt_t* st, scad_scope_t* scope, const transform_t* t,
+                        csg_op_t op, scad_shapes_t* out) {
+    int groups = op == CSG_DIFFERENCE ? 2 : st->body.count;
+    scad_shapes_t* children = calloc(groups ? groups : 1, sizeof(scad_shapes_t));
+    if (!children) {
+        s->failed = 1;
+        return -1;
+    }
+    int n = scad_eval_children(s, &st->body, scope, t, children, groups);
+    mesh_t result = { 0 };
+    int ret = n < 0 ? -1 : 0;
+    for (int i = 0; i < n && ret == 0; i++) {
+        mesh_t operand, r;
+        if (shapes_union(s, &children[i], &operand) < 0) {
+            ret = -1;
+            break;
+        }
+        if (i == 0) {
+            result = operand;
+            continue;
+        }
+        ret = mesh_boolean(&result, &operand, op, &r);
+        mesh_free(&operand);
+        mesh_free(&result);
+        result = r;
+        if (ret < 0) {
+            fprintf(stderr, "Error: %s:%d: %s() failed\n", scope->file->path, st->line, st->name);
+            s->failed = 1;
+        }
+    }
+    for (int i = 0; i < groups; i++) shapes_free(&children[i]);
+    free(children);
+    if (ret == 0) ret = shapes_add_solid(s, out, &result);
+    else mesh_free(&result);
+    return ret;
+}
+
+// translate(), rotate(), scale(), mirror() and the operators that leave
+// their children alone
+static int scad_transform(scad_t* s, const scad_stmt_t* st, const scad_args_t* args, scad_scope_t* scope,
+                          const transform_t* t, scad_shapes_t* out) {
+    transform_t m = transform_identity;
+    double v[3];
+    if (strcmp(st->name, "translate") == 0) {
+        if (scad_arg_vec3(args, "v", 0, 0, v) < 0) scad_warning(s, scope->file, st->line, "Unable to convert translate() argument");
+        m = transform_translate(v[0], v[1], v[2]);
+    } else if (strcmp(st->name, "rotate") == 0) {
+        const scad_value_t* a = scad_arg(args, "a", 0);
+        if (scad_arg(args, "v", 1)) scad_warning(s, scope->file, st->line, "rotate() about an axis is not supported");
+        if (a && a->type == VAL_NUMBER) m = transform_rotate(0, 0, a->number);
+        else if (scad_arg_vec3(args, "a", 0, 0, v) >= 0) m = transform_rotate(v[0], v[1], v[2]);
+    } else if (strcmp(st->name, "scale") == 0) {
+        if (scad_arg_vec3(args, "v", 0, 1, v) < 0) {
+            scad_warning(s, scope->file, st->line, "Unable to convert scale() argument");
+            v[0] = v[1] = v[2] = 1;
+        }
+        for (int i = 0; i < 3; i++) m.m[i][i] = v[i];
+    } else if (strcmp(st->name, "mirror") == 0) {
+        scad_arg_vec3(args, "v", 0, 0, v);
+        double len = v[0] * v[0] + v[1] * v[1] + v[2] * v[2];
+        for (int i = 0; i < 3 && len > 0; i++) {
+            for (int j = 0; j < 3; j++) m.m[i][j] -= 2 * v[i] * v[j] / len;
+        }
+    }
+    transform_t inner = transform_mul(t, &m);
+    return scad_eval_children(s, &st->body, scope, &inner, out, 0) < 0 ? -1 : 0;
+}
+
+static int scad_echo(scad_t* s, const scad_args_t* args) {
+    if (s->quiet) return 0;
+    fprintf(stderr, "ECHO: ");
+    for (int i = 0; i < args->count; i++) {
+        if (i) fprintf(stderr, ", ");
+        if (args->names[i]) fprintf(stderr, "%s = ", args->names[i]);
+        scad_format(stderr, &args->values[i], 1);
+    }
+    fprintf(stderr, "\n");
+    return 0;
+}
+
+static int scad_eval_call(scad_t* s, const scad_stmt_t* st, scad_scope_t* scope, const transform_t* t,
+                          scad_shapes_t* out) {
+    scad_args_t args;
+    scad_eval_args(s, st, scope, &args);
+    const char* name = st->name;
+
+    if (strcmp(name, "cube") == 0) return scad_cube(s, &args, t, out);
+    if (strcmp(name, "cylinder") == 0) return scad_cylinder(s, &args, scope, t, out);
+    if (strcmp(name, "polyhedron") == 0) return scad_polyhedron(s, st, &args, scope, t, out);
+    if (strcmp(name, "square") == 0) return scad_square(s, &args, t, out);
+    if (strcmp(name, "circle") == 0) return scad_circle(s, &args, scope, t, out);
+    if (strcmp(name, "echo") == 0) return scad_echo(s, &args);
+    if (strcmp(name, "difference") == 0) return scad_boolean(s, st, scope, t, CSG_DIFFERENCE, out);
+    if (strcmp(name, "intersection") == 0) return scad_boolean(s, st, scope, t, CSG_INTERSECTION, out);
+    if (strcmp(name, "translate") == 0 || strcmp(name, "rotate") == 0 || strcmp(name, "scale") == 0 ||
+        strcmp(name, "mirror") == 0 || strcmp(name, "union") == 0 || strcmp(name, "color") == 0 ||
+        strcmp(name, "render") == 0 || strcmp(name, "group") == 0) {
+        return scad_transform(s, st, &args, scope, t, out);
+    }
+    if (strcmp(name, "rotate_extrude") == 0) {
+        // The outline is drawn in its own plane and swept afterwards
+        scad_shapes_t children = { 0 };
+        int ret = scad_eval_children(s, &st->body, scope, &transform_identity, &children, 0);
+        if (ret >= 0) ret = scad_rotate_extrude(s, &args, scope, t, &children, out);
+        shapes_free(&children);
+        return ret < 0 ? -1 : 0;
+    }
+
+    const scad_module_t* m = scad_find_module(scope->file, name);
+    if (!m) {
+        scad_warning(s, scope->file, st->line, "Ignoring unknown module '%s'", name);
+        return 0;
+    }
+    return scad_call_module(s, st, m, &args, scope, t, out);
+}
+
+static int scad_eval_statement(scad_t* s, const scad_stmt_t* st, scad_scope_t* scope, const transform_t* t,
+                               scad_shapes_t* out) {
+    if (s->failed) return -1;
+    switch (st->kind) {
+    case STMT_BLOCK:
+        return scad_eval_children(s, &st->body, scope, t, out, 0) < 0 ? -1 : 0;
+    case STMT_IF: {
+        scad_value_t c = scad_eval(s, st->value, scope);
+        return scad_eval_children(s, scad_truth(&c) ? &st->body : &st->other, scope, t, out, 0) < 0 ? -1 : 0;
+    }
+    case STMT_FOR:
+        return scad_eval_for(s, st, 0, scope, t, out);
+    case STMT_CALL:
+        return scad_eval_call(s, st, scope, t, out);
+    default:
+        return 0;
+    }
+}
+
+// Evaluates a body in scope. With groups > 0, out is an array and the k-th
+// instantiation goes to out[k], the last entry taking all the rest; returns
+// the number of entries used.
+static int scad_eval_body(scad_t* s, const scad_body_t* body, scad_scope_t* scope, const transform_t* t,
+                          scad_shapes_t* out, int groups) {
+    scad_eval_assignments(s, body, scope);
+    int n = 0;
+    for (int i = 0; i < body->count && !s->failed; i++) {
+        const scad_stmt_t* st = body->items[i];
+        if (st->kind == STMT_ASSIGN || st->kind == STMT_MODULE || st->modifier == '*' || st->modifier == '%') continue;
+        scad_shapes_t* dst = groups ? &out[n < groups ? n : groups - 1] : out;
+        if (scad_eval_statement(s, st, scope, t, dst) < 0) return -1;
+        n++;
+    }
+    if (s->failed) return -1;
+    return groups ? (n < groups ? n : groups) : n;
+}
+
+// ---------------------------------------------------------------------------
+// Driver
+// ---------------------------------------------------------------------------
+
+// Parts of a VRML file as written by write_vrml_model(): the points and
+// coordIndex lists of its IndexedFaceSets, polygons fanned into triangles
+int analyse_vrml(const char* path, mesh_stats_t** parts, int* part_count) {
+    size_t size = 0;
+    char* data = read_file(path, &size);
+    if (!data) {
+        fprintf(stderr, "Error: %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    const char* p = data;
+    const char* end = data + size;
+    double* points = NULL;
+    int point_count = 0, point_capacity = 0, ret = -1;
+    mesh_analysis_t* a = calloc(1, sizeof(*a));
+    if (!a) goto out;
+
+    while (p < end) {
+        const char* key = p;
+        while (p < end && !isspace((unsigned char)*p)) p++;
+        size_t len = p - key;
+        while (p < end && isspace((unsigned char)*p)) p++;
+        if (p >= end || *p != '[') continue;
+        int is_point = len == 5 && memcmp(key, "point", 5) == 0;
+        int is_index = len == 10 && memcmp(key, "coordIndex", 10) == 0;
+        if (!is_point && !is_index) continue;
+        if (is_point) point_count = 0;
+        int face[3], n = 0;
+        for (p++; p < end && *p != ']';) {
+            if (isspace((unsigned char)*p) || *p == ',') {
+                p++;
+                continue;
+            }
+            double x;
+            if (!(p = parse_stl_number(p, end, &x))) {
+                fprintf(stderr, "Error: %s: malformed VRML\n", path);
+                goto out;
+            }
+            if (is_point) {
+                if (grow_array((void**)&points, &point_capacity, point_count + 1, sizeof(double)) < 0) goto out;
+                points[point_count++] = x;
+            } else if (x < 0) {
+                n = 0;
+            } else if (x >= point_count / 3) {
+                fprintf(stderr, "Error: %s: point index out of range\n", path);
+                goto out;
+            } else {
+                face[n < 2 ? n : 2] = (int)x;
+                if (++n >= 3) {
+                    double v[9];
+                    for (int k = 0; k < 3; k++) memcpy(&v[3 * k], &points[3 * face[k]], 3 * sizeof(double));
+                    analysis_triangle(a, v);
+                    face[1] = face[2];
+                }
+            }
+        }
+    }
+    analysis_flush(a);
+    if (a->failed) {
+        fprintf(stderr, "Error: out of memory\n");
+        goto out;
+    }
+    ret = analysis_parts(a, parts, part_count);
+
+out:
+    analysis_free(a);
+    free(points);
+    free(data);
+    return ret;
+}
+
+// Evaluate path with the -D assignments in defines and union everything it
+// instantiates into mesh. quiet drops ECHO output, for batch runs.
+int scad_render(const char* path, char** defines, int define_count, int quiet, mesh_t* mesh) {
+    scad_t s = { 0 };
+    scad_shapes_t shapes = { 0 };
+    int ret = -1;
+
+    s.quiet = quiet;
+    s.root = scad_new_scope(&s, NULL, NULL, NULL);
+    if (!s.root) goto out;
+    scad_define(&s, s.root, "$fn", scad_number(0));
+    scad_define(&s, s.root, "$fa", scad_number(12));
+    scad_define(&s, s.root, "$fs", scad_number(2));
+
+    scad_file_t* main_file = scad_load(&s, path);
+    if (!main_file) goto out;
+    // -D NAME=VALUE works like an assignment at the end of the file
+    for (int i = 0; i < define_count; i++) {
+        size_t len = strlen(defines[i]);
+        char* text = scad_alloc(&s, len + 2);
+        if (!text) goto out;
+        memcpy(text, defines[i], len);
+        text[len] = ';';
+        if (!strchr(defines[i], '=') || scad_parse(&s, main_file, "-D", text, len + 1) < 0) {
+            if (!s.failed) fprintf(stderr, "Error: -D %s: expected NAME=VALUE\n", defines[i]);
+            goto out;
+        }
+    }
+
+    // Used files contribute their modules and top level variables only
+    for (int i = 0; i < s.file_count; i++) {
+        scad_file_t* file = s.files[i];
+        if (!(file->scope = scad_new_scope(&s, s.root, NULL, file))) goto out;
+        if (file != main_file) scad_eval_assignments(&s, &file->body, file->scope);
+    }
+    if (scad_eval_body(&s, &main_file->body, main_file->scope, &transform_identity, &shapes, 0) < 0) goto out;
+    if (shapes.polygon_count) fprintf(stderr, "WARNING: ignoring 2D objects at the top level\n");
+    if (shapes_union(&s, &shapes, mesh) < 0) goto out;
+    ret = 0;
+
+out:
+    shapes_free(&shapes);
+    scad_free(&s);
+    return ret;
+}
+
+// Largest relative difference in volume and box of two part lists, and in
+// area separately; INFINITY if the parts do not pair up
+double scad_compare_parts(const mesh_stats_t* a, int na, const mesh_stats_t* b, int nb, double* area_error) {
+    *area_error = na == nb ? 0 : INFINITY;
+    if (na != nb) return INFINITY;
+    double worst = 0;
+    for (int i = 0; i < na; i++) {
+        const double x[7] = { a[i].volume, a[i].min[0], a[i].min[1], a[i].min[2], a[i].max[0], a[i].max[1], a[i].max[2] };
+        const double y[7] = { b[i].volume, b[i].min[0], b[i].min[1], b[i].min[2], b[i].max[0], b[i].max[1], b[i].max[2] };
+        for (int k = 0; k < 7; k++) {
+            double e = fabs(x[k] - y[k]) / fmax(fabs(y[k]), 1);
+            if (!(e <= worst)) worst = e;
+        }
+        double e = fabs(a[i].area - b[i].area) / fmax(fabs(b[i].area), 1);
+        if (!(e <= *area_error)) *area_error = e;
+    }
+    return worst;
+}
@@ -0,0 +1,18 @@
+/* OpenSCAD evaluator for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#ifndef PLCC_SCAD_H
+#define PLCC_SCAD_H
+
+#include "plcc-gen.h"
+#include "mesh-analysis.h"
+
+#define SCAD_MAX_DEFINES 32
+
+int analyse_vrml(const char* path, mesh_stats_t** parts, int* part_count);
+int scad_render(const char* path, char** defines, int define_count, int quiet, mesh_t* mesh);
+double scad_compare_parts(const mesh_stats_t* a, int na, const mesh_stats_t* b, int nb, double* area_error);
+
+#endif
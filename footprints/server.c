@@ -0,0 +1,623 @@
+/* Request server for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#include "server.h"
+#include "backends.h"
+#include "geometry.h"
+#include "header-model.h"
+#include "mesh.h"
+#include "precompiled.h"
+#include "step.h"
+
+#include <unistd.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <fcntl.h>
+
+// A request is one line of whitespace separated tokens:
+//
+//   APW9328 single-sided via-outside
+//   84 format=wrl
+//   84 format=stl header
+//   84 format=step
+//   spec=MYPART,21,21,1.27,36.60,27.50,36.60,27.50,0.9 via-outside
+//
+// The first token selects the part (name, pin count, pins=N or an inline
+// spec=NAME,PINS_X,PINS_Y,PITCH,A,B,C,D,PAD_WIDTH[,OFFSET_X,OFFSET_Y]).
+// Meshes come from the model library; "header" builds just the pin header
+// strips natively instead. STEP models are always built natively, "header"
+// leaving out the body. "step-model" points footprints at the STEP model.
+// The reply is "OK <bytes> <key>\n" followed by the payload, or
+// "ERR <message>\n". "stats" reports cache and latency counters, framed the
+// same way with the key "stats".
+
+#define MAX_CLIENTS 64
+#define OUTPUT_HIGH_WATER (4 << 20)   // stop reading a client with this much unsent
+
+// Replies waiting to go out to one client
+typedef struct {
+    char* data;
+    size_t pos, len, capacity;
+} output_queue_t;
+
+static int output_append(output_queue_t* q, const char* data, size_t len) {
+    if (q->pos == q->len) q->pos = q->len = 0;
+    if (q->len + len > q->capacity && q->pos > 0) {
+        // Reclaim what has been sent before growing
+        memmove(q->data, q->data + q->pos, q->len - q->pos);
+        q->len -= q->pos;
+        q->pos = 0;
+    }
+    if (q->len + len > q->capacity) {
+        size_t capacity = q->capacity ? q->capacity : 4096;
+        while (capacity < q->len + len) capacity *= 2;
+        char* grown = realloc(q->data, capacity);
+        if (!grown) return -1;
+        q->data = grown;
+        q->capacity = capacity;
+    }
+    memcpy(q->data + q->len, data, len);
+    q->len += len;
+    return 0;
+}
+
+static size_t output_pending(const output_queue_t* q) {
+    return q->len - q->pos;
+}
+
+static int write_all(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int cache_init(lru_cache_t* cache, int capacity) {
+    memset(cache, 0, sizeof(*cache));
+    cache->capacity = capacity > 0 ? capacity : 1;
+    cache->bucket_count = 1;
+    while (cache->bucket_count < cache->capacity * 2) {
+        cache->bucket_count <<= 1;
+    }
+    cache->buckets = calloc(cache->bucket_count, sizeof(cache_entry_t*));
+    return cache->buckets ? 0 : -1;
+}
+
+static void cache_unlink(lru_cache_t* cache, cache_entry_t* e) {
+    if (e->prev) e->prev->next = e->next; else cache->head = e->next;
+    if (e->next) e->next->prev = e->prev; else cache->tail = e->prev;
+    e->prev = e->next = NULL;
+}
+
+static void cache_push_front(lru_cache_t* cache, cache_entry_t* e) {
+    e->prev = NULL;
+    e->next = cache->head;
+    if (cache->head) cache->head->prev = e;
+    cache->head = e;
+    if (!cache->tail) cache->tail = e;
+}
+
+static cache_entry_t* cache_lookup(lru_cache_t* cache, const char* key, uint64_t hash) {
+    cache_entry_t* e = cache->buckets[hash & (cache->bucket_count - 1)];
+    for (; e; e = e->chain) {
+        if (e->hash == hash && strcmp(e->key, key) == 0) {
+            cache_unlink(cache, e);
+            cache_push_front(cache, e);
+            cache->hits++;
+            return e;
+        }
+    }
+    cache->misses++;
+    return NULL;
+}
+
+static void cache_evict(lru_cache_t* cache) {
+    cache_entry_t* victim = cache->tail;
+    if (!victim) return;
+
+    cache_entry_t** slot = &cache->buckets[victim->hash & (cache->bucket_count - 1)];
+    while (*slot != victim) {
+        slot = &(*slot)->chain;
+    }
+    *slot = victim->chain;
+
+    cache_unlink(cache, victim);
+    cache->count--;
+    free(victim->key);
+    free(victim->data);
+    free(victim);
+}
+
+// Takes ownership of data
+static cache_entry_t* cache_insert(lru_cache_t* cache, const char* key, uint64_t hash, char* data, size_t size) {
+    cache_entry_t* e = calloc(1, sizeof(cache_entry_t));
+    if (!e || !(e->key = strdup(key))) {
+        free(e);
+        free(data);
+        return NULL;
+    }
+    e->hash = hash;
+    e->data = data;
+    e->size = size;
+
+    if (cache->count >= cache->capacity) {
+        cache_evict(cache);
+    }
+
+    cache_entry_t** slot = &cache->buckets[hash & (cache->bucket_count - 1)];
+    e->chain = *slot;
+    *slot = e;
+    cache_push_front(cache, e);
+    cache->count++;
+    return e;
+}
+
+static void cache_free(lru_cache_t* cache) {
+    while (cache->tail) {
+        cache_evict(cache);
+    }
+    free(cache->buckets);
+}
+
+int parse_inline_spec(const char* text, component_spec_t* spec) {
+    memset(spec, 0, sizeof(*spec));
+    int n = sscanf(text, "%31[^,],%d,%d,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf",
+                   spec->name, &spec->pins_x, &spec->pins_y, &spec->pitch,
+                   &spec->body.a, &spec->body.b, &spec->body.c, &spec->body.d,
+                   &spec->pad_width, &spec->offset_x, &spec->offset_y);
+    if (n != 9 && n != 11) return -1;
+    spec->pins = 2 * (spec->pins_x + spec->pins_y);
+    return validate_spec(spec) ? 0 : -1;
+}
+
+// Pin count token, "84" or "pins=84"; 0 unless the whole token is a number
+static int parse_pins(const char* tok) {
+    if (strncmp(tok, "pins=", 5) == 0) tok += 5;
+    char* end;
+    errno = 0;
+    long pins = strtol(tok, &end, 10);
+    if (end == tok || *end || errno || pins < 1 || pins > INT_MAX) return 0;
+    return pins;
+}
+
+int parse_request(char* line, request_t* req, char* err, size_t errlen) {
+    memset(req, 0, sizeof(*req));
+    req->opts.double_sided = 1;
+    req->writer = &footprint_writers[0];
+    generate_timestamp(req->opts.timestamp, sizeof(req->opts.timestamp));
+
+    int have_part = 0;
+    char* save = NULL;
+    for (char* tok = strtok_r(line, " \t\r\n", &save); tok; tok = strtok_r(NULL, " \t\r\n", &save)) {
+        const component_spec_t* spec = NULL;
+
+        if (strcmp(tok, "double-sided") == 0) {
+            req->opts.double_sided = 1;
+        } else if (strcmp(tok, "single-sided") == 0) {
+            req->opts.double_sided = 0;
+        } else if (strcmp(tok, "via-outside") == 0) {
+            req->opts.via_outside = 1;
+        } else if (strcmp(tok, "via-inside") == 0) {
+            req->opts.via_outside = 0;
+        } else if (strcmp(tok, "header") == 0) {
+            req->header = 1;
+        } else if (strcmp(tok, "step-model") == 0) {
+            req->opts.step_model = 1;
+        } else if (strncmp(tok, "format=", 7) == 0) {
+            if ((req->writer = find_footprint_writer(tok + 7)) != NULL) req->format = OUTPUT_FOOTPRINT;
+            else if (strcmp(tok + 7, "stl") == 0) req->format = OUTPUT_STL;
+            else if (strcmp(tok + 7, "wrl") == 0) req->format = OUTPUT_WRL;
+            else if (strcmp(tok + 7, "step") == 0) req->format = OUTPUT_STEP;
+            else {
+                snprintf(err, errlen, "unknown format '%s'", tok + 7);
+                return -1;
+            }
+        } else if (strncmp(tok, "spec=", 5) == 0) {
+            if (parse_inline_spec(tok + 5, &req->spec) < 0) {
+                snprintf(err, errlen, "invalid spec '%s'", tok + 5);
+                return -1;
+            }
+            req->custom = 1;
+            have_part = 1;
+        } else if ((spec = find_component_by_name(tok)) != NULL ||
+                   (spec = find_component_by_pins(parse_pins(tok))) != NULL) {
+            req->spec = *spec;
+            have_part = 1;
+        } else {
+            snprintf(err, errlen, "unknown token '%s'", tok);
+            return -1;
+        }
+    }
+
+    if (!have_part) {
+        snprintf(err, errlen, "no part given");
+        return -1;
+    }
+    return 0;
+}
+
+// Cache key of a request. Dimensions are printed with %a, so two specs
+// share a key only if every double is bit for bit the same; inline specs
+// are kept apart from catalog parts, which render with plug data.
+void request_key(const request_t* req, char* key, size_t len) {
+    const component_spec_t* s = &req->spec;
+    snprintf(key, len, "%s|%d|%d|%d|%d|%a|%a|%a|%a|%a|%a|%a|%a|%d|%d|%d|%d|%d|%s",
+             s->name, req->custom, s->pins, s->pins_x, s->pins_y, s->pitch,
+             s->body.a, s->body.b, s->body.c, s->body.d,
+             s->pad_width, s->offset_x, s->offset_y,
+             req->opts.double_sided, req->opts.via_outside, req->opts.step_model, req->format,
+             req->format != OUTPUT_FOOTPRINT && req->header,
+             req->format == OUTPUT_FOOTPRINT ? req->writer->name : "");
+}
+
+// Render a request into a freshly allocated buffer
+char* render_request(const server_t* server, request_t* req, size_t* size, char* err, size_t errlen) {
+    if (req->format == OUTPUT_FOOTPRINT) {
+        char* data = req->writer == &footprint_writers[0] ? precompiled_footprint(&req->spec, &req->opts, size) : NULL;
+        if (data) return data;
+        footprint_geometry_t* geom = generate_geometry(&req->spec, &req->opts);
+        data = geom ? render_footprint(geom, &req->spec, &req->opts, req->writer, size) : NULL;
+        free_geometry(geom);
+        if (!data) {
+            snprintf(err, errlen, "failed to generate footprint");
+        }
+        return data;
+    }
+
+    if (req->header || req->format == OUTPUT_STEP) {
+        const plug_spec_t* plug = req->custom ? NULL : find_plug_by_pins(req->spec.pins);
+        model_t model;
+        if (!plug) {
+            snprintf(err, errlen, "no plug dimensions for %s", req->spec.name);
+            return NULL;
+        }
+        if (req->format == OUTPUT_STEP) {
+            char* data = render_step_model(plug, !req->header, 1, size);
+            if (!data) {
+                snprintf(err, errlen, "failed to build STEP model");
+            }
+            return data;
+        }
+        if (build_header_model(&model, plug, DEFAULT_BEND_SEGMENTS) < 0) {
+            snprintf(err, errlen, "failed to build header model");
+            return NULL;
+        }
+        char* data = render_model(&model, find_mesh_writer(req->format == OUTPUT_STL ? "stl" : "wrl"), size);
+        model_free(&model);
+        if (!data) {
+            snprintf(err, errlen, "failed to format header model");
+        }
+        return data;
+    }
+
+    // Meshes come from the model library, standard parts only
+    if (req->custom) {
+        snprintf(err, errlen, "no mesh for custom spec %s", req->spec.name);
+        return NULL;
+    }
+    char path[4096];
+    if (req->format == OUTPUT_STL) {
+        snprintf(path, sizeof(path), "%s/PLCCplug.stl/PLCCplug-%dpin.stl", server->root, req->spec.pins);
+    } else {
+        snprintf(path, sizeof(path), "%s/PLCCplug.3dshapes/PLCCplug-%dpin.wrl", server->root, req->spec.pins);
+    }
+    TRACE_START(t_read);
+    char* data = read_file(path, size);
+    TRACE_STOP(t_read, STAGE_FILE_IO, data ? *size : 0);
+    if (!data) {
+        snprintf(err, errlen, "%.200s: %s", path, strerror(errno));
+    }
+    return data;
+}
+
+static void server_stats(server_t* server, char* buf, size_t len) {
+    unsigned long n = server->requests < LATENCY_SAMPLES ? server->requests : LATENCY_SAMPLES;
+    double sorted[LATENCY_SAMPLES];
+    double p50 = 0, p99 = 0;
+
+    if (n > 0) {
+        memcpy(sorted, server->latency_us, n * sizeof(double));
+        qsort(sorted, n, sizeof(double), compare_double);
+        p50 = sorted[(n - 1) / 2];
+        p99 = sorted[(n - 1) * 99 / 100];
+    }
+    snprintf(buf, len, "requests=%lu errors=%lu hits=%lu misses=%lu cached=%d/%d p50_us=%.1f p99_us=%.1f\n",
+             server->requests, server->errors, server->cache.hits, server->cache.misses,
+             server->cache.count, server->cache.capacity, p50, p99);
+}
+
+// Answer one request line, queueing the reply on out. Returns -1 if the peer
+// asked to quit or the reply could not be queued.
+static int handle_request(server_t* server, char* line, output_queue_t* out) {
+    char err[256];
+    char reply[512];
+    request_t req;
+
+    line[strcspn(line, "\r\n")] = '\0';
+    if (line[strspn(line, " \t")] == '\0') return 0;
+    if (strcmp(line, "quit") == 0) return -1;
+    if (strcmp(line, "stats") == 0) {
+        char stats[448];
+        server_stats(server, stats, sizeof(stats));
+        snprintf(reply, sizeof(reply), "OK %zu stats\n%s", strlen(stats), stats);
+        return output_append(out, reply, strlen(reply));
+    }
+
+    double start = monotonic_us();
+    int ret;
+
+    if (parse_request(line, &req, err, sizeof(err)) < 0) {
+        server->errors++;
+        snprintf(reply, sizeof(reply), "ERR %s\n", err);
+        ret = output_append(out, reply, strlen(reply));
+    } else {
+        char key[512];
+        request_key(&req, key, sizeof(key));
+        uint64_t hash = hash_bytes(key, strlen(key));
+
+        cache_entry_t* e = cache_lookup(&server->cache, key, hash);
+        if (!e) {
+            size_t size = 0;
+            char* data = render_request(server, &req, &size, err, sizeof(err));
+            if (data) {
+                e = cache_insert(&server->cache, key, hash, data, size);
+            }
+            if (!e) {
+                server->errors++;
+                if (data) snprintf(err, sizeof(err), "out of memory");
+            }
+        }
+        if (e) {
+            snprintf(reply, sizeof(reply), "OK %zu %016llx\n", e->size, (unsigned long long)hash);
+            ret = output_append(out, reply, strlen(reply));
+            if (ret == 0) {
+                ret = output_append(out, e->data, e->size);
+            }
+        } else {
+            snprintf(reply, sizeof(reply), "ERR %s\n", err);
+            ret = output_append(out, reply, strlen(reply));
+        }
+    }
+
+    server->latency_us[server->requests % LATENCY_SAMPLES] = monotonic_us() - start;
+    server->requests++;
+    TRACE_STOP(start, STAGE_REQUEST, 1);
+    return ret;
+}
+
+static int serve_stdio(server_t* server) {
+    char line[REQUEST_MAX];
+    output_queue_t out = { 0 };
+    int ret = 0;
+    while (fgets(line, sizeof(line), stdin)) {
+        int quit = handle_request(server, line, &out) < 0;
+        if (write_all(STDOUT_FILENO, out.data + out.pos, output_pending(&out)) < 0) {
+            ret = 1;
+            break;
+        }
+        out.pos = out.len;
+        if (quit) break;
+    }
+    free(out.data);
+    return ret;
+}
+
+typedef struct {
+    int fd;
+    char buf[REQUEST_MAX];
+    size_t len;
+    output_queue_t out;
+    int closing;           // quit or end of input: close once out is flushed
+} client_t;
+
+static volatile sig_atomic_t server_stop;
+
+static void server_signal(int sig) {
+    (void)sig;
+    server_stop = 1;
+}
+
+// Consume complete lines from a client buffer while its replies fit under
+// the high water mark. Returns -1 to drop the client.
+static int drain_client(server_t* server, client_t* c) {
+    char* start = c->buf;
+    char* nl;
+    while (!c->closing && output_pending(&c->out) < OUTPUT_HIGH_WATER &&
+           (nl = memchr(start, '\n', c->len - (start - c->buf))) != NULL) {
+        *nl = '\0';
+        if (handle_request(server, start, &c->out) < 0) c->closing = 1;
+        start = nl + 1;
+    }
+    c->len -= start - c->buf;
+    memmove(c->buf, start, c->len);
+    if (c->len == sizeof(c->buf)) return -1;   // line too long
+    return 0;
+}
+
+// Send as much queued output as the socket takes without blocking. Returns
+// -1 if the connection broke.
+static int flush_client(client_t* c) {
+    output_queue_t* q = &c->out;
+    while (output_pending(q) > 0) {
+        ssize_t n = write(c->fd, q->data + q->pos, output_pending(q));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            return -1;
+        }
+        q->pos += n;
+    }
+    return 0;
+}
+
+// Read what a client has sent and answer it. Returns -1 to drop the client.
+static int service_client(server_t* server, client_t* c, short revents) {
+    if (revents & POLLIN) {
+        ssize_t n = read(c->fd, c->buf + c->len, sizeof(c->buf) - c->len);
+        if (n < 0 && errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK) return -1;
+        if (n == 0) c->closing = 1;
+        if (n > 0) c->len += n;
+    } else if (revents & (POLLERR | POLLHUP | POLLNVAL)) {
+        return -1;
+    }
+
+    // Requests held back by a full queue run again as it empties
+    do {
+        if (drain_client(server, c) < 0 || flush_client(c) < 0) return -1;
+    } while (!c->closing && output_pending(&c->out) == 0 && memchr(c->buf, '\n', c->len));
+
+    return c->closing && output_pending(&c->out) == 0 ? -1 : 0;
+}
+
+static void close_client(client_t* c) {
+    close(c->fd);
+    free(c->out.data);
+}
+
+static int serve_socket(server_t* server, const char* path) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Error: socket path too long: %s\n", path);
+        return 1;
+    }
+    strcpy(addr.sun_path, path);
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        perror("Error creating socket");
+        return 1;
+    }
+    unlink(path);
+    if (bind(listener, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(listener, MAX_CLIENTS) < 0) {
+        perror("Error binding socket");
+        close(listener);
+        return 1;
+    }
+
+    static client_t clients[MAX_CLIENTS];
+    struct pollfd fds[MAX_CLIENTS + 1];
+    int nclients = 0;
+
+    // Shut down cleanly so the trace and statistics still get written
+    struct sigaction sa = { .sa_handler = server_signal };
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    while (!server_stop) {
+        // A client with a full queue is only written to until it drains, so
+        // a slow reader holds up nobody but itself
+        fds[0] = (struct pollfd){ .fd = listener, .events = POLLIN };
+        for (int i = 0; i < nclients; i++) {
+            size_t pending = output_pending(&clients[i].out);
+            short events = pending ? POLLOUT : 0;
+            if (pending < OUTPUT_HIGH_WATER && !clients[i].closing) events |= POLLIN;
+            fds[i + 1] = (struct pollfd){ .fd = clients[i].fd, .events = events };
+        }
+        if (poll(fds, nclients + 1, -1) < 0) {
+            if (errno == EINTR) continue;
+            perror("Error in poll");
+            break;
+        }
+
+        for (int i = nclients - 1; i >= 0; i--) {
+            if (!fds[i + 1].revents) continue;
+            if (service_client(server, &clients[i], fds[i + 1].revents) < 0) {
+                close_client(&clients[i]);
+                clients[i] = clients[--nclients];
+            }
+        }
+
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(listener, NULL, NULL);
+            if (fd >= 0 && nclients < MAX_CLIENTS && fcntl(fd, F_SETFL, O_NONBLOCK) == 0) {
+                clients[nclients++] = (client_t){ .fd = fd, .len = 0 };
+            } else if (fd >= 0) {
+                close(fd);
+            }
+        }
+    }
+
+    for (int i = 0; i < nclients; i++) {
+        close_client(&clients[i]);
+    }
+    close(listener);
+    unlink(path);
+    return server_stop ? 0 : 1;
+}
+
+int run_server(const char* socket_path, const char* root, int cache_size) {
+    server_t* server = calloc(1, sizeof(server_t));
+    if (!server || cache_init(&server->cache, cache_size) < 0) {
+        fprintf(stderr, "Error: out of memory\n");
+        free(server);
+        return 1;
+    }
+    server->root = root;
+
+    int ret = socket_path ? serve_socket(server, socket_path) : serve_stdio(server);
+
+    cache_free(&server->cache);
+    free(server);
+    return ret;
+}
+
+// Minimal client: forward request lines from stdin, copy replies to stdout
+int run_client(const char* path) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Error: socket path too long: %s\n", path);
+        return 1;
+    }
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror("Error connecting to server");
+        if (fd >= 0) close(fd);
+        return 1;
+    }
+
+    FILE* in = fdopen(fd, "r");
+    char line[REQUEST_MAX];
+    int ret = 0;
+    while (fgets(line, sizeof(line), stdin)) {
+        if (write_all(fd, line, strlen(line)) < 0) {
+            ret = 1;
+            break;
+        }
+        line[strcspn(line, "\r\n")] = '\0';
+        if (strcmp(line, "quit") == 0) break;
+        if (line[strspn(line, " \t")] == '\0') continue;
+
+        char reply[512];
+        if (!fgets(reply, sizeof(reply), in)) {
+            ret = 1;
+            break;
+        }
+        fputs(reply, stdout);
+
+        size_t size;
+        if (sscanf(reply, "OK %zu", &size) == 1) {
+            char buf[65536];
+            while (size > 0) {
+                size_t n = fread(buf, 1, size < sizeof(buf) ? size : sizeof(buf), in);
+                if (n == 0) break;
+                fwrite(buf, 1, n, stdout);
+                size -= n;
+            }
+        }
+    }
+    fclose(in);
+    return ret;
+}
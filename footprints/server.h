@@ -0,0 +1,65 @@
+/* Request server for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#ifndef PLCC_SERVER_H
+#define PLCC_SERVER_H
+
+#include "plcc-gen.h"
+#include "backends.h"
+
+#define DEFAULT_LIBRARY_ROOT ".."
+#define DEFAULT_CACHE_SIZE 256
+#define LATENCY_SAMPLES 4096
+#define REQUEST_MAX 1024
+
+typedef enum {
+    OUTPUT_FOOTPRINT,
+    OUTPUT_STL,
+    OUTPUT_WRL,
+    OUTPUT_STEP
+} output_format_t;
+
+typedef struct {
+    component_spec_t spec;
+    footprint_options_t opts;
+    output_format_t format;
+    const footprint_writer_t* writer;   // for OUTPUT_FOOTPRINT
+    int custom;            // spec was given inline
+    int header;            // native header strips instead of the library model
+} request_t;
+
+typedef struct cache_entry {
+    char* key;
+    uint64_t hash;
+    char* data;
+    size_t size;
+    struct cache_entry *prev, *next;   // LRU order, most recent first
+    struct cache_entry *chain;         // hash bucket chain
+} cache_entry_t;
+
+typedef struct {
+    cache_entry_t** buckets;
+    int bucket_count;
+    cache_entry_t *head, *tail;
+    int count, capacity;
+    unsigned long hits, misses;
+} lru_cache_t;
+
+typedef struct {
+    lru_cache_t cache;
+    const char* root;
+    double latency_us[LATENCY_SAMPLES];
+    unsigned long requests;
+    unsigned long errors;
+} server_t;
+
+int parse_inline_spec(const char* text, component_spec_t* spec);
+int parse_request(char* line, request_t* req, char* err, size_t errlen);
+void request_key(const request_t* req, char* key, size_t len);
+char* render_request(const server_t* server, request_t* req, size_t* size, char* err, size_t errlen);
+int run_server(const char* socket_path, const char* root, int cache_size);
+int run_client(const char* path);
+
+#endif
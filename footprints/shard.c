@@ -0,0 +1,563 @@
+/* Sharded runs for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#include "shard.h"
+#include "check.h"
+#include "panel.h"
+#include "server.h"
+
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fnmatch.h>
+
+// --run renders a work manifest into a directory: every entry (server
+// request grammar, footprints and meshes) and, for footprints, every point
+// of the --sweep grid. The manifest only depends on the arguments, and
+// --shard I/N gives each process the slice a longest-first assignment of
+// the items by estimated cost gives shard I, so N processes or machines
+// started with the same arguments render disjoint, roughly equal slices
+// without talking to each other. Each shard lists what it wrote, with
+// content hashes, in DIR/manifest-I-of-N.tsv. --merge checks that the
+// shards cover the manifest exactly once, verifies every file against its
+// hash and assembles one library whose manifest.tsv is the one an
+// unsharded run would have written.
+
+#define MAX_SHARDS 4096
+#define RUN_MAX_ITEMS 1000000
+#define MANIFEST_MAGIC "# plcc-gen manifest 1"
+
+typedef struct {
+    int entry;                  // index into the entry texts
+    int steps[MAX_SWEEPS];      // point of the sweep grid, footprints only
+    request_t req;
+    char file[160];
+    long cost;                  // estimated render time, us
+    uint64_t hash;              // of the rendered file
+    size_t size;
+    int status;                 // 1 written, 0 unchanged, -1 failed
+} run_item_t;
+
+typedef struct {
+    char** entries;
+    int entry_count, entry_capacity;
+    panel_sweep_t sweeps[MAX_SWEEPS];
+    int sweep_count;
+    run_item_t* items;
+    int count, capacity;
+    uint64_t id;                // identifies entries and sweeps
+} run_manifest_t;
+
+typedef struct {
+    run_manifest_t* manifest;
+    const int* slice;           // item indices of this shard
+    const char* dir;
+    server_t* server;
+} run_batch_t;
+
+// Rough render time from the benchmarks, independent of the machine and
+// build so every shard computes the same slices: the KiCad writer grows
+// with the pad count, native header meshes with the pins, library meshes
+// are only read
+static long run_item_cost(const request_t* req) {
+    long pins = req->spec.pins;
+    switch (req->format) {
+    case OUTPUT_FOOTPRINT:
+        return 50 + 2 * pins * (req->opts.double_sided ? 2 : 1);
+    case OUTPUT_STEP:
+        return 150 * pins;
+    case OUTPUT_STL:
+        return req->header ? 700 * pins : 50;
+    case OUTPUT_WRL:
+        return req->header ? 160 * pins : 50;
+    }
+    return 1;
+}
+
+static void run_item_sweep_text(const run_manifest_t* m, const run_item_t* item, char* buf, size_t len) {
+    size_t n = 0;
+    buf[0] = '\0';
+    for (int s = 0; s < m->sweep_count && item->req.format == OUTPUT_FOOTPRINT; s++) {
+        const panel_sweep_t* sweep = &m->sweeps[s];
+        n += snprintf(buf + n, n < len ? len - n : 0, "%s%s=%+.3f", s ? "," : "", sweep->param->name,
+                      sweep->from + item->steps[s] * sweep->step);
+    }
+    if (n == 0) snprintf(buf, len, "-");
+}
+
+static int add_run_item(run_manifest_t* m, int entry, const int* steps, const request_t* req, const char* file) {
+    if (m->count == RUN_MAX_ITEMS) {
+        fprintf(stderr, "Error: more than %d items\n", RUN_MAX_ITEMS);
+        return -1;
+    }
+    if (grow_array((void**)&m->items, &m->capacity, m->count + 1, sizeof(run_item_t)) < 0) return -1;
+    run_item_t* item = &m->items[m->count++];
+    memset(item, 0, sizeof(*item));
+    item->entry = entry;
+    if (steps) memcpy(item->steps, steps, sizeof(item->steps));
+    item->req = *req;
+    item->cost = run_item_cost(req);
+    snprintf(item->file, sizeof(item->file), "%s", file);
+    return 0;
+}
+
+// One item per sweep grid point for footprints, a single one for meshes
+static int add_run_entry(run_manifest_t* m, int entry) {
+    char line[REQUEST_MAX], err[256];
+    request_t req;
+    snprintf(line, sizeof(line), "%s", m->entries[entry]);
+    if (parse_request(line, &req, err, sizeof(err)) < 0) {
+        fprintf(stderr, "Error: entry '%s': %s\n", m->entries[entry], err);
+        return -1;
+    }
+
+    char file[160];
+    if (req.format != OUTPUT_FOOTPRINT) {
+        if (req.custom) {
+            fprintf(stderr, "Error: entry '%s': no mesh for custom spec %s\n", m->entries[entry], req.spec.name);
+            return -1;
+        }
+        snprintf(file, sizeof(file), "PLCCplug-%dpin%s.%s", req.spec.pins, req.header ? "_header" : "",
+                 req.format == OUTPUT_STL ? "stl" : req.format == OUTPUT_WRL ? "wrl" : "step");
+        return add_run_item(m, entry, NULL, &req, file);
+    }
+
+    const char* variant = "";
+    for (size_t v = 0; v < sizeof(check_variants) / sizeof(check_variants[0]); v++) {
+        if (check_variants[v].double_sided == req.opts.double_sided && check_variants[v].via_outside == req.opts.via_outside) {
+            variant = check_variants[v].suffix;
+        }
+    }
+    long points = 1;
+    for (int s = 0; s < m->sweep_count; s++) points *= sweep_step_count(&m->sweeps[s]);
+    if (points > RUN_MAX_ITEMS) {
+        fprintf(stderr, "Error: entry '%s': sweep grid of %ld points\n", m->entries[entry], points);
+        return -1;
+    }
+
+    for (long p = 0; p < points; p++) {
+        int steps[MAX_SWEEPS] = {0};
+        long rest = p;
+        for (int s = m->sweep_count - 1; s >= 0; s--) {
+            int n = sweep_step_count(&m->sweeps[s]);
+            steps[s] = rest % n;
+            rest /= n;
+        }
+        request_t r = req;
+        char stem[96];
+        int len = snprintf(stem, sizeof(stem), "%s", req.spec.name);
+        for (int s = 0; s < m->sweep_count; s++) {
+            double delta = apply_sweep(&r.spec, &m->sweeps[s], steps[s]);
+            len += snprintf(stem + len, len < (int)sizeof(stem) ? sizeof(stem) - len : 0, "_%s%+.3f", m->sweeps[s].param->name, delta);
+        }
+        if (m->sweep_count) {
+            if (!validate_spec(&r.spec)) {
+                fprintf(stderr, "Error: %s: sweep leaves an invalid spec\n", stem);
+                return -1;
+            }
+            snprintf(r.spec.name, sizeof(r.spec.name), "%.31s", stem);
+        }
+        snprintf(file, sizeof(file), "%s%s%s.%s", stem, variant, r.opts.step_model ? "_step_model" : "", r.writer->extension);
+        if (add_run_item(m, entry, steps, &r, file) < 0) return -1;
+    }
+    return 0;
+}
+
+static int compare_run_files(const void* a, const void* b, void* arg) {
+    const run_item_t* items = arg;
+    return strcmp(items[*(const int*)a].file, items[*(const int*)b].file);
+}
+
+static int build_run_manifest(run_manifest_t* m) {
+    for (int i = 0; i < m->entry_count; i++) {
+        if (add_run_entry(m, i) < 0) return -1;
+    }
+
+    int* order = malloc((m->count ? m->count : 1) * sizeof(int));
+    uint64_t* keys = malloc((m->count ? m->count : 1) * sizeof(uint64_t));
+    int ret = order && keys ? 0 : -1;
+    for (int i = 0; i < m->count && ret == 0; i++) {
+        char key[512];
+        request_key(&m->items[i].req, key, sizeof(key));
+        size_t n = strlen(key);
+        snprintf(key + n, sizeof(key) - n, "|%s", m->items[i].file);
+        keys[i] = hash_bytes(key, strlen(key));
+        order[i] = i;
+    }
+    if (ret == 0) {
+        m->id = hash_bytes(keys, m->count * sizeof(uint64_t));
+        qsort_r(order, m->count, sizeof(int), compare_run_files, m->items);
+        for (int i = 1; i < m->count; i++) {
+            if (strcmp(m->items[order[i - 1]].file, m->items[order[i]].file) == 0) {
+                fprintf(stderr, "Error: two entries write %s\n", m->items[order[i]].file);
+                ret = -1;
+                break;
+            }
+        }
+    }
+    free(order);
+    free(keys);
+    return ret;
+}
+
+static int compare_run_cost(const void* a, const void* b, void* arg) {
+    const run_item_t* items = arg;
+    int x = *(const int*)a, y = *(const int*)b;
+    if (items[x].cost != items[y].cost) return items[x].cost > items[y].cost ? -1 : 1;
+    return x - y;
+}
+
+// Longest first: items by falling cost, each to the shard with the least
+// work so far (a min-heap on load, ties to the lower shard). Returns the
+// items of shard, most expensive first.
+static int* shard_slice(const run_manifest_t* m, int shard, int shards, int* count, long* cost) {
+    int* order = malloc((m->count ? m->count : 1) * sizeof(int));
+    int* heap = malloc(shards * sizeof(int));
+    long* load = calloc(shards, sizeof(long));
+    if (!order || !heap || !load) {
+        free(order);
+        free(heap);
+        free(load);
+        return NULL;
+    }
+    for (int i = 0; i < m->count; i++) order[i] = i;
+    for (int s = 0; s < shards; s++) heap[s] = s;
+    qsort_r(order, m->count, sizeof(int), compare_run_cost, m->items);
+
+    int n = 0;
+    for (int i = 0; i < m->count; i++) {
+        int s = heap[0];
+        load[s] += m->items[order[i]].cost;
+        if (s == shard) order[n++] = order[i];
+        // Only the root grew; sift it down
+        for (int k = 0; ; ) {
+            int l = 2 * k + 1, r = l + 1, min = k;
+            if (l < shards && (load[heap[l]] < load[heap[min]] || (load[heap[l]] == load[heap[min]] && heap[l] < heap[min]))) min = l;
+            if (r < shards && (load[heap[r]] < load[heap[min]] || (load[heap[r]] == load[heap[min]] && heap[r] < heap[min]))) min = r;
+            if (min == k) break;
+            int t = heap[k];
+            heap[k] = heap[min];
+            heap[min] = t;
+            k = min;
+        }
+    }
+    *count = n;
+    *cost = load[shard];
+    free(heap);
+    free(load);
+    return order;
+}
+
+static void render_run_item(void* ctx, int index) {
+    run_batch_t* batch = ctx;
+    run_item_t* item = &batch->manifest->items[batch->slice[index]];
+    request_t req = item->req;
+    char err[256], path[4096 + 160];
+    size_t size = 0;
+
+    char* data = render_request(batch->server, &req, &size, err, sizeof(err));
+    if (!data) {
+        fprintf(stderr, "Error: %s: %s\n", item->file, err);
+        item->status = -1;
+        return;
+    }
+    snprintf(path, sizeof(path), "%s/%s", batch->dir, item->file);
+    item->hash = hash_bytes(data, size);
+    item->size = size;
+    item->status = replace_file(path, data, size);
+    free(data);
+}
+
+static void write_manifest_header(FILE* f, uint64_t id, int items, int shard, int shards) {
+    fprintf(f, "%s\n# id %016llx items %d", MANIFEST_MAGIC, (unsigned long long)id, items);
+    if (shards > 1) fprintf(f, " shard %d/%d", shard, shards);
+    fprintf(f, "\n");
+}
+
+static int write_run_manifest(const char* dir, const run_manifest_t* m, int* slice, int count, int shard, int shards) {
+    char path[4096], sweep[256];
+    char* data = NULL;
+    size_t size = 0;
+    FILE* f = open_memstream(&data, &size);
+    if (!f) return -1;
+
+    qsort(slice, count, sizeof(int), compare_ints);
+    write_manifest_header(f, m->id, m->count, shard, shards);
+    for (int i = 0; i < count; i++) {
+        const run_item_t* item = &m->items[slice[i]];
+        run_item_sweep_text(m, item, sweep, sizeof(sweep));
+        fprintf(f, "%d\t%016llx\t%zu\t%ld\t%s\t%s\t%s\n", slice[i], (unsigned long long)item->hash, item->size, item->cost,
+                item->file, m->entries[item->entry], sweep);
+    }
+    fclose(f);
+    if (shards > 1) snprintf(path, sizeof(path), "%s/manifest-%d-of-%d.tsv", dir, shard, shards);
+    else snprintf(path, sizeof(path), "%s/manifest.tsv", dir);
+    int ret = data ? replace_file(path, data, size) : -1;
+    free(data);
+    return ret < 0 ? -1 : 0;
+}
+
+static int make_directory(const char* dir) {
+    if (mkdir(dir, 0777) < 0 && errno != EEXIST) {
+        fprintf(stderr, "Error: %s: %s\n", dir, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+static int add_entry_text(run_manifest_t* m, const char* text) {
+    if (grow_array((void**)&m->entries, &m->entry_capacity, m->entry_count + 1, sizeof(char*)) < 0) return -1;
+    char* copy = strdup(text);
+    if (!copy) return -1;
+    for (char* p = copy; *p; p++) {
+        if (*p == '\t') *p = ' ';
+    }
+    m->entries[m->entry_count++] = copy;
+    return 0;
+}
+
+// Entries from argv, or from list_path (one per line, # comments), or the
+// whole catalog in all four variants
+int run_sharded(const char* dir, char** args, int nargs, const char* list_path, char** sweep_texts,
+                int sweep_count, const char* shard_text, const char* root, int jobs) {
+    run_manifest_t m = {0};
+    server_t* server = calloc(1, sizeof(server_t));
+    int shard = 0, shards = 1, count = 0, ret = 1;
+    long cost = 0;
+    int* slice = NULL;
+
+    if (!server) goto out;
+    server->root = root;
+    if (shard_text && (sscanf(shard_text, "%d/%d", &shard, &shards) != 2 || shards < 1 ||
+                       shards > MAX_SHARDS || shard < 0 || shard >= shards)) {
+        fprintf(stderr, "Error: invalid shard '%s' (I/N with 0 <= I < N <= %d)\n", shard_text, MAX_SHARDS);
+        goto out;
+    }
+    if (sweep_count > MAX_SWEEPS) {
+        fprintf(stderr, "Error: at most %d sweeps\n", MAX_SWEEPS);
+        goto out;
+    }
+    for (int i = 0; i < sweep_count; i++) {
+        if (parse_sweep(sweep_texts[i], &m.sweeps[i]) < 0) goto out;
+    }
+    m.sweep_count = sweep_count;
+
+    if (list_path) {
+        FILE* list = fopen(list_path, "r");
+        if (!list) {
+            fprintf(stderr, "Error: %s: %s\n", list_path, strerror(errno));
+            goto out;
+        }
+        char line[REQUEST_MAX];
+        int bad = 0;
+        while (!bad && fgets(line, sizeof(line), list)) {
+            char* p = line + strspn(line, " \t");
+            if (*p == '#' || *p == '\n' || *p == '\0') continue;
+            line[strcspn(line, "\r\n#")] = '\0';
+            bad = add_entry_text(&m, line) < 0;
+        }
+        fclose(list);
+        if (bad) goto out;
+    }
+    for (int i = 0; i < nargs; i++) {
+        if (add_entry_text(&m, args[i]) < 0) goto out;
+    }
+    if (!list_path && nargs == 0) {
+        for (int s = 0; s < num_component_specs; s++) {
+            for (size_t v = 0; v < sizeof(check_variants) / sizeof(check_variants[0]); v++) {
+                char line[128];
+                snprintf(line, sizeof(line), "%.31s %s %s", component_specs[s].name,
+                         check_variants[v].double_sided ? "double-sided" : "single-sided",
+                         check_variants[v].via_outside ? "via-outside" : "via-inside");
+                if (add_entry_text(&m, line) < 0) goto out;
+            }
+        }
+    }
+
+    TRACE_START(t_plan);
+    if (build_run_manifest(&m) < 0 || !(slice = shard_slice(&m, shard, shards, &count, &cost))) goto out;
+    TRACE_STOP(t_plan, STAGE_INDEX, m.count);
+    if (make_directory(dir) < 0) goto out;
+
+    double start = monotonic_us();
+    run_batch_t batch = { &m, slice, dir, server };
+    parallel_for(count, jobs, render_run_item, &batch);
+
+    int written = 0, failed = 0;
+    for (int i = 0; i < count; i++) {
+        written += m.items[slice[i]].status > 0;
+        failed += m.items[slice[i]].status < 0;
+    }
+    if (!failed && write_run_manifest(dir, &m, slice, count, shard, shards) == 0) ret = 0;
+    fprintf(stderr, "shard %d/%d: %d of %d items (%.1f ms estimated), %d written, %d unchanged, %d failed in %.1f ms\n",
+            shard, shards, count, m.count, cost / 1000.0, written, count - written - failed, failed,
+            (monotonic_us() - start) / 1000);
+
+out:
+    for (int i = 0; i < m.entry_count; i++) free(m.entries[i]);
+    free(m.entries);
+    free(m.items);
+    free(slice);
+    free(server);
+    return ret;
+}
+
+typedef struct {
+    uint64_t id;
+    int items, shard, shards;
+} manifest_header_t;
+
+static int parse_manifest_header(FILE* f, manifest_header_t* h) {
+    char line[256];
+    memset(h, 0, sizeof(*h));
+    h->shards = 1;
+    if (!fgets(line, sizeof(line), f) || strncmp(line, MANIFEST_MAGIC "\n", sizeof(MANIFEST_MAGIC)) != 0 ||
+        !fgets(line, sizeof(line), f)) {
+        return -1;
+    }
+    unsigned long long id = 0;
+    int n = sscanf(line, "# id %llx items %d shard %d/%d", &id, &h->items, &h->shard, &h->shards);
+    h->id = id;
+    return (n == 2 || n == 4) && h->items >= 0 && h->shards >= 1 && h->shards <= MAX_SHARDS &&
+           h->shard >= 0 && h->shard < h->shards ? 0 : -1;
+}
+
+// Check one shard manifest and its files, copy them to dir unless the
+// shard rendered there, and keep its lines for the merged manifest
+static int merge_shard(const char* dir, const char* shard_dir, const char* path, const manifest_header_t* h,
+                       FILE* f, char** lines) {
+    struct stat a, b;
+    int same_dir = stat(dir, &a) == 0 && stat(shard_dir, &b) == 0 && a.st_dev == b.st_dev && a.st_ino == b.st_ino;
+    char line[REQUEST_MAX + 512];
+    int line_no = 2;
+
+    while (fgets(line, sizeof(line), f)) {
+        line_no++;
+        int index, consumed = 0;
+        unsigned long long hash;
+        size_t size;
+        long cost;
+        char file[160];
+        if (sscanf(line, "%d\t%llx\t%zu\t%ld\t%159[^\t]\t%n", &index, &hash, &size, &cost, file, &consumed) != 5 ||
+            !consumed || index < 0 || index >= h->items || strchr(file, '/')) {
+            fprintf(stderr, "Error: %s:%d: invalid manifest line\n", path, line_no);
+            return -1;
+        }
+        if (lines[index]) {
+            fprintf(stderr, "Error: %s:%d: item %d is in two shards\n", path, line_no, index);
+            return -1;
+        }
+
+        char src[4096 + 160];
+        size_t actual = 0;
+        snprintf(src, sizeof(src), "%s/%s", shard_dir, file);
+        char* data = read_file(src, &actual);
+        if (!data || actual != size || hash_bytes(data, actual) != hash) {
+            fprintf(stderr, "Error: %s does not match its manifest\n", src);
+            free(data);
+            return -1;
+        }
+        int ret = 0;
+        if (!same_dir) {
+            char dst[4096 + 160];
+            snprintf(dst, sizeof(dst), "%s/%s", dir, file);
+            ret = replace_file(dst, data, actual);
+        }
+        free(data);
+        if (ret < 0 || !(lines[index] = strdup(line))) return -1;
+    }
+    return 0;
+}
+
+int run_merge(const char* dir, char** shard_dirs, int count) {
+    manifest_header_t first = {0};
+    char** lines = NULL;
+    unsigned char* seen = NULL;
+    int manifests = 0, ret = 1;
+
+    if (count == 0) {
+        fprintf(stderr, "Error: --merge needs the shard directories\n");
+        return 1;
+    }
+    if (make_directory(dir) < 0) return 1;
+
+    for (int d = 0; d < count; d++) {
+        DIR* dp = opendir(shard_dirs[d]);
+        if (!dp) {
+            fprintf(stderr, "Error: %s: %s\n", shard_dirs[d], strerror(errno));
+            goto out;
+        }
+        struct dirent* de;
+        int bad = 0;
+        while (!bad && (de = readdir(dp)) != NULL) {
+            if (fnmatch("manifest-*-of-*.tsv", de->d_name, 0) != 0) continue;
+            char path[4096 + 256];
+            manifest_header_t h;
+            snprintf(path, sizeof(path), "%s/%s", shard_dirs[d], de->d_name);
+            FILE* f = fopen(path, "r");
+            if (!f || parse_manifest_header(f, &h) < 0) {
+                fprintf(stderr, "Error: %s: not a shard manifest\n", path);
+                bad = 1;
+            } else if (manifests && (h.id != first.id || h.items != first.items || h.shards != first.shards)) {
+                fprintf(stderr, "Error: %s belongs to another run\n", path);
+                bad = 1;
+            } else {
+                if (!manifests++) {
+                    first = h;
+                    lines = calloc(h.items ? h.items : 1, sizeof(char*));
+                    seen = calloc(h.shards, 1);
+                    if (!lines || !seen) bad = 1;
+                }
+                // The same directory may be named twice
+                if (!bad && !seen[h.shard]) {
+                    seen[h.shard] = 1;
+                    bad = merge_shard(dir, shard_dirs[d], path, &h, f, lines) < 0;
+                }
+            }
+            if (f) fclose(f);
+        }
+        closedir(dp);
+        if (bad) goto out;
+    }
+
+    if (!manifests) {
+        fprintf(stderr, "Error: no shard manifests found\n");
+        goto out;
+    }
+    int missing = 0;
+    for (int s = 0; s < first.shards; s++) {
+        if (!seen[s]) {
+            fprintf(stderr, "Error: shard %d/%d is missing\n", s, first.shards);
+            missing++;
+        }
+    }
+    for (int i = 0; i < first.items && !missing; i++) {
+        if (!lines[i]) {
+            fprintf(stderr, "Error: item %d is in no shard\n", i);
+            missing++;
+        }
+    }
+    if (missing) goto out;
+
+    char* data = NULL;
+    size_t size = 0;
+    char path[4096];
+    FILE* f = open_memstream(&data, &size);
+    if (!f) goto out;
+    write_manifest_header(f, first.id, first.items, 0, 1);
+    for (int i = 0; i < first.items; i++) fputs(lines[i], f);
+    fclose(f);
+    snprintf(path, sizeof(path), "%s/manifest.tsv", dir);
+    if (data && replace_file(path, data, size) >= 0) {
+        fprintf(stderr, "%d shards, %d items merged into %s\n", first.shards, first.items, dir);
+        ret = 0;
+    }
+    free(data);
+
+out:
+    for (int i = 0; lines && i < first.items; i++) free(lines[i]);
+    free(lines);
+    free(seen);
+    return ret;
+}
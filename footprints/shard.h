@@ -0,0 +1,17 @@
+/* Sharded runs for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#ifndef PLCC_SHARD_H
+#define PLCC_SHARD_H
+
+#include "plcc-gen.h"
+
+#define MAX_SWEEPS 4
+
+int run_sharded(const char* dir, char** args, int nargs, const char* list_path, char** sweep_texts,
+                int sweep_count, const char* shard_text, const char* root, int jobs);
+int run_merge(const char* dir, char** shard_dirs, int count);
+
+#endif
@@ -0,0 +1,73 @@
+/* Component specifications for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#include "plcc-gen.h"
+
+// Both tables are expanded from plcc-specs.def, which also generates the
+// plug dimensions of plccplug.scad (--emit-scad-specs). The model offset
+// centres the bottom plate of the plug, turned by 90 degrees, on the pads.
+#define PART(name, pins, pins_x, pins_y, pitch, a, b, c, d, pad_width, pa, pb, pc, pd) \
+    {name, pins, pins_x, pins_y, pitch, {a, b, c, d}, pad_width, (pd) / 2, -(pc) / 2},
+const component_spec_t component_specs[] = {
+#include "plcc-specs.def"
+};
+#undef PART
+
+const int num_component_specs = sizeof(component_specs) / sizeof(component_specs[0]);
+
+// Printed plug dimensions; the plug is turned by 90 degrees
+#define PART(name, pins, pins_x, pins_y, pitch, a, b, c, d, pad_width, pa, pb, pc, pd) \
+    {pins, pa, pb, pc, pd, pins_y, pins_x},
+const plug_spec_t plug_specs[] = {
+#include "plcc-specs.def"
+};
+#undef PART
+
+#define PART(name, pins, pins_x, pins_y, ...) \
+    _Static_assert(pins_x >= 1 && pins_y >= 1, name ": needs pins on every side"); \
+    _Static_assert(pins == 2 * (pins_x + pins_y), name ": pins must be 2 * (pins_x + pins_y)"); \
+    _Static_assert(pins_x % 2 == 1, name ": pin 1 sits in the middle of the top row, pins_x must be odd");
+#include "plcc-specs.def"
+#undef PART
+
+const int num_plug_specs = sizeof(plug_specs) / sizeof(plug_specs[0]);
+
+const component_spec_t* find_component_by_pins(int pins) {
+    for (int i = 0; i < num_component_specs; i++) {
+        if (component_specs[i].pins == pins) {
+            return &component_specs[i];
+        }
+    }
+    return NULL;
+}
+
+const plug_spec_t* find_plug_by_pins(int pins) {
+    for (int i = 0; i < num_plug_specs; i++) {
+        if (plug_specs[i].pins == pins) {
+            return &plug_specs[i];
+        }
+    }
+    return NULL;
+}
+
+const component_spec_t* find_component_by_name(const char* name) {
+    for (int i = 0; i < num_component_specs; i++) {
+        if (strcasecmp(component_specs[i].name, name) == 0) {
+            return &component_specs[i];
+        }
+    }
+    return NULL;
+}
+
+// The runtime side of the _Static_asserts on plcc-specs.def, for parts
+// given inline
+int validate_spec(const component_spec_t* spec) {
+    if (spec->pins_x < 1 || spec->pins_y < 1) return 0;
+    if (spec->pins != 2 * (spec->pins_x + spec->pins_y)) return 0;
+    if (spec->pins_x % 2 != 1) return 0;  // pin 1 in the middle of the top row
+    if (spec->pitch <= 0 || spec->pad_width <= 0) return 0;
+    if (spec->body.a <= 0 || spec->body.c <= spec->body.d) return 0;
+    return 1;
+}
@@ -0,0 +1,950 @@
+/* STEP output formatter for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#include "step.h"
+#include "header-model.h"
+#include "mesh.h"
+
+// ISO 10303-21 (AP214) version of the plug model with exact geometry:
+// planes and cylinders bounded by lines and circles instead of triangles,
+// computed from the same plug_specs as the meshes. The printed body is
+// written as three stacked prisms (lid, plug walls, notched rim) that
+// touch but do not overlap, so no boolean kernel is needed. One header pin
+// is written once and placed with MAPPED_ITEMs. The countersinks under the
+// pin holes (the cones in pin()) are left out; they are only there for the
+// printer and would need intersection curves.
+//
+// The rows of pin holes and grooves make for many coplanar faces and
+// collinear edges. Within a solid these share one PLANE or LINE, and all
+// lines along a direction share one unit VECTOR. That brings the files to
+// about the size of the VRML models, though not below it: every edge still
+// needs two ORIENTED_EDGEs, an EDGE_CURVE and two vertices.
+
+// PLUG_H1, PLUG_WALL, ...: the dimensions plccplug.scad reads from
+// plcc_specs.scad
+#define PLUG_PARAM(name, scad_name, value, description) static const double name = value;
+#include "plcc-plug.def"
+#undef PLUG_PARAM
+
+#define STEP_MAX_DIRECTIONS 512
+#define STEP_MAX_STYLED 4096
+
+typedef struct {
+    FILE* f;
+    int next_id;
+    int context;                         // GEOMETRIC_REPRESENTATION_CONTEXT
+    vec3_t directions[STEP_MAX_DIRECTIONS];
+    int direction_ids[STEP_MAX_DIRECTIONS];
+    int vector_ids[STEP_MAX_DIRECTIONS];  // unit VECTOR along each, 0 until used
+    int direction_count;
+    int styled[STEP_MAX_STYLED];         // STYLED_ITEMs for the presentation
+    int styled_count;
+} step_writer_t;
+
+typedef struct {
+    vec3_t p;
+    int id;                              // VERTEX_POINT
+    int point;                           // its CARTESIAN_POINT
+} brep_vertex_t;
+
+typedef struct {
+    int a, b;                            // vertex indices, curve runs a -> b
+    int id;                              // EDGE_CURVE
+} brep_edge_t;
+
+// Surface or curve shared by the faces or edges that lie on it: a PLANE
+// with unit normal n at n.p = d, or a LINE along n through the foot point
+// p nearest the origin
+typedef struct {
+    vec3_t n, p;
+    double d;
+    int id;
+} brep_carrier_t;
+
+// One closed shell under construction. Vertices and straight edges are
+// shared between faces so every edge is used exactly twice.
+typedef struct {
+    step_writer_t* w;
+    brep_vertex_t* vertices;
+    int vertex_count, vertex_capacity;
+    brep_edge_t* edges;
+    int edge_count, edge_capacity;
+    brep_carrier_t* planes;
+    int plane_count, plane_capacity;
+    brep_carrier_t* lines;
+    int line_count, line_capacity;
+    int* faces;
+    int face_count, face_capacity;
+    int failed;
+} brep_t;
+
+typedef struct {
+    const point_t* points;
+    int count;
+} outline_t;
+
+typedef struct {
+    double x, y, r;
+} step_circle_t;
+
+// STEP reals always carry a decimal point: 1. and 1.E-05
+static const char* step_real(char* buf, size_t len, double v) {
+    char tmp[24];
+    if (fabs(v) < 1e-12) v = 0;
+    snprintf(tmp, sizeof(tmp), "%.10g", v);
+    char* e = strchr(tmp, 'e');
+    if (e) *e = 'E';
+    if (strchr(tmp, '.')) {
+        snprintf(buf, len, "%s", tmp);
+    } else if (e) {
+        snprintf(buf, len, "%.*s.%s", (int)(e - tmp), tmp, e);
+    } else {
+        snprintf(buf, len, "%s.", tmp);
+    }
+    return buf;
+}
+
+// Start an entity; the caller prints the rest of the line
+static int step_begin(step_writer_t* w) {
+    int id = w->next_id++;
+    fprintf(w->f, "#%d=", id);
+    return id;
+}
+
+static void step_id_list(FILE* f, const int* ids, int count) {
+    fputc('(', f);
+    for (int i = 0; i < count; i++) {
+        fprintf(f, i ? ",#%d" : "#%d", ids[i]);
+    }
+    fputc(')', f);
+}
+
+static int step_point(step_writer_t* w, vec3_t p) {
+    char x[32], y[32], z[32];
+    int id = step_begin(w);
+    fprintf(w->f, "CARTESIAN_POINT('',(%s,%s,%s));\n", step_real(x, sizeof(x), p.x),
+            step_real(y, sizeof(y), p.y), step_real(z, sizeof(z), p.z));
+    return id;
+}
+
+// Directions repeat a lot (axes, face normals), so the common ones are
+// written once. Returns the slot of d in the cache, or -1 with *id set if
+// the cache is full.
+static int step_direction_slot(step_writer_t* w, vec3_t d, int* id) {
+    char x[32], y[32], z[32];
+    double len = sqrt(vec3_dot(d, d));
+    d = (vec3_t){ d.x / len, d.y / len, d.z / len };
+    for (int i = 0; i < w->direction_count; i++) {
+        vec3_t o = w->directions[i];
+        if (fabs(o.x - d.x) < 1e-12 && fabs(o.y - d.y) < 1e-12 && fabs(o.z - d.z) < 1e-12) {
+            *id = w->direction_ids[i];
+            return i;
+        }
+    }
+    *id = step_begin(w);
+    fprintf(w->f, "DIRECTION('',(%s,%s,%s));\n", step_real(x, sizeof(x), d.x),
+            step_real(y, sizeof(y), d.y), step_real(z, sizeof(z), d.z));
+    if (w->direction_count == STEP_MAX_DIRECTIONS) return -1;
+    w->directions[w->direction_count] = d;
+    w->direction_ids[w->direction_count] = *id;
+    w->vector_ids[w->direction_count] = 0;
+    return w->direction_count++;
+}
+
+static int step_direction(step_writer_t* w, vec3_t d) {
+    int id;
+    step_direction_slot(w, d, &id);
+    return id;
+}
+
+// A LINE's parameter range comes from its vertices, so one unit VECTOR
+// per direction serves every line along it
+static int step_vector(step_writer_t* w, vec3_t d) {
+    int dir;
+    int slot = step_direction_slot(w, d, &dir);
+    if (slot >= 0 && w->vector_ids[slot]) return w->vector_ids[slot];
+    int id = step_begin(w);
+    fprintf(w->f, "VECTOR('',#%d,1.);\n", dir);
+    if (slot >= 0) w->vector_ids[slot] = id;
+    return id;
+}
+
+// Any unit vector perpendicular to n
+static vec3_t perpendicular(vec3_t n) {
+    vec3_t r = fabs(n.x) < 0.9 ? vec3_cross(n, (vec3_t){ 1, 0, 0 }) : vec3_cross(n, (vec3_t){ 0, 1, 0 });
+    double len = sqrt(vec3_dot(r, r));
+    return (vec3_t){ r.x / len, r.y / len, r.z / len };
+}
+
+static int step_axis_at(step_writer_t* w, int point, vec3_t axis, vec3_t ref) {
+    int a = step_direction(w, axis), r = step_direction(w, ref);
+    int id = step_begin(w);
+    fprintf(w->f, "AXIS2_PLACEMENT_3D('',#%d,#%d,#%d);\n", point, a, r);
+    return id;
+}
+
+static int step_axis(step_writer_t* w, vec3_t origin, vec3_t axis, vec3_t ref) {
+    return step_axis_at(w, step_point(w, origin), axis, ref);
+}
+
+// Placement of a rigid transform: its z column is the axis, x the reference
+static int step_placement(step_writer_t* w, const transform_t* t) {
+    return step_axis(w, (vec3_t){ t->m[0][3], t->m[1][3], t->m[2][3] },
+                     (vec3_t){ t->m[0][2], t->m[1][2], t->m[2][2] },
+                     (vec3_t){ t->m[0][0], t->m[1][0], t->m[2][0] });
+}
+
+static int step_oriented_edge(step_writer_t* w, int edge, int sense) {
+    int id = step_begin(w);
+    fprintf(w->f, "ORIENTED_EDGE('',*,*,#%d,%s);\n", edge, sense ? ".T." : ".F.");
+    return id;
+}
+
+static int step_loop(step_writer_t* w, const int* oriented, int count, int outer) {
+    int loop = step_begin(w);
+    fprintf(w->f, "EDGE_LOOP('',");
+    step_id_list(w->f, oriented, count);
+    fprintf(w->f, ");\n");
+    int id = step_begin(w);
+    fprintf(w->f, "%s('',#%d,.T.);\n", outer ? "FACE_OUTER_BOUND" : "FACE_BOUND", loop);
+    return id;
+}
+
+static int step_face(step_writer_t* w, const int* bounds, int count, int surface, int same_sense) {
+    int id = step_begin(w);
+    fprintf(w->f, "ADVANCED_FACE('',");
+    step_id_list(w->f, bounds, count);
+    fprintf(w->f, ",#%d,%s);\n", surface, same_sense ? ".T." : ".F.");
+    return id;
+}
+
+static int brep_vertex(brep_t* b, vec3_t p) {
+    for (int i = 0; i < b->vertex_count; i++) {
+        vec3_t q = b->vertices[i].p;
+        if (fabs(p.x - q.x) < 1e-9 && fabs(p.y - q.y) < 1e-9 && fabs(p.z - q.z) < 1e-9) return i;
+    }
+    if (grow_array((void**)&b->vertices, &b->vertex_capacity, b->vertex_count + 1, sizeof(brep_vertex_t)) < 0) {
+        b->failed = 1;
+        return -1;
+    }
+    brep_vertex_t* v = &b->vertices[b->vertex_count];
+    v->p = p;
+    v->point = step_point(b->w, p);
+    v->id = step_begin(b->w);
+    fprintf(b->w->f, "VERTEX_POINT('',#%d);\n", v->point);
+    return b->vertex_count++;
+}
+
+// Unit vector along d, flipped so that its first non-zero component is
+// positive: lines and planes facing either way then compare equal
+static vec3_t canonical_direction(vec3_t d, int* flipped) {
+    double len = sqrt(vec3_dot(d, d));
+    d = (vec3_t){ d.x / len, d.y / len, d.z / len };
+    double lead = fabs(d.x) > 1e-9 ? d.x : fabs(d.y) > 1e-9 ? d.y : d.z;
+    *flipped = lead < 0;
+    return *flipped ? (vec3_t){ -d.x, -d.y, -d.z } : d;
+}
+
+static int same_vec3(vec3_t a, vec3_t c) {
+    return fabs(a.x - c.x) < 1e-9 && fabs(a.y - c.y) < 1e-9 && fabs(a.z - c.z) < 1e-9;
+}
+
+// The LINE through pa and pc, written by the first edge along it. *sense
+// tells whether pa -> pc runs along the line's direction.
+static int brep_carrier_line(brep_t* b, vec3_t pa, vec3_t pc, int point, int* sense) {
+    int flipped;
+    vec3_t u = canonical_direction(vec3_sub(pc, pa), &flipped);
+    double t = vec3_dot(pa, u);
+    vec3_t foot = { pa.x - t * u.x, pa.y - t * u.y, pa.z - t * u.z };
+    *sense = !flipped;
+    for (int i = 0; i < b->line_count; i++) {
+        if (same_vec3(b->lines[i].n, u) && same_vec3(b->lines[i].p, foot)) return b->lines[i].id;
+    }
+    if (grow_array((void**)&b->lines, &b->line_capacity, b->line_count + 1, sizeof(brep_carrier_t)) < 0) {
+        b->failed = 1;
+        return -1;
+    }
+    int vector = step_vector(b->w, u);
+    int id = step_begin(b->w);
+    fprintf(b->w->f, "LINE('',#%d,#%d);\n", point, vector);
+    b->lines[b->line_count++] = (brep_carrier_t){ u, foot, 0, id };
+    return id;
+}
+
+// The PLANE with outward normal n through the vertex origin, written by
+// the first face on it. *same_sense tells whether n is the plane's normal.
+static int brep_carrier_plane(brep_t* b, vec3_t n, int origin, int* same_sense) {
+    int flipped;
+    vec3_t u = canonical_direction(n, &flipped);
+    double d = vec3_dot(b->vertices[origin].p, u);
+    *same_sense = !flipped;
+    for (int i = 0; i < b->plane_count; i++) {
+        if (same_vec3(b->planes[i].n, u) && fabs(b->planes[i].d - d) < 1e-9) return b->planes[i].id;
+    }
+    if (grow_array((void**)&b->planes, &b->plane_capacity, b->plane_count + 1, sizeof(brep_carrier_t)) < 0) {
+        b->failed = 1;
+        return -1;
+    }
+    int plane_axis = step_axis_at(b->w, b->vertices[origin].point, u, perpendicular(u));
+    int id = step_begin(b->w);
+    fprintf(b->w->f, "PLANE('',#%d);\n", plane_axis);
+    b->planes[b->plane_count++] = (brep_carrier_t){ u, b->vertices[origin].p, d, id };
+    return id;
+}
+
+// Straight edge between two vertices, as an ORIENTED_EDGE running a -> b
+static int brep_line(brep_t* b, int a, int c) {
+    if (a < 0 || c < 0) return -1;
+    for (int i = 0; i < b->edge_count; i++) {
+        const brep_edge_t* e = &b->edges[i];
+        if (e->a == a && e->b == c) return step_oriented_edge(b->w, e->id, 1);
+        if (e->a == c && e->b == a) return step_oriented_edge(b->w, e->id, 0);
+    }
+    if (grow_array((void**)&b->edges, &b->edge_capacity, b->edge_count + 1, sizeof(brep_edge_t)) < 0) {
+        b->failed = 1;
+        return -1;
+    }
+    step_writer_t* w = b->w;
+    int sense;
+    int line = brep_carrier_line(b, b->vertices[a].p, b->vertices[c].p, b->vertices[a].point, &sense);
+    if (line < 0) return -1;
+    brep_edge_t* e = &b->edges[b->edge_count++];
+    e->a = a;
+    e->b = c;
+    e->id = step_begin(w);
+    fprintf(w->f, "EDGE_CURVE('',#%d,#%d,#%d,%s);\n", b->vertices[a].id, b->vertices[c].id, line,
+            sense ? ".T." : ".F.");
+    return step_oriented_edge(w, e->id, 1);
+}
+
+// Circle or arc from vertex a to vertex c, counter-clockwise about axis
+// with ref pointing at parameter 0
+static int brep_arc(brep_t* b, int a, int c, vec3_t centre, vec3_t axis, vec3_t ref, double r) {
+    if (a < 0 || c < 0) return -1;
+    step_writer_t* w = b->w;
+    char radius[32];
+    int placement = step_axis(w, centre, axis, ref);
+    int circle = step_begin(w);
+    fprintf(w->f, "CIRCLE('',#%d,%s);\n", placement, step_real(radius, sizeof(radius), r));
+    int id = step_begin(w);
+    fprintf(w->f, "EDGE_CURVE('',#%d,#%d,#%d,.T.);\n", b->vertices[a].id, b->vertices[c].id, circle);
+    return id;
+}
+
+static void brep_add_face(brep_t* b, int face) {
+    if (grow_array((void**)&b->faces, &b->face_capacity, b->face_count + 1, sizeof(int)) < 0) {
+        b->failed = 1;
+        return;
+    }
+    b->faces[b->face_count++] = face;
+}
+
+// Newell normal of a polygon; its direction tells the winding
+static vec3_t polygon_normal(const vec3_t* p, int n) {
+    vec3_t r = { 0, 0, 0 };
+    for (int i = 0; i < n; i++) {
+        vec3_t a = p[i], c = p[(i + 1) % n];
+        r.x += (a.y - c.y) * (a.z + c.z);
+        r.y += (a.z - c.z) * (a.x + c.x);
+        r.z += (a.x - c.x) * (a.y + c.y);
+    }
+    return r;
+}
+
+// Planar face with outward normal n. loops[0] is the outer boundary, the
+// rest are holes; windings are fixed up here. extra holds further bounds
+// built by the caller (circular holes).
+static void brep_plane_face(brep_t* b, vec3_t n, const vec3_t* const* loops, const int* counts, int loop_count,
+                            const int* extra, int extra_count) {
+    int* bounds = malloc((loop_count + extra_count) * sizeof(int));
+    int max = 0;
+    for (int l = 0; l < loop_count; l++) {
+        if (counts[l] > max) max = counts[l];
+    }
+    int* oriented = malloc(max * sizeof(int));
+    if (!bounds || !oriented) {
+        free(bounds);
+        free(oriented);
+        b->failed = 1;
+        return;
+    }
+
+    for (int l = 0; l < loop_count; l++) {
+        const vec3_t* p = loops[l];
+        int count = counts[l];
+        int forward = (vec3_dot(polygon_normal(p, count), n) > 0) == (l == 0);
+        for (int i = 0; i < count; i++) {
+            int j = forward ? i : count - 1 - i;
+            int k = forward ? (i + 1) % count : (2 * count - 2 - i) % count;
+            oriented[i] = brep_line(b, brep_vertex(b, p[j]), brep_vertex(b, p[k]));
+        }
+        bounds[l] = step_loop(b->w, oriented, count, l == 0);
+    }
+    if (extra_count) memcpy(bounds + loop_count, extra, extra_count * sizeof(int));
+
+    // The loops' vertices exist by now unless an allocation failed
+    if (!b->failed) {
+        int same_sense;
+        int plane = brep_carrier_plane(b, n, brep_vertex(b, loops[0][0]), &same_sense);
+        if (plane >= 0) brep_add_face(b, step_face(b->w, bounds, loop_count + extra_count, plane, same_sense));
+    }
+    free(bounds);
+    free(oriented);
+}
+
+static int brep_finish(brep_t* b, const char* name) {
+    int id = -1;
+    if (!b->failed) {
+        step_writer_t* w = b->w;
+        int shell = step_begin(w);
+        fprintf(w->f, "CLOSED_SHELL('',");
+        step_id_list(w->f, b->faces, b->face_count);
+        fprintf(w->f, ");\n");
+        id = step_begin(w);
+        fprintf(w->f, "MANIFOLD_SOLID_BREP('%s',#%d);\n", name, shell);
+    }
+    free(b->vertices);
+    free(b->edges);
+    free(b->planes);
+    free(b->lines);
+    free(b->faces);
+    return id;
+}
+
+static double outline_area(const outline_t* o) {
+    double area = 0;
+    for (int i = 0; i < o->count; i++) {
+        const point_t* a = &o->points[i];
+        const point_t* c = &o->points[(i + 1) % o->count];
+        area += a->x * c->y - c->x * a->y;
+    }
+    return area / 2;
+}
+
+// Vertical extrusion of a region from z0 to z1. loops[0] is the outline,
+// the other loops and the circles are through holes.
+static int brep_prism(step_writer_t* w, const char* name, const outline_t* loops, int loop_count,
+                      const step_circle_t* circles, int circle_count, double z0, double z1) {
+    brep_t b = { .w = w };
+    int total = 0;
+    for (int l = 0; l < loop_count; l++) total += loops[l].count;
+
+    vec3_t* bottom = malloc(total * sizeof(vec3_t));
+    vec3_t* top = malloc(total * sizeof(vec3_t));
+    const vec3_t** bottom_loops = malloc(loop_count * sizeof(vec3_t*));
+    const vec3_t** top_loops = malloc(loop_count * sizeof(vec3_t*));
+    int* counts = malloc(loop_count * sizeof(int));
+    int* bottom_circles = malloc((circle_count + 1) * sizeof(int));
+    int* top_circles = malloc((circle_count + 1) * sizeof(int));
+    if (!bottom || !top || !bottom_loops || !top_loops || !counts || !bottom_circles || !top_circles) {
+        b.failed = 1;
+        goto out;
+    }
+
+    // Outline counter-clockwise and holes clockwise, so the material is
+    // always on the left of an edge
+    vec3_t* bp = bottom;
+    vec3_t* tp = top;
+    for (int l = 0; l < loop_count; l++) {
+        const outline_t* o = &loops[l];
+        int reverse = (outline_area(o) > 0) != (l == 0);
+        for (int i = 0; i < o->count; i++) {
+            const point_t* p = &o->points[reverse ? o->count - 1 - i : i];
+            bp[i] = (vec3_t){ p->x, p->y, z0 };
+            tp[i] = (vec3_t){ p->x, p->y, z1 };
+        }
+        bottom_loops[l] = bp;
+        top_loops[l] = tp;
+        counts[l] = o->count;
+
+        for (int i = 0; i < o->count; i++) {
+            int j = (i + 1) % o->count;
+            const vec3_t side[4] = { bp[i], bp[j], tp[j], tp[i] };
+            const vec3_t* side_loop = side;
+            const int four = 4;
+            vec3_t n = { bp[j].y - bp[i].y, bp[i].x - bp[j].x, 0 };
+            brep_plane_face(&b, n, &side_loop, &four, 1, NULL, 0);
+        }
+        bp += o->count;
+        tp += o->count;
+    }
+
+    // Bores: a full circle on each cap joined by a seam line, with the
+    // cylinder facing its axis
+    for (int i = 0; i < circle_count; i++) {
+        const step_circle_t* c = &circles[i];
+        const vec3_t up = { 0, 0, 1 }, ref = { 1, 0, 0 };
+        int v0 = brep_vertex(&b, (vec3_t){ c->x + c->r, c->y, z0 });
+        int v1 = brep_vertex(&b, (vec3_t){ c->x + c->r, c->y, z1 });
+        int low = brep_arc(&b, v0, v0, (vec3_t){ c->x, c->y, z0 }, up, ref, c->r);
+        int high = brep_arc(&b, v1, v1, (vec3_t){ c->x, c->y, z1 }, up, ref, c->r);
+        if (low < 0 || high < 0) {
+            b.failed = 1;
+            goto out;
+        }
+        int edge = step_oriented_edge(w, low, 1);
+        bottom_circles[i] = step_loop(w, &edge, 1, 0);
+        edge = step_oriented_edge(w, high, 0);
+        top_circles[i] = step_loop(w, &edge, 1, 0);
+
+        int wall[4] = {
+            step_oriented_edge(w, low, 0),
+            brep_line(&b, v0, v1),
+            step_oriented_edge(w, high, 1),
+            brep_line(&b, v1, v0),
+        };
+        int bound = step_loop(w, wall, 4, 0);
+        int axis = step_axis(w, (vec3_t){ c->x, c->y, z0 }, up, ref);
+        char radius[32];
+        int cylinder = step_begin(w);
+        fprintf(w->f, "CYLINDRICAL_SURFACE('',#%d,%s);\n", axis, step_real(radius, sizeof(radius), c->r));
+        brep_add_face(&b, step_face(w, &bound, 1, cylinder, 0));
+    }
+
+    brep_plane_face(&b, (vec3_t){ 0, 0, -1 }, bottom_loops, counts, loop_count, bottom_circles, circle_count);
+    brep_plane_face(&b, (vec3_t){ 0, 0, 1 }, top_loops, counts, loop_count, top_circles, circle_count);
+
+out:
+    free(bottom);
+    free(top);
+    free(bottom_loops);
+    free(top_loops);
+    free(counts);
+    free(bottom_circles);
+    free(top_circles);
+    return brep_finish(&b, name);
+}
+
+static int brep_box(step_writer_t* w, const char* name, vec3_t lo, vec3_t hi) {
+    const point_t square[4] = { {lo.x, lo.y}, {hi.x, lo.y}, {hi.x, hi.y}, {lo.x, hi.y} };
+    const outline_t outline = { square, 4 };
+    return brep_prism(w, name, &outline, 1, NULL, 0, lo.z, hi.z);
+}
+
+// Solid of mesh_pyramid(): square base of half width wd, apex at height h
+static int brep_pyramid(step_writer_t* w, const char* name, double wd, double h, const transform_t* t) {
+    brep_t b = { .w = w };
+    const double corners[4][2] = { {-wd, -wd}, {wd, -wd}, {wd, wd}, {-wd, wd} };
+    vec3_t base[4];
+    vec3_t apex = transform_apply(t, (vec3_t){ 0, 0, h });
+    vec3_t centre = transform_apply(t, (vec3_t){ 0, 0, h / 4 });   // inside
+    for (int i = 0; i < 4; i++) {
+        base[i] = transform_apply(t, (vec3_t){ corners[i][0], corners[i][1], 0 });
+    }
+
+    const vec3_t* loop = base;
+    const int four = 4, three = 3;
+    vec3_t n = polygon_normal(base, 4);
+    if (vec3_dot(n, vec3_sub(base[0], centre)) < 0) n = (vec3_t){ -n.x, -n.y, -n.z };
+    brep_plane_face(&b, n, &loop, &four, 1, NULL, 0);
+    for (int i = 0; i < 4; i++) {
+        const vec3_t side[3] = { base[i], base[(i + 1) % 4], apex };
+        loop = side;
+        vec3_t middle = { (side[0].x + side[1].x + apex.x) / 3, (side[0].y + side[1].y + apex.y) / 3,
+                          (side[0].z + side[1].z + apex.z) / 3 };
+        n = polygon_normal(side, 3);
+        if (vec3_dot(n, vec3_sub(middle, centre)) < 0) n = (vec3_t){ -n.x, -n.y, -n.z };
+        brep_plane_face(&b, n, &loop, &three, 1, NULL, 0);
+    }
+    return brep_finish(&b, name);
+}
+
+// mesh_quarter_bend() under rotate([90, 0, 0]): a square section of side
+// s swept a quarter turn about the y axis at radius r, from (-r, 0, 0)
+// down to (0, 0, -r)
+static int brep_bend(step_writer_t* w, const char* name, double r, double s) {
+    brep_t b = { .w = w };
+    const double radius[2] = { r - s / 2, r + s / 2 };   // inner, outer
+    const double side[2] = { -s / 2, s / 2 };
+    const vec3_t axis = { 0, -1, 0 }, ref = { -1, 0, 0 };
+    int start[2][2], end[2][2], arc[2][2];
+
+    for (int i = 0; i < 2; i++) {
+        for (int j = 0; j < 2; j++) {
+            start[i][j] = brep_vertex(&b, (vec3_t){ -radius[i], side[j], 0 });
+            end[i][j] = brep_vertex(&b, (vec3_t){ 0, side[j], -radius[i] });
+        }
+    }
+    for (int i = 0; i < 2; i++) {
+        for (int j = 0; j < 2; j++) {
+            arc[i][j] = brep_arc(&b, start[i][j], end[i][j], (vec3_t){ 0, side[j], 0 }, axis, ref, radius[i]);
+            if (arc[i][j] < 0) return brep_finish(&b, name);
+        }
+    }
+
+    // Flat ends
+    for (int k = 0; k < 2; k++) {
+        int (*v)[2] = k ? end : start;
+        const vec3_t corners[4] = {
+            b.vertices[v[0][0]].p, b.vertices[v[1][0]].p, b.vertices[v[1][1]].p, b.vertices[v[0][1]].p,
+        };
+        const vec3_t* loop = corners;
+        const int four = 4;
+        brep_plane_face(&b, k ? (vec3_t){ 1, 0, 0 } : (vec3_t){ 0, 0, 1 }, &loop, &four, 1, NULL, 0);
+    }
+
+    // Flat sides at y = +-s/2
+    for (int j = 0; j < 2; j++) {
+        int edges[4];
+        if (j) {
+            edges[0] = brep_line(&b, start[1][1], start[0][1]);
+            edges[1] = step_oriented_edge(w, arc[0][1], 1);
+            edges[2] = brep_line(&b, end[0][1], end[1][1]);
+            edges[3] = step_oriented_edge(w, arc[1][1], 0);
+        } else {
+            edges[0] = step_oriented_edge(w, arc[1][0], 1);
+            edges[1] = brep_line(&b, end[1][0], end[0][0]);
+            edges[2] = step_oriented_edge(w, arc[0][0], 0);
+            edges[3] = brep_line(&b, start[0][0], start[1][0]);
+        }
+        int bound = step_loop(w, edges, 4, 1);
+        int plane_axis = step_axis_at(w, b.vertices[start[0][j]].point, (vec3_t){ 0, j ? 1 : -1, 0 }, ref);
+        int plane = step_begin(w);
+        fprintf(w->f, "PLANE('',#%d);\n", plane_axis);
+        brep_add_face(&b, step_face(w, &bound, 1, plane, 1));
+    }
+
+    // Inner cylinder faces the axis, outer one away from it
+    for (int i = 0; i < 2; i++) {
+        int lo = i ? 1 : 0, hi = i ? 0 : 1;
+        int edges[4] = {
+            step_oriented_edge(w, arc[i][lo], 1),
+            brep_line(&b, end[i][lo], end[i][hi]),
+            step_oriented_edge(w, arc[i][hi], 0),
+            brep_line(&b, start[i][hi], start[i][lo]),
+        };
+        int bound = step_loop(w, edges, 4, 1);
+        int cylinder_axis = step_axis(w, (vec3_t){ 0, 0, 0 }, axis, ref);
+        char rad[32];
+        int cylinder = step_begin(w);
+        fprintf(w->f, "CYLINDRICAL_SURFACE('',#%d,%s);\n", cylinder_axis, step_real(rad, sizeof(rad), radius[i]));
+        brep_add_face(&b, step_face(w, &bound, 1, cylinder, i));
+    }
+    return brep_finish(&b, name);
+}
+
+// Colour a solid; one presentation style per colour
+static void step_style(step_writer_t* w, int item, int style) {
+    if (item < 0 || w->styled_count >= STEP_MAX_STYLED) return;
+    int id = step_begin(w);
+    fprintf(w->f, "STYLED_ITEM('color',(#%d),#%d);\n", style, item);
+    w->styled[w->styled_count++] = id;
+}
+
+static int step_color(step_writer_t* w, double r, double g, double b) {
+    char rs[32], gs[32], bs[32];
+    int colour = step_begin(w);
+    fprintf(w->f, "COLOUR_RGB('',%s,%s,%s);\n", step_real(rs, sizeof(rs), r),
+            step_real(gs, sizeof(gs), g), step_real(bs, sizeof(bs), b));
+    int fill_colour = step_begin(w);
+    fprintf(w->f, "FILL_AREA_STYLE_COLOUR('',#%d);\n", colour);
+    int fill = step_begin(w);
+    fprintf(w->f, "FILL_AREA_STYLE('',(#%d));\n", fill_colour);
+    int area = step_begin(w);
+    fprintf(w->f, "SURFACE_STYLE_FILL_AREA(#%d);\n", fill);
+    int side = step_begin(w);
+    fprintf(w->f, "SURFACE_SIDE_STYLE('',(#%d));\n", area);
+    int usage = step_begin(w);
+    fprintf(w->f, "SURFACE_STYLE_USAGE(.BOTH.,#%d);\n", side);
+    int id = step_begin(w);
+    fprintf(w->f, "PRESENTATION_STYLE_ASSIGNMENT((#%d));\n", usage);
+    return id;
+}
+
+// Pin hole positions of plccplug() relative to the plug corner: lower left
+// corner of each pinwidth square, left and right columns then bottom and
+// top rows. Returns the number of holes.
+static int plug_pin_holes(const plug_spec_t* plug, point_t* holes) {
+    const double p = HEADER_PITCH, pw = PLUG_PIN_WIDTH, recess = pw / 2;
+    const double x_shift = (plug->a - (plug->pins_x - 1) * p) / 2;
+    const double y_shift = (plug->b - (plug->pins_y - 1) * p) / 2;
+    int n = 0;
+
+    for (int col = 0; col < plug->pins_y; col++) {
+        holes[n++] = (point_t){ -recess, y_shift - recess + p * col };
+        holes[n++] = (point_t){ plug->a - pw + recess, y_shift - recess + p * col };
+    }
+    for (int row = 0; row < plug->pins_x; row++) {
+        holes[n++] = (point_t){ x_shift - recess + p * row, -recess };
+        holes[n++] = (point_t){ x_shift - recess + p * row, plug->b - pw + recess };
+    }
+    return n;
+}
+
+// Cut the pin grooves into one side of the plug outline, walking from
+// start along u with inward normal v. Each hole square of the side that
+// straddles the edge becomes a notch.
+static int outline_side(point_t* out, point_t start, point_t u, point_t v,
+                        const double* at, int count, double width, double depth) {
+    int n = 0;
+    out[n++] = start;
+    for (int i = 0; i < count; i++) {
+        double t0 = at[i], t1 = at[i] + width;
+        out[n++] = (point_t){ start.x + u.x * t0, start.y + u.y * t0 };
+        out[n++] = (point_t){ start.x + u.x * t0 + v.x * depth, start.y + u.y * t0 + v.y * depth };
+        out[n++] = (point_t){ start.x + u.x * t1 + v.x * depth, start.y + u.y * t1 + v.y * depth };
+        out[n++] = (point_t){ start.x + u.x * t1, start.y + u.y * t1 };
+    }
+    return n;
+}
+
+// The three body prisms of plccplug(). Returns the number of solids.
+static int step_plug_body(step_writer_t* w, const plug_spec_t* plug, int* solids) {
+    const double a = plug->a, b = plug->b, c = plug->c, d = plug->d;
+    const double dx = (d - b) / 2, dy = (c - a) / 2;     // as in plccplug()
+    const double pw = PLUG_PIN_WIDTH, tol = PLUG_PIN_TOLERANCE, t = PLUG_WALL;
+    const double depth = pw - pw / 2;                    // groove depth in the walls
+    const int holes = 2 * (plug->pins_x + plug->pins_y);
+    int count = 0;
+
+    point_t* hole = malloc(holes * sizeof(point_t));
+    point_t* squares = malloc((holes + 4) * 4 * sizeof(point_t));
+    outline_t* loops = malloc((holes + 5) * sizeof(outline_t));
+    point_t* ring = malloc((4 * holes + 8) * sizeof(point_t));
+    double* at = malloc((plug->pins_x > plug->pins_y ? plug->pins_x : plug->pins_y) * sizeof(double));
+    if (!hole || !squares || !loops || !ring || !at) goto out;
+    plug_pin_holes(plug, hole);
+
+    // Lid: corner cut, bore, airgaps and the wider printable pin holes
+    const point_t lid[5] = { {0, 0}, {c - PLUG_EDGE_TOP, 0}, {c, PLUG_EDGE_TOP}, {c, d}, {0, d} };
+    int loop_count = 0;
+    loops[loop_count++] = (outline_t){ lid, 5 };
+    point_t* sq = squares;
+    for (int i = 0; i < holes; i++, sq += 4) {
+        double x0 = dx + hole[i].x - tol / 2, y0 = dy + hole[i].y - tol / 2, x1 = x0 + pw + tol, y1 = y0 + pw + tol;
+        sq[0] = (point_t){ x0, y0 };
+        sq[1] = (point_t){ x1, y0 };
+        sq[2] = (point_t){ x1, y1 };
+        sq[3] = (point_t){ x0, y1 };
+        loops[loop_count++] = (outline_t){ sq, 4 };
+    }
+    if (a >= PLUG_AIRGAP_MIN_A) {
+        const double g = PLUG_AIRGAP;
+        const double gaps[4][4] = {
+            { c * 0.25, t + dy, c / 2, g },
+            { c * 0.25, d - (t + dy + g), c / 2, g },
+            { dx + t, d * 0.25, g, d / 2 },
+            { dx + a - t - g, d * 0.25, g, d / 2 },
+        };
+        for (int i = 0; i < 4; i++, sq += 4) {
+            sq[0] = (point_t){ gaps[i][0], gaps[i][1] };
+            sq[1] = (point_t){ gaps[i][0] + gaps[i][2], gaps[i][1] };
+            sq[2] = (point_t){ gaps[i][0] + gaps[i][2], gaps[i][1] + gaps[i][3] };
+            sq[3] = (point_t){ gaps[i][0], gaps[i][1] + gaps[i][3] };
+            loops[loop_count++] = (outline_t){ sq, 4 };
+        }
+    }
+    const step_circle_t bore = { c / 2, d / 2, PLUG_BORE_RADIUS };
+    if ((solids[count] = brep_prism(w, "lid", loops, loop_count, &bore, 1, 0, PLUG_H2)) < 0) goto out;
+    count++;
+
+    // Plug walls: outline with the corner cut and the pin grooves, walked
+    // counter-clockwise; top and left run backwards
+    const double x_shift = (a - (plug->pins_x - 1) * HEADER_PITCH) / 2 - pw / 2;
+    const double y_shift = (b - (plug->pins_y - 1) * HEADER_PITCH) / 2 - pw / 2;
+    const int px = plug->pins_x, py = plug->pins_y;
+    int n = 0;
+    for (int i = 0; i < px; i++) at[i] = x_shift + HEADER_PITCH * i;
+    n += outline_side(ring + n, (point_t){ dx, dy }, (point_t){ 1, 0 }, (point_t){ 0, 1 }, at, px, pw, depth);
+    ring[n++] = (point_t){ dx + a - PLUG_EDGE_BOTTOM, dy };
+    for (int i = 0; i < py; i++) at[i] = y_shift + HEADER_PITCH * i - PLUG_EDGE_BOTTOM;
+    n += outline_side(ring + n, (point_t){ dx + a, dy + PLUG_EDGE_BOTTOM }, (point_t){ 0, 1 }, (point_t){ -1, 0 },
+                      at, py, pw, depth);
+    for (int i = 0; i < px; i++) at[i] = a - (x_shift + HEADER_PITCH * (px - 1 - i)) - pw;
+    n += outline_side(ring + n, (point_t){ dx + a, dy + b }, (point_t){ -1, 0 }, (point_t){ 0, -1 }, at, px, pw, depth);
+    for (int i = 0; i < py; i++) at[i] = b - (y_shift + HEADER_PITCH * (py - 1 - i)) - pw;
+    n += outline_side(ring + n, (point_t){ dx, dy + b }, (point_t){ 0, -1 }, (point_t){ 1, 0 }, at, py, pw, depth);
+
+    const point_t inner[4] = { {dx + t, dy + t}, {dx + a - t, dy + t}, {dx + a - t, dy + b - t}, {dx + t, dy + b - t} };
+    outline_t walls[2] = { { ring, n }, { inner, 4 } };
+    if ((solids[count] = brep_prism(w, "plug", walls, 2, NULL, 0, PLUG_H2, PLUG_H2 + PLUG_H1 - PLUG_NOTCH_DEPTH)) < 0) {
+        goto out;
+    }
+    count++;
+
+    // Rim: the square hole widened by the two crossing notches
+    const double in = PLUG_NOTCH_INSET;
+    const double x0 = dx + in, x1 = dx + a - in, xa = dx + a * 0.43, xb = dx + a * 0.57;
+    const double y0 = dy + in, y1 = dy + b - in, ya = dy + b * 0.43, yb = dy + b * 0.57;
+    const double l = dx + t, r = dx + a - t, lo = dy + t, hi = dy + b - t;
+    const point_t notched[20] = {
+        {l, lo}, {xa, lo}, {xa, y0}, {xb, y0}, {xb, lo},
+        {r, lo}, {r, ya}, {x1, ya}, {x1, yb}, {r, yb},
+        {r, hi}, {xb, hi}, {xb, y1}, {xa, y1}, {xa, hi},
+        {l, hi}, {l, yb}, {x0, yb}, {x0, ya}, {l, ya},
+    };
+    walls[1] = (outline_t){ notched, 20 };
+    if ((solids[count] = brep_prism(w, "rim", walls, 2, NULL, 0, PLUG_H2 + PLUG_H1 - PLUG_NOTCH_DEPTH,
+                                    PLUG_H2 + PLUG_H1)) < 0) {
+        goto out;
+    }
+    count++;
+
+out:
+    free(hole);
+    free(squares);
+    free(loops);
+    free(ring);
+    free(at);
+    return count;
+}
+
+// One header pin in the angle_pin() frame, as build_header_pin()
+static int step_header_pin(step_writer_t* w, int* solids, int metal_style, int plastic_style) {
+    const double p = HEADER_PITCH;
+    const double s = p / 4 + 0.005;
+    const double d = s / 2;
+    const double h = p * 4 - 0.5 + 1.9;
+    const double body_z = HEADER_PIN_BASE + d;
+    int n = 0;
+
+    transform_t top = transform_translate(-p, 0, h);
+    transform_t tip_at = transform_translate(p, 0, -p);
+    transform_t tip_rot = transform_rotate(0, 90, 0);
+    transform_t tip = transform_mul(&tip_at, &tip_rot);
+
+    solids[n++] = brep_box(w, "leg", (vec3_t){ -p - d, -d, 0 }, (vec3_t){ -p + d, d, h });
+    solids[n++] = brep_pyramid(w, "top", d, d, &top);
+    solids[n++] = brep_bend(w, "bend", p, s);
+    solids[n++] = brep_box(w, "foot", (vec3_t){ 0, -d, -p - d }, (vec3_t){ p, d, -p + d });
+    solids[n++] = brep_pyramid(w, "tip", d, d, &tip);
+    for (int i = 0; i < n; i++) step_style(w, solids[i], metal_style);
+
+    const double chamfer = 2 * 1.9 * s - sqrt(2) * d;
+    const double e = p / 2, c = chamfer - e;
+    const point_t body[8] = {
+        {-p + e, -c}, {-p + e, c}, {-p + c, e}, {-p - c, e},
+        {-p - e, c}, {-p - e, -c}, {-p - c, -e}, {-p + c, -e},
+    };
+    const outline_t outline = { body, 8 };
+    solids[n] = brep_prism(w, "spacer", &outline, 1, NULL, 0, body_z - p / 2, body_z + p / 2);
+    step_style(w, solids[n++], plastic_style);
+
+    for (int i = 0; i < n; i++) {
+        if (solids[i] < 0) return -1;
+    }
+    return n;
+}
+
+// The plug model as an AP214 file: body and/or header strips
+static int write_step_model(FILE* f, const plug_spec_t* plug, int with_body, int with_pins) {
+    step_writer_t w = { .f = f, .next_id = 1 };
+    char name[64];
+    int ret = -1;
+    transform_t* place = NULL;
+    int* items = malloc((plug->pins + 8) * sizeof(int));
+    if (!items) return -1;
+
+    snprintf(name, sizeof(name), "PLCCplug-%dpin", plug->pins);
+    fprintf(f, "ISO-10303-21;\nHEADER;\n");
+    fprintf(f, "FILE_DESCRIPTION(('%s'),'2;1');\n", name);
+    fprintf(f, "FILE_NAME('%s.step','1970-01-01T00:00:00',(''),(''),'plcc-gen','plcc-gen','');\n", name);
+    fprintf(f, "FILE_SCHEMA(('AUTOMOTIVE_DESIGN { 1 0 10303 214 1 1 1 1 }'));\nENDSEC;\nDATA;\n");
+
+    // Product, units and context
+    int app = step_begin(&w);
+    fprintf(f, "APPLICATION_CONTEXT('core data for automotive mechanical design processes');\n");
+    step_begin(&w);
+    fprintf(f, "APPLICATION_PROTOCOL_DEFINITION('international standard','automotive_design',2000,#%d);\n", app);
+    int product_context = step_begin(&w);
+    fprintf(f, "PRODUCT_CONTEXT('',#%d,'mechanical');\n", app);
+    int product = step_begin(&w);
+    fprintf(f, "PRODUCT('%s','%s','',(#%d));\n", name, name, product_context);
+    int formation = step_begin(&w);
+    fprintf(f, "PRODUCT_DEFINITION_FORMATION('','',#%d);\n", product);
+    int definition_context = step_begin(&w);
+    fprintf(f, "PRODUCT_DEFINITION_CONTEXT('part definition',#%d,'design');\n", app);
+    int definition = step_begin(&w);
+    fprintf(f, "PRODUCT_DEFINITION('design','',#%d,#%d);\n", formation, definition_context);
+    int shape = step_begin(&w);
+    fprintf(f, "PRODUCT_DEFINITION_SHAPE('','',#%d);\n", definition);
+    int length = step_begin(&w);
+    fprintf(f, "(LENGTH_UNIT()NAMED_UNIT(*)SI_UNIT(.MILLI.,.METRE.));\n");
+    int angle = step_begin(&w);
+    fprintf(f, "(NAMED_UNIT(*)PLANE_ANGLE_UNIT()SI_UNIT($,.RADIAN.));\n");
+    int solid_angle = step_begin(&w);
+    fprintf(f, "(NAMED_UNIT(*)SI_UNIT($,.STERADIAN.)SOLID_ANGLE_UNIT());\n");
+    int uncertainty = step_begin(&w);
+    fprintf(f, "UNCERTAINTY_MEASURE_WITH_UNIT(LENGTH_MEASURE(1.E-07),#%d,'distance_accuracy_value','');\n", length);
+    w.context = step_begin(&w);
+    fprintf(f, "(GEOMETRIC_REPRESENTATION_CONTEXT(3)GLOBAL_UNCERTAINTY_ASSIGNED_CONTEXT((#%d))"
+            "GLOBAL_UNIT_ASSIGNED_CONTEXT((#%d,#%d,#%d))REPRESENTATION_CONTEXT('',''));\n",
+            uncertainty, length, angle, solid_angle);
+
+    int n = 0;
+    items[n++] = step_axis(&w, (vec3_t){ 0, 0, 0 }, (vec3_t){ 0, 0, 1 }, (vec3_t){ 1, 0, 0 });
+
+    if (with_body) {
+        int grey = step_color(&w, 0.501961, 0.501961, 0.501961);
+        int body = step_plug_body(&w, plug, items + n);
+        if (body != 3) goto out;
+        for (int i = 0; i < body; i++) step_style(&w, items[n + i], grey);
+        n += body;
+    }
+
+    if (with_pins) {
+        int gold = step_color(&w, 0.976471, 0.843137, 0.172549);
+        int dark = step_color(&w, 0.411765, 0.411765, 0.411765);
+        int pin_items[8];
+        int pin_count = 0;
+        pin_items[pin_count++] = step_axis(&w, (vec3_t){ 0, 0, 0 }, (vec3_t){ 0, 0, 1 }, (vec3_t){ 1, 0, 0 });
+        int solids = step_header_pin(&w, pin_items + pin_count, gold, dark);
+        if (solids < 0) goto out;
+        pin_count += solids;
+
+        int pin_rep = step_begin(&w);
+        fprintf(f, "ADVANCED_BREP_SHAPE_REPRESENTATION('pin',");
+        step_id_list(f, pin_items, pin_count);
+        fprintf(f, ",#%d);\n", w.context);
+        int map = step_begin(&w);
+        fprintf(f, "REPRESENTATION_MAP(#%d,#%d);\n", pin_items[0], pin_rep);
+
+        if (!(place = malloc(plug->pins * sizeof(*place)))) goto out;
+        int count = header_pin_placements(plug, place);
+        for (int i = 0; i < count; i++) {
+            int target = step_placement(&w, &place[i]);
+            items[n] = step_begin(&w);
+            fprintf(f, "MAPPED_ITEM('',#%d,#%d);\n", map, target);
+            n++;
+        }
+    }
+
+    int representation = step_begin(&w);
+    fprintf(f, "ADVANCED_BREP_SHAPE_REPRESENTATION('%s',", name);
+    step_id_list(f, items, n);
+    fprintf(f, ",#%d);\n", w.context);
+    step_begin(&w);
+    fprintf(f, "SHAPE_DEFINITION_REPRESENTATION(#%d,#%d);\n", shape, representation);
+    if (w.styled_count) {
+        step_begin(&w);
+        fprintf(f, "MECHANICAL_DESIGN_GEOMETRIC_PRESENTATION_REPRESENTATION('',");
+        step_id_list(f, w.styled, w.styled_count);
+        fprintf(f, ",#%d);\n", w.context);
+    }
+    fprintf(f, "ENDSEC;\nEND-ISO-10303-21;\n");
+    ret = 0;
+
+out:
+    free(items);
+    free(place);
+    return ret;
+}
+
+// Format a plug model into a freshly allocated buffer
+char* render_step_model(const plug_spec_t* plug, int with_body, int with_pins, size_t* size) {
+    char* data = NULL;
+    FILE* f = open_memstream(&data, size);
+    if (!f) return NULL;
+
+    TRACE_START(t_write);
+    int ret = write_step_model(f, plug, with_body, with_pins);
+    TRACE_STOP(t_write, STAGE_WRITER, plug->pins);
+
+    if (fclose(f) != 0 || ret < 0) {
+        free(data);
+        return NULL;
+    }
+    return data;
+}
@@ -0,0 +1,13 @@
+/* STEP output formatter for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#ifndef PLCC_STEP_H
+#define PLCC_STEP_H
+
+#include "plcc-gen.h"
+
+char* render_step_model(const plug_spec_t* plug, int with_body, int with_pins, size_t* size);
+
+#endif
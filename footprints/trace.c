@@ -0,0 +1,203 @@
+/* Instrumentation for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#include "plcc-gen.h"
+
+// Per-stage wall time and item counters. Built in with -DPLCC_TRACE and
+// enabled at runtime with --trace/--stats; without PLCC_TRACE the
+// TRACE_* macros compile to nothing.
+
+double monotonic_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+#ifdef PLCC_TRACE
+
+static const struct {
+    const char* name;
+    const char* category;
+} trace_stage_info[STAGE_COUNT] = {
+    [STAGE_GEOMETRY]   = {"generate_geometry", "geometry"},
+    [STAGE_PINS]       = {"pins", "geometry"},
+    [STAGE_SILKSCREEN] = {"silkscreen", "geometry"},
+    [STAGE_COURTYARD]  = {"courtyard", "geometry"},
+    [STAGE_FAB]        = {"fab", "geometry"},
+    [STAGE_TEXT]       = {"text", "geometry"},
+    [STAGE_WRITER]     = {"writer", "output"},
+    [STAGE_FILE_IO]    = {"file_io", "output"},
+    [STAGE_MESH]       = {"mesh", "mesh"},
+    [STAGE_VALIDATE]   = {"validate", "check"},
+    [STAGE_REQUEST]    = {"request", "server"},
+    [STAGE_INDEX]      = {"index", "catalog"},
+    [STAGE_QUERY]      = {"query", "catalog"},
+    [STAGE_CSG]        = {"csg", "mesh"},
+};
+
+#define TRACE_MAX_EVENTS (1 << 20)  // per thread
+
+typedef struct {
+    trace_stage_t stage;
+    double start_us;
+    double duration_us;
+    long items;
+} trace_event_t;
+
+typedef struct {
+    unsigned long calls;
+    double total_us;
+    double max_us;
+    long items;
+} trace_stat_t;
+
+// Every thread records into its own buffer, so workers neither race nor
+// wait on each other; the buffers are merged when the trace is written
+typedef struct trace_buffer {
+    int tid;
+    trace_event_t* events;
+    size_t event_count, event_capacity;
+    unsigned long dropped;
+    trace_stat_t stats[STAGE_COUNT];
+    struct trace_buffer* next;
+} trace_buffer_t;
+
+// Read by TRACE_START/TRACE_STOP in every module
+int trace_active;
+
+static struct {
+    const char* path;     // Chrome trace output, NULL if only --stats
+    int summary;          // print summary table on exit
+    double epoch_us;
+    pthread_mutex_t lock; // guards buffers and thread_count
+    trace_buffer_t* buffers;
+    int thread_count;
+} tracer = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static __thread trace_buffer_t* trace_local;
+
+static trace_buffer_t* trace_buffer(void) {
+    if (trace_local) return trace_local;
+    trace_buffer_t* b = calloc(1, sizeof(*b));
+    if (!b) return NULL;
+    pthread_mutex_lock(&tracer.lock);
+    b->tid = ++tracer.thread_count;
+    b->next = tracer.buffers;
+    tracer.buffers = b;
+    pthread_mutex_unlock(&tracer.lock);
+    return trace_local = b;
+}
+
+void trace_record(trace_stage_t stage, double start_us, long items) {
+    double duration = monotonic_us() - start_us;
+    trace_buffer_t* b = trace_buffer();
+    if (!b) return;
+    trace_stat_t* st = &b->stats[stage];
+    st->calls++;
+    st->total_us += duration;
+    if (duration > st->max_us) st->max_us = duration;
+    st->items += items;
+
+    if (!tracer.path) return;
+    if (b->event_count == b->event_capacity) {
+        size_t cap = b->event_capacity ? b->event_capacity * 2 : 4096;
+        trace_event_t* ev = cap <= TRACE_MAX_EVENTS ? realloc(b->events, cap * sizeof(*ev)) : NULL;
+        if (!ev) {
+            b->dropped++;
+            return;
+        }
+        b->events = ev;
+        b->event_capacity = cap;
+    }
+    b->events[b->event_count++] = (trace_event_t){stage, start_us, duration, items};
+}
+
+void trace_enable(const char* path, int summary) {
+    trace_active = 1;
+    tracer.path = path;
+    tracer.summary = summary;
+    tracer.epoch_us = monotonic_us();
+}
+
+static void write_chrome_trace(FILE* f) {
+    const char* sep = "";
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (trace_buffer_t* b = tracer.buffers; b; b = b->next) {
+        for (size_t i = 0; i < b->event_count; i++) {
+            trace_event_t* ev = &b->events[i];
+            fprintf(f, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                       "\"pid\":1,\"tid\":%d,\"args\":{\"items\":%ld}}",
+                    sep, trace_stage_info[ev->stage].name, trace_stage_info[ev->stage].category,
+                    ev->start_us - tracer.epoch_us, ev->duration_us, b->tid, ev->items);
+            sep = ",\n";
+        }
+    }
+    fprintf(f, "\n]}\n");
+}
+
+static void write_trace_summary(FILE* f) {
+    trace_stat_t total[STAGE_COUNT] = {{0}};
+    unsigned long dropped = 0;
+    for (trace_buffer_t* b = tracer.buffers; b; b = b->next) {
+        for (int i = 0; i < STAGE_COUNT; i++) {
+            total[i].calls += b->stats[i].calls;
+            total[i].total_us += b->stats[i].total_us;
+            total[i].items += b->stats[i].items;
+            if (b->stats[i].max_us > total[i].max_us) total[i].max_us = b->stats[i].max_us;
+        }
+        dropped += b->dropped;
+    }
+
+    fprintf(f, "%-18s %8s %12s %10s %10s %12s\n", "stage", "calls", "total_ms", "mean_us", "max_us", "items");
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        trace_stat_t* st = &total[i];
+        if (!st->calls) continue;
+        fprintf(f, "%-18s %8lu %12.3f %10.2f %10.2f %12ld\n",
+                trace_stage_info[i].name, st->calls, st->total_us / 1e3,
+                st->total_us / st->calls, st->max_us, st->items);
+    }
+    if (dropped) {
+        fprintf(f, "(%lu trace events dropped)\n", dropped);
+    }
+}
+
+static int trace_finish(void) {
+    int ret = 0;
+    if (!trace_active) return 0;
+
+    if (tracer.path) {
+        FILE* f = fopen(tracer.path, "w");
+        if (f) {
+            write_chrome_trace(f);
+            fclose(f);
+        } else {
+            perror("Error opening trace file");
+            ret = 1;
+        }
+    }
+    if (tracer.summary) {
+        write_trace_summary(stderr);
+    }
+    // Called once the workers are done
+    while (tracer.buffers) {
+        trace_buffer_t* next = tracer.buffers->next;
+        free(tracer.buffers->events);
+        free(tracer.buffers);
+        tracer.buffers = next;
+    }
+    trace_local = NULL;
+    trace_active = 0;
+    return ret;
+}
+
+#endif
+
+int finish_instrumentation(void) {
+#ifdef PLCC_TRACE
+    return trace_finish();
+#else
+    return 0;
+#endif
+}
@@ -0,0 +1,140 @@
+/* Utility functions for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#include "plcc-gen.h"
+
+#include <unistd.h>
+
+// Grow an array so it holds at least need elements
+int grow_array(void** array, int* capacity, int need, size_t size) {
+    if (need <= *capacity) return 0;
+    int cap = *capacity ? *capacity : 64;
+    while (cap < need) cap *= 2;
+    void* p = realloc(*array, cap * size);
+    if (!p) return -1;
+    *array = p;
+    *capacity = cap;
+    return 0;
+}
+
+uint64_t hash_bytes(const void* data, size_t len) {
+    // FNV-1a, 64 bit
+    const unsigned char* p = data;
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+void generate_timestamp(char* buffer, size_t size) {
+    // Use zero timestamp like the original
+    snprintf(buffer, size, "00000000-0000-0000-0000-000000000000");
+}
+
+int compare_ints(const void* a, const void* b) {
+    return *(const int*)a - *(const int*)b;
+}
+
+char* read_file(const char* path, size_t* size) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return NULL;
+
+    char* data = NULL;
+    if (fseek(f, 0, SEEK_END) == 0) {
+        long len = ftell(f);
+        if (len >= 0 && fseek(f, 0, SEEK_SET) == 0) {
+            data = malloc(len > 0 ? len : 1);
+            if (data && fread(data, 1, len, f) != (size_t)len) {
+                free(data);
+                data = NULL;
+            }
+            *size = len;
+        }
+    }
+    fclose(f);
+    return data;
+}
+
+int compare_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+char* read_text_file(const char* path, size_t* size) {
+    char* data = read_file(path, size);
+    char* text = data ? realloc(data, *size + 1) : NULL;
+    if (!text) {
+        free(data);
+        return NULL;
+    }
+    text[*size] = '\0';
+    return text;
+}
+
+#define MAX_JOBS 64
+
+typedef struct {
+    parallel_fn_t fn;
+    void* ctx;
+    int count;
+    int next;
+} parallel_work_t;
+
+static void* parallel_worker(void* arg) {
+    parallel_work_t* work = arg;
+    int i;
+    while ((i = __atomic_fetch_add(&work->next, 1, __ATOMIC_RELAXED)) < work->count) {
+        work->fn(work->ctx, i);
+    }
+    return NULL;
+}
+
+int default_jobs(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+// Run fn(ctx, 0..count-1) on up to jobs threads
+void parallel_for(int count, int jobs, parallel_fn_t fn, void* ctx) {
+    parallel_work_t work = { fn, ctx, count, 0 };
+    pthread_t threads[MAX_JOBS];
+    int started = 0;
+
+    if (jobs > MAX_JOBS) jobs = MAX_JOBS;
+    for (int i = 1; i < jobs && i < count; i++) {
+        if (pthread_create(&threads[started], NULL, parallel_worker, &work) == 0) {
+            started++;
+        }
+    }
+    parallel_worker(&work);
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+}
+
+// Write data to a temporary file next to path and rename it over path,
+// unless path already holds exactly data. Returns 1 if written.
+int replace_file(const char* path, const char* data, size_t size) {
+    size_t old_size = 0;
+    char* old = read_file(path, &old_size);
+    int same = old && old_size == size && memcmp(old, data, size) == 0;
+    free(old);
+    if (same) return 0;
+
+    char tmp[4096 + 16];
+    const char* base = strrchr(path, '/');
+    snprintf(tmp, sizeof(tmp), "%.*s.watch-%s", base ? (int)(base + 1 - path) : 0, path, base ? base + 1 : path);
+    FILE* f = fopen(tmp, "w");
+    int ok = f && fwrite(data, 1, size, f) == size;
+    if (f && fclose(f) != 0) ok = 0;
+    if (!ok || rename(tmp, path) < 0) {
+        fprintf(stderr, "Error: %s: %s\n", path, strerror(errno));
+        unlink(tmp);
+        return -1;
+    }
+    return 1;
+}
@@ -0,0 +1,427 @@
+/* Watch mode for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#include "watch.h"
+#include "backends.h"
+#include "check.h"
+#include "precompiled.h"
+#include "server.h"
+
+#include <unistd.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/inotify.h>
+#include <sys/wait.h>
+
+// Keeps the library up to date while specs and models are being tuned.
+// The spec file (--specs), plccplug.scad, plcc_specs.scad, angle_header.scad
+// and the plcc-gen binary are watched with inotify. Events are collected until
+// the inputs have been quiet for WATCH_DEBOUNCE_MS, then only the outputs
+// a change can affect are rebuilt on the parallel pipeline:
+//
+//   spec file          the four footprint variants of every changed part
+//   plccplug.scad      the STL and VRML models
+//   plcc_specs.scad    the models of the plugs on the changed lines, and
+//                      the all-versions set
+//   angle_header.scad  the VRML models, the only ones holding the pins
+//   plcc-gen           re-executes itself, then rewrites what differs
+//
+// Every output is written next to its target and renamed over it, so KiCad
+// never reads a half-written file. Unchanged footprints are left alone.
+
+#define WATCH_DEBOUNCE_MS 150
+#define WATCH_MAX_PARTS 64
+#define WATCH_EVENT_BUFFER 16384
+
+typedef enum {
+    WATCH_SPECS,
+    WATCH_PLUG_SCAD,
+    WATCH_SPEC_SCAD,
+    WATCH_HEADER_SCAD,
+    WATCH_SELF,
+    WATCH_INPUT_COUNT
+} watch_input_t;
+
+typedef enum {
+    WATCH_FOOTPRINT,
+    WATCH_STL,
+    WATCH_WRL
+} watch_output_t;
+
+typedef struct {
+    component_spec_t specs[WATCH_MAX_PARTS];
+    int count;
+} watch_catalog_t;
+
+typedef struct {
+    watch_output_t kind;
+    const component_spec_t* spec;   // footprints
+    int variant;                    // index into check_variants
+    int pins;                       // models; 0 for all versions
+    char path[4096];
+    int status;                     // 1 written, 0 unchanged, -1 failed
+    double us;
+} watch_job_t;
+
+typedef struct {
+    const char* root;
+    const char* openscad;
+    watch_job_t* jobs;
+} watch_batch_t;
+
+typedef struct {
+    char path[4096];
+    const char* name;     // last path component
+    int wd;
+} watch_file_t;
+
+// Built-in parts, replaced or extended by the NAME,PINS_X,... lines of path
+static int load_watch_catalog(const char* path, watch_catalog_t* cat) {
+    memcpy(cat->specs, component_specs, num_component_specs * sizeof(component_spec_t));
+    cat->count = num_component_specs;
+    if (!path) return 0;
+
+    size_t size = 0;
+    char* data = read_file(path, &size);
+    if (!data) {
+        fprintf(stderr, "Error: %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    int ret = 0, line_no = 0;
+    for (char* line = data; line < data + size && ret == 0; ) {
+        char* end = memchr(line, '\n', data + size - line);
+        if (!end) end = data + size;
+        *end = '\0';
+        line_no++;
+        char* hash = strchr(line, '#');
+        if (hash) *hash = '\0';
+        while (isspace((unsigned char)*line)) line++;
+
+        component_spec_t spec;
+        if (*line == '\0') {
+            // blank or comment
+        } else if (parse_inline_spec(line, &spec) < 0) {
+            fprintf(stderr, "Error: %s:%d: invalid spec\n", path, line_no);
+            ret = -1;
+        } else {
+            int i = 0;
+            while (i < cat->count && strcasecmp(cat->specs[i].name, spec.name) != 0) i++;
+            if (i == WATCH_MAX_PARTS) {
+                fprintf(stderr, "Error: %s:%d: more than %d parts\n", path, line_no, WATCH_MAX_PARTS);
+                ret = -1;
+            } else {
+                cat->specs[i] = spec;
+                if (i == cat->count) cat->count++;
+            }
+        }
+        line = end + 1;
+    }
+    free(data);
+    return ret;
+}
+
+// Pin counts named on the changed lines if every line that differs between
+// the two versions of plcc_specs.scad is a "[N, ...]" row of plug_specs;
+// -1 if the change can affect every plug
+static int scad_changed_pins(const char* old, size_t old_size, const char* new, size_t new_size,
+                             int* pins, int max) {
+    size_t prefix = 0, suffix = 0;
+    while (prefix < old_size && prefix < new_size && old[prefix] == new[prefix]) prefix++;
+    while (suffix < old_size - prefix && suffix < new_size - prefix &&
+           old[old_size - 1 - suffix] == new[new_size - 1 - suffix]) {
+        suffix++;
+    }
+    while (prefix > 0 && new[prefix - 1] != '\n') prefix--;
+
+    int count = 0;
+    const char* versions[2] = { old, new };
+    size_t sizes[2] = { old_size, new_size };
+    for (int v = 0; v < 2; v++) {
+        const char* text = versions[v];
+        size_t end = sizes[v] - suffix;
+        while (end > prefix && end < sizes[v] && text[end - 1] != '\n') end++;
+        for (size_t pos = prefix; pos < end; ) {
+            const char* nl = memchr(text + pos, '\n', end - pos);
+            size_t len = nl ? (size_t)(nl - (text + pos)) : end - pos;
+            char line[256];
+            int n;
+            if (len >= sizeof(line)) return -1;
+            memcpy(line, text + pos, len);
+            line[len] = '\0';
+            if (sscanf(line, " [%d,", &n) != 1 || !find_plug_by_pins(n)) return -1;
+            int seen = 0;
+            for (int i = 0; i < count; i++) seen |= pins[i] == n;
+            if (!seen && count < max) pins[count++] = n;
+            pos += len + 1;
+        }
+    }
+    return count;
+}
+
+// Run OpenSCAD on plccplug.scad the way the top level Makefile does
+static int run_openscad(const watch_batch_t* batch, const watch_job_t* job) {
+    char scad[4096], tmp[4096 + 16], pins[32];
+    const char* base = strrchr(job->path, '/');
+    snprintf(scad, sizeof(scad), "%s/plccplug.scad", batch->root);
+    snprintf(tmp, sizeof(tmp), "%.*s.watch-%s", (int)(base + 1 - job->path), job->path, base + 1);
+    snprintf(pins, sizeof(pins), "output_pins=%d", job->pins);
+
+    char* argv[16];
+    int argc = 0;
+    argv[argc++] = (char*)batch->openscad;
+    if (job->pins) {
+        argv[argc++] = "-D";
+        argv[argc++] = pins;
+    }
+    if (job->kind == WATCH_WRL) {
+        argv[argc++] = "-Drender_pins=1";
+        argv[argc++] = "-D";
+        argv[argc++] = "scale_factor=0.3937";
+    } else {
+        argv[argc++] = "-D";
+        argv[argc++] = "scale_factor=1";
+    }
+    argv[argc++] = scad;
+    argv[argc++] = "-o";
+    argv[argc++] = tmp;
+    argv[argc] = NULL;
+
+    pid_t pid;
+    int status;
+    int err = posix_spawnp(&pid, batch->openscad, NULL, NULL, argv, environ);
+    if (err != 0) {
+        fprintf(stderr, "Error: %s: %s\n", batch->openscad, strerror(err));
+        return -1;
+    }
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) return -1;
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || rename(tmp, job->path) < 0) {
+        fprintf(stderr, "Error: OpenSCAD failed to build %s\n", job->path);
+        unlink(tmp);
+        return -1;
+    }
+    return 1;
+}
+
+static void watch_build(void* ctx, int index) {
+    watch_batch_t* batch = ctx;
+    watch_job_t* job = &batch->jobs[index];
+    double start = monotonic_us();
+
+    if (job->kind == WATCH_FOOTPRINT) {
+        footprint_options_t opts = { check_variants[job->variant].double_sided, check_variants[job->variant].via_outside, {0} };
+        generate_timestamp(opts.timestamp, sizeof(opts.timestamp));
+        component_spec_t spec = *job->spec;
+        size_t size = 0;
+        char* data = precompiled_footprint(&spec, &opts, &size);
+        if (!data) data = render_kicad_footprint(&spec, &opts, &size);
+        job->status = data ? replace_file(job->path, data, size) : -1;
+        free(data);
+    } else {
+        job->status = run_openscad(batch, job);
+    }
+    job->us = monotonic_us() - start;
+}
+
+static void add_footprint_jobs(watch_job_t* jobs, int* count, const char* root, const component_spec_t* spec) {
+    for (int v = 0; v < 4; v++) {
+        watch_job_t* job = &jobs[(*count)++];
+        memset(job, 0, sizeof(*job));
+        job->kind = WATCH_FOOTPRINT;
+        job->spec = spec;
+        job->variant = v;
+        snprintf(job->path, sizeof(job->path), "%s/PLCCplug.pretty/%s%s.kicad_mod", root, spec->name, check_variants[v].suffix);
+    }
+}
+
+static void add_model_job(watch_job_t* jobs, int* count, const char* root, watch_output_t kind, int pins) {
+    watch_job_t* job = &jobs[(*count)++];
+    memset(job, 0, sizeof(*job));
+    job->kind = kind;
+    job->pins = pins;
+    const char* dir = kind == WATCH_STL ? "PLCCplug.stl" : "PLCCplug.3dshapes";
+    const char* ext = kind == WATCH_STL ? "stl" : "wrl";
+    if (pins) snprintf(job->path, sizeof(job->path), "%s/%s/PLCCplug-%dpin.%s", root, dir, pins, ext);
+    else snprintf(job->path, sizeof(job->path), "%s/%s/PLCCplug_all_versions.%s", root, dir, ext);
+}
+
+static void run_watch_batch(watch_batch_t* batch, int count, int jobs) {
+    if (count == 0) return;
+    double start = monotonic_us();
+    parallel_for(count, jobs, watch_build, batch);
+
+    int written = 0, failed = 0;
+    for (int i = 0; i < count; i++) {
+        const watch_job_t* job = &batch->jobs[i];
+        if (job->status > 0) {
+            printf("  updated %s (%.1f ms)\n", job->path, job->us / 1000);
+            written++;
+        }
+        failed += job->status < 0;
+    }
+    printf("%d of %d outputs updated in %.1f ms", written, count, (monotonic_us() - start) / 1000);
+    if (failed) printf(", %d failed", failed);
+    printf("\n");
+    fflush(stdout);
+}
+
+static int add_watch(int fd, watch_file_t* file, const char* path) {
+    snprintf(file->path, sizeof(file->path), "%s", path);
+    char dir[4096];
+    const char* base = strrchr(file->path, '/');
+    file->name = base ? base + 1 : file->path;
+    if (!base) snprintf(dir, sizeof(dir), ".");
+    else if (base == file->path) snprintf(dir, sizeof(dir), "/");
+    else snprintf(dir, sizeof(dir), "%.*s", (int)(base - file->path), file->path);
+    // Editors and linkers replace files, so watch the directory
+    file->wd = inotify_add_watch(fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (file->wd < 0) {
+        fprintf(stderr, "Error: cannot watch %s: %s\n", dir, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+// Mark the inputs named by the pending events; returns -1 on read errors
+static int read_watch_events(int fd, const watch_file_t* files, int* changed) {
+    char buf[WATCH_EVENT_BUFFER] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t n = read(fd, buf, sizeof(buf));
+    if (n < 0) return errno == EINTR || errno == EAGAIN ? 0 : -1;
+
+    for (char* p = buf; p < buf + n; ) {
+        const struct inotify_event* ev = (const struct inotify_event*)p;
+        for (int i = 0; i < WATCH_INPUT_COUNT; i++) {
+            if (files[i].wd == ev->wd && ev->len && strcmp(files[i].name, ev->name) == 0) {
+                changed[i] = 1;
+            }
+        }
+        p += sizeof(struct inotify_event) + ev->len;
+    }
+    return 0;
+}
+
+int run_watch(const char* root, const char* specs_path, const char* openscad, int jobs, char** argv) {
+    static watch_catalog_t catalogs[2];
+    watch_catalog_t* catalog = &catalogs[0];
+    watch_job_t* job_list = malloc((4 * WATCH_MAX_PARTS + 2 * (num_plug_specs + 1)) * sizeof(watch_job_t));
+    watch_batch_t batch = { root, openscad, job_list };
+    watch_file_t files[WATCH_INPUT_COUNT];
+    char* scad = NULL;
+    size_t scad_size = 0;
+    int ret = 1;
+
+    char self[4096];
+    ssize_t self_len = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    int fd = inotify_init1(IN_CLOEXEC);
+    if (!job_list || fd < 0 || self_len < 0) {
+        fprintf(stderr, "Error: cannot start watching: %s\n", strerror(errno));
+        goto out;
+    }
+    self[self_len] = '\0';
+    if (load_watch_catalog(specs_path, catalog) < 0) goto out;
+
+    char path[4096];
+    memset(files, 0, sizeof(files));
+    for (int i = 0; i < WATCH_INPUT_COUNT; i++) files[i].wd = -1;
+    if (specs_path && add_watch(fd, &files[WATCH_SPECS], specs_path) < 0) goto out;
+    snprintf(path, sizeof(path), "%s/plccplug.scad", root);
+    if (add_watch(fd, &files[WATCH_PLUG_SCAD], path) < 0) goto out;
+    snprintf(path, sizeof(path), "%s/plcc_specs.scad", root);
+    if (add_watch(fd, &files[WATCH_SPEC_SCAD], path) < 0) goto out;
+    scad = read_file(path, &scad_size);
+    snprintf(path, sizeof(path), "%s/angle_header.scad", root);
+    if (add_watch(fd, &files[WATCH_HEADER_SCAD], path) < 0) goto out;
+    if (add_watch(fd, &files[WATCH_SELF], self) < 0) goto out;
+
+    // Catch up with whatever changed while nobody was watching
+    int count = 0;
+    for (int i = 0; i < catalog->count; i++) {
+        add_footprint_jobs(job_list, &count, root, &catalog->specs[i]);
+    }
+    printf("Watching");
+    for (int i = 0; i < WATCH_INPUT_COUNT; i++) {
+        if (files[i].wd >= 0) printf(" %s", files[i].path);
+    }
+    printf("\n");
+    run_watch_batch(&batch, count, jobs);
+
+    for (;;) {
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        int changed[WATCH_INPUT_COUNT] = {0};
+        if (poll(&pfd, 1, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        // Debounce: an editor save or a build is a burst of events
+        do {
+            if (read_watch_events(fd, files, changed) < 0) goto out;
+        } while (poll(&pfd, 1, WATCH_DEBOUNCE_MS) > 0);
+
+        if (changed[WATCH_SELF] && access(self, X_OK) == 0) {
+            printf("%s was rebuilt, restarting\n", self);
+            fflush(stdout);
+            close(fd);
+            execv(self, argv);
+            perror("Error restarting");
+            goto out;
+        }
+
+        count = 0;
+        if (changed[WATCH_SPECS]) {
+            watch_catalog_t* next = catalog == &catalogs[0] ? &catalogs[1] : &catalogs[0];
+            if (load_watch_catalog(specs_path, next) == 0) {
+                for (int i = 0; i < next->count; i++) {
+                    const component_spec_t* old = NULL;
+                    for (int k = 0; k < catalog->count && !old; k++) {
+                        if (strcasecmp(catalog->specs[k].name, next->specs[i].name) == 0) old = &catalog->specs[k];
+                    }
+                    if (!old || memcmp(old, &next->specs[i], sizeof(*old)) != 0) {
+                        add_footprint_jobs(job_list, &count, root, &next->specs[i]);
+                    }
+                }
+                catalog = next;
+            }
+        }
+
+        int stl[16] = {0}, wrl[16] = {0}, all_stl = 0, all_wrl = 0;
+        if (changed[WATCH_PLUG_SCAD] || changed[WATCH_SPEC_SCAD]) {
+            size_t size = 0;
+            char* text = read_file(files[WATCH_SPEC_SCAD].path, &size);
+            int pins[16];
+            int n = text && scad && !changed[WATCH_PLUG_SCAD] ?
+                    scad_changed_pins(scad, scad_size, text, size, pins, 16) : -1;
+            for (int i = 0; i < num_plug_specs; i++) {
+                for (int k = 0; k < n; k++) {
+                    if (plug_specs[i].pins == pins[k]) stl[i] = wrl[i] = 1;
+                }
+                if (n < 0) stl[i] = wrl[i] = 1;
+            }
+            all_stl = all_wrl = n != 0;
+            if (text) {
+                free(scad);
+                scad = text;
+                scad_size = size;
+            }
+        }
+        if (changed[WATCH_HEADER_SCAD]) {
+            for (int i = 0; i < num_plug_specs; i++) wrl[i] = 1;
+            all_wrl = 1;
+        }
+        for (int i = 0; i < num_plug_specs; i++) {
+            if (stl[i]) add_model_job(job_list, &count, root, WATCH_STL, plug_specs[i].pins);
+            if (wrl[i]) add_model_job(job_list, &count, root, WATCH_WRL, plug_specs[i].pins);
+        }
+        if (all_stl) add_model_job(job_list, &count, root, WATCH_STL, 0);
+        if (all_wrl) add_model_job(job_list, &count, root, WATCH_WRL, 0);
+        run_watch_batch(&batch, count, jobs);
+    }
+
+out:
+    if (fd >= 0) close(fd);
+    free(scad);
+    free(job_list);
+    return ret;
+}
@@ -0,0 +1,15 @@
+/* Watch mode for plcc-gen
+ * GPL-2
+ * (C) 2021-2025 Stefan Reinauer <stefan.reinauer@coreboot.org>
+ */
+
+#ifndef PLCC_WATCH_H
+#define PLCC_WATCH_H
+
+#include "plcc-gen.h"
+
+#define DEFAULT_OPENSCAD "openscad-nightly"
+
+int run_watch(const char* root, const char* specs_path, const char* openscad, int jobs, char** argv);
+
+#endif